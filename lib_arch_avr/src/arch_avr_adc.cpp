@@ -72,7 +72,9 @@ bool ArchAVR_ADC::init(Device& device)
                              m_config.int_vector);
 
     m_timer.init(*device.cycle_manager(), logger());
-    m_timer.signal().connect(*this);
+    m_timer.tick_signal().connect<ArchAVR_ADC, &ArchAVR_ADC::timer_raised>(*this);
+
+    add_state_timer(m_timer);
 
     return status;
 }
@@ -106,6 +108,35 @@ bool ArchAVR_ADC::ctlreq(ctlreq_id_t req, ctlreq_data_t* data)
     return false;
 }
 
+bool ArchAVR_ADC::save_state(std::vector<uint8_t>& state) const
+{
+    StateWriter writer(state);
+    m_timer.save_state(writer);
+    writer.write(m_state);
+    writer.write(m_first);
+    writer.write(m_trigger);
+    writer.write(m_latched_ch_mux);
+    writer.write(m_latched_ref_mux);
+    writer.write(m_conv_value);
+    return true;
+}
+
+bool ArchAVR_ADC::load_state(const uint8_t* state, size_t len)
+{
+    StateReader reader(state, len);
+    m_timer.load_state(reader);
+    reader.read(m_state);
+    reader.read(m_first);
+    reader.read(m_trigger);
+    reader.read(m_latched_ch_mux);
+    reader.read(m_latched_ref_mux);
+    reader.read(m_conv_value);
+
+    m_intflag.update_from_ioreg();
+
+    return reader.complete();
+}
+
 
 //=======================================================================================
 //I/O register callback reimplementation
@@ -183,7 +214,7 @@ void ArchAVR_ADC::reset_prescaler()
  */
 void ArchAVR_ADC::start_conversion_cycle()
 {
-    logger().dbg("Starting a conversion cycle");
+    LOGGER_DBG(logger(), "Starting a conversion cycle");
 
     m_state = ADC_PendingConversion;
 
@@ -212,7 +243,7 @@ void ArchAVR_ADC::start_conversion_cycle()
 
 void ArchAVR_ADC::read_analog_value()
 {
-    logger().dbg("Reading analog value");
+    LOGGER_DBG(logger(), "Reading analog value");
 
     //Find the channel mux configuration
     auto ch_config = find_reg_config_p<channel_config_t>(m_config.channels, m_latched_ch_mux);
@@ -293,9 +324,9 @@ void ArchAVR_ADC::read_analog_value()
 }
 
 
-void ArchAVR_ADC::raised(const signal_data_t& sigdata, int)
+void ArchAVR_ADC::timer_raised(const PrescaledTimer::tick_event_t& event, int)
 {
-    if (sigdata.index != 1) return;
+    if (!event.timeout) return;
 
     if (m_state == ADC_PendingConversion) {
         //Raise the signal
@@ -323,11 +354,11 @@ void ArchAVR_ADC::raised(const signal_data_t& sigdata, int)
         m_first = false;
 
         if (m_intflag.set_flag())
-            logger().dbg("Interrupt triggered");
+            LOGGER_DBG(logger(), "Interrupt triggered");
 
         //If free running auto-trigger is enabled, start a new conversion cycle
         if (m_trigger == CFG::Trig_FreeRunning) {
-            logger().dbg("In free running, starting a new conversion");
+            LOGGER_DBG(logger(), "In free running, starting a new conversion");
             start_conversion_cycle();
         }
     }
@@ -348,7 +379,7 @@ void ArchAVR_ADC::write_digital_value()
     else
         r = (sign << 10) | v;
 
-    logger().dbg("Converted value: 0x%04x", r);
+    LOGGER_DBG(logger(), "Converted value: 0x%04x", r);
 
     write_ioreg(m_config.reg_datah, r >> 8);
     write_ioreg(m_config.reg_datal, r & 0x00FF);
@@ -365,9 +396,9 @@ void ArchAVR_ADC::sleep(bool on, SleepMode mode)
 {
     if (mode > SleepMode::ADC) {
         if (on)
-            logger().dbg("Pausing");
+            LOGGER_DBG(logger(), "Pausing");
         else
-            logger().dbg("Resuming");
+            LOGGER_DBG(logger(), "Resuming");
 
         m_timer.set_paused(on);
     }
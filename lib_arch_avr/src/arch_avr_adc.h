@@ -118,8 +118,7 @@ struct ArchAVR_ADCConfig {
     an external trigger source is selected.
  */
 class AVR_ARCHAVR_PUBLIC_API ArchAVR_ADC : public ADC,
-                                           public Peripheral,
-                                           public SignalHook {
+                                           public Peripheral {
 
 public:
 
@@ -128,10 +127,11 @@ public:
     virtual bool init(Device& device) override;
     virtual void reset() override;
     virtual bool ctlreq(ctlreq_id_t req, ctlreq_data_t* data) override;
+    virtual bool save_state(std::vector<uint8_t>& state) const override;
+    virtual bool load_state(const uint8_t* state, size_t len) override;
     virtual uint8_t ioreg_read_handler(reg_addr_t addr, uint8_t value) override;
     virtual void ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& data) override;
     virtual void sleep(bool on, SleepMode mode) override;
-    virtual void raised(const signal_data_t& sigdata, int hooktag) override;
 
 private:
 
@@ -174,7 +174,7 @@ private:
 
     void start_conversion_cycle();
     void reset_prescaler();
-    void timer_raised();
+    void timer_raised(const PrescaledTimer::tick_event_t& event, int);
 
     void read_analog_value();
     void write_digital_value();
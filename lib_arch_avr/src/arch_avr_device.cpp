@@ -51,7 +51,7 @@ uint8_t ArchAVR_Core::cpu_read_data(mem_addr_t data_addr)
         value = m_sram[data_addr - m_config.ramstart];
     }
     else if (!m_device->test_option(Device::Option_IgnoreBadCpuIO)) {
-        m_device->logger().err("CPU reading an invalid data address: 0x%04x", data_addr);
+        m_device->logger().err("CPU reading an invalid data address: 0x%04lx", data_addr);
         m_device->crash(CRASH_BAD_CPU_IO, "Bad data address");
     }
 
@@ -73,7 +73,7 @@ void ArchAVR_Core::cpu_write_data(mem_addr_t data_addr, uint8_t value)
         m_sram[data_addr - m_config.ramstart] = value;
     }
     else if (!m_device->test_option(Device::Option_IgnoreBadCpuIO)) {
-        m_device->logger().err("CPU writing an invalid data address: 0x%04x", data_addr);
+        m_device->logger().err("CPU writing an invalid data address: 0x%04lx", data_addr);
         m_device->crash(CRASH_BAD_CPU_IO, "Bad data address");
     }
 
@@ -154,7 +154,10 @@ bool ArchAVR_Device::program(const Firmware& firmware)
     if (!Device::program(firmware))
         return false;
 
-    if (firmware.has_memory(Firmware::Area_EEPROM)) {
+    if (m_core_impl.m_eeprom.persisted()) {
+        logger().dbg("Firmware load: EEPROM content restored from its backing file");
+    }
+    else if (firmware.has_memory(Firmware::Area_EEPROM)) {
         if (firmware.load_memory(Firmware::Area_EEPROM, m_core_impl.m_eeprom)) {
             logger().dbg("Firmware load: EEPROM loaded");
         } else {
@@ -47,6 +47,27 @@ ArchAVR_ExtInt::ArchAVR_ExtInt(const ArchAVR_ExtIntConfig& config)
 ,m_extint_pin_value(0)
 {}
 
+/*
+ * Destructor of a ExtInt controller. The pin signals do not disconnect
+ * their receivers automatically.
+ */
+ArchAVR_ExtInt::~ArchAVR_ExtInt()
+{
+    if (!device()) return;
+
+    for (int i = 0; i < EXTINT_PIN_COUNT; ++i) {
+        Pin* pin = device()->find_pin(m_config.extint_pins[i]);
+        if (pin)
+            pin->digital_signal().disconnect(this);
+    }
+
+    for (int i = 0; i < PCINT_PIN_COUNT; ++i) {
+        Pin* pin = device()->find_pin(m_config.pcint_pins[i]);
+        if (pin)
+            pin->digital_signal().disconnect(this);
+    }
+}
+
 /*
  * Initialisation of a ExtInt controller
  */
@@ -82,7 +103,7 @@ bool ArchAVR_ExtInt::init(Device& device)
         pin_id_t pin_id = m_config.extint_pins[i];
         Pin* pin = device.find_pin(pin_id);
         if (pin)
-            pin->signal().connect(*this, i);
+            pin->digital_signal().connect<ArchAVR_ExtInt, &ArchAVR_ExtInt::pin_raised>(*this, i);
     }
 
     //Find the pins for Pin Change and connect the hook mapper to their signals
@@ -90,7 +111,7 @@ bool ArchAVR_ExtInt::init(Device& device)
         pin_id_t pin_id = m_config.pcint_pins[i];
         Pin* pin = device.find_pin(pin_id);
         if (pin)
-            pin->signal().connect(*this, 0x100 | i);
+            pin->digital_signal().connect<ArchAVR_ExtInt, &ArchAVR_ExtInt::pin_raised>(*this, 0x100 | i);
     }
 
     return status;
@@ -170,11 +191,8 @@ void ArchAVR_ExtInt::interrupt_ack_handler(int_vect_t vector)
     }
 }
 
-void ArchAVR_ExtInt::raised(const signal_data_t& sigdata, int hooktag)
+void ArchAVR_ExtInt::pin_raised(const bool& pin_level, int hooktag)
 {
-    if (sigdata.sigid != Pin::Signal_DigitalChange) return;
-
-    bool pin_level = sigdata.data.as_uint();
     uint8_t pin_num = hooktag & 0x00FF;
     bool is_pc = (hooktag & 0x0100);
 
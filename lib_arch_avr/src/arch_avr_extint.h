@@ -73,8 +73,7 @@ struct ArchAVR_ExtIntConfig {
    \brief Implementation of a model for a External Interrupts peripheral for AVR series
  */
 class AVR_ARCHAVR_PUBLIC_API ArchAVR_ExtInt : public Peripheral,
-                                             public InterruptHandler,
-                                             public SignalHook {
+                                             public InterruptHandler {
 
 public:
 
@@ -84,6 +83,7 @@ public:
     };
 
     explicit ArchAVR_ExtInt(const ArchAVR_ExtIntConfig& config);
+    virtual ~ArchAVR_ExtInt();
 
     virtual bool init(Device& device) override;
     virtual void reset() override;
@@ -91,8 +91,6 @@ public:
     virtual void ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& data) override;
     virtual void interrupt_ack_handler(int_vect_t vector) override;
 
-    virtual void raised(const signal_data_t& sigdata, int hooktag) override;
-
 private:
 
     const ArchAVR_ExtIntConfig& m_config;
@@ -103,6 +101,7 @@ private:
     uint8_t m_pcint_pin_value[PCINT_BANK_COUNT];
 
     uint8_t get_extint_mode(uint8_t pin) const;
+    void pin_raised(const bool& pin_level, int hooktag);
 
 };
 
@@ -47,11 +47,7 @@ ArchAVR_IntCtrl::ArchAVR_IntCtrl(unsigned int size)
  */
 int_vect_t ArchAVR_IntCtrl::get_next_irq() const
 {
-    for (int_vect_t i = 0; i < intr_count(); ++i) {
-        if (interrupt_raised(i))
-            return i;
-    }
-    return AVR_INTERRUPT_NONE;
+    return first_raised();
 }
 
 
@@ -73,33 +73,20 @@ void ArchAVR_Port::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& dat
         update_pin_states(m_portr_value, data.value);
         m_ddr_value = data.value;
     }
-    //Writing a 1 to PINR toggles the pin state
+    //Writing a 1 to PINR toggles the pin state, PINR itself keeps the pin values
     else if (addr == m_config.reg_pin) {
+        write_ioreg(m_config.reg_pin, data.old);
         uint8_t port_value = read_ioreg(m_config.reg_port) ^ (data.value & pin_mask());
         write_ioreg(m_config.reg_port, port_value);
         update_pin_states(port_value, m_ddr_value);
-        m_portr_value = data.value;
+        m_portr_value = port_value;
     }
 }
 
 void ArchAVR_Port::update_pin_states(uint8_t portr, uint8_t ddr)
 {
-    //Filters the pins to update to only those for which portr or ddr has actually changed
-    uint8_t pinmask = ((portr ^ m_portr_value) | (ddr ^ m_ddr_value)) & pin_mask();
-    Pin::State state;
-    for (int i = 0; i < 8; ++i) {
-        if (pinmask & 1) {
-            if (ddr & 1) {
-                state = portr & 1 ? Pin::State_High : Pin::State_Low;
-            } else {
-                state = portr & 1 ? Pin::State_PullUp : Pin::State_Floating;
-            }
-            set_pin_internal_state(i, state);
-        }
-        pinmask >>= 1;
-        portr >>= 1;
-        ddr >>= 1;
-    }
+    //Driven pins output PORTR, the others have the pull-up enabled by PORTR
+    set_pin_internal_states(ddr, portr, portr);
 }
 
 /*
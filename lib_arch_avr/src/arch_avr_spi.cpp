@@ -29,8 +29,6 @@ YASIMAVR_USING_NAMESPACE
 
 //=======================================================================================
 
-#define HOOKTAG_SPI         0
-#define HOOKTAG_PIN         1
 
 const uint32_t ClockFactors[] = {4, 16, 64, 128};
 
@@ -43,6 +41,13 @@ ArchAVR_SPI::ArchAVR_SPI(uint8_t num, const ArchAVR_SPIConfig& config)
 ,m_intflag(true)
 {}
 
+ArchAVR_SPI::~ArchAVR_SPI()
+{
+    //The pin signals do not disconnect their receivers automatically
+    if (m_pin_select)
+        m_pin_select->digital_signal().disconnect(this);
+}
+
 bool ArchAVR_SPI::init(Device& device)
 {
     bool status = Peripheral::init(device);
@@ -63,10 +68,15 @@ bool ArchAVR_SPI::init(Device& device)
     m_spi.init(*device.cycle_manager(), logger());
     m_spi.set_tx_buffer_limit(1);
     m_spi.set_rx_buffer_limit(2);
-    m_spi.signal().connect(*this, HOOKTAG_SPI);
+    m_spi.signal().connect(*this);
 
     m_pin_select = device.find_pin(m_config.pin_select);
-    m_pin_select->signal().connect(*this, HOOKTAG_PIN);
+    if (m_pin_select)
+        m_pin_select->digital_signal().connect<ArchAVR_SPI, &ArchAVR_SPI::pin_raised>(*this);
+    else
+        status = false;
+
+    add_state_timer(m_spi);
 
     return status;
 }
@@ -103,6 +113,25 @@ bool ArchAVR_SPI::ctlreq(ctlreq_id_t req, ctlreq_data_t* data)
     return false;
 }
 
+bool ArchAVR_SPI::save_state(std::vector<uint8_t>& state) const
+{
+    StateWriter writer(state);
+    m_spi.save_state(writer);
+    writer.write(m_pin_selected);
+    return true;
+}
+
+bool ArchAVR_SPI::load_state(const uint8_t* state, size_t len)
+{
+    StateReader reader(state, len);
+    m_spi.load_state(reader);
+    reader.read(m_pin_selected);
+
+    m_intflag.update_from_ioreg();
+
+    return reader.complete();
+}
+
 uint8_t ArchAVR_SPI::ioreg_read_handler(reg_addr_t addr, uint8_t value)
 {
     if (addr == m_config.reg_data) {
@@ -142,21 +171,21 @@ void ArchAVR_SPI::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& data
         m_spi.set_host_mode(m_config.rb_mode.extract(data.value));
 }
 
-void ArchAVR_SPI::raised(const signal_data_t& sigdata, int hooktag)
+void ArchAVR_SPI::raised(const signal_data_t& sigdata, int)
 {
-    if (sigdata.sigid != Pin::Signal_DigitalChange) return;
-
     //On completion of a transfer, raise the interrupt flag
-    if (hooktag == HOOKTAG_SPI) {
-        if (sigdata.sigid == SPI::Signal_HostTfrComplete ||
-            sigdata.sigid == SPI::Signal_ClientTfrComplete)
-            m_intflag.set_flag();
-    }
-    //Signal of pin state change, check if we're selected
-    else if (hooktag == HOOKTAG_PIN) {
-        m_pin_selected = !sigdata.data.as_uint();
-        m_spi.set_selected(m_pin_selected && test_ioreg(m_config.rb_enable));
-    }
+    if (sigdata.sigid == SPI::Signal_HostTfrComplete ||
+        sigdata.sigid == SPI::Signal_ClientTfrComplete)
+        m_intflag.set_flag();
+}
+
+/*
+ * Callback for a digital change of the select pin, check if we're selected
+ */
+void ArchAVR_SPI::pin_raised(const bool& pin_level, int)
+{
+    m_pin_selected = !pin_level;
+    m_spi.set_selected(m_pin_selected && test_ioreg(m_config.rb_enable));
 }
 
 void ArchAVR_SPI::update_framerate()
@@ -64,6 +64,9 @@ struct ArchAVR_Timer::OutputCompareChannel {
     uint16_t reg;
     bool active;
     unsigned char state;
+    //True if the waveform is steady and described by 'waveform'
+    bool steady;
+    waveform_t waveform;
     InterruptFlag intflag;
 
     OutputCompareChannel(const CFG::OC_config_t& cfg)
@@ -72,6 +75,8 @@ struct ArchAVR_Timer::OutputCompareChannel {
     ,reg(0)
     ,active(false)
     ,state(false)
+    ,steady(false)
+    ,waveform({ 0, 0, 0, false })
     ,intflag(true)
     {}
 
@@ -80,6 +85,7 @@ struct ArchAVR_Timer::OutputCompareChannel {
         reg = 0;
         active = false;
         state = false;
+        steady = false;
         intflag.update_from_ioreg();
     }
 
@@ -94,6 +100,8 @@ ArchAVR_Timer::ArchAVR_Timer(int num, const CFG& config)
 ,m_counter(m_timer, (m_config.is_16bits ? 0x10000 : 0x100), m_config.oc_channels.size())
 ,m_intflag_ovf(true)
 ,m_intflag_icr(true)
+,m_signal_exported(false)
+,m_waveform_exported(false)
 {
     //Calculate the prescaler max value by looking for the highest division factor
     unsigned long maxdiv = 0;
@@ -172,6 +180,8 @@ bool ArchAVR_Timer::init(Device& device)
     m_counter.set_logger(&logger());
     m_counter.signal().connect(*this);
 
+    add_state_timer(m_timer);
+
     return status;
 }
 
@@ -191,11 +201,16 @@ void ArchAVR_Timer::reset()
     }
 
     for (size_t i = 0; i < m_oc_channels.size(); ++i) {
+        if (m_oc_channels[i]->steady)
+            m_waveform_signal.raise(WaveformSignal_Period, vardata_t(), i);
+
         m_oc_channels[i]->reset();
-        m_signal.raise(signal_data_t{Signal_CompOutput, (long long) i, vardata_t()});
+        raise_OC_state(i, vardata_t());
 
         m_counter.set_comp_enabled(i,  true);
     }
+
+    update_observed_events();
 }
 
 
@@ -203,6 +218,33 @@ bool ArchAVR_Timer::ctlreq(ctlreq_id_t req, ctlreq_data_t* data)
 {
     if (req == AVR_CTLREQ_GET_SIGNAL) {
         data->data = &m_signal;
+        if (!m_signal_exported) {
+            //The edges of the steady outputs are signalled from now on,
+            //starting from their current state
+            m_timer.update();
+            sync_OC_states(m_timer.last_tick_cycle());
+            m_signal_exported = true;
+            for (size_t i = 0; i < m_oc_channels.size(); ++i) {
+                if (m_oc_channels[i]->active)
+                    m_signal.set_data(Signal_CompOutput, m_oc_channels[i]->state, i);
+            }
+
+            update_observed_events();
+            if (m_counter.tick_source() == TimerCounter::Tick_Timer)
+                m_counter.reschedule();
+        }
+        return true;
+    }
+    else if (req == AVR_CTLREQ_TMR_GET_WAVEFORM_SIGNAL) {
+        data->data = &m_waveform_signal;
+        if (!m_waveform_exported) {
+            m_timer.update();
+            m_waveform_exported = true;
+            update_waveforms();
+            update_observed_events();
+            if (m_counter.tick_source() == TimerCounter::Tick_Timer)
+                m_counter.reschedule();
+        }
         return true;
     }
     else if (req == AVR_CTLREQ_TMR_GET_EXTCLK_HOOK) {
@@ -217,11 +259,106 @@ bool ArchAVR_Timer::ctlreq(ctlreq_id_t req, ctlreq_data_t* data)
 }
 
 
+bool ArchAVR_Timer::save_state(std::vector<uint8_t>& state) const
+{
+    StateWriter writer(state);
+    m_timer.save_state(writer);
+    m_counter.save_state(writer);
+    writer.write(m_icr);
+    writer.write(m_temp);
+    writer.write(m_mode);
+    for (const OutputCompareChannel* oc : m_oc_channels) {
+        writer.write(oc->mode);
+        writer.write(oc->reg);
+        writer.write(oc->active);
+        writer.write(oc->state);
+        writer.write(oc->steady);
+        writer.write(oc->waveform);
+    }
+    //The events observed by the counter depend on the users of the signals
+    writer.write(m_signal_exported);
+    writer.write(m_waveform_exported);
+    return true;
+}
+
+
+bool ArchAVR_Timer::load_state(const uint8_t* state, size_t len)
+{
+    StateReader reader(state, len);
+    m_timer.load_state(reader);
+    m_counter.load_state(reader);
+    reader.read(m_icr);
+    reader.read(m_temp);
+    reader.read(m_mode);
+    for (OutputCompareChannel* oc : m_oc_channels) {
+        reader.read(oc->mode);
+        reader.read(oc->reg);
+        reader.read(oc->active);
+        reader.read(oc->state);
+        reader.read(oc->steady);
+        reader.read(oc->waveform);
+    }
+    bool signal_exported = false, waveform_exported = false;
+    reader.read(signal_exported);
+    reader.read(waveform_exported);
+
+    if (!reader.complete()) return false;
+
+    m_intflag_ovf.update_from_ioreg();
+    if (m_config.reg_icr.valid())
+        m_intflag_icr.update_from_ioreg();
+    for (OutputCompareChannel* oc : m_oc_channels)
+        oc->intflag.update_from_ioreg();
+
+    //If the signals are not used as they were at the capture, the observed
+    //events are recalculated, from the current state of the outputs
+    bool resync = (signal_exported != m_signal_exported) || (waveform_exported != m_waveform_exported);
+    if (resync) {
+        //Bring the outputs up to date, as the capture would have
+        bool sig_exported = m_signal_exported, wf_exported = m_waveform_exported;
+        m_signal_exported = signal_exported;
+        m_waveform_exported = waveform_exported;
+        m_timer.update();
+        sync_OC_states(m_timer.last_tick_cycle());
+        m_signal_exported = sig_exported;
+        m_waveform_exported = wf_exported;
+
+        if (!m_waveform_exported) {
+            for (OutputCompareChannel* oc : m_oc_channels)
+                oc->steady = false;
+        }
+    }
+
+    //Announce the restored state of the outputs
+    for (size_t i = 0; i < m_oc_channels.size(); ++i) {
+        OutputCompareChannel* oc = m_oc_channels[i];
+        if (oc->steady) {
+            waveform_t waveform = oc->waveform;
+            oc->steady = false;
+            set_waveform(i, &waveform);
+        }
+        raise_OC_state(i, oc->active ? vardata_t(oc->state) : vardata_t());
+    }
+
+    if (resync) {
+        update_waveforms();
+        update_observed_events();
+        if (m_counter.tick_source() == TimerCounter::Tick_Timer)
+            m_counter.reschedule();
+    }
+
+    return true;
+}
+
+
 uint8_t ArchAVR_Timer::ioreg_read_handler(reg_addr_t addr, uint8_t value)
 {
-    //reading of interrupt flags
-    if (addr == m_config.reg_int_flag)
+    //reading of interrupt flags, the value is re-read as the update may have
+    //processed events not observed so far and changed the flags
+    if (addr == m_config.reg_int_flag) {
         m_timer.update();
+        value = read_ioreg(addr);
+    }
 
     //8 or 16 bits reading of CNTx
     else if (addr == m_config.reg_cnt) {
@@ -253,6 +390,10 @@ void ArchAVR_Timer::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& da
     bool do_reschedule = false;
     bool do_com_reconfig = false;
 
+    //Process the counter events not observed so far, before any change
+    m_timer.update();
+    sync_OC_states(m_timer.last_tick_cycle());
+
     //8 or 16 bits writing to CNTx
     if (addr == m_config.reg_cnt) {
         m_counter.set_counter((m_temp << 8) | data.value);
@@ -296,8 +437,12 @@ void ArchAVR_Timer::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& da
                 break;
             }
             else if (addr == oc->config.rb_force.addr && oc->config.rb_force.extract(data.value)) {
-                if (!m_mode.disable_foc)
+                if (!m_mode.disable_foc) {
+                    //Forcing the output breaks the steady waveform, it is recalculated afterwards
+                    set_waveform(i, nullptr);
                     change_OC_state(i, TimerCounter::Event_Compare);
+                    do_reschedule = true;
+                }
                 clear_ioreg(oc->config.rb_force);
                 break;
             }
@@ -339,6 +484,10 @@ void ArchAVR_Timer::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& da
             do_com_reconfig = true;
         }
 
+        //Enabling or disabling interrupts changes the counter events to observe
+        if (addr == m_config.reg_int_enable)
+            do_reschedule = true;
+
         //If we're writing a 1 to a interrupt flag bit, it cancels the corresponding interrupt if it
         //has not been executed yet
         if (addr == m_config.reg_int_flag) {
@@ -367,16 +516,343 @@ void ArchAVR_Timer::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& da
             oc->active = output_active(oc->mode, i);
             //If the ocm is inactive, ensure the output level is reset
             if (old_active && !oc->active)
-                m_signal.raise(Signal_CompOutput, vardata_t(), i);
+                raise_OC_state(i, vardata_t());
             //If the ocm is activated, ensure the output level is up-to-date
             else if (oc->active && !old_active)
-                m_signal.raise(Signal_CompOutput, oc->state, i);
+                raise_OC_state(i, oc->state);
         }
         do_reschedule = true;
     }
 
-    if (do_reschedule)
+    if (do_reschedule) {
+        update_waveforms();
+        update_observed_events();
         m_counter.reschedule();
+    }
+}
+
+
+/*
+ * Determine the counter events which have an observable effect and must be processed
+ * when they are reached: the events raising an enabled interrupt, all of them if the
+ * edges of an output are signalled (including while its waveform is not steady yet),
+ * MAX/TOP/BOTTOM if the signal is used by another object, and TOP/BOTTOM if a buffered
+ * compare value is waiting to be updated.
+ * The other events are processed when the counter or the flags are accessed.
+ */
+void ArchAVR_Timer::update_observed_events()
+{
+    bool observe_all = m_signal_exported;
+    for (size_t i = 0; i < m_oc_channels.size(); ++i)
+        observe_all |= OC_edges_signalled(i);
+
+    uint8_t events = 0;
+    if (observe_all || (m_config.vect_ovf.num && test_ioreg(m_config.reg_int_enable, m_config.vect_ovf.bit)))
+        events = TimerCounter::Event_Max | TimerCounter::Event_Top | TimerCounter::Event_Bottom;
+
+    if (m_mode.ocr != CFG::OCR_Unbuffered) {
+        for (size_t i = 0; i < m_oc_channels.size(); ++i) {
+            if (m_oc_channels[i]->reg != m_counter.comp_value(i))
+                events |= TimerCounter::Event_Top | TimerCounter::Event_Bottom;
+        }
+    }
+
+    m_counter.set_observed_events(events);
+
+    for (size_t i = 0; i < m_oc_channels.size(); ++i) {
+        const CFG::vector_config_t& v = m_oc_channels[i]->config.vector;
+        bool observed = OC_edges_signalled(i) || (v.num && test_ioreg(m_config.reg_int_enable, v.bit));
+        m_counter.set_comp_observed(i, observed);
+    }
+}
+
+
+/*
+ * The edges of an output are signalled if it is active and its waveform is not
+ * steady, or if the timer signal is used by another object.
+ */
+bool ArchAVR_Timer::OC_edges_signalled(size_t index) const
+{
+    const OutputCompareChannel* oc = m_oc_channels[index];
+    return oc->active && (!oc->steady || m_signal_exported);
+}
+
+
+/*
+ * Level of a steady waveform at a given cycle
+ */
+static unsigned char waveform_level(const ArchAVR_Timer::waveform_t& waveform, cycle_count_t cycle)
+{
+    if (!waveform.duty || waveform.duty == waveform.period)
+        return waveform.duty ? 1 : 0;
+
+    cycle_count_t phase = (cycle - waveform.start) % waveform.period;
+    if (phase < 0)
+        phase += waveform.period;
+
+    return phase < waveform.duty ? 1 : 0;
+}
+
+
+static bool same_waveform(const ArchAVR_Timer::waveform_t& a, const ArchAVR_Timer::waveform_t& b)
+{
+    if (a.period != b.period || a.duty != b.duty || a.inverted != b.inverted)
+        return false;
+
+    if (!a.duty || a.duty == a.period)
+        return true;
+
+    return ((a.start - b.start) % a.period) == 0;
+}
+
+
+/*
+ * Bring up to date the state of the outputs whose edges are not signalled,
+ * from their waveform descriptor. ref_cycle is the cycle of the last counter tick.
+ */
+void ArchAVR_Timer::sync_OC_states(cycle_count_t ref_cycle)
+{
+    for (size_t i = 0; i < m_oc_channels.size(); ++i) {
+        OutputCompareChannel* oc = m_oc_channels[i];
+        if (oc->active && !OC_edges_signalled(i))
+            oc->state = waveform_level(oc->waveform, ref_cycle);
+    }
+}
+
+
+/*
+ * Set the waveform descriptor of an output, or clear it with nullptr,
+ * and raise the signal if it changed.
+ */
+void ArchAVR_Timer::set_waveform(size_t index, const waveform_t* waveform)
+{
+    OutputCompareChannel* oc = m_oc_channels[index];
+
+    if (waveform) {
+        if (!oc->steady || !same_waveform(*waveform, oc->waveform)) {
+            oc->waveform = *waveform;
+            oc->steady = true;
+            logger().dbg("OC %zu waveform: period=%lld duty=%lld", index,
+                         oc->waveform.period, oc->waveform.duty);
+            m_waveform_signal.set_data(WaveformSignal_Start, oc->waveform.start, index);
+            m_waveform_signal.set_data(WaveformSignal_Duty, oc->waveform.duty, index);
+            m_waveform_signal.set_data(WaveformSignal_Inverted, oc->waveform.inverted ? 1 : 0, index);
+            m_waveform_signal.raise(WaveformSignal_Period, oc->waveform.period, index);
+        }
+    }
+    else if (oc->steady) {
+        oc->steady = false;
+        m_waveform_signal.raise(WaveformSignal_Period, vardata_t(), index);
+        //Resume the signalling of the edges from the current state
+        if (oc->active && !m_signal_exported)
+            m_signal.raise(Signal_CompOutput, oc->state, index);
+        m_waveform_signal.raise(WaveformSignal_Level, oc->active ? vardata_t(oc->state) : vardata_t(), index);
+    }
+}
+
+
+/*
+ * Raise the state of an output on the timer signal and, while its waveform is not
+ * steady, on the waveform signal.
+ */
+void ArchAVR_Timer::raise_OC_state(size_t index, const vardata_t& state)
+{
+    m_signal.raise(Signal_CompOutput, state, index);
+    if (m_waveform_exported && !m_oc_channels[index]->steady)
+        m_waveform_signal.raise(WaveformSignal_Level, state, index);
+}
+
+
+/*
+ * Recalculate the waveforms of all the outputs, if the waveform signal is used.
+ * The states of the outputs must be up to date.
+ */
+void ArchAVR_Timer::update_waveforms()
+{
+    if (!m_waveform_exported) return;
+
+    cycle_count_t ref_cycle = m_timer.last_tick_cycle();
+
+    for (size_t i = 0; i < m_oc_channels.size(); ++i) {
+        waveform_t waveform;
+        if (m_oc_channels[i]->active && calculate_waveform(i, ref_cycle, waveform))
+            set_waveform(i, &waveform);
+        else
+            set_waveform(i, nullptr);
+    }
+}
+
+
+/*
+ * Determine the new state of an output on an event, depending on the COM settings
+ */
+static unsigned char OC_next_state(const CFG::COM_config_t& mode, int event_flags,
+                                   bool countdown, unsigned char state)
+{
+    //TODO: Take into account edge cases (such as OCRx == BOTTOM or TOP)
+    bool do_clear = false;
+    bool do_set = false;
+    bool do_toggle = false;
+
+    if (event_flags & TimerCounter::Event_Compare) {
+        if (countdown) {
+            do_clear |= mode.down == CFG::COM_Clear;
+            do_set |= mode.down == CFG::COM_Set;
+            do_toggle |= mode.down == CFG::COM_Toggle;
+        } else {
+            do_clear |= mode.up == CFG::COM_Clear;
+            do_set |= mode.up == CFG::COM_Set;
+            do_toggle |= mode.up == CFG::COM_Toggle;
+        }
+    }
+
+    if (event_flags & TimerCounter::Event_Top) {
+        do_clear |= mode.top == CFG::COM_Clear;
+        do_set |= mode.top == CFG::COM_Set;
+        do_toggle |= mode.top == CFG::COM_Toggle;
+    }
+
+    if (event_flags & TimerCounter::Event_Bottom) {
+        do_clear |= mode.bottom == CFG::COM_Clear;
+        do_set |= mode.bottom == CFG::COM_Set;
+        do_toggle |= mode.bottom == CFG::COM_Toggle;
+    }
+
+    if (do_clear && !do_set)
+        return 0;
+    else if (do_set && !do_clear)
+        return 1;
+    else if (do_toggle && !(do_set || do_clear))
+        return state ^ 1;
+    else
+        return state;
+}
+
+
+/*
+ * Determine the state of an output after a counter event, in the same way as raised()
+ * and change_OC_state() do when processing the event.
+ */
+static unsigned char OC_state_after_event(const CFG::COM_config_t& mode, size_t index,
+                                          const TimerCounter::event_t& event, unsigned char state)
+{
+    if (event.comp_mask & (1UL << index))
+        state = OC_next_state(mode, event.type, event.countdown, state);
+
+    if (!(event.type & TimerCounter::Event_Compare)) {
+        if (event.type & TimerCounter::Event_Top)
+            state = OC_next_state(mode, event.type, event.countdown, state);
+        if (event.type & TimerCounter::Event_Bottom)
+            state = OC_next_state(mode, event.type, event.countdown, state);
+    }
+
+    return state;
+}
+
+
+/*
+ * Calculate the steady waveform of an output with the current configuration, by
+ * running its states through the events of three counter periods. The first one
+ * is the transition from the current state, the other two give the waveform, whose
+ * period may be twice the counter period, e.g. with toggling.
+ * Returns false if the waveform is not steady, or not yet.
+ */
+bool ArchAVR_Timer::calculate_waveform(size_t index, cycle_count_t ref_cycle, waveform_t& waveform)
+{
+    OutputCompareChannel* oc = m_oc_channels[index];
+
+    //The waveform can only be steady if the counter is clocked by the prescaler
+    unsigned long ps_factor = m_timer.prescaler_factor();
+    if (m_counter.tick_source() != TimerCounter::Tick_Timer || !ps_factor)
+        return false;
+
+    //A pending update of the compare values would change the waveform at the next TOP or BOTTOM
+    if (m_mode.ocr != CFG::OCR_Unbuffered) {
+        for (size_t i = 0; i < m_oc_channels.size(); ++i) {
+            if (m_oc_channels[i]->reg != m_counter.comp_value(i))
+                return false;
+        }
+    }
+
+    std::vector<TimerCounter::event_t> events;
+    long period = m_counter.period_events(events);
+    if (!period)
+        return false;
+
+    //Run the states, storing the tick (relative to the current state) and the
+    //state after each event
+    const size_t n = events.size();
+    std::vector<std::pair<long, unsigned char>> trace(3 * n);
+    unsigned char state = oc->state;
+    long t = 0;
+    for (size_t k = 0; k < 3 * n; ++k) {
+        const TimerCounter::event_t& ev = events[k % n];
+        t = (k % n) ? (t + ev.delay) : (events[0].delay + (k / n) * period);
+        state = OC_state_after_event(oc->mode, index, ev, state);
+        trace[k] = { t, state };
+    }
+
+    //Collect the edges over the last two periods
+    long rise[2], fall[2];
+    size_t rise_count = 0, fall_count = 0;
+    bool inverted = false;
+    for (size_t k = n; k < 3 * n; ++k) {
+        if (trace[k].second == trace[k - 1].second) continue;
+
+        if (trace[k].second) {
+            if (rise_count < 2) rise[rise_count] = trace[k].first;
+            if (!rise_count) inverted = events[k % n].comp_mask & (1UL << index);
+            ++rise_count;
+        } else {
+            if (fall_count < 2) fall[fall_count] = trace[k].first;
+            ++fall_count;
+        }
+    }
+
+    //The state must come back to where it was at the start of the two periods
+    if (trace[3 * n - 1].second != trace[n - 1].second)
+        return false;
+
+    long wf_period, duty = 0, start = 0;
+    if (!rise_count && !fall_count) {
+        wf_period = period;
+        duty = state ? period : 0;
+    }
+    else if (rise_count == 1 && fall_count == 1) {
+        wf_period = 2 * period;
+    }
+    else if (rise_count == 2 && fall_count == 2 &&
+             (rise[1] - rise[0]) == period && (fall[1] - fall[0]) == period) {
+        wf_period = period;
+    }
+    else {
+        return false;
+    }
+
+    if (rise_count) {
+        start = rise[0];
+        duty = fall[0] - rise[0];
+        if (duty < 0)
+            duty += wf_period;
+    }
+
+    //Check that the current state and the transition period already match the waveform
+    const waveform_t tick_waveform = { start, wf_period, duty, inverted };
+    if (oc->state != waveform_level(tick_waveform, 0))
+        return false;
+
+    for (size_t k = 0; k < n; ++k) {
+        if (trace[k].second != waveform_level(tick_waveform, trace[k].first))
+            return false;
+    }
+
+    //Conversion into clock cycles, the event 't' ticks ahead occurs at ref_cycle + t * ps_factor
+    waveform.start = ref_cycle + start * ps_factor;
+    waveform.period = wf_period * ps_factor;
+    waveform.duty = duty * ps_factor;
+    waveform.inverted = inverted;
+
+    return true;
 }
 
 
@@ -458,6 +934,8 @@ void ArchAVR_Timer::raised(const signal_data_t& sigdata, int)
 
                 if (m_mode.top == CFG::Top_OnCompA)
                     update_top();
+
+                update_observed_events();
             }
 
             if (m_mode.ovf == CFG::OVF_SetOnTop)
@@ -481,6 +959,8 @@ void ArchAVR_Timer::raised(const signal_data_t& sigdata, int)
 
                 if (m_mode.top == CFG::Top_OnCompA)
                     update_top();
+
+                update_observed_events();
             }
 
             if (m_mode.ovf == CFG::OVF_SetOnBottom)
@@ -499,6 +979,20 @@ void ArchAVR_Timer::raised(const signal_data_t& sigdata, int)
             m_intflag_ovf.set_flag();
             m_signal.raise(Signal_OVF, 0);
         }
+
+        //Outputs whose waveform is not steady yet may have become so on TOP or BOTTOM.
+        //These events are observed in that case, so the last tick is the current event.
+        if (m_waveform_exported && (event_flags & (TimerCounter::Event_Top | TimerCounter::Event_Bottom))) {
+            bool unsteady = false;
+            for (auto oc : m_oc_channels)
+                unsteady |= oc->active && !oc->steady;
+
+            if (unsteady) {
+                sync_OC_states(m_timer.last_tick_cycle());
+                update_waveforms();
+                update_observed_events();
+            }
+        }
     }
 
     else if (sigdata.sigid == TimerCounter::Signal_CompMatch) {
@@ -511,51 +1005,16 @@ void ArchAVR_Timer::raised(const signal_data_t& sigdata, int)
 
 void ArchAVR_Timer::change_OC_state(size_t index, int event_flags)
 {
-    OutputCompareChannel* oc = m_oc_channels[index];
-    if (!oc->active) return;
-
-    //Determine the action to perform on the Output Compare state depending
-    //on the COM settings
-    //TODO: Take into account edge cases (such as OCRx == BOTTOM or TOP)
-    bool do_clear = false;
-    bool do_set = false;
-    bool do_toggle = false;
-
-    if (event_flags & TimerCounter::Event_Compare) {
-        if (m_counter.countdown()) {
-            do_clear |= oc->mode.down == CFG::COM_Clear;
-            do_set |= oc->mode.down == CFG::COM_Set;
-            do_toggle |= oc->mode.down == CFG::COM_Toggle;
-        } else {
-            do_clear |= oc->mode.up == CFG::COM_Clear;
-            do_set |= oc->mode.up == CFG::COM_Set;
-            do_toggle |= oc->mode.up == CFG::COM_Toggle;
-        }
-    }
-
-    if (event_flags & TimerCounter::Event_Top) {
-        do_clear |= oc->mode.top == CFG::COM_Clear;
-        do_set |= oc->mode.top == CFG::COM_Set;
-        do_toggle |= oc->mode.top == CFG::COM_Toggle;
-    }
-
-    if (event_flags & TimerCounter::Event_Bottom) {
-        do_clear |= oc->mode.bottom == CFG::COM_Clear;
-        do_set |= oc->mode.bottom == CFG::COM_Set;
-        do_toggle |= oc->mode.bottom == CFG::COM_Toggle;
-    }
+    //If the waveform is steady, the state is obtained from its descriptor when needed
+    if (!OC_edges_signalled(index)) return;
 
+    OutputCompareChannel* oc = m_oc_channels[index];
     unsigned char old_state = oc->state;
-    if (do_clear && !do_set)
-        oc->state = 0;
-    else if (do_set && !do_clear)
-        oc->state = 1;
-    else if (do_toggle && !(do_set || do_clear))
-        oc->state ^= 1;
+    oc->state = OC_next_state(oc->mode, event_flags, m_counter.countdown(), old_state);
 
     if (oc->state != old_state) {
         logger().dbg("OC update from %u to %u", old_state, oc->state);
-        m_signal.raise(Signal_CompOutput, oc->state, index);
+        raise_OC_state(index, oc->state);
     }
 }
 
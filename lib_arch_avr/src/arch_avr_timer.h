@@ -51,6 +51,14 @@ YASIMAVR_BEGIN_NAMESPACE
  */
 #define AVR_CTLREQ_TMR_GET_CAPT_HOOK          2
 
+/**
+   Request to obtain a pointer to the DataSignal describing the steady waveforms of
+   the Compare Outputs. The descriptors are only calculated once this signal has been
+   obtained.
+   \sa ArchAVR_Timer::WaveformSignalId
+ */
+#define AVR_CTLREQ_TMR_GET_WAVEFORM_SIGNAL    3
+
 /// @}
 
 
@@ -225,6 +233,13 @@ struct ArchAVR_TimerConfig {
    It has a number of Output Compare channels, each defined by a OC_config_t structure.
    Each OC channel behaviour is defined by a set of Compare Output Mode (COM) values.
 
+   When the waveform of a Compare Output is periodic and stable, it can be described once
+   by a descriptor on the waveform signal, obtained with AVR_CTLREQ_TMR_GET_WAVEFORM_SIGNAL,
+   instead of signalling each edge. The edges of a steady output are still signalled with
+   Signal_CompOutput if the timer signal has been obtained with AVR_CTLREQ_GET_SIGNAL.
+   Otherwise, they are not processed at all and the output state is derived from the
+   descriptor when needed.
+
    Unsupported features:
         - Asynchronous operations
  */
@@ -232,6 +247,21 @@ class AVR_ARCHAVR_PUBLIC_API ArchAVR_Timer : public Peripheral, public SignalHoo
 
 public:
 
+    /**
+       Descriptor of a steady waveform on a Compare Output. The output is high from
+       'start' + k * 'period' for 'duty' cycles, for any integer k.
+     */
+    struct waveform_t {
+        /// Cycle number of a rising edge, or of the start of the steady state for a constant output
+        cycle_count_t start;
+        /// Period in clock cycles
+        cycle_count_t period;
+        /// Duration in clock cycles of the high level in each period, 0 or 'period' for a constant output
+        cycle_count_t duty;
+        /// True if the rising edges are produced by the compare matches
+        bool inverted;
+    };
+
     enum SignalId {
         /// Raised on a overflow event, no data is carried
         Signal_OVF,
@@ -250,12 +280,40 @@ public:
         Signal_Capt
     };
 
+    /**
+       Signal IDs of the waveform signal. The index indicates which channel
+       (0='A', 1='B', ...). The fields of a descriptor are stored in the signal
+       before WaveformSignal_Period is raised, and can be obtained with DataSignal::data().
+     */
+    enum WaveformSignalId {
+        /**
+           Raised when the waveform of a Compare Output becomes steady, changes or stops
+           being steady. The data is the period in clock cycles, or invalid data when the
+           waveform is not steady.
+         */
+        WaveformSignal_Period,
+        /**
+           Raised with the Compare Output state on each edge while the waveform is not steady,
+           and when it stops being steady. The data is the state (0 or 1) or invalid data if
+           the channel is disabled.
+         */
+        WaveformSignal_Level,
+        /// Cycle number of a rising edge, or of the start of the steady state for a constant output
+        WaveformSignal_Start,
+        /// Duration in clock cycles of the high level in each period
+        WaveformSignal_Duty,
+        /// 1 if the rising edges are produced by the compare matches, 0 otherwise
+        WaveformSignal_Inverted,
+    };
+
     ArchAVR_Timer(int num, const ArchAVR_TimerConfig& config);
     ~ArchAVR_Timer();
 
     virtual bool init(Device& device) override;
     virtual void reset() override;
     virtual bool ctlreq(ctlreq_id_t req, ctlreq_data_t* data) override;
+    virtual bool save_state(std::vector<uint8_t>& state) const override;
+    virtual bool load_state(const uint8_t* state, size_t len) override;
     virtual uint8_t ioreg_read_handler(reg_addr_t addr, uint8_t value) override;
     virtual void ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& data) override;
 
@@ -289,9 +347,23 @@ private:
     InterruptFlag m_intflag_ovf;
     InterruptFlag m_intflag_icr;
     DataSignal m_signal;
+    //True if the signal has been obtained by another object, which observes the overflows
+    //and the edges of the outputs
+    bool m_signal_exported;
+    //Signal for the descriptors of the steady waveforms
+    DataSignal m_waveform_signal;
+    //True if the waveform signal has been obtained by another object
+    bool m_waveform_exported;
     CaptureHook* m_capt_hook;
 
     void update_top();
+    void update_observed_events();
+    void update_waveforms();
+    bool calculate_waveform(size_t index, cycle_count_t ref_cycle, waveform_t& waveform);
+    void sync_OC_states(cycle_count_t ref_cycle);
+    void set_waveform(size_t index, const waveform_t* waveform);
+    bool OC_edges_signalled(size_t index) const;
+    void raise_OC_state(size_t index, const vardata_t& state);
     void capt_raised();
     ArchAVR_TimerConfig::COM_config_t get_COM_config(uint8_t regval);
     void change_OC_state(size_t index, int event_flags);
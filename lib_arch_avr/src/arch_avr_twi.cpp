@@ -109,6 +109,9 @@ bool ArchAVR_TWI::init(Device& device)
     m_twi.init(*device.cycle_manager(), logger());
     m_twi.signal().connect(*this);
 
+    for (CycleTimer* timer : m_twi.state_timers())
+        add_state_timer(*timer);
+
     return status;
 }
 
@@ -134,6 +137,30 @@ bool ArchAVR_TWI::ctlreq(ctlreq_id_t req, ctlreq_data_t* data)
     return false;
 }
 
+bool ArchAVR_TWI::save_state(std::vector<uint8_t>& state) const
+{
+    StateWriter writer(state);
+    if (!m_twi.save_state(writer))
+        return false;
+    writer.write(m_gencall);
+    writer.write(m_rx);
+    return true;
+}
+
+bool ArchAVR_TWI::load_state(const uint8_t* state, size_t len)
+{
+    StateReader reader(state, len);
+    if (!m_twi.load_state(reader))
+        return false;
+
+    reader.read(m_gencall);
+    reader.read(m_rx);
+
+    m_intflag.update_from_ioreg();
+
+    return reader.complete();
+}
+
 void ArchAVR_TWI::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& data)
 {
     if (addr == m_config.reg_ctrl) {
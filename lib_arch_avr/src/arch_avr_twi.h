@@ -79,6 +79,8 @@ public:
     virtual bool init(Device& device) override;
     virtual void reset() override;
     virtual bool ctlreq(ctlreq_id_t req, ctlreq_data_t *data) override;
+    virtual bool save_state(std::vector<uint8_t>& state) const override;
+    virtual bool load_state(const uint8_t* state, size_t len) override;
     virtual void ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& data) override;
     virtual void raised(const signal_data_t& sigdata, int hooktag) override;
 
@@ -74,7 +74,10 @@ bool ArchAVR_USART::init(Device& device)
     m_uart.init(*device.cycle_manager(), logger());
     m_uart.set_tx_buffer_limit(2);
     m_uart.set_rx_buffer_limit(3);
-    m_uart.signal().connect(*this);
+    m_uart.event_signal().connect<ArchAVR_USART, &ArchAVR_USART::uart_raised>(*this);
+
+    for (CycleTimer* timer : m_uart.state_timers())
+        add_state_timer(*timer);
 
     return status;
 }
@@ -100,6 +103,25 @@ bool ArchAVR_USART::ctlreq(ctlreq_id_t req, ctlreq_data_t* data)
     return false;
 }
 
+bool ArchAVR_USART::save_state(std::vector<uint8_t>& state) const
+{
+    StateWriter writer(state);
+    m_uart.save_state(writer);
+    return true;
+}
+
+bool ArchAVR_USART::load_state(const uint8_t* state, size_t len)
+{
+    StateReader reader(state, len);
+    m_uart.load_state(reader);
+
+    m_rxc_intflag.update_from_ioreg();
+    m_txc_intflag.update_from_ioreg();
+    m_txe_intflag.update_from_ioreg();
+
+    return reader.complete();
+}
+
 uint8_t ArchAVR_USART::ioreg_read_handler(reg_addr_t addr, uint8_t value)
 {
     if (addr == m_config.reg_data) {
@@ -155,19 +177,19 @@ void ArchAVR_USART::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& da
 
 }
 
-void ArchAVR_USART::raised(const signal_data_t& sigdata, int)
+void ArchAVR_USART::uart_raised(const UART::event_t& event, int)
 {
     //If a frame emission is started, it means the TX buffer is empty
     //so raise the TXE (DRE) flag
-    if (sigdata.sigid == UART::Signal_TX_Start)
+    if (event.sigid == UART::Signal_TX_Start)
         m_txe_intflag.set_flag();
 
     //If a frame is successfully emitted, raise the TXC flag
-    else if (sigdata.sigid == UART::Signal_TX_Complete && sigdata.data.as_int())
+    else if (event.sigid == UART::Signal_TX_Complete && event.data)
         m_txc_intflag.set_flag();
 
     //If a frame is successfully received, raise the RXC flag
-    else if (sigdata.sigid == UART::Signal_RX_Complete && sigdata.data.as_int())
+    else if (event.sigid == UART::Signal_RX_Complete && event.data)
         m_rxc_intflag.set_flag();
 }
 
@@ -185,7 +207,7 @@ void ArchAVR_USART::update_framerate()
     else
         bit_delay = (brr + 1) << 4;
 
-    logger().dbg("Baud rate set to %d bps", (device()->frequency() / bit_delay));
+    logger().dbg("Baud rate set to %lu bps", (device()->frequency() / bit_delay));
 
     //The USART frame delay is for 10-bits frames (8-bits data, no parity, 1 stop bit)
     uint32_t frame_delay = bit_delay * 10;
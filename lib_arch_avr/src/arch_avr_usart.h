@@ -78,7 +78,7 @@ struct ArchAVR_USARTConfig {
      - AVR_CTLREQ_UART_ENDPOINT : returns in data.p the endpoint to use in order to transmit
         data in and out (see sim_uart.h)
  */
-class AVR_ARCHAVR_PUBLIC_API ArchAVR_USART : public Peripheral, public SignalHook {
+class AVR_ARCHAVR_PUBLIC_API ArchAVR_USART : public Peripheral {
 
 public:
 
@@ -87,9 +87,10 @@ public:
     virtual bool init(Device& device) override;
     virtual void reset() override;
     virtual bool ctlreq(ctlreq_id_t req, ctlreq_data_t* data) override;
+    virtual bool save_state(std::vector<uint8_t>& state) const override;
+    virtual bool load_state(const uint8_t* state, size_t len) override;
     virtual uint8_t ioreg_read_handler(reg_addr_t addr, uint8_t value) override;
     virtual void ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& data) override;
-    virtual void raised(const signal_data_t& sigdata, int hooktag) override;
 
 private:
 
@@ -103,6 +104,7 @@ private:
     InterruptFlag m_txe_intflag;
 
     void update_framerate();
+    void uart_raised(const UART::event_t& event, int);
 
 };
 
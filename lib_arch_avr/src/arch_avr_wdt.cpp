@@ -23,6 +23,7 @@
 
 #include "arch_avr_wdt.h"
 #include "core/sim_device.h"
+#include "core/sim_state.h"
 
 YASIMAVR_USING_NAMESPACE
 
@@ -61,6 +62,30 @@ void ArchAVR_WDT::reset()
 }
 
 
+bool ArchAVR_WDT::save_state(std::vector<uint8_t>& state) const
+{
+    if (!WatchdogTimer::save_state(state))
+        return false;
+    StateWriter writer(state);
+    writer.write(m_unlock_cycle);
+    return true;
+}
+
+
+bool ArchAVR_WDT::load_state(const uint8_t* state, size_t len)
+{
+    //The unlock cycle is appended to the state of the generic watchdog timer
+    if (len < sizeof(m_unlock_cycle))
+        return false;
+
+    size_t base_len = len - sizeof(m_unlock_cycle);
+    StateReader reader(state + base_len, sizeof(m_unlock_cycle));
+    reader.read(m_unlock_cycle);
+
+    return WatchdogTimer::load_state(state, base_len) && reader.complete();
+}
+
+
 void ArchAVR_WDT::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& data)
 {
     bool change_enable = m_config.bm_chg_enable.extract(data.value);
@@ -95,7 +95,10 @@ bool ArchXT_ADC::init(Device& device)
                                  m_config.iv_wincmp);
 
     m_timer.init(*device.cycle_manager(), logger());
-    m_timer.signal().connect(*this);
+    m_timer.tick_signal().connect<ArchXT_ADC, &ArchXT_ADC::timer_raised>(*this);
+
+
+    add_state_timer(m_timer);
 
     return status;
 }
@@ -127,6 +130,40 @@ bool ArchXT_ADC::ctlreq(ctlreq_id_t req, ctlreq_data_t* data)
     return false;
 }
 
+bool ArchXT_ADC::save_state(std::vector<uint8_t>& state) const
+{
+    StateWriter writer(state);
+    m_timer.save_state(writer);
+    writer.write(m_state);
+    writer.write(m_first);
+    writer.write(m_latched_ch_mux);
+    writer.write(m_latched_ref_mux);
+    writer.write(m_accum_counter);
+    writer.write(m_result);
+    writer.write(m_win_lothres);
+    writer.write(m_win_hithres);
+    return true;
+}
+
+bool ArchXT_ADC::load_state(const uint8_t* state, size_t len)
+{
+    StateReader reader(state, len);
+    m_timer.load_state(reader);
+    reader.read(m_state);
+    reader.read(m_first);
+    reader.read(m_latched_ch_mux);
+    reader.read(m_latched_ref_mux);
+    reader.read(m_accum_counter);
+    reader.read(m_result);
+    reader.read(m_win_lothres);
+    reader.read(m_win_hithres);
+
+    m_res_intflag.update_from_ioreg();
+    m_cmp_intflag.update_from_ioreg();
+
+    return reader.complete();
+}
+
 
 //I/O register callback reimplementation
 
@@ -316,9 +353,9 @@ void ArchXT_ADC::read_analog_value()
  * First, we perform the actual analog read.
  * Second, we store it in the data register and raise the interrupt flag
  */
-void ArchXT_ADC::raised(const signal_data_t& sigdata, int)
+void ArchXT_ADC::timer_raised(const PrescaledTimer::tick_event_t& event, int)
 {
-    if (sigdata.index != 1) return;
+    if (!event.timeout) return;
 
     if (m_state == ADC_Starting) {
 
@@ -60,7 +60,7 @@ uint8_t ArchXT_Core::cpu_read_data(mem_addr_t data_addr)
     }
     //Read in any other area => generate a device crash if the option to ignore it is not set
     else if (!m_device->test_option(Device::Option_IgnoreBadCpuIO)) {
-        m_device->logger().err("CPU reading an invalid data address: 0x%04x", data_addr);
+        m_device->logger().err("CPU reading an invalid data address: 0x%04lx", data_addr);
         m_device->crash(CRASH_BAD_CPU_IO, "Bad data address");
     }
 
@@ -94,7 +94,7 @@ void ArchXT_Core::cpu_write_data(mem_addr_t data_addr, uint8_t value)
         };
         //Send a request to write in the memory
         ctlreq_data_t d = { .data = &nvm_req };
-        m_device->ctlreq(AVR_IOCTL_NVM, AVR_CTLREQ_NVM_WRITE, &d);
+        m_req_nvm_write(&d);
     }
     //Write in the Flash section => send a request to the NVM controller
     else if (data_addr >= cfg.flashstart_ds && data_addr <= cfg.flashend_ds) {
@@ -107,11 +107,11 @@ void ArchXT_Core::cpu_write_data(mem_addr_t data_addr, uint8_t value)
         };
         //Send a request to write in the memory
         ctlreq_data_t d = { .data = &nvm_req };
-        m_device->ctlreq(AVR_IOCTL_NVM, AVR_CTLREQ_NVM_WRITE, &d);
+        m_req_nvm_write(&d);
     }
     //Write in any other area => generate a device crash if the option to ignore it is not set
     else if (!m_device->test_option(Device::Option_IgnoreBadCpuIO)) {
-        m_device->logger().err("CPU writing an invalid data address: 0x%04x", data_addr);
+        m_device->logger().err("CPU writing an invalid data address: 0x%04lx", data_addr);
         m_device->crash(CRASH_BAD_CPU_IO, "Bad data address");
     }
 
@@ -212,7 +212,10 @@ bool ArchXT_Device::program(const Firmware& firmware)
     if (!Device::program(firmware))
         return false;
 
-    if (firmware.has_memory(Firmware::Area_EEPROM)) {
+    if (m_core_impl.m_eeprom.persisted()) {
+        logger().dbg("Firmware load: EEPROM content restored from its backing file");
+    }
+    else if (firmware.has_memory(Firmware::Area_EEPROM)) {
         if (firmware.load_memory(Firmware::Area_EEPROM, m_core_impl.m_eeprom)) {
             logger().dbg("Firmware load: EEPROM loaded");
         } else {
@@ -221,7 +224,10 @@ bool ArchXT_Device::program(const Firmware& firmware)
         }
     }
 
-    if (firmware.has_memory(Firmware::Area_UserSignatures)) {
+    if (m_core_impl.m_userrow.persisted()) {
+        logger().dbg("Firmware load: USERROW content restored from its backing file");
+    }
+    else if (firmware.has_memory(Firmware::Area_UserSignatures)) {
         if (firmware.load_memory(Firmware::Area_UserSignatures, m_core_impl.m_userrow)) {
             logger().dbg("Firmware load: USERROW loaded");
         } else {
@@ -146,21 +146,16 @@ int_vect_t ArchXT_IntCtrl::get_next_irq() const
     if (BITSET(status_ex, IntrPriorityLevel0))
         return AVR_INTERRUPT_NONE;
 
+    //Round-robin scheme: the vectors following LVL0PRI have the highest priority,
+    //then the search wraps around from vector 0
     int lvl0_vector = read_ioreg(INT_REG_ADDR(LVL0PRI));
-    if (!lvl0_vector) {
-        for (int_vect_t i = 0; i < intr_count(); ++i) {
-            if (interrupt_raised(i))
-                return i;
-        }
-    } else {
-        for (int_vect_t i = 1; i <= intr_count(); ++i) {
-            int_vect_t v = (i + lvl0_vector) % intr_count();
-            if (interrupt_raised(v))
-                return v;
-        }
+    if (lvl0_vector) {
+        int_vect_t v = first_raised(lvl0_vector + 1);
+        if (v != AVR_INTERRUPT_NONE)
+            return v;
     }
 
-    return AVR_INTERRUPT_NONE;
+    return first_raised();
 }
 
 void ArchXT_IntCtrl::cpu_reti()
@@ -26,6 +26,7 @@
 #include "arch_xt_io.h"
 #include "arch_xt_io_utils.h"
 #include "core/sim_device.h"
+#include "core/sim_state.h"
 #include "cstring"
 
 YASIMAVR_USING_NAMESPACE
@@ -180,6 +181,9 @@ bool ArchXT_NVM::init(Device& device)
                                 DEF_REGBIT_B(INTFLAGS, NVMCTRL_EEREADY),
                                 m_config.iv_eeready);
 
+
+    add_state_timer(*m_timer);
+
     return status;
 }
 
@@ -205,6 +209,31 @@ bool ArchXT_NVM::ctlreq(ctlreq_id_t req, ctlreq_data_t* data)
     return false;
 }
 
+bool ArchXT_NVM::save_state(std::vector<uint8_t>& state) const
+{
+    StateWriter writer(state);
+    writer.write(m_state);
+    writer.write(m_mem_index);
+    writer.write(m_page);
+    writer.write(m_buffer, m_config.flash_page_size);
+    writer.write(m_bufset, m_config.flash_page_size);
+    return true;
+}
+
+bool ArchXT_NVM::load_state(const uint8_t* state, size_t len)
+{
+    StateReader reader(state, len);
+    reader.read(m_state);
+    reader.read(m_mem_index);
+    reader.read(m_page);
+    reader.read(m_buffer, m_config.flash_page_size);
+    reader.read(m_bufset, m_config.flash_page_size);
+
+    m_ee_intflag.update_from_ioreg();
+
+    return reader.complete();
+}
+
 void ArchXT_NVM::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& data)
 {
     reg_addr_t reg_ofs = addr - m_config.reg_base;
@@ -282,7 +311,7 @@ void ArchXT_NVM::write_nvm(const NVM_request_t& nvm_req)
     //Storing the page number
     m_page = nvm_req.addr / page_size;
 
-    logger().dbg("Buffer write addr=%04x, index=%d, page=%d, value=%02x",
+    logger().dbg("Buffer write addr=%04lx, index=%d, page=%lu, value=%02x",
                  nvm_req.addr, m_mem_index, m_page, nvm_req.data);
 }
 
@@ -377,9 +406,9 @@ unsigned int ArchXT_NVM::execute_page_command(Command cmd)
     if (cmd == Cmd_PageErase || cmd == Cmd_PageEraseWrite) {
         if (is_flash_op) {
             nvm->erase(page_size * m_page, page_size);
-            logger().dbg("Erased flash page %d", m_page);
+            logger().dbg("Erased flash page %lu", m_page);
         } else {
-            logger().dbg("Erased eeprom/userrow page %d", m_page);
+            logger().dbg("Erased eeprom/userrow page %lu", m_page);
             nvm->erase(m_bufset, page_size * m_page, page_size);
         }
 
@@ -392,10 +421,10 @@ unsigned int ArchXT_NVM::execute_page_command(Command cmd)
     if (cmd == Cmd_PageWrite || cmd == Cmd_PageEraseWrite) {
         if (is_flash_op) {
             nvm->spm_write(m_buffer, nullptr, page_size * m_page, page_size);
-            logger().dbg("Written flash page %d", m_page);
+            logger().dbg("Written flash page %lu", m_page);
         } else {
             nvm->spm_write(m_buffer, m_bufset, page_size * m_page, page_size);
-            logger().dbg("Written eeprom/userrow page %d", m_page);
+            logger().dbg("Written eeprom/userrow page %lu", m_page);
         }
 
         delay_usecs += m_config.page_write_delay;
@@ -217,32 +217,15 @@ void ArchXT_Port::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& data
 
 void ArchXT_Port::update_pin_states()
 {
-    Pin::State state;
-    uint8_t valdir = m_dir_value;
-    uint8_t valport = m_port_value;
+    //Collect the pull-up enables from the pin control registers
+    uint8_t pullup = 0x00;
     uint8_t pinmask = pin_mask();
-
-    for (int i = 0; i < 8; ++i) {
-        if (pinmask & 0x01) {
-            uint8_t pin_cfg = read_ioreg(m_config.reg_base_port + 0x10 + i);
-            if (valdir & 0x01) {
-                if (valport & 0x01)
-                    state = Pin::State_High;
-                else
-                    state = Pin::State_Low;
-            } else {
-                if (BITSET(pin_cfg, PORT_PULLUPEN_bp))
-                    state = Pin::State_PullUp;
-                else
-                    state = Pin::State_Floating;
-            }
-            set_pin_internal_state(i, state);
-        }
-
-        valdir >>= 1;
-        valport >>= 1;
-        pinmask >>= 1;
+    for (int i = 0; pinmask; ++i, pinmask >>= 1) {
+        if ((pinmask & 0x01) && BITSET(read_ioreg(m_config.reg_base_port + 0x10 + i), PORT_PULLUPEN_bp))
+            pullup |= 1 << i;
     }
+
+    set_pin_internal_states(m_dir_value, m_port_value, pullup);
 }
 
 void ArchXT_Port::pin_state_changed(uint8_t num, Pin::State state)
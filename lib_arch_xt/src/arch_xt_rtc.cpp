@@ -130,6 +130,10 @@ bool ArchXT_RTC::init(Device& device)
     m_rtc_counter.set_logger(&logger());
     m_pit_counter.set_logger(&logger());
 
+
+    add_state_timer(m_rtc_timer);
+    add_state_timer(m_pit_timer);
+
     return status;
 }
 
@@ -144,6 +148,32 @@ void ArchXT_RTC::reset()
     m_pit_counter.reset();
 }
 
+bool ArchXT_RTC::save_state(std::vector<uint8_t>& state) const
+{
+    StateWriter writer(state);
+    writer.write(m_clk_mode);
+    m_rtc_timer.save_state(writer);
+    m_pit_timer.save_state(writer);
+    m_rtc_counter.save_state(writer);
+    m_pit_counter.save_state(writer);
+    return true;
+}
+
+bool ArchXT_RTC::load_state(const uint8_t* state, size_t len)
+{
+    StateReader reader(state, len);
+    reader.read(m_clk_mode);
+    m_rtc_timer.load_state(reader);
+    m_pit_timer.load_state(reader);
+    m_rtc_counter.load_state(reader);
+    m_pit_counter.load_state(reader);
+
+    m_rtc_intflag.update_from_ioreg();
+    m_pit_intflag.update_from_ioreg();
+
+    return reader.complete();
+}
+
 uint8_t ArchXT_RTC::ioreg_read_handler(reg_addr_t addr, uint8_t value)
 {
     reg_addr_t reg_ofs = addr - m_config.reg_base;
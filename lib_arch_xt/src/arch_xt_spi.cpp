@@ -37,8 +37,6 @@ YASIMAVR_USING_NAMESPACE
     offsetof(SPI_t, reg)
 
 
-#define HOOKTAG_SPI         0
-#define HOOKTAG_PIN         1
 
 const unsigned long ClockFactors[] = {4, 16, 64, 128};
 
@@ -53,6 +51,13 @@ ArchXT_SPI::ArchXT_SPI(int num, const ArchXT_SPIConfig& config)
 ,m_intflag(false)
 {}
 
+ArchXT_SPI::~ArchXT_SPI()
+{
+    //The pin signals do not disconnect their receivers automatically
+    if (m_pin_select)
+        m_pin_select->digital_signal().disconnect(this);
+}
+
 bool ArchXT_SPI::init(Device& device)
 {
     bool status = Peripheral::init(device);
@@ -72,16 +77,19 @@ bool ArchXT_SPI::init(Device& device)
     m_spi.init(*device.cycle_manager(), logger());
     m_spi.set_tx_buffer_limit(1);
     m_spi.set_rx_buffer_limit(2);
-    m_spi.signal().connect(*this, HOOKTAG_SPI);
+    m_spi.signal().connect(*this);
 
     if (m_config.pin_select) {
         m_pin_select = device.find_pin(m_config.pin_select);
-        if (!m_pin_select)
-            m_pin_select->signal().connect(*this, HOOKTAG_PIN);
+        if (m_pin_select)
+            m_pin_select->digital_signal().connect<ArchXT_SPI, &ArchXT_SPI::pin_raised>(*this);
         else
             status = false;
     }
 
+
+    add_state_timer(m_spi);
+
     return status;
 }
 
@@ -117,6 +125,25 @@ bool ArchXT_SPI::ctlreq(ctlreq_id_t req, ctlreq_data_t* data)
     return false;
 }
 
+bool ArchXT_SPI::save_state(std::vector<uint8_t>& state) const
+{
+    StateWriter writer(state);
+    m_spi.save_state(writer);
+    writer.write(m_pin_selected);
+    return true;
+}
+
+bool ArchXT_SPI::load_state(const uint8_t* state, size_t len)
+{
+    StateReader reader(state, len);
+    m_spi.load_state(reader);
+    reader.read(m_pin_selected);
+
+    m_intflag.update_from_ioreg();
+
+    return reader.complete();
+}
+
 uint8_t ArchXT_SPI::ioreg_read_handler(reg_addr_t addr, uint8_t value)
 {
     reg_addr_t reg_ofs = addr - m_config.reg_base;
@@ -161,17 +188,18 @@ void ArchXT_SPI::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& data)
     }
 }
 
-void ArchXT_SPI::raised(const signal_data_t& sigdata, int hooktag)
+void ArchXT_SPI::raised(const signal_data_t& sigdata, int)
 {
-    if (hooktag == HOOKTAG_SPI) {
-        if (sigdata.sigid == SPI::Signal_HostTfrComplete ||
-            sigdata.sigid == SPI::Signal_ClientTfrComplete)
-            m_intflag.set_flag();
-    }
-    else if (hooktag == HOOKTAG_PIN) {
-        if (sigdata.sigid != Pin::Signal_DigitalChange) {
-            m_pin_selected = !sigdata.data.as_uint();
-            m_spi.set_selected(m_pin_selected && TEST_IOREG(CTRLA, SPI_ENABLE));
-        }
-    }
+    if (sigdata.sigid == SPI::Signal_HostTfrComplete ||
+        sigdata.sigid == SPI::Signal_ClientTfrComplete)
+        m_intflag.set_flag();
+}
+
+/*
+ * Callback for a digital change of the select pin
+ */
+void ArchXT_SPI::pin_raised(const bool& pin_level, int)
+{
+    m_pin_selected = !pin_level;
+    m_spi.set_selected(m_pin_selected && TEST_IOREG(CTRLA, SPI_ENABLE));
 }
@@ -67,10 +67,13 @@ class AVR_ARCHXT_PUBLIC_API ArchXT_SPI : public Peripheral, public SignalHook {
 public:
 
     ArchXT_SPI(int num, const ArchXT_SPIConfig& config);
+    virtual ~ArchXT_SPI();
 
     virtual bool init(Device& device) override;
     virtual void reset() override;
     virtual bool ctlreq(ctlreq_id_t req, ctlreq_data_t* data) override;
+    virtual bool save_state(std::vector<uint8_t>& state) const override;
+    virtual bool load_state(const uint8_t* state, size_t len) override;
     virtual uint8_t ioreg_read_handler(reg_addr_t addr, uint8_t value) override;
     virtual void ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& data) override;
     virtual void raised(const signal_data_t& sigdata, int hooktag) override;
@@ -86,6 +89,8 @@ private:
 
     InterruptFlag m_intflag;
 
+    void pin_raised(const bool& pin_level, int);
+
 };
 
 
@@ -114,7 +114,10 @@ bool ArchXT_TimerA::init(Device& device)
                                           m_config.ivs_cmp[i]);
 
     m_timer.init(*device.cycle_manager(), logger());
-    m_timer.signal().connect(*this);
+    m_timer.tick_signal().connect<ArchXT_TimerA, &ArchXT_TimerA::timer_raised>(*this);
+
+
+    add_state_timer(m_timer);
 
     return status;
 }
@@ -146,6 +149,37 @@ bool ArchXT_TimerA::ctlreq(ctlreq_id_t req, ctlreq_data_t* data)
     return false;
 }
 
+bool ArchXT_TimerA::save_state(std::vector<uint8_t>& state) const
+{
+    StateWriter writer(state);
+    m_timer.save_state(writer);
+    writer.write(m_cnt);
+    writer.write(m_per);
+    writer.write(m_cmp);
+    writer.write(m_perbuf);
+    writer.write(m_cmpbuf);
+    writer.write(m_next_event_type);
+    return true;
+}
+
+bool ArchXT_TimerA::load_state(const uint8_t* state, size_t len)
+{
+    StateReader reader(state, len);
+    m_timer.load_state(reader);
+    reader.read(m_cnt);
+    reader.read(m_per);
+    reader.read(m_cmp);
+    reader.read(m_perbuf);
+    reader.read(m_cmpbuf);
+    reader.read(m_next_event_type);
+
+    m_ovf_intflag.update_from_ioreg();
+    for (int i = 0; i < AVR_TCA_CMP_CHANNEL_COUNT; ++i)
+        m_cmp_intflags[i]->update_from_ioreg();
+
+    return reader.complete();
+}
+
 uint8_t ArchXT_TimerA::ioreg_read_handler(reg_addr_t addr, uint8_t value)
 {
     reg_addr_t reg_ofs = addr - m_config.reg_base;
@@ -349,11 +383,11 @@ uint32_t ArchXT_TimerA::delay_to_event()
     return (uint32_t)ticks_to_next_event;
 }
 
-void ArchXT_TimerA::raised(const signal_data_t& sigdata, int)
+void ArchXT_TimerA::timer_raised(const PrescaledTimer::tick_event_t& event, int)
 {
-    m_cnt += sigdata.data.as_uint();
+    m_cnt += event.ticks;
 
-    if (!sigdata.index) return;
+    if (!event.timeout) return;
 
     logger().dbg("Processing events %02x", m_next_event_type);
 
@@ -95,7 +95,7 @@ struct ArchXT_TimerAConfig {
     - AVR_CTLREQ_TCA_REGISTER_TCB : Used internally by ArchXT_TimerB instances to
       link their prescaler clock source to the TCA prescaler output
  */
-class AVR_ARCHXT_PUBLIC_API ArchXT_TimerA : public Peripheral, public SignalHook {
+class AVR_ARCHXT_PUBLIC_API ArchXT_TimerA : public Peripheral {
 
 public:
 
@@ -106,11 +106,11 @@ public:
     virtual bool init(Device& device) override;
     virtual void reset() override;
     virtual bool ctlreq(ctlreq_id_t req, ctlreq_data_t* data) override;
+    virtual bool save_state(std::vector<uint8_t>& state) const override;
+    virtual bool load_state(const uint8_t* state, size_t len) override;
     virtual uint8_t ioreg_read_handler(reg_addr_t addr, uint8_t value) override;
     virtual void ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& data) override;
     virtual void sleep(bool on, SleepMode mode) override;
-    //Override of Hook callback
-    virtual void raised(const signal_data_t& sigdata, int hooktag) override;
 
 private:
 
@@ -138,6 +138,7 @@ private:
 
     uint32_t delay_to_event();
     void update_16bits_buffers();
+    void timer_raised(const PrescaledTimer::tick_event_t& event, int);
 
 };
 
@@ -83,6 +83,9 @@ bool ArchXT_TimerB::init(Device& device)
     m_counter.set_logger(&logger());
     m_counter.signal().connect(*this);
 
+
+    add_state_timer(m_timer);
+
     return status;
 }
 
@@ -94,6 +97,43 @@ void ArchXT_TimerB::reset()
     m_counter.reset();
     m_counter.set_top(0);
     m_counter.set_tick_source(TimerCounter::Tick_Timer);
+    update_observed_events();
+}
+
+bool ArchXT_TimerB::save_state(std::vector<uint8_t>& state) const
+{
+    StateWriter writer(state);
+    writer.write(m_clk_mode);
+    m_timer.save_state(writer);
+    m_counter.save_state(writer);
+    return true;
+}
+
+bool ArchXT_TimerB::load_state(const uint8_t* state, size_t len)
+{
+    StateReader reader(state, len);
+    uint8_t clk_mode = TIMER_CLOCK_DISABLED;
+    if (!reader.read(clk_mode))
+        return false;
+
+    //Chain or de-chain the TCB timer from TCA, before loading its state
+    bool is_chained = (m_clk_mode == TCB_CLKSEL_CLKTCA_gc);
+    bool to_chain = (clk_mode == TCB_CLKSEL_CLKTCA_gc);
+    if (to_chain != is_chained) {
+        ctlreq_data_t d = { .data = &m_timer, .index = (to_chain ? 1 : 0) };
+        device()->ctlreq(AVR_IOCTL_TIMER('A', '0'), AVR_CTLREQ_TCA_REGISTER_TCB, &d);
+    }
+
+    m_clk_mode = clk_mode;
+    m_timer.load_state(reader);
+    m_counter.load_state(reader);
+
+    if (to_chain != is_chained)
+        m_counter.reschedule();
+
+    m_intflag.update_from_ioreg();
+
+    return reader.complete();
 }
 
 uint8_t ArchXT_TimerB::ioreg_read_handler(reg_addr_t addr, uint8_t value)
@@ -111,6 +151,12 @@ uint8_t ArchXT_TimerB::ioreg_read_handler(reg_addr_t addr, uint8_t value)
         value = read_ioreg(REG_ADDR(TEMP));
     }
 
+    //Process the TOP events not observed so far, to update the flag
+    else if (reg_ofs == REG_OFS(INTFLAGS)) {
+        m_timer.update();
+        value = read_ioreg(REG_ADDR(INTFLAGS));
+    }
+
     //16-bits reading of CCMP
     else if (reg_ofs == REG_OFS(CCMPL)) {
         uint16_t v = (uint16_t) m_counter.top();
@@ -128,6 +174,9 @@ void ArchXT_TimerB::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& da
 {
     reg_addr_t reg_ofs = addr - m_config.reg_base;
 
+    //Process the counter events not observed so far, before any change
+    m_timer.update();
+
     if (reg_ofs == REG_OFS(CTRLA)) {
         uint8_t old_clk_mode = m_clk_mode;
 
@@ -187,6 +236,8 @@ void ArchXT_TimerB::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& da
 
     else if (reg_ofs == REG_OFS(INTCTRL)) {
         m_intflag.update_from_ioreg();
+        update_observed_events();
+        m_counter.reschedule();
     }
 
     //If we're writing a 1 to the interrupt flag bit, it clears the bit and cancels the interrupt
@@ -202,6 +253,16 @@ void ArchXT_TimerB::raised(const signal_data_t& sigdata, int)
         m_intflag.set_flag();
 }
 
+/*
+ * The counter only needs to wake up on TOP if the interrupt is enabled. Otherwise,
+ * the flag is updated when it is read.
+ */
+void ArchXT_TimerB::update_observed_events()
+{
+    bool int_enabled = TEST_IOREG(INTCTRL, TCB_CAPT);
+    m_counter.set_observed_events(int_enabled ? TimerCounter::Event_Top : 0);
+}
+
 void ArchXT_TimerB::sleep(bool on, SleepMode mode)
 {
     //The timer is paused for sleep modes above Standby and in Standby if RUNSTDBY bit is not set
@@ -68,6 +68,8 @@ public:
     //Override of Peripheral callbacks
     virtual bool init(Device& device) override;
     virtual void reset() override;
+    virtual bool save_state(std::vector<uint8_t>& state) const override;
+    virtual bool load_state(const uint8_t* state, size_t len) override;
     virtual uint8_t ioreg_read_handler(reg_addr_t addr, uint8_t value) override;
     virtual void ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& data) override;
     virtual void sleep(bool on, SleepMode mode) override;
@@ -87,6 +89,8 @@ private:
     PrescaledTimer m_timer;
     TimerCounter m_counter;
 
+    void update_observed_events();
+
 };
 
 
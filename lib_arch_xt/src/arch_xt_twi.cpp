@@ -87,6 +87,10 @@ bool ArchXT_TWI::init(Device& device)
     m_twi.init(*device.cycle_manager(), logger());
     m_twi.signal().connect(*this);
 
+
+    for (CycleTimer* timer : m_twi.state_timers())
+        add_state_timer(*timer);
+
     return status;
 }
 
@@ -112,6 +116,33 @@ bool ArchXT_TWI::ctlreq(ctlreq_id_t req, ctlreq_data_t* data)
     return false;
 }
 
+bool ArchXT_TWI::save_state(std::vector<uint8_t>& state) const
+{
+    StateWriter writer(state);
+    if (!m_twi.save_state(writer))
+        return false;
+    writer.write(m_has_address);
+    writer.write(m_has_master_rx_data);
+    writer.write(m_has_slave_rx_data);
+    return true;
+}
+
+bool ArchXT_TWI::load_state(const uint8_t* state, size_t len)
+{
+    StateReader reader(state, len);
+    if (!m_twi.load_state(reader))
+        return false;
+
+    reader.read(m_has_address);
+    reader.read(m_has_master_rx_data);
+    reader.read(m_has_slave_rx_data);
+
+    m_intflag_master.update_from_ioreg();
+    m_intflag_slave.update_from_ioreg();
+
+    return reader.complete();
+}
+
 uint8_t ArchXT_TWI::ioreg_read_handler(reg_addr_t addr, uint8_t value)
 {
     reg_addr_t reg_ofs = addr - m_config.reg_base;
@@ -85,7 +85,11 @@ bool ArchXT_USART::init(Device& device)
     m_uart.init(*device.cycle_manager(), logger());
     m_uart.set_tx_buffer_limit(2);
     m_uart.set_rx_buffer_limit(3);
-    m_uart.signal().connect(*this);
+    m_uart.event_signal().connect<ArchXT_USART, &ArchXT_USART::uart_raised>(*this);
+
+
+    for (CycleTimer* timer : m_uart.state_timers())
+        add_state_timer(*timer);
 
     return status;
 }
@@ -93,6 +97,7 @@ bool ArchXT_USART::init(Device& device)
 void ArchXT_USART::reset()
 {
     m_uart.reset();
+    m_uart.set_rx_start_observed(false);
     SET_IOREG(STATUS, USART_DREIF);
     update_framerate();
 }
@@ -111,6 +116,25 @@ bool ArchXT_USART::ctlreq(ctlreq_id_t req, ctlreq_data_t* data)
     return false;
 }
 
+bool ArchXT_USART::save_state(std::vector<uint8_t>& state) const
+{
+    StateWriter writer(state);
+    m_uart.save_state(writer);
+    return true;
+}
+
+bool ArchXT_USART::load_state(const uint8_t* state, size_t len)
+{
+    StateReader reader(state, len);
+    m_uart.load_state(reader);
+
+    m_rxc_intflag.update_from_ioreg();
+    m_txc_intflag.update_from_ioreg();
+    m_txe_intflag.update_from_ioreg();
+
+    return reader.complete();
+}
+
 uint8_t ArchXT_USART::ioreg_read_handler(reg_addr_t addr, uint8_t value)
 {
     reg_addr_t reg_ofs = addr - m_config.reg_base;
@@ -170,6 +194,9 @@ void ArchXT_USART::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& dat
             m_rxc_intflag.clear_flag(USART_RXCIF_bm);
         }
 
+        //The RX start must be signaled on time for the Start-of-Frame detection
+        m_uart.set_rx_start_observed(TEST_IOREG(CTRLB, USART_SFDEN));
+
         update_framerate();
     }
 
@@ -178,23 +205,23 @@ void ArchXT_USART::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& dat
     }
 }
 
-void ArchXT_USART::raised(const signal_data_t& sigdata, int)
+void ArchXT_USART::uart_raised(const UART::event_t& event, int)
 {
-    if (sigdata.sigid == UART::Signal_TX_Start) {
+    if (event.sigid == UART::Signal_TX_Start) {
         //Notification that the pending frame has been pushed to the shift register
         //to be emitted. The TX buffer is now empty so raise the DRE interrupt.
         m_txe_intflag.set_flag();
         logger().dbg("TX started, raising DRE");
     }
 
-    else if (sigdata.sigid == UART::Signal_TX_Complete && sigdata.data.as_int()) {
+    else if (event.sigid == UART::Signal_TX_Complete && event.data) {
         //Notification that the frame in the shift register has been emitted
         //Raise the TXC interrupt.
         m_txc_intflag.set_flag();
         logger().dbg("TX complete, raising TXC");
     }
 
-    else if (sigdata.sigid == UART::Signal_RX_Start) {
+    else if (event.sigid == UART::Signal_RX_Start) {
         //If the Start-of-Frame detection is enabled, raise the RXS flag
         if (TEST_IOREG(CTRLB, USART_SFDEN) && device()->sleep_mode() == SleepMode::Standby) {
             m_rxc_intflag.set_flag(USART_RXSIF_bm);
@@ -202,7 +229,7 @@ void ArchXT_USART::raised(const signal_data_t& sigdata, int)
         }
     }
 
-    else if (sigdata.sigid == UART::Signal_RX_Complete && sigdata.data.as_int()) {
+    else if (event.sigid == UART::Signal_RX_Complete && event.data) {
         //Raise the RX completion flag
         m_rxc_intflag.set_flag(USART_RXCIF_bm);
         logger().dbg("RX complete, raising RXC");
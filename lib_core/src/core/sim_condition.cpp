@@ -0,0 +1,376 @@
+/*
+ * sim_condition.cpp
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#include "sim_condition.h"
+#include "sim_debug.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+YASIMAVR_USING_NAMESPACE
+
+
+//=======================================================================================
+
+//Maximum depth of the evaluation stack
+#define STACK_SIZE      32
+//Maximum nesting level of the sub-expressions, limiting the parser recursion
+#define MAX_NESTING     64
+
+
+//Recursive descent parser, emitting the bytecode in postfix order
+class DebugCondition::Parser {
+
+public:
+
+    Parser(const std::string& expr, std::vector<instr_t>& code)
+    :m_pos(expr.c_str())
+    ,m_code(code)
+    ,m_depth(0)
+    ,m_nesting(0)
+    {}
+
+    bool parse(std::string& error)
+    {
+        if (!expression(1)) {
+            error = m_error;
+            return false;
+        }
+
+        skip_spaces();
+        if (*m_pos) {
+            error = std::string("Unexpected character at '") + m_pos + "'";
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+
+    struct binop_t {
+        const char* token;
+        int prec;
+        Opcode op;
+    };
+
+    static const binop_t BinaryOps[];
+
+    const char* m_pos;
+    std::vector<instr_t>& m_code;
+    unsigned int m_depth;
+    unsigned int m_nesting;
+    std::string m_error;
+
+    void skip_spaces()
+    {
+        while (isspace(*m_pos)) ++m_pos;
+    }
+
+    bool fail(const std::string& msg)
+    {
+        if (m_error.empty())
+            m_error = msg;
+        return false;
+    }
+
+    //Emit an instruction, keeping track of the stack depth
+    bool emit(Opcode op, long long arg = 0)
+    {
+        if (op <= Op_Addr) {
+            if (++m_depth > STACK_SIZE)
+                return fail("Expression too complex");
+        }
+        else if (op >= Op_Mul) {
+            --m_depth;
+        }
+
+        m_code.push_back({ op, arg });
+        return true;
+    }
+
+    //Enter a nested sub-expression, failing if the nesting is too deep
+    bool enter()
+    {
+        if (++m_nesting > MAX_NESTING)
+            return fail("Expression nested too deeply");
+        return true;
+    }
+
+    //Parse a binary expression with operators of precedence >= min_prec
+    bool expression(int min_prec)
+    {
+        if (!enter()) return false;
+        bool ok = binary(min_prec);
+        --m_nesting;
+        return ok;
+    }
+
+    bool binary(int min_prec)
+    {
+        if (!unary()) return false;
+
+        while (true) {
+            skip_spaces();
+            const binop_t* binop = nullptr;
+            for (const binop_t* b = BinaryOps; b->token; ++b) {
+                if (!strncmp(m_pos, b->token, strlen(b->token))) {
+                    binop = b;
+                    break;
+                }
+            }
+
+            if (!binop || binop->prec < min_prec)
+                return true;
+
+            m_pos += strlen(binop->token);
+            if (!expression(binop->prec + 1)) return false;
+            if (!emit(binop->op)) return false;
+        }
+    }
+
+    bool unary()
+    {
+        skip_spaces();
+        Opcode op;
+        switch (*m_pos) {
+            case '-': op = Op_Neg; break;
+            case '!': op = Op_Not; break;
+            case '~': op = Op_Inv; break;
+            default: return primary();
+        }
+
+        ++m_pos;
+        if (!enter()) return false;
+        bool ok = unary() && emit(op);
+        --m_nesting;
+        return ok;
+    }
+
+    //Parse a sub-expression between brackets, for memory accesses
+    bool indexed(Opcode op)
+    {
+        skip_spaces();
+        if (*m_pos != '[')
+            return fail("Expected '['");
+        ++m_pos;
+
+        if (!expression(1)) return false;
+
+        skip_spaces();
+        if (*m_pos != ']')
+            return fail("Expected ']'");
+        ++m_pos;
+
+        return emit(op);
+    }
+
+    bool primary()
+    {
+        skip_spaces();
+
+        if (*m_pos == '(') {
+            ++m_pos;
+            if (!expression(1)) return false;
+            skip_spaces();
+            if (*m_pos != ')')
+                return fail("Expected ')'");
+            ++m_pos;
+            return true;
+        }
+
+        if (isdigit(*m_pos)) {
+            char* end;
+            long long v;
+            if (m_pos[0] == '0' && (m_pos[1] == 'b' || m_pos[1] == 'B'))
+                v = strtoll(m_pos + 2, &end, 2);
+            else
+                v = strtoll(m_pos, &end, 0);
+            if (isalnum(*end))
+                return fail(std::string("Invalid number at '") + m_pos + "'");
+            m_pos = end;
+            return emit(Op_Const, v);
+        }
+
+        if (!isalpha(*m_pos) && *m_pos != '_')
+            return fail(*m_pos ? std::string("Unexpected character at '") + m_pos + "'"
+                               : std::string("Unexpected end of expression"));
+
+        const char* start = m_pos;
+        while (isalnum(*m_pos) || *m_pos == '_') ++m_pos;
+        std::string name(start, m_pos - start);
+
+        if (name == "sreg") return emit(Op_Sreg);
+        if (name == "sp") return emit(Op_Sp);
+        if (name == "pc") return emit(Op_Pc);
+        if (name == "value") return emit(Op_Value);
+        if (name == "addr") return emit(Op_Addr);
+        if (name == "x") return emit(Op_Reg16, 26);
+        if (name == "y") return emit(Op_Reg16, 28);
+        if (name == "z") return emit(Op_Reg16, 30);
+        if (name == "mem") return indexed(Op_Mem);
+        if (name == "mem16") return indexed(Op_Mem16);
+        if (name == "io") return indexed(Op_IO);
+
+        if (name[0] == 'r' && name.size() > 1 && name.size() <= 3 &&
+            isdigit(name[1]) && (name.size() == 2 || isdigit(name[2]))) {
+            int n = atoi(name.c_str() + 1);
+            if (n < 32)
+                return emit(Op_Reg, n);
+        }
+
+        return fail("Unknown identifier '" + name + "'");
+    }
+
+};
+
+
+//Binary operators, the longest tokens first
+const DebugCondition::Parser::binop_t DebugCondition::Parser::BinaryOps[] = {
+    { "||", 1, Op_LOr },
+    { "&&", 2, Op_LAnd },
+    { "==", 6, Op_Eq },
+    { "!=", 6, Op_Ne },
+    { "<=", 7, Op_Le },
+    { ">=", 7, Op_Ge },
+    { "<<", 8, Op_Shl },
+    { ">>", 8, Op_Shr },
+    { "|", 3, Op_Or },
+    { "^", 4, Op_Xor },
+    { "&", 5, Op_And },
+    { "<", 7, Op_Lt },
+    { ">", 7, Op_Gt },
+    { "+", 9, Op_Add },
+    { "-", 9, Op_Sub },
+    { "*", 10, Op_Mul },
+    { "/", 10, Op_Div },
+    { "%", 10, Op_Mod },
+    { nullptr, 0, Op_Const },
+};
+
+
+//=======================================================================================
+
+DebugCondition::DebugCondition()
+{}
+
+/**
+   Construct and compile a condition.
+   \sa compile()
+ */
+DebugCondition::DebugCondition(const std::string& expr)
+{
+    compile(expr);
+}
+
+/**
+   Compile an expression. On failure, the condition is left invalid and
+   error() returns the reason.
+   \param expr expression to compile
+   \return true if the compilation succeeded
+ */
+bool DebugCondition::compile(const std::string& expr)
+{
+    m_expr = expr;
+    m_error.clear();
+    m_code.clear();
+
+    Parser parser(expr, m_code);
+    if (!parser.parse(m_error)) {
+        m_code.clear();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+   Evaluate the condition.
+   \param probe debug probe used to access the device state
+   \param addr data space address of the access, for a watchpoint
+   \param value value read or written, for a watchpoint
+   \return the result of the expression, or 0 if the condition is not valid
+ */
+long long DebugCondition::evaluate(const DeviceDebugProbe& probe, mem_addr_t addr, uint8_t value) const
+{
+    if (m_code.empty()) return 0;
+
+    long long stack[STACK_SIZE];
+    long long* top = stack - 1;
+
+    for (const instr_t& instr : m_code) {
+        switch (instr.op) {
+            case Op_Const: *++top = instr.arg; break;
+            case Op_Reg: *++top = probe.read_gpreg(instr.arg); break;
+            case Op_Reg16:
+                *++top = probe.read_gpreg(instr.arg) | (probe.read_gpreg(instr.arg + 1) << 8);
+                break;
+            case Op_Sreg: *++top = probe.read_sreg(); break;
+            case Op_Sp: *++top = probe.read_sp(); break;
+            case Op_Pc: *++top = probe.read_pc(); break;
+            case Op_Value: *++top = value; break;
+            case Op_Addr: *++top = addr; break;
+
+            case Op_Mem: *top = probe.peek_data(*top); break;
+            case Op_Mem16:
+                *top = probe.peek_data(*top) | (probe.peek_data((mem_addr_t) *top + 1) << 8);
+                break;
+            case Op_IO: *top = probe.peek_ioreg(*top); break;
+
+            //The arithmetic is performed on unsigned values so that overflows wrap around
+            case Op_Neg: *top = -(unsigned long long) *top; break;
+            case Op_Not: *top = !*top; break;
+            case Op_Inv: *top = ~*top; break;
+
+            default: {
+                long long b = *top--;
+                long long& a = *top;
+                unsigned long long ua = a, ub = b;
+                switch (instr.op) {
+                    case Op_Mul: a = ua * ub; break;
+                    //Division by -1 is a negation, to avoid the overflow of LLONG_MIN / -1
+                    case Op_Div: a = (b == -1) ? (long long) -ua : (b ? (a / b) : 0); break;
+                    case Op_Mod: a = (b && b != -1) ? (a % b) : 0; break;
+                    case Op_Add: a = ua + ub; break;
+                    case Op_Sub: a = ua - ub; break;
+                    case Op_Shl: a = (b >= 0 && b < 64) ? (ua << b) : 0; break;
+                    case Op_Shr: a = (b >= 0 && b < 64) ? (a >> b) : 0; break;
+                    case Op_Lt: a = a < b; break;
+                    case Op_Le: a = a <= b; break;
+                    case Op_Gt: a = a > b; break;
+                    case Op_Ge: a = a >= b; break;
+                    case Op_Eq: a = a == b; break;
+                    case Op_Ne: a = a != b; break;
+                    case Op_And: a = a & b; break;
+                    case Op_Xor: a = a ^ b; break;
+                    case Op_Or: a = a | b; break;
+                    case Op_LAnd: a = a && b; break;
+                    case Op_LOr: a = a || b; break;
+                    default: break;
+                }
+            }
+        }
+    }
+
+    return *top;
+}
@@ -0,0 +1,127 @@
+/*
+ * sim_condition.h
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#ifndef __YASIMAVR_CONDITION_H__
+#define __YASIMAVR_CONDITION_H__
+
+#include "sim_types.h"
+#include <string>
+#include <vector>
+
+YASIMAVR_BEGIN_NAMESPACE
+
+class DeviceDebugProbe;
+
+
+//=======================================================================================
+/**
+   \brief Compiled debug condition
+
+   Condition attached to a breakpoint or a watchpoint of a DeviceDebugProbe, evaluated
+   in the simulation each time it is hit. The hit is ignored if the condition is false.
+
+   The condition is written as a C-like integer expression, compiled into a bytecode for
+   a small stack machine. The operands are:
+    - integer literals, in decimal, hexadecimal (0x) or binary (0b),
+    - r0 to r31 : general purpose registers,
+    - x, y, z : 16-bits pointer registers,
+    - sreg, sp, pc : status register, stack pointer, program counter (in bytes),
+    - value, addr : value and data space address of the access for a watchpoint,
+    - mem[e], mem16[e] : byte or little-endian word at the data space address e,
+    - io[e] : I/O register at the I/O address e.
+
+   The operators, by increasing precedence, are:
+   || && | ^ & (== !=) (< <= > >=) (<< >>) (+ -) (* / %) and the unary operators - ! ~.
+   Reading memory and I/O registers has no side effect on the simulation.
+
+   Example: "r24 == 0x10 && sp < 0x8F0", "value > 100"
+ */
+class AVR_CORE_PUBLIC_API DebugCondition {
+
+public:
+
+    DebugCondition();
+    explicit DebugCondition(const std::string& expr);
+
+    bool compile(const std::string& expr);
+
+    bool valid() const;
+    const std::string& expression() const;
+    const std::string& error() const;
+
+    long long evaluate(const DeviceDebugProbe& probe, mem_addr_t addr = 0, uint8_t value = 0) const;
+    bool test(const DeviceDebugProbe& probe, mem_addr_t addr = 0, uint8_t value = 0) const;
+
+private:
+
+    class Parser;
+    friend class Parser;
+
+    enum Opcode {
+        Op_Const, Op_Reg, Op_Reg16, Op_Sreg, Op_Sp, Op_Pc, Op_Value, Op_Addr,
+        Op_Mem, Op_Mem16, Op_IO,
+        Op_Neg, Op_Not, Op_Inv,
+        Op_Mul, Op_Div, Op_Mod, Op_Add, Op_Sub, Op_Shl, Op_Shr,
+        Op_Lt, Op_Le, Op_Gt, Op_Ge, Op_Eq, Op_Ne,
+        Op_And, Op_Xor, Op_Or, Op_LAnd, Op_LOr,
+    };
+
+    struct instr_t {
+        Opcode op;
+        long long arg;
+    };
+
+    std::string m_expr;
+    std::string m_error;
+    std::vector<instr_t> m_code;
+
+};
+
+/// Returns true if the condition is compiled and can be evaluated
+inline bool DebugCondition::valid() const
+{
+    return !m_code.empty();
+}
+
+/// Returns the expression of the condition
+inline const std::string& DebugCondition::expression() const
+{
+    return m_expr;
+}
+
+/// Returns the compilation error message, empty if the compilation succeeded
+inline const std::string& DebugCondition::error() const
+{
+    return m_error;
+}
+
+/// Evaluate the condition and return true if the result is non-zero
+inline bool DebugCondition::test(const DeviceDebugProbe& probe, mem_addr_t addr, uint8_t value) const
+{
+    return evaluate(probe, addr, value) != 0;
+}
+
+
+YASIMAVR_END_NAMESPACE
+
+#endif //__YASIMAVR_CONDITION_H__
@@ -101,6 +101,13 @@ bool Core::init(Device& d)
         m_device->logger().err("No Interrupt Controller attached");
         return false;
     }
+
+    //Resolve the requests sent by the CPU. The peripherals are all attached at this point.
+    m_req_sleep = d.resolve_ctlreq(AVR_IOCTL_SLEEP, AVR_CTLREQ_SLEEP_CALL);
+    m_req_pseudo_sleep = d.resolve_ctlreq(AVR_IOCTL_SLEEP, AVR_CTLREQ_SLEEP_PSEUDO);
+    m_req_watchdog_reset = d.resolve_ctlreq(AVR_IOCTL_WTDG, AVR_CTLREQ_WATCHDOG_RESET);
+    m_req_nvm_write = d.resolve_ctlreq(AVR_IOCTL_NVM, AVR_CTLREQ_NVM_WRITE);
+
     return true;
 }
 
@@ -463,13 +470,13 @@ void Core::ioctl_write_ioreg(const regbit_t& rb, uint8_t value)
 uint8_t Core::cpu_read_flash(flash_addr_t pgm_addr)
 {
     if (pgm_addr > m_config.flashend) {
-        m_device->logger().err("CPU reading an invalid flash address: 0x%04x", pgm_addr);
+        m_device->logger().err("CPU reading an invalid flash address: 0x%04lx", pgm_addr);
         m_device->crash(CRASH_FLASH_ADDR_OVERFLOW, "Invalid flash address");
         return 0;
     }
 
     if (!m_flash.programmed(pgm_addr)) {
-        m_device->logger().wng("CPU reading an unprogrammed flash address: 0x%04x", pgm_addr);
+        m_device->logger().wng("CPU reading an unprogrammed flash address: 0x%04lx", pgm_addr);
         if (!m_device->test_option(Device::Option_IgnoreBadCpuLPM)) {
             m_device->crash(CRASH_FLASH_ADDR_OVERFLOW, "Invalid flash address");
         }
@@ -28,6 +28,7 @@
 #include "sim_pin.h"
 #include "sim_config.h"
 #include "sim_memory.h"
+#include "sim_peripheral.h"
 #include <vector>
 #include <string>
 #include <map>
@@ -39,6 +40,7 @@ class Device;
 class Firmware;
 class InterruptController;
 class DeviceDebugProbe;
+class DeviceSnapshot;
 
 
 //=======================================================================================
@@ -97,6 +99,7 @@ class AVR_CORE_PUBLIC_API Core {
 
     friend class Device;
     friend class DeviceDebugProbe;
+    friend class DeviceSnapshot;
 
 public:
 
@@ -161,6 +164,8 @@ protected:
     unsigned int m_int_inhib_counter;
     ///Pointer to the generic debug probe
     DeviceDebugProbe* m_debug_probe;
+    ///Handle for the NVM write requests, resolved by init()
+    CtlRequest m_req_nvm_write;
 
     //CPU access to I/O registers in I/O address space
     uint8_t cpu_read_ioreg(reg_addr_t addr);
@@ -243,6 +248,10 @@ private:
     uint8_t m_sreg[8];
     //Direct pointer to the interrupt controller. We don't use the ctlreq framework for performance
     InterruptController* m_intrctl;
+    //Handles for the requests sent by the SLEEP, WDR and "rjmp .-2" instructions
+    CtlRequest m_req_sleep;
+    CtlRequest m_req_pseudo_sleep;
+    CtlRequest m_req_watchdog_reset;
 
     reg_addr_t m_reg_console;
     std::string m_console_buffer;
@@ -259,6 +268,7 @@ private:
 
     //Main instruction interpreter
     cycle_count_t run_instruction();
+    cycle_count_t execute_instruction(uint32_t opcode);
 
     //Called by a RETI instruction
     void exec_reti();
@@ -228,16 +228,36 @@ static bool _is_instruction_32_bits(uint16_t opcode)
             o == 0x940f;    // CALL Long Call to sub
 }
 
-//Main instruction interpreter, copied from the simavr project with some adaptation
 cycle_count_t Core::run_instruction()
 {
-
     if (m_pc > m_config.flashend) {
         m_device->crash(CRASH_PC_OVERFLOW, "PC over programend");
         return 0;
     }
 
-    uint32_t        opcode = get_flash16le(m_pc);
+    uint32_t opcode = get_flash16le(m_pc);
+
+    //If it's a BREAK inserted for a breakpoint with a false condition, the original
+    //instruction is executed in its place, with the breakpoint removed for the time
+    //of the execution. If the original instruction is itself a BREAK, it is executed
+    //as such.
+    breakpoint_t* cond_bp = nullptr;
+    if (opcode == AVR_BREAK_OPCODE && m_debug_probe)
+        cond_bp = m_debug_probe->_cpu_notify_break(m_pc);
+
+    if (!cond_bp)
+        return execute_instruction(opcode);
+
+    breakpoint_t bp = *cond_bp;
+    dbg_remove_breakpoint(bp);
+    cycle_count_t bp_cycle = execute_instruction(get_flash16le(m_pc));
+    dbg_insert_breakpoint(bp);
+    return bp_cycle;
+}
+
+//Main instruction interpreter, copied from the simavr project with some adaptation
+cycle_count_t Core::execute_instruction(uint32_t opcode)
+{
     flash_addr_t    new_pc = m_pc + 2;  // future "default" pc
     int             cycle = 1;
 #ifndef YASIMAVR_NO_TRACE
@@ -516,7 +536,7 @@ cycle_count_t Core::run_instruction()
             } else switch (opcode) {
                 case 0x9588: { // SLEEP -- 1001 0101 1000 1000
                     TRACE_OP("sleep");
-                    m_device->ctlreq(AVR_IOCTL_SLEEP, AVR_CTLREQ_SLEEP_CALL);
+                    m_req_sleep();
                 }   break;
                 case 0x9598: { // BREAK -- 1001 0101 1001 1000
                     TRACE_OP("break");
@@ -527,7 +547,7 @@ cycle_count_t Core::run_instruction()
                 }   break;
                 case 0x95a8: { // WDR -- Watchdog Reset -- 1001 0101 1010 1000
                     //STATE("wdr\n");
-                    m_device->ctlreq(AVR_IOCTL_WTDG, AVR_CTLREQ_WATCHDOG_RESET);
+                    m_req_watchdog_reset();
                 }   break;
                 case 0x95e8:    // SPM -- Store Program Memory -- 1001 0101 1110 1000
                 case 0x95f8: {  // SPM -- Store Program Memory -- 1001 0101 1111 1000 (Z post-increment)
@@ -546,7 +566,7 @@ cycle_count_t Core::run_instruction()
                     }
 
                     ctlreq_data_t d = { .data = &nvm_req };
-                    m_device->ctlreq(AVR_IOCTL_NVM, AVR_CTLREQ_NVM_WRITE, &d);
+                    m_req_nvm_write(&d);
                 }   break;
                 case 0x9409:   // IJMP -- Indirect jump -- 1001 0100 0000 1001
                 case 0x9419: { // EIJMP -- Indirect jump -- 1001 0100 0001 1001   bit 4 is "extended"
@@ -947,7 +967,7 @@ cycle_count_t Core::run_instruction()
             get_o12(opcode);
             TRACE_OP("rjmp .%+d [%04x]", o, new_pc + o);
             if (o == -2)
-                m_device->ctlreq(AVR_IOCTL_SLEEP, AVR_CTLREQ_SLEEP_PSEUDO);
+                m_req_pseudo_sleep();
             new_pc = (new_pc + o) % (m_config.flashend + 1);
             cycle++;
             TRACE_JUMP;
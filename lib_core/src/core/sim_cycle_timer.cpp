@@ -22,6 +22,7 @@
 //=======================================================================================
 
 #include "sim_cycle_timer.h"
+#include "sim_signal.h"
 
 YASIMAVR_USING_NAMESPACE
 
@@ -73,6 +74,8 @@ struct CycleManager::TimerSlot {
 
 CycleManager::CycleManager()
 :m_cycle(0)
+,m_processed_cycle(INVALID_CYCLE)
+,m_signal_queue(nullptr)
 {}
 
 
@@ -86,6 +89,8 @@ CycleManager::~CycleManager()
     }
 
     m_timer_slots.clear();
+
+    delete m_signal_queue;
 }
 
 /**
@@ -96,6 +101,17 @@ void CycleManager::increment_cycle(cycle_count_t count)
     m_cycle += count;
 }
 
+/**
+   Set the cycle counter to an arbitrary value. This is only meant for restoring
+   a device snapshot. The timers of the new cycle are considered not processed yet.
+   The scheduled timers are left untouched and will be called at their scheduled cycle.
+ */
+void CycleManager::set_cycle(cycle_count_t cycle)
+{
+    m_cycle = cycle;
+    m_processed_cycle = cycle - 1;
+}
+
 
 void CycleManager::add_to_queue(TimerSlot* slot)
 {
@@ -213,6 +229,8 @@ void CycleManager::resume(CycleTimer& timer)
  */
 void CycleManager::process_timers()
 {
+    m_processed_cycle = m_cycle;
+
     //Loops until either the timer queue is empty or the front timer is paused or its 'when' is in the future
     while(!m_timer_slots.empty()) {
         TimerSlot* slot = m_timer_slots.front();
@@ -240,6 +258,10 @@ void CycleManager::process_timers()
             }
         }
     }
+
+    //Dispatch the deferred signal raises of this cycle
+    if (m_signal_queue)
+        m_signal_queue->flush();
 }
 
 /**
@@ -260,6 +282,33 @@ cycle_count_t CycleManager::next_when() const
 }
 
 
+/**
+   \return the timers currently in the queue, in the order they are called,
+   followed by the paused timers.
+ */
+std::vector<CycleManager::timer_slot_t> CycleManager::timer_slots() const
+{
+    std::vector<timer_slot_t> slots;
+    slots.reserve(m_timer_slots.size());
+    for (TimerSlot* slot : m_timer_slots)
+        slots.push_back({ slot->timer, slot->when, slot->paused });
+    return slots;
+}
+
+
+/**
+   Returns the queue for deferred signal raises, flushed at the end of
+   each call to process_timers().
+   \sa Signal::set_deferred()
+ */
+SignalQueue& CycleManager::signal_queue()
+{
+    if (!m_signal_queue)
+        m_signal_queue = new SignalQueue();
+    return *m_signal_queue;
+}
+
+
 void CycleManager::copy_slot(const CycleTimer& src, CycleTimer& dst)
 {
     for (auto it = m_timer_slots.begin(); it != m_timer_slots.end(); ++it) {
@@ -26,6 +26,7 @@
 
 #include "sim_types.h"
 #include <deque>
+#include <vector>
 
 YASIMAVR_BEGIN_NAMESPACE
 
@@ -33,6 +34,7 @@ YASIMAVR_BEGIN_NAMESPACE
 //=======================================================================================
 
 class CycleManager;
+class SignalQueue;
 
 /**
    Abstract interface for timers that can register with the cycle manager and
@@ -83,17 +85,33 @@ private:
 
    Cycles are meant to represent one cycle of the MCU main clock though
    the overall cycle-level accuracy of the simulation is not guaranteed.
-   It it a counter guaranteed to start at 0 and always increasing.
+   It it a counter guaranteed to start at 0 and always increasing, except
+   when explicitly set by the restoration of a device snapshot.
+
+   The manager also owns a queue for deferred signal raises, flushed at the end of
+   process_timers().
  */
 class AVR_CORE_PUBLIC_API CycleManager {
 
 public:
 
+    /// State of a timer in the queue, as returned by timer_slots()
+    struct timer_slot_t {
+        /// Pointer to the timer
+        CycleTimer* timer;
+        /// Absolute cycle of the next call or, if the timer is paused, remaining delay
+        cycle_count_t when;
+        /// Indicates if the timer is paused
+        bool paused;
+    };
+
     CycleManager();
     ~CycleManager();
 
     cycle_count_t cycle() const;
+    cycle_count_t processed_cycle() const;
     void increment_cycle(cycle_count_t count);
+    void set_cycle(cycle_count_t cycle);
 
     void schedule(CycleTimer& timer, cycle_count_t when);
 
@@ -109,6 +127,10 @@ public:
 
     cycle_count_t next_when() const;
 
+    std::vector<timer_slot_t> timer_slots() const;
+
+    SignalQueue& signal_queue();
+
     CycleManager(const CycleManager&) = delete;
     CycleManager& operator=(const CycleManager&) = delete;
 
@@ -120,6 +142,9 @@ private:
     struct TimerSlot;
     std::deque<TimerSlot*> m_timer_slots;
     cycle_count_t m_cycle;
+    cycle_count_t m_processed_cycle;
+    //Queue for deferred signals, allocated on first use
+    SignalQueue* m_signal_queue;
 
     //Utility method to add a timer in the cycle queue, conserving the order or 'when'
     //and paused timers last
@@ -138,6 +163,17 @@ inline cycle_count_t CycleManager::cycle() const
     return m_cycle;
 }
 
+/**
+   Returns the cycle of the last call to process_timers(), or INVALID_CYCLE
+   if it has not been called yet.
+   Any change made to the simulation after the call is equivalent to a change
+   made by a timer scheduled at this cycle.
+ */
+inline cycle_count_t CycleManager::processed_cycle() const
+{
+    return m_processed_cycle;
+}
+
 
 YASIMAVR_END_NAMESPACE
 
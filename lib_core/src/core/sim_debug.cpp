@@ -137,7 +137,11 @@ void DeviceDebugProbe::detach()
 
             //Hand over the breakpoints and watchpoints
             new_primary->m_breakpoints = std::move(m_breakpoints);
+            new_primary->m_bp_conditions = std::move(m_bp_conditions);
             new_primary->m_watchpoints = std::move(m_watchpoints);
+            new_primary->update_watchpoint_maps();
+            m_watchpoints.clear();
+            update_watchpoint_maps();
 
         } else {
             //If no secondary to promote, unregister from the core and destroy
@@ -148,8 +152,10 @@ void DeviceDebugProbe::detach()
             for (auto& [addr, bp] : m_breakpoints)
                 m_device->core().dbg_remove_breakpoint(bp);
             m_breakpoints.clear();
+            m_bp_conditions.clear();
 
             m_watchpoints.clear();
+            update_watchpoint_maps();
 
         }
     }
@@ -307,6 +313,61 @@ void DeviceDebugProbe::read_data(mem_addr_t addr, uint8_t* buf, mem_addr_t len)
     m_device->set_option(Device::Option_IgnoreBadCpuIO, badioopt);
 }
 
+/**
+   Read a byte from the data space without any side effect on the simulation,
+   unlike read_data(). The I/O registers are read from their stored value, bypassing
+   the peripherals.
+   \param addr data space address
+   \return value of the byte
+ */
+uint8_t DeviceDebugProbe::peek_data(mem_addr_t addr) const
+{
+    if (!m_device) return 0;
+
+    Core& core = m_device->core();
+    const CoreConfiguration& cfg = core.config();
+
+    if (addr >= cfg.iostart && addr <= cfg.ioend) {
+        return peek_ioreg(addr - cfg.iostart);
+    }
+    else if (addr >= cfg.ramstart && addr <= cfg.ramend) {
+        return core.m_sram[addr - cfg.ramstart];
+    }
+    else if (addr < 32 && cfg.iostart >= 32) {
+        return core.m_regs[addr];
+    }
+    else {
+        uint8_t value = 0;
+        read_data(addr, &value, 1);
+        return value;
+    }
+}
+
+/**
+   Read an I/O register without any side effect on the simulation, unlike read_ioreg().
+   \param reg_addr I/O address of the register
+   \return value of the register, or 0 if the register does not exist
+ */
+uint8_t DeviceDebugProbe::peek_ioreg(reg_addr_t reg_addr) const
+{
+    if (!m_device || !reg_addr.valid()) return 0;
+
+    Core& core = m_device->core();
+    const mem_addr_t iosize = core.config().ioend - core.config().iostart + 1;
+
+    unsigned short addr = (unsigned short) reg_addr;
+
+    if (addr == R_SREG) {
+        return core.read_sreg();
+    }
+    else if (addr < iosize) {
+        IO_Register *ioreg = core.m_ioregs[addr];
+        if (ioreg)
+            return ioreg->value();
+    }
+    return 0;
+}
+
 void DeviceDebugProbe::insert_breakpoint(flash_addr_t addr)
 {
     if (!m_device) return;
@@ -333,9 +394,69 @@ void DeviceDebugProbe::remove_breakpoint(flash_addr_t addr)
     if (search != m_breakpoints.end()) {
         m_device->core().dbg_remove_breakpoint(search->second);
         m_breakpoints.erase(search);
+        m_bp_conditions.erase(addr);
     }
 }
 
+/**
+   Attach a condition to a breakpoint. When the breakpoint is hit, the CPU is halted
+   only if the condition is true. An invalid condition (e.g. default-constructed)
+   removes any condition previously attached.
+   The condition is discarded when the breakpoint is removed.
+   \param addr address of the breakpoint in the flash
+   \param condition compiled condition
+ */
+void DeviceDebugProbe::set_breakpoint_condition(flash_addr_t addr, const DebugCondition& condition)
+{
+    if (!m_device) return;
+
+    if (m_primary) {
+        m_primary->set_breakpoint_condition(addr, condition);
+        return;
+    }
+
+    if (m_breakpoints.find(addr) == m_breakpoints.end()) return;
+
+    if (condition.valid())
+        m_bp_conditions[addr] = condition;
+    else
+        m_bp_conditions.erase(addr);
+}
+
+/**
+   Get the condition attached to a breakpoint.
+   \param addr address of the breakpoint in the flash
+   \return the condition, invalid if the breakpoint has no condition
+ */
+DebugCondition DeviceDebugProbe::breakpoint_condition(flash_addr_t addr) const
+{
+    if (m_primary)
+        return m_primary->breakpoint_condition(addr);
+
+    auto search = m_bp_conditions.find(addr);
+    return search != m_bp_conditions.end() ? search->second : DebugCondition();
+}
+
+/**
+   Test if a breakpoint would halt the CPU at its current state.
+   \param addr address of the breakpoint in the flash
+   \return true if a breakpoint is inserted at the address and has no condition
+   or its condition is true
+ */
+bool DeviceDebugProbe::test_breakpoint(flash_addr_t addr) const
+{
+    if (!m_device) return false;
+
+    if (m_primary)
+        return m_primary->test_breakpoint(addr);
+
+    if (m_breakpoints.find(addr) == m_breakpoints.end())
+        return false;
+
+    auto search = m_bp_conditions.find(addr);
+    return search == m_bp_conditions.end() || search->second.test(*this);
+}
+
 void DeviceDebugProbe::insert_watchpoint(mem_addr_t addr, mem_addr_t len, int flags)
 {
     if (!m_device) return;
@@ -352,6 +473,8 @@ void DeviceDebugProbe::insert_watchpoint(mem_addr_t addr, mem_addr_t len, int fl
     } else {
         m_watchpoints[addr] = { addr, len, flags };
     }
+
+    update_watchpoint_maps();
 }
 
 void DeviceDebugProbe::remove_watchpoint(mem_addr_t addr, int flags)
@@ -370,14 +493,52 @@ void DeviceDebugProbe::remove_watchpoint(mem_addr_t addr, int flags)
         //If neither Read or Write event flags are left, destroy the watchpoint
         if (!(search->second.flags & (Watchpoint_Write | Watchpoint_Read)))
             m_watchpoints.erase(search);
+
+        update_watchpoint_maps();
+    }
+}
+
+/**
+   Attach a condition to a watchpoint. When the watchpoint is hit, it is ignored
+   unless the condition is true. The operands 'addr' and 'value' of the condition are
+   set to the address and the value of the data access.
+   An invalid condition removes any condition previously attached.
+   \param addr start address of the watchpoint in the data space
+   \param condition compiled condition
+ */
+void DeviceDebugProbe::set_watchpoint_condition(mem_addr_t addr, const DebugCondition& condition)
+{
+    if (!m_device) return;
+
+    if (m_primary) {
+        m_primary->set_watchpoint_condition(addr, condition);
+        return;
     }
+
+    auto search = m_watchpoints.find(addr);
+    if (search != m_watchpoints.end())
+        search->second.condition = condition;
+}
+
+/**
+   Get the condition attached to a watchpoint.
+   \param addr start address of the watchpoint in the data space
+   \return the condition, invalid if the watchpoint has no condition
+ */
+DebugCondition DeviceDebugProbe::watchpoint_condition(mem_addr_t addr) const
+{
+    if (m_primary)
+        return m_primary->watchpoint_condition(addr);
+
+    auto search = m_watchpoints.find(addr);
+    return search != m_watchpoints.end() ? search->second.condition : DebugCondition();
 }
 
 void DeviceDebugProbe::notify_watchpoint(watchpoint_t& wp, int event, mem_addr_t addr, uint8_t value)
 {
     //If the watchpoint flag is set to Break, halt the CPU, only if this is the primary probe
     if (!m_primary && (wp.flags & Watchpoint_Break)) {
-        m_device->logger().wng("Device break on watchpoint A=%04x", addr);
+        m_device->logger().wng("Device break on watchpoint A=%04lx", addr);
         m_device->ctlreq(AVR_IOCTL_CORE, AVR_CTLREQ_CORE_BREAK, nullptr);
     }
 
@@ -390,24 +551,41 @@ void DeviceDebugProbe::notify_watchpoint(watchpoint_t& wp, int event, mem_addr_t
         secondary->notify_watchpoint(wp, event, addr, value);
 }
 
-//Notification when the CPU reads from the RAM. Check if there's a watchpoint associated with the address.
-void DeviceDebugProbe::_cpu_notify_data_read(mem_addr_t addr, uint8_t value)
+//Search for the watchpoints associated with an address accessed by the CPU, after the
+//access has passed the granule filter. Only watchpoints starting at or before
+//the address can match. Watchpoints may overlap so every matching one is notified,
+//unless its condition is false. The conditions are evaluated once, by the primary
+//probe, before notifying the secondaries.
+void DeviceDebugProbe::notify_data_access(int event, mem_addr_t addr, uint8_t value)
 {
-    for (auto& [_, wp] : m_watchpoints) {
-        if (addr >= wp.addr && addr < (wp.addr + wp.len) && (wp.flags & Watchpoint_Read)) {
-            notify_watchpoint(wp, Watchpoint_Read, addr, value);
-            return;
-        }
+    auto end = m_watchpoints.upper_bound(addr);
+    for (auto it = m_watchpoints.begin(); it != end; ++it) {
+        watchpoint_t& wp = it->second;
+        if (addr >= (wp.addr + wp.len) || !(wp.flags & event))
+            continue;
+        if (wp.condition.valid() && !wp.condition.test(*this, addr, value))
+            continue;
+        notify_watchpoint(wp, event, addr, value);
     }
 }
 
-//Notification when the CPU writes into the RAM. Check if there's a watchpoint associated with the address.
-void DeviceDebugProbe::_cpu_notify_data_write(mem_addr_t addr, uint8_t value)
+//Rebuild the granule bitmaps from the watchpoint list.
+void DeviceDebugProbe::update_watchpoint_maps()
 {
+    m_wp_read_map.clear();
+    m_wp_write_map.clear();
+
     for (auto& [_, wp] : m_watchpoints) {
-        if (addr >= wp.addr && addr < (wp.addr + wp.len) && (wp.flags & Watchpoint_Write)) {
-            notify_watchpoint(wp, Watchpoint_Write, addr, value);
-            return;
+        if (!wp.len) continue;
+        size_t first = wp.addr >> 4;
+        size_t last = (wp.addr + wp.len - 1) >> 4;
+        for (int event : { Watchpoint_Read, Watchpoint_Write }) {
+            if (!(wp.flags & event)) continue;
+            std::vector<uint64_t>& map = (event == Watchpoint_Read) ? m_wp_read_map : m_wp_write_map;
+            if (map.size() <= (last >> 6))
+                map.resize((last >> 6) + 1, 0);
+            for (size_t g = first; g <= last; ++g)
+                map[g >> 6] |= 1ULL << (g & 63);
         }
     }
 }
@@ -416,3 +594,19 @@ void DeviceDebugProbe::_cpu_notify_data_write(mem_addr_t addr, uint8_t value)
 void DeviceDebugProbe::_cpu_notify_jump(flash_addr_t addr) {}
 void DeviceDebugProbe::_cpu_notify_call(flash_addr_t addr) {}
 void DeviceDebugProbe::_cpu_notify_ret() {}
+
+//Called by the CPU when executing a BREAK instruction. If it's a breakpoint with a false
+//condition, returns the breakpoint so that the CPU can execute the original
+//instruction instead. Otherwise returns null and the CPU should be halted.
+breakpoint_t* DeviceDebugProbe::_cpu_notify_break(flash_addr_t addr)
+{
+    auto search = m_breakpoints.find(addr);
+    if (search == m_breakpoints.end())
+        return nullptr;
+
+    auto cond = m_bp_conditions.find(addr);
+    if (cond == m_bp_conditions.end() || cond->second.test(*this))
+        return nullptr;
+
+    return &search->second;
+}
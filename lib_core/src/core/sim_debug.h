@@ -26,6 +26,7 @@
 
 #include "sim_types.h"
 #include "sim_device.h"
+#include "sim_condition.h"
 
 YASIMAVR_BEGIN_NAMESPACE
 
@@ -37,6 +38,7 @@ YASIMAVR_BEGIN_NAMESPACE
  *  - function to read/write directly into CPU registers, I/O registers, flash, data space
  *  - soft breakpoints
  *  - data watchpoints
+ *  - conditions on breakpoints and watchpoints, evaluated in the simulation
  *  - device reset and state change
  */
 class AVR_CORE_PUBLIC_API DeviceDebugProbe {
@@ -101,13 +103,22 @@ public:
     void write_data(mem_addr_t addr, const uint8_t* buf, mem_addr_t len) const;
     void read_data(mem_addr_t addr, uint8_t* buf, mem_addr_t len) const;
 
+    //Side-effect free access to the data space and the I/O registers
+    uint8_t peek_data(mem_addr_t addr) const;
+    uint8_t peek_ioreg(reg_addr_t addr) const;
+
     //Breakpoint management
     void insert_breakpoint(flash_addr_t addr);
     void remove_breakpoint(flash_addr_t addr);
+    void set_breakpoint_condition(flash_addr_t addr, const DebugCondition& condition);
+    DebugCondition breakpoint_condition(flash_addr_t addr) const;
+    bool test_breakpoint(flash_addr_t addr) const;
 
     //Watchpoint management
     void insert_watchpoint(mem_addr_t addr, mem_addr_t len, int flags);
     void remove_watchpoint(mem_addr_t addr, int flags);
+    void set_watchpoint_condition(mem_addr_t addr, const DebugCondition& condition);
+    DebugCondition watchpoint_condition(mem_addr_t addr) const;
     Signal& watchpoint_signal();
 
     //Callbacks from the CPU for notifications
@@ -116,6 +127,7 @@ public:
     void _cpu_notify_jump(flash_addr_t addr);
     void _cpu_notify_call(flash_addr_t addr);
     void _cpu_notify_ret();
+    breakpoint_t* _cpu_notify_break(flash_addr_t addr);
 
     DeviceDebugProbe& operator=(const DeviceDebugProbe& probe);
 
@@ -125,6 +137,7 @@ private:
         mem_addr_t addr;
         mem_addr_t len;
         int flags;
+        DebugCondition condition;
     };
 
     //Pointer to the device this is attached to.
@@ -135,12 +148,23 @@ private:
     std::vector<DeviceDebugProbe*> m_secondaries;
     //Mapping containers PC => breakpoint
     std::map<flash_addr_t, breakpoint_t> m_breakpoints;
+    //Mapping containers PC => breakpoint condition
+    std::map<flash_addr_t, DebugCondition> m_bp_conditions;
     //Mapping containers mem address => watchpoint
     std::map<mem_addr_t, watchpoint_t> m_watchpoints;
+    //Bitmaps of the 16-bytes granules of data space covered by a read or write
+    //watchpoint, used to filter the CPU accesses before searching the watchpoints.
+    //Empty if no watchpoint exists.
+    std::vector<uint64_t> m_wp_read_map;
+    std::vector<uint64_t> m_wp_write_map;
     //Signal for watchpoint notification
     Signal m_wp_signal;
 
     void notify_watchpoint(watchpoint_t& wp, int event, mem_addr_t addr, uint8_t value);
+    void notify_data_access(int event, mem_addr_t addr, uint8_t value);
+    void update_watchpoint_maps();
+
+    static bool is_watched(const std::vector<uint64_t>& map, mem_addr_t addr);
 
 };
 
@@ -159,6 +183,26 @@ inline Signal& DeviceDebugProbe::watchpoint_signal()
     return m_wp_signal;
 }
 
+inline bool DeviceDebugProbe::is_watched(const std::vector<uint64_t>& map, mem_addr_t addr)
+{
+    size_t granule = addr >> 4;
+    return (granule >> 6) < map.size() && ((map[granule >> 6] >> (granule & 63)) & 1);
+}
+
+//Notification when the CPU reads from the RAM. Check if there's a watchpoint associated with the address.
+inline void DeviceDebugProbe::_cpu_notify_data_read(mem_addr_t addr, uint8_t value)
+{
+    if (is_watched(m_wp_read_map, addr))
+        notify_data_access(Watchpoint_Read, addr, value);
+}
+
+//Notification when the CPU writes into the RAM. Check if there's a watchpoint associated with the address.
+inline void DeviceDebugProbe::_cpu_notify_data_write(mem_addr_t addr, uint8_t value)
+{
+    if (is_watched(m_wp_write_map, addr))
+        notify_data_access(Watchpoint_Write, addr, value);
+}
+
 
 YASIMAVR_END_NAMESPACE
 
@@ -45,6 +45,7 @@ Device::Device(Core& core, const DeviceConfiguration& config)
 ,m_logger(chr_to_id('D', 'E', 'V', 0), m_log_handler)
 ,m_cycle_manager(nullptr)
 ,m_reset_flags(0)
+,m_cycle_delta(0)
 {
     //Allocate the pin array
     for (unsigned int i = 0; i < config.pins.size(); ++i) {
@@ -72,6 +73,7 @@ void Device::erase_peripherals()
         delete per;
     }
     m_peripherals.clear();
+    m_peripheral_map.clear();
 
     //Destroys the device pins.
     for (auto it = m_pins.begin(); it != m_pins.end(); ++it) {
@@ -123,19 +125,18 @@ bool Device::init(CycleManager& cycle_manager)
 
     m_log_handler.init(cycle_manager);
 
-    m_logger.dbg("Initialisation of %s core", m_config.name);
+    m_logger.dbg("Initialisation of %s core", m_config.name.c_str());
     if (!m_core.init(*this)) {
-        m_logger.err("Initialisation of %s core failed.", m_config.name);
+        m_logger.err("Initialisation of %s core failed.", m_config.name.c_str());
         return false;
     }
 
     for (auto per : m_peripherals) {
-        const char* per_name = id_to_str(per->id()).c_str();
-        m_logger.dbg("Initialisation of peripheral '%s'", per_name);
+        LOGGER_DBG(m_logger, "Initialisation of peripheral '%s'", id_to_str(per->id()).c_str());
         if (!per->init(*this)) {
             m_logger.err("Initialisation of peripheral '%s' of %s failed.",
-                         per_name,
-                         m_config.name);
+                         id_to_str(per->id()).c_str(),
+                         m_config.name.c_str());
             return false;
         }
     }
@@ -143,7 +144,7 @@ bool Device::init(CycleManager& cycle_manager)
     m_state = State_Ready;
     reset();
 
-    m_logger.dbg("Initialisation of device '%s' complete", m_config.name);
+    m_logger.dbg("Initialisation of device '%s' complete", m_config.name.c_str());
 
     return true;
 }
@@ -226,12 +227,38 @@ bool Device::load_firmware(const Firmware& firmware)
  */
 bool Device::program(const Firmware& firmware)
 {
-    if (!firmware.has_memory(Firmware::Area_Flash)) {
+    //A flash mapped to a file with a content from a previous run is not reprogrammed,
+    //unless the tag of the file shows it was programmed with a different firmware.
+    NonVolatileMemory& flash = m_core.m_flash;
+    uint64_t fw_hash = firmware.has_memory(Firmware::Area_Flash) ? firmware.memory_hash(Firmware::Area_Flash) : 0;
+    bool reprogram = true;
+    if (flash.persisted()) {
+        uint64_t file_tag = flash.file_tag();
+        if (!fw_hash || file_tag == fw_hash) {
+            m_logger.dbg("Firmware load: flash content restored from its backing file");
+            reprogram = false;
+        }
+        else if (!file_tag) {
+            m_logger.wng("Firmware load: flash content restored from its backing file, not checked against the firmware");
+            reprogram = false;
+        }
+        else {
+            m_logger.wng("Firmware load: flash backing file programmed with another firmware, reprogramming");
+            flash.erase();
+        }
+    }
+
+    if (!reprogram) {
+        //Keep the content of the backing file
+    }
+    else if (!firmware.has_memory(Firmware::Area_Flash)) {
         m_logger.err("Firmware load: No program to load");
         return false;
     }
-    else if (firmware.load_memory(Firmware::Area_Flash, m_core.m_flash)) {
-        m_logger.dbg("Loaded %d bytes of flash", firmware.memory_size(Firmware::Area_Flash));
+    else if (firmware.load_memory(Firmware::Area_Flash, flash)) {
+        m_logger.dbg("Loaded %zu bytes of flash", firmware.memory_size(Firmware::Area_Flash));
+        //Record the firmware in the backing file, if any
+        flash.set_file_tag(fw_hash);
     } else {
         m_logger.err("Firmware load: The flash does not fit");
         return false;
@@ -256,18 +283,18 @@ bool Device::program(const Firmware& firmware)
  */
 cycle_count_t Device::exec_cycle()
 {
+    m_cycle_delta = 0;
     if (!(m_state & 0x0F)) return 0;
 
-    cycle_count_t cycle_delta;
     if (m_state == State_Running)
-        cycle_delta = m_core.exec_cycle();
+        m_cycle_delta = m_core.exec_cycle();
     else
-        cycle_delta = 1;
+        m_cycle_delta = 1;
 
     if (m_state == State_Reset)
         reset();
 
-    return cycle_delta;
+    return m_cycle_delta;
 }
 
 
@@ -285,6 +312,8 @@ void Device::attach_peripheral(Peripheral& ctl)
         m_core.m_intrctl = reinterpret_cast<InterruptController*>(&ctl);
 
     m_peripherals.push_back(&ctl);
+    //If several peripherals share the same identifier, the first one attached is used
+    m_peripheral_map.emplace(ctl.id(), &ctl);
 }
 
 /**
@@ -300,17 +329,34 @@ bool Device::ctlreq(ctl_id_t id, ctlreq_id_t req, ctlreq_data_t* reqdata)
     if (id == AVR_IOCTL_CORE) {
         return core_ctlreq(req, reqdata);
     } else {
-        for (auto per : m_peripherals) {
-            if (id == per->id()) {
-                return per->ctlreq(req, reqdata);
-            }
-        }
+        Peripheral* per = find_peripheral(id);
+        if (per)
+            return per->ctlreq(req, reqdata);
 
         m_logger.wng("Sending request but peripheral %s not found", id_to_str(id).c_str());
         return false;
     }
 }
 
+/**
+   Resolve a peripheral request into a handle that can be called repeatedly without
+   looking up the peripheral.
+   The handle must be resolved again if peripherals are attached afterwards.
+   \param id identifier of the peripheral to interrogate
+   \param req request identifier, specific to each peripheral
+   \return the handle. If the peripheral is not found, calling the handle
+   behaves as ctlreq().
+ */
+CtlRequest Device::resolve_ctlreq(ctl_id_t id, ctlreq_id_t req)
+{
+    CtlRequest h;
+    h.m_device = this;
+    h.m_peripheral = (id == AVR_IOCTL_CORE) ? nullptr : find_peripheral(id);
+    h.m_id = id;
+    h.m_req = req;
+    return h;
+}
+
 Peripheral* Device::find_peripheral(const char* name)
 {
     return find_peripheral(str_to_id(name));
@@ -323,11 +369,11 @@ Peripheral* Device::find_peripheral(const char* name)
  */
 Peripheral* Device::find_peripheral(ctl_id_t id)
 {
-    for (auto per : m_peripherals) {
-        if (per->id() == id)
-            return per;
-    }
-    return nullptr;
+    auto search = m_peripheral_map.find(id);
+    if (search == m_peripheral_map.end())
+        return nullptr;
+    else
+        return search->second;
 }
 
 /**
@@ -343,7 +389,7 @@ Peripheral* Device::find_peripheral(ctl_id_t id)
 void Device::add_ioreg_handler(reg_addr_t addr, IO_RegHandler& handler, uint8_t ro_mask)
 {
     if (addr != R_SREG && addr >= 0) {
-        m_logger.dbg("Registering handler for I/O 0x%04X", addr);
+        m_logger.dbg("Registering handler for I/O 0x%04X", (unsigned int) addr);
         IO_Register* reg = m_core.get_ioreg(addr);
         reg->set_handler(handler, 0xFF, ro_mask);
     }
@@ -361,7 +407,7 @@ void Device::add_ioreg_handler(reg_addr_t addr, IO_RegHandler& handler, uint8_t
 void Device::add_ioreg_handler(const regbit_t& rb, IO_RegHandler& handler, bool readonly)
 {
     if (rb.addr != R_SREG && rb.valid()) {
-        m_logger.dbg("Registering handler for I/O 0x%04X", rb.addr);
+        m_logger.dbg("Registering handler for I/O 0x%04X", (unsigned int) rb.addr);
         IO_Register* reg = m_core.get_ioreg(rb.addr);
         reg->set_handler(handler, rb.mask, readonly ? rb.mask : 0x00);
     }
@@ -375,7 +421,7 @@ bool Device::core_ctlreq(ctlreq_id_t req, ctlreq_data_t* reqdata)
 {
     if (req == AVR_CTLREQ_CORE_BREAK) {
         if (m_core.m_debug_probe) {
-            m_logger.wng("Device break at PC=%04x", m_core.m_pc);
+            m_logger.wng("Device break at PC=%04lx", m_core.m_pc);
             m_state = State_Break;
         }
         return true;
@@ -390,7 +436,7 @@ bool Device::core_ctlreq(ctlreq_id_t req, ctlreq_data_t* reqdata)
             else
                 m_logger.wng("Device going to sleep with GIE=0, stopping.");
 
-            m_logger.wng("End of program at PC = 0x%04x", m_core.m_pc);
+            m_logger.wng("End of program at PC = 0x%04lx", m_core.m_pc);
             m_state = State_Done;
 
         } else {
@@ -434,8 +480,8 @@ bool Device::core_ctlreq(ctlreq_id_t req, ctlreq_data_t* reqdata)
     }
 
     else if (req == AVR_CTLREQ_CORE_CRASH) {
-        m_logger.err("CPU crash, reason=%d", reqdata->index);
-        m_logger.wng("End of program at PC = 0x%04x", m_core.m_pc);
+        m_logger.err("CPU crash, reason=%lld", reqdata->index);
+        m_logger.wng("End of program at PC = 0x%04lx", m_core.m_pc);
         m_state = State_Crashed;
         return true;
     }
@@ -514,6 +560,6 @@ Pin* Device::find_pin(pin_id_t id)
 void Device::crash(uint16_t reason, const char* text)
 {
     m_logger.err("MCU crash, reason (code=%d) : %s", reason, text);
-    m_logger.wng("End of program at PC = 0x%04x", m_core.m_pc);
+    m_logger.wng("End of program at PC = 0x%04lx", m_core.m_pc);
     m_state = State_Crashed;
 }
@@ -30,7 +30,7 @@
 #include "sim_logger.h"
 #include <string>
 #include <vector>
-#include <map>
+#include <unordered_map>
 
 YASIMAVR_BEGIN_NAMESPACE
 
@@ -61,6 +61,7 @@ enum class SleepMode;
 class AVR_CORE_PUBLIC_API Device {
 
     friend class DeviceDebugProbe;
+    friend class DeviceSnapshot;
 
 public:
 
@@ -130,6 +131,14 @@ public:
            It is set by default.
          */
         Option_InfiniteLoopDetect   = 0x10,
+
+        /**
+           This option makes the signals of the ports and pins deferred to the signal queue
+           of the cycle manager, so that their hooks are called once per cycle with the last
+           data of each change. It must be set before init() to be effective.
+           \sa Signal::set_deferred()
+         */
+        Option_DeferPinSignals      = 0x20,
     };
 
     Device(Core& core, const DeviceConfiguration& config);
@@ -153,6 +162,7 @@ public:
     void reset(int reset_flags = Reset_PowerOn);
 
     cycle_count_t exec_cycle();
+    cycle_count_t last_cycle_delta() const;
 
     void attach_peripheral(Peripheral& ctl);
 
@@ -161,6 +171,7 @@ public:
     Peripheral* find_peripheral(const char* name);
     Peripheral* find_peripheral(ctl_id_t id);
     bool ctlreq(ctl_id_t id, ctlreq_id_t req, ctlreq_data_t* reqdata = nullptr);
+    CtlRequest resolve_ctlreq(ctl_id_t id, ctlreq_id_t req);
 
     //Helpers for the peripheral timers
     CycleManager* cycle_manager();
@@ -196,9 +207,11 @@ private:
     LogHandler m_log_handler;
     Logger m_logger;
     std::vector<Peripheral*> m_peripherals;
-    std::map<pin_id_t, Pin*> m_pins;
+    std::unordered_map<ctl_id_t, Peripheral*> m_peripheral_map;
+    std::unordered_map<pin_id_t, Pin*> m_pins;
     CycleManager* m_cycle_manager;
     int m_reset_flags;
+    cycle_count_t m_cycle_delta;
 
     std::string& name_from_pin(Pin* pin);
 
@@ -221,6 +234,14 @@ inline cycle_count_t Device::cycle() const
     return m_cycle_manager ? m_cycle_manager->cycle() : INVALID_CYCLE;
 }
 
+/**
+   Return the number of cycles consumed by the last call to exec_cycle().
+ */
+inline cycle_count_t Device::last_cycle_delta() const
+{
+    return m_cycle_delta;
+}
+
 inline Core& Device::core() const
 {
     return m_core;
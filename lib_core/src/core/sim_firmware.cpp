@@ -42,6 +42,7 @@ Firmware::Firmware()
 ,vcc(0.0)
 ,aref(0.0)
 ,console_register(0)
+,share_flash(false)
 ,m_datasize(0)
 ,m_bsssize(0)
 {}
@@ -214,6 +215,11 @@ void Firmware::add_block(Area area, const Block& block)
     }
     //Add the copy to the area map
     m_blocks[area].push_back(b);
+
+    if (area == Area_Flash) {
+        std::lock_guard<std::mutex> lock(m_flash_mutex);
+        m_flash_image.reset();
+    }
 }
 
 
@@ -259,6 +265,41 @@ size_t Firmware::memory_size(Area area) const
 }
 
 
+//64-bits FNV-1a hash
+#define FNV_OFFSET_BASIS        0xcbf29ce484222325ULL
+#define FNV_PRIME               0x00000100000001b3ULL
+
+static uint64_t fnv1a(uint64_t h, const void* data, size_t len)
+{
+    const unsigned char* p = (const unsigned char*) data;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+/**
+   Compute a hash of the binary data loaded for a given NVM area,
+   including the block addresses.
+   \param area NVM area to hash
+   \return the hash value, never zero
+ */
+uint64_t Firmware::memory_hash(Area area) const
+{
+    uint64_t h = FNV_OFFSET_BASIS;
+    for (const Block& block : blocks(area)) {
+        uint64_t base = block.base, size = block.size;
+        h = fnv1a(h, &base, sizeof(base));
+        h = fnv1a(h, &size, sizeof(size));
+        h = fnv1a(h, block.buf, block.size);
+    }
+
+    //Zero is reserved for a file tag that has never been set
+    return h ? h : 1;
+}
+
+
 /**
    Get the binary blocks loaded for a given NVM area.
    \param area NVM area to check
@@ -279,11 +320,36 @@ std::vector<Firmware::Block> Firmware::blocks(Area area) const
    \param area NVM area to retrieve
    \param memory NVM model where the data should be copied
    \return true if the binary data could be copied, false if it failed
+   \note If share_flash is set, the flash content is replaced entirely by the
+   mapping of the shared image, built on the first call.
+   This function is thread-safe.
  */
 bool Firmware::load_memory(Area area, NonVolatileMemory& memory) const
 {
     bool status = true;
 
+    //A memory mapped to a file keeps its mapping and is programmed normally
+    if (area == Area_Flash && share_flash && !memory.mapped()) {
+        std::shared_ptr<NonVolatileImage> image;
+        {
+            std::lock_guard<std::mutex> lock(m_flash_mutex);
+            if (!m_flash_image || m_flash_image->size() != memory.size()) {
+                NonVolatileMemory image_src(memory.size());
+                for (Block& fb : blocks(area))
+                    status &= image_src.program(fb, fb.base);
+                if (!status) return false;
+
+                m_flash_image = std::make_shared<NonVolatileImage>(image_src);
+            }
+            //Keep a reference so that the image outlives the mapping operation,
+            //even if another thread replaces it meanwhile
+            image = m_flash_image;
+        }
+
+        if (memory.map_image(*image))
+            return true;
+    }
+
     for (Block& fb : blocks(area))
         status &= memory.program(fb, fb.base);
 
@@ -305,6 +371,7 @@ Firmware& Firmware::operator=(const Firmware& other)
     vcc = other.vcc;
     aref = other.aref;
     console_register = other.console_register;
+    share_flash = other.share_flash;
     m_datasize = other.m_datasize;
     m_bsssize = other.m_bsssize;
 
@@ -313,5 +380,13 @@ Firmware& Firmware::operator=(const Firmware& other)
             add_block(it->first, b);
     }
 
+    std::shared_ptr<NonVolatileImage> image;
+    {
+        std::lock_guard<std::mutex> lock(other.m_flash_mutex);
+        image = other.m_flash_image;
+    }
+    std::lock_guard<std::mutex> lock(m_flash_mutex);
+    m_flash_image = image;
+
     return *this;
 }
@@ -29,6 +29,8 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <memory>
+#include <mutex>
 
 YASIMAVR_BEGIN_NAMESPACE
 
@@ -77,6 +79,9 @@ public:
     double aref;
     ///I/O register address used for console output
     reg_addr_t console_register;
+    ///If set, the flash is loaded by mapping a shared image, so that all the devices
+    ///loaded with this firmware (or its copies) share the same flash pages until modified.
+    bool share_flash;
 
     Firmware();
     Firmware(const Firmware& other);
@@ -91,6 +96,7 @@ public:
     std::vector<Area> memories() const;
 
     size_t memory_size(Area area) const;
+    uint64_t memory_hash(Area area) const;
 
     std::vector<Block> blocks(Area area) const;
 
@@ -106,6 +112,11 @@ private:
     std::map<Area, std::vector<Block>> m_blocks;
     mem_addr_t m_datasize;
     mem_addr_t m_bsssize;
+    //Flash image shared between devices, built on the first load.
+    //The mutex guards it as load_memory may be called concurrently from
+    //several threads, each building its own device.
+    mutable std::shared_ptr<NonVolatileImage> m_flash_image;
+    mutable std::mutex m_flash_mutex;
 
 };
 
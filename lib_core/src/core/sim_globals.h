@@ -48,6 +48,15 @@
 #endif
 
 
+//Checks the arguments of a printf-like function against its format string, at compile time
+#ifdef __GNUC__
+  #define YASIMAVR_PRINTF_FORMAT(fmt_index, args_index) \
+    __attribute__ ((format (printf, fmt_index, args_index)))
+#else
+  #define YASIMAVR_PRINTF_FORMAT(fmt_index, args_index)
+#endif
+
+
 #ifdef YASIMAVR_NAMESPACE
     #define YASIMAVR_BEGIN_NAMESPACE namespace YASIMAVR_NAMESPACE {
     #define YASIMAVR_END_NAMESPACE };
@@ -24,18 +24,33 @@
 #include "sim_interrupt.h"
 #include "sim_core.h"
 #include "sim_device.h"
+#include <algorithm>
 
 YASIMAVR_USING_NAMESPACE
 
 
 //========================================================================================
 
+//Index of the lowest bit set in a non-zero word
+static inline int lowest_bit(uint64_t w)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(w);
+#else
+    int n = 0;
+    while (!(w & 1)) { w >>= 1; ++n; }
+    return n;
+#endif
+}
+
+
 /**
    Construct the controller with the given vector table size
 */
 InterruptController::InterruptController(unsigned int size)
 :Peripheral(AVR_IOCTL_INTR)
 ,m_interrupts(size)
+,m_raised((size + 63) / 64, 0)
 ,m_irq_vector(AVR_INTERRUPT_NONE)
 {
     m_interrupts[0].used = true; //The reset vector is always available
@@ -44,10 +59,9 @@ InterruptController::InterruptController(unsigned int size)
 void InterruptController::reset()
 {
     //Reset the state of all vectors
-    for (unsigned int i = 0; i < m_interrupts.size(); ++i) {
-        m_interrupts[i].raised = false;
+    std::fill(m_raised.begin(), m_raised.end(), 0);
+    for (unsigned int i = 0; i < m_interrupts.size(); ++i)
         m_signal.raise(Signal_StateChange, State_Reset, i);
-    }
 
     m_irq_vector = AVR_INTERRUPT_NONE;
 }
@@ -110,10 +124,31 @@ void InterruptController::sleep(bool on, SleepMode mode)
 {
     if (!on) return;
 
-    for (unsigned int v = 0; v < m_interrupts.size(); ++v) {
-        if (m_interrupts[v].raised)
-            m_signal.raise(Signal_StateChange, State_RaisedFromSleep, v);
-    }
+    for (int_vect_t v = first_raised(); v != AVR_INTERRUPT_NONE; v = first_raised(v + 1))
+        m_signal.raise(Signal_StateChange, State_RaisedFromSleep, v);
+}
+
+/*
+ * The state of the controller is the raised flag of each vector, one byte per vector.
+ */
+bool InterruptController::save_state(std::vector<uint8_t>& state) const
+{
+    for (int_vect_t v = 0; v < intr_count(); ++v)
+        state.push_back(interrupt_raised(v) ? 1 : 0);
+    return true;
+}
+
+bool InterruptController::load_state(const uint8_t* state, size_t len)
+{
+    if (len != m_interrupts.size())
+        return false;
+
+    for (size_t i = 0; i < len; ++i)
+        set_interrupt_raised(i, m_interrupts[i].used && state[i]);
+
+    update_irq();
+
+    return true;
 }
 
 /**
@@ -131,7 +166,7 @@ void InterruptController::cpu_ack_irq()
 */
 void InterruptController::cpu_ack_irq(int_vect_t vector)
 {
-    m_interrupts[vector].raised = false;
+    set_interrupt_raised(vector, false);
 
     if (m_interrupts[vector].handler)
         m_interrupts[vector].handler->interrupt_ack_handler(vector);
@@ -161,14 +196,39 @@ void InterruptController::update_irq()
 ///Interrupt state setter
 void InterruptController::set_interrupt_raised(int_vect_t vector, bool raised)
 {
-    m_interrupts[vector].raised = raised;
+    uint64_t mask = 1ULL << (vector & 0x3F);
+    if (raised)
+        m_raised[vector >> 6] |= mask;
+    else
+        m_raised[vector >> 6] &= ~mask;
+}
+
+/**
+   Find the lowest raised vector, starting from a given index.
+   \param from index of the first vector to consider
+   \return the lowest raised vector greater or equal to 'from' or AVR_INTERRUPT_NONE
+ */
+int_vect_t InterruptController::first_raised(int_vect_t from) const
+{
+    if (from < 0) from = 0;
+    if (from >= intr_count()) return AVR_INTERRUPT_NONE;
+
+    size_t w = from >> 6;
+    uint64_t bits = m_raised[w] & (~0ULL << (from & 0x3F));
+    while (!bits) {
+        if (++w == m_raised.size())
+            return AVR_INTERRUPT_NONE;
+        bits = m_raised[w];
+    }
+
+    return (w << 6) + lowest_bit(bits);
 }
 
 void InterruptController::raise_interrupt(int_vect_t vector)
 {
     //If the interrupt is unused or already raised, no op
-    if (m_interrupts[vector].used && !m_interrupts[vector].raised) {
-        m_interrupts[vector].raised = true;
+    if (m_interrupts[vector].used && !interrupt_raised(vector)) {
+        set_interrupt_raised(vector, true);
         m_signal.raise(Signal_StateChange, State_Raised, vector);
         update_irq();
     }
@@ -176,8 +236,8 @@ void InterruptController::raise_interrupt(int_vect_t vector)
 
 void InterruptController::cancel_interrupt(int_vect_t vector)
 {
-    if (m_interrupts[vector].used && m_interrupts[vector].raised) {
-        m_interrupts[vector].raised = false;
+    if (m_interrupts[vector].used && interrupt_raised(vector)) {
+        set_interrupt_raised(vector, false);
         m_signal.raise(Signal_StateChange, State_Cancelled, vector);
         if (m_irq_vector == vector)
             update_irq();
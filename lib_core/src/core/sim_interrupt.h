@@ -105,6 +105,8 @@ public:
     virtual void reset() override;
     virtual bool ctlreq(ctlreq_id_t req, ctlreq_data_t* data) override;
     virtual void sleep(bool on, SleepMode mode) override;
+    virtual bool save_state(std::vector<uint8_t>& state) const override;
+    virtual bool load_state(const uint8_t* state, size_t len) override;
 
     //===== Interface API for the CPU =====
     int_vect_t cpu_get_irq() const;
@@ -117,6 +119,7 @@ protected:
     bool interrupt_raised(int_vect_t vector) const;
     int_vect_t intr_count() const;
     void set_interrupt_raised(int_vect_t vector, bool raised);
+    int_vect_t first_raised(int_vect_t from = 0) const;
 
     virtual void cpu_ack_irq(int_vect_t vector);
 
@@ -138,12 +141,14 @@ private:
     //===== Structure holding data on the vector table =====
     struct interrupt_t {
         bool used = false;
-        bool raised = false;
         InterruptHandler* handler = nullptr;
     };
 
     //Interrupt vector table
     std::vector<interrupt_t> m_interrupts;
+    //Bitset of the raised vectors, 64 vectors per word, so that the arbitration
+    //does not need to scan the whole table
+    std::vector<uint64_t> m_raised;
     //Variable holding the vector to be executed next
     int_vect_t m_irq_vector;
     //Signal raised with changes of interrupt state
@@ -177,7 +182,7 @@ inline int_vect_t InterruptController::intr_count() const
 ///Interrupt state getter
 inline bool InterruptController::interrupt_raised(int_vect_t vector) const
 {
-    return m_interrupts[vector].raised;
+    return (m_raised[vector >> 6] >> (vector & 0x3F)) & 1;
 }
 
 
@@ -36,28 +36,36 @@ void LogWriter::write(cycle_count_t cycle,
 {
     std::FILE* f = stdout;
 
-    const char* slvl;
+    //Decode the id in place, to avoid allocating a string for each message
+    char sid[5] = { 0 };
+    for (int i = 0; i < 4 && id > 0; ++i)
+        sid[i] = (id >> (8 * i)) & 0xFF;
+
+    fprintf(f, "[%08lld] %s %s : ", cycle, level_name(level), sid);
+    vfprintf(f, format, args);
+    fprintf(f, "\n");
+    fflush(f);
+}
+
+/**
+   Returns the 3-letters abbreviation of a level, as printed in the log messages.
+ */
+const char* LogWriter::level_name(int level)
+{
     switch (level) {
         case Logger::Level_Trace:
-            slvl = "TRA"; break;
+            return "TRA";
         case Logger::Level_Debug:
-            slvl = "DBG"; break;
+            return "DBG";
         case Logger::Level_Warning:
-            slvl = "WNG"; break;
+            return "WNG";
         case Logger::Level_Error:
-            slvl = "ERR"; break;
+            return "ERR";
         case Logger::Level_Output:
-            slvl= "OUT"; break;
+            return "OUT";
         default:
-            slvl = "---"; break;
+            return "---";
     }
-
-    std::string sid = id > 0 ? id_to_str(id) : "";
-
-    fprintf(f, "[%08lld] %s %s : ", cycle, slvl, sid.c_str());
-    vfprintf(f, format, args);
-    fprintf(f, "\n");
-    fflush(f);
 }
 
 static LogWriter s_default_writer;
@@ -104,42 +112,44 @@ Logger::Logger(ctl_id_t id, Logger* prt)
 
 void Logger::log(int lvl, const char* format, ...)
 {
+    if (!enabled(lvl)) return;
+
     std::va_list args;
     va_start(args, format);
-    filtered_write(lvl, format, args);
+    write(lvl, m_id, format, args);
     va_end(args);
 }
 
 void Logger::err(const char* format, ...)
 {
+    if (!enabled(Level_Error)) return;
+
     std::va_list args;
     va_start(args, format);
-    filtered_write(Level_Error, format, args);
+    write(Level_Error, m_id, format, args);
     va_end(args);
 }
 
 void Logger::wng(const char* format, ...)
 {
+    if (!enabled(Level_Warning)) return;
+
     std::va_list args;
     va_start(args, format);
-    filtered_write(Level_Warning, format, args);
+    write(Level_Warning, m_id, format, args);
     va_end(args);
 }
 
 void Logger::dbg(const char* format, ...)
 {
+    if (!enabled(Level_Debug)) return;
+
     std::va_list args;
     va_start(args, format);
-    filtered_write(Level_Debug, format, args);
+    write(Level_Debug, m_id, format, args);
     va_end(args);
 }
 
-void Logger::filtered_write(int lvl, const char* fmt, std::va_list args)
-{
-    if (lvl <= level())
-        write(lvl, m_id, fmt, args);
-}
-
 void Logger::write(int lvl, ctl_id_t id, const char* fmt, std::va_list args)
 {
     if (m_parent)
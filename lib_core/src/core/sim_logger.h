@@ -46,6 +46,7 @@ public:
                        std::va_list args);
 
     static LogWriter* default_writer();
+    static const char* level_name(int level);
 };
 
 
@@ -110,17 +111,18 @@ public:
     void set_parent(Logger* p);
     Logger* parent() const;
 
-    void log(int level, const char* format, ...);
+    bool enabled(int lvl) const;
 
-    void err(const char* format, ...);
-    void wng(const char* format, ...);
-    void dbg(const char* format, ...);
+    void log(int level, const char* format, ...) YASIMAVR_PRINTF_FORMAT(3, 4);
+
+    void err(const char* format, ...) YASIMAVR_PRINTF_FORMAT(2, 3);
+    void wng(const char* format, ...) YASIMAVR_PRINTF_FORMAT(2, 3);
+    void dbg(const char* format, ...) YASIMAVR_PRINTF_FORMAT(2, 3);
 
 protected:
 
     ctl_id_t id() const;
 
-    void filtered_write(int lvl, const char* fmt, std::va_list args);
     void write(int lvl, ctl_id_t id, const char* fmt, std::va_list args);
 
 private:
@@ -142,6 +144,15 @@ inline int Logger::level() const
     return m_level;
 }
 
+/**
+   Returns true if a message of the given level would pass the level filter
+   of this logger.
+ */
+inline bool Logger::enabled(int lvl) const
+{
+    return lvl <= m_level;
+}
+
 inline ctl_id_t Logger::id() const
 {
     return m_id;
@@ -161,6 +172,26 @@ inline Logger* Logger::parent() const
 Logger& global_logger() AVR_CORE_PUBLIC_API;
 
 
+//=======================================================================================
+/*
+ * Logging macros for the simulation paths. The level is checked before the arguments
+ * are evaluated so that a filtered message costs a single comparison, and the format
+ * string is checked against the arguments at compile time.
+ * 'logger' must be an expression of type Logger, e.g. LOGGER_DBG(*m_logger, "x=%d", x)
+ */
+#define LOGGER_LOG(logger, lvl, ...) \
+    do { if ((logger).enabled(lvl)) (logger).log((lvl), __VA_ARGS__); } while (0)
+
+#define LOGGER_ERR(logger, ...) \
+    LOGGER_LOG(logger, YASIMAVR_QUALIFIED_NAME(Logger)::Level_Error, __VA_ARGS__)
+
+#define LOGGER_WNG(logger, ...) \
+    LOGGER_LOG(logger, YASIMAVR_QUALIFIED_NAME(Logger)::Level_Warning, __VA_ARGS__)
+
+#define LOGGER_DBG(logger, ...) \
+    LOGGER_LOG(logger, YASIMAVR_QUALIFIED_NAME(Logger)::Level_Debug, __VA_ARGS__)
+
+
 YASIMAVR_END_NAMESPACE
 
 #endif //__YASIMAVR_LOGGER_H__
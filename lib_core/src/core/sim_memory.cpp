@@ -23,6 +23,19 @@
 
 #include "sim_memory.h"
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#if defined _WIN32
+#include <windows.h>
+#else
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 YASIMAVR_USING_NAMESPACE
 
@@ -34,6 +47,13 @@ YASIMAVR_USING_NAMESPACE
     if (((base) + (len)) > (size))          \
         (len) = (size) - (base);
 
+//Number of 64-bits words in the bitmap of programmed states
+#define TAG_WORDS(size)                     (((size) + 63) / 64)
+//Offset of the bitmap in a backing file, aligned on 8 bytes
+#define TAG_OFFSET(size)                    (((size) + 7) & ~((size_t) 7))
+//Size of a backing file, with the data, the bitmap and the file tag
+#define FILE_SIZE(size)                     (TAG_OFFSET(size) + (TAG_WORDS(size) + 1) * sizeof(uint64_t))
+
 
 /**
    Construct a non-volatile memory.
@@ -43,15 +63,57 @@ YASIMAVR_USING_NAMESPACE
  */
 NonVolatileMemory::NonVolatileMemory(size_t size, const std::string& name)
 :m_size(size)
+,m_memory(nullptr)
+,m_tag(nullptr)
 ,m_name(name)
+,m_mapping(nullptr)
+,m_mapping_size(0)
+,m_file_tag(nullptr)
+,m_persisted(false)
+,m_raw_mapping(false)
 {
-    if (size) {
+    allocate();
+}
+
+/**
+   Construct a non-volatile memory with its storage mapped to a file.
+   This is equivalent to constructing the NVM and calling map_file(), except that
+   no storage is allocated in memory if the mapping succeeds, which matters for large memories.
+   If the mapping fails, the storage is allocated in memory and mapped() returns false.
+   \param size size of the NVM in bytes
+   \param name name of the NVM
+   \param filename path of the backing file, if empty the storage is allocated in memory
+   \param raw if true, the file contains only the data
+   \sa map_file
+ */
+NonVolatileMemory::NonVolatileMemory(size_t size, const std::string& name,
+                                     const std::string& filename, bool raw)
+:m_size(size)
+,m_memory(nullptr)
+,m_tag(nullptr)
+,m_name(name)
+,m_mapping(nullptr)
+,m_mapping_size(0)
+,m_file_tag(nullptr)
+,m_persisted(false)
+,m_raw_mapping(false)
+{
+    if (!size || filename.empty() || !map_storage(filename, raw))
+        allocate();
+}
+
+/*
+ * Allocate the storage in memory, set to unprogrammed and filled with 0xFF.
+ */
+void NonVolatileMemory::allocate()
+{
+    if (m_size) {
         m_memory = (unsigned char*) malloc(m_size);
         memset(m_memory, 0xFF, m_size);
-        m_tag = (unsigned char*) malloc(m_size);
-        memset(m_tag, 0, m_size);
+        m_tag = (uint64_t*) calloc(TAG_WORDS(m_size), sizeof(uint64_t));
     } else {
-        m_memory = m_tag = nullptr;
+        m_memory = nullptr;
+        m_tag = nullptr;
     }
 }
 
@@ -60,20 +122,64 @@ NonVolatileMemory::NonVolatileMemory(size_t size, const std::string& name)
  */
 NonVolatileMemory::~NonVolatileMemory()
 {
-    if (m_size) {
+    release();
+}
+
+/*
+ * Free the storage, or unmap it if it's mapped to a file.
+ */
+void NonVolatileMemory::release()
+{
+    if (m_mapping) {
+#if defined _WIN32
+        UnmapViewOfFile(m_mapping);
+#else
+        munmap(m_mapping, m_mapping_size);
+#endif
+        m_mapping = nullptr;
+        m_mapping_size = 0;
+        m_file_tag = nullptr;
+        m_persisted = false;
+
+        if (m_raw_mapping)
+            free(m_tag);
+        m_raw_mapping = false;
+    }
+    else if (m_size) {
         free(m_memory);
         free(m_tag);
     }
+
+    m_memory = nullptr;
+    m_tag = nullptr;
 }
 
 
 NonVolatileMemory::NonVolatileMemory(const NonVolatileMemory& other)
-:NonVolatileMemory(0, nullptr)
+:NonVolatileMemory(0)
 {
     *this = other;
 }
 
 
+/*
+ * Pack a run of up to 64 selection bytes into a bit mask, bit i being set if
+ * the byte i is non-zero. It is branchless so that the loop can be vectorised.
+ */
+static inline uint64_t pack_bits(const unsigned char* buf, size_t n)
+{
+    uint64_t bits = 0;
+    for (size_t i = 0; i < n; ++i)
+        bits |= (uint64_t) (buf[i] != 0) << i;
+    return bits;
+}
+
+//Mask of the n lowest bits, with 0 < n <= 64
+static inline uint64_t low_mask(size_t n)
+{
+    return (n < 64) ? ((1ULL << n) - 1) : ~0ULL;
+}
+
 /**
    Return the unprogrammed/programmed state of the NVM into a buffer.
    Each byte in the buffer is set a value of 0 for "unprogrammed" and 1 for "programmed".
@@ -88,11 +194,90 @@ size_t NonVolatileMemory::programmed(unsigned char* buf, size_t base, size_t len
 
     ADJUST_BASE_LEN(base, len, m_size);
 
-    memcpy(buf, m_tag + base, len);
+    //Process the bitmap one word at a time, uniform words being expanded at once
+    size_t i = 0;
+    while (i < len) {
+        size_t pos = base + i;
+        size_t n = std::min<size_t>(64 - (pos & 63), len - i);
+        uint64_t mask = low_mask(n);
+        uint64_t bits = (m_tag[pos >> 6] >> (pos & 63)) & mask;
+        if (!bits || bits == mask) {
+            memset(buf + i, bits ? 1 : 0, n);
+        } else {
+            for (size_t j = 0; j < n; ++j)
+                buf[i + j] = (bits >> j) & 1;
+        }
+        i += n;
+    }
 
     return len;
 }
 
+/**
+   Compare a block of the NVM with a buffer.
+   \param buf data to compare with the NVM content
+   \param buftag programmed states to compare with the NVM states, as returned by
+   programmed(). If set to nullptr, only the data are compared.
+   \param base first address to be compared
+   \param len length of the area to be compared, in bytes
+   \return true if the data and, if provided, the programmed states are identical
+ */
+bool NonVolatileMemory::compare(const unsigned char* buf, const unsigned char* buftag,
+                                size_t base, size_t len) const
+{
+    if (!len) return true;
+    if (base >= m_size || len > m_size - base) return false;
+
+    if (memcmp(m_memory + base, buf, len))
+        return false;
+
+    if (!buftag) return true;
+
+    size_t i = 0;
+    while (i < len) {
+        size_t pos = base + i;
+        size_t n = std::min<size_t>(64 - (pos & 63), len - i);
+        uint64_t bits = (m_tag[pos >> 6] >> (pos & 63)) & low_mask(n);
+        if (bits != pack_bits(buftag + i, n))
+            return false;
+        i += n;
+    }
+
+    return true;
+}
+
+/*
+ * Set or clear the programmed state of a block of bytes.
+ * The words entirely covered by the block are filled at once.
+ */
+void NonVolatileMemory::set_tags(size_t base, size_t len, bool value)
+{
+    size_t end = base + len;
+    size_t first_word = base >> 6;
+    size_t last_word = (end - 1) >> 6;
+    uint64_t first_mask = ~0ULL << (base & 63);
+    uint64_t last_mask = ~0ULL >> (63 - ((end - 1) & 63));
+
+    if (first_word == last_word) {
+        uint64_t mask = first_mask & last_mask;
+        if (value)
+            m_tag[first_word] |= mask;
+        else
+            m_tag[first_word] &= ~mask;
+        return;
+    }
+
+    if (value) {
+        m_tag[first_word] |= first_mask;
+        memset(m_tag + first_word + 1, 0xFF, (last_word - first_word - 1) * sizeof(uint64_t));
+        m_tag[last_word] |= last_mask;
+    } else {
+        m_tag[first_word] &= ~first_mask;
+        memset(m_tag + first_word + 1, 0x00, (last_word - first_word - 1) * sizeof(uint64_t));
+        m_tag[last_word] &= ~last_mask;
+    }
+}
+
 
 /**
    Erase the entire NVM.
@@ -115,7 +300,7 @@ void NonVolatileMemory::erase(size_t base, size_t len)
     ADJUST_BASE_LEN(base, len, m_size);
 
     memset(m_memory + base, 0xFF, len);
-    memset(m_tag + base, 0, len);
+    set_tags(base, len, false);
 }
 
 /**
@@ -132,11 +317,17 @@ void NonVolatileMemory::erase(const unsigned char* buf, size_t base, size_t len)
 
     ADJUST_BASE_LEN(base, len, m_size);
 
-    for (size_t i = 0; i < len; ++i) {
-        if (buf[i]) {
-            m_memory[base + i] = 0xFF;
-            m_tag[base + i] = 0;
-        }
+    unsigned char* p = m_memory + base;
+    for (size_t i = 0; i < len; ++i)
+        p[i] |= buf[i] ? 0xFF : 0x00;
+
+    //Clear the programmed states one word at a time
+    size_t i = 0;
+    while (i < len) {
+        size_t pos = base + i;
+        size_t n = std::min<size_t>(64 - (pos & 63), len - i);
+        m_tag[pos >> 6] &= ~(pack_bits(buf + i, n) << (pos & 63));
+        i += n;
     }
 }
 
@@ -159,7 +350,7 @@ bool NonVolatileMemory::program(const mem_block_t& mem_block, size_t base)
 
     if (size) {
         memcpy(m_memory + base, mem_block.buf, size);
-        memset(m_tag + base, 1, size);
+        set_tags(base, size, true);
     }
 
     return (bool) size;
@@ -255,7 +446,7 @@ void NonVolatileMemory::spm_write(unsigned char v, size_t pos)
 {
     if (pos < m_size) {
         m_memory[pos] &= v;
-        m_tag[pos] = 1;
+        m_tag[pos >> 6] |= 1ULL << (pos & 63);
     }
 }
 
@@ -277,33 +468,360 @@ void NonVolatileMemory::spm_write(const unsigned char* buf,
 
     ADJUST_BASE_LEN(base, len, m_size);
 
-    for (size_t i = 0; i < len; ++i) {
-        if (!bufset || bufset[i]) {
-            m_memory[base + i] &= buf[i];
-            m_tag[base + i] = 1;
-        }
+    if (!bufset) {
+        unsigned char* p = m_memory + base;
+        for (size_t i = 0; i < len; ++i)
+            p[i] &= buf[i];
+        set_tags(base, len, true);
+        return;
+    }
+
+    unsigned char* p = m_memory + base;
+    for (size_t i = 0; i < len; ++i)
+        p[i] &= bufset[i] ? buf[i] : 0xFF;
+
+    //Set the programmed states one word at a time
+    size_t i = 0;
+    while (i < len) {
+        size_t pos = base + i;
+        size_t n = std::min<size_t>(64 - (pos & 63), len - i);
+        m_tag[pos >> 6] |= pack_bits(bufset + i, n) << (pos & 63);
+        i += n;
     }
 }
 
 
-NonVolatileMemory& NonVolatileMemory::operator=(const NonVolatileMemory& other)
+/**
+   Map the NVM storage to a file.
+   If the file does not exist or is empty, it is created with the current content of the NVM.
+   Otherwise the NVM content is loaded from the file, which must have been created
+   by a NVM of the same size, and persisted() returns true.
+   The file ends with a 64-bits tag, initialised to zero, which can be used by the owner
+   of the NVM to identify the origin of the content. See file_tag() and set_file_tag().
+   \param filename path of the backing file
+   \param raw if true, the file contains only the data and must have the size of the NVM.
+   All the bytes are set as programmed when loaded from an existing file.
+   \return true if the mapping succeeded
+ */
+bool NonVolatileMemory::map_file(const std::string& filename, bool raw)
 {
-    if (m_size) {
+    if (!m_size) return false;
+
+    unmap_file();
+
+    return map_storage(filename, raw);
+}
+
+/*
+ * Map the storage to a file. If the storage is not allocated, a new file is
+ * initialised as an unprogrammed memory, otherwise with the current content.
+ * The previous storage is freed if the mapping succeeds.
+ */
+bool NonVolatileMemory::map_storage(const std::string& filename, bool raw)
+{
+    size_t tag_size = TAG_WORDS(m_size) * sizeof(uint64_t);
+    size_t file_size = raw ? m_size : FILE_SIZE(m_size);
+    bool existing;
+    void* mapping;
+
+#if defined _WIN32
+
+    HANDLE fh = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fs;
+    if (!GetFileSizeEx(fh, &fs) || (fs.QuadPart && (size_t) fs.QuadPart != file_size)) {
+        CloseHandle(fh);
+        return false;
+    }
+    existing = fs.QuadPart > 0;
+
+    HANDLE mh = CreateFileMappingA(fh, NULL, PAGE_READWRITE,
+                                   (DWORD) ((uint64_t) file_size >> 32), (DWORD) file_size, NULL);
+    CloseHandle(fh);
+    if (!mh) return false;
+
+    mapping = MapViewOfFile(mh, FILE_MAP_ALL_ACCESS, 0, 0, file_size);
+    CloseHandle(mh);
+    if (!mapping) return false;
+
+#else
+
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) || (st.st_size && (size_t) st.st_size != file_size)) {
+        close(fd);
+        return false;
+    }
+    existing = st.st_size > 0;
+
+    if (!existing && ftruncate(fd, file_size)) {
+        close(fd);
+        return false;
+    }
+
+    mapping = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+#endif
+
+    unsigned char* file_data = (unsigned char*) mapping;
+    if (raw) {
+        if (!m_tag)
+            m_tag = (uint64_t*) calloc(TAG_WORDS(m_size), sizeof(uint64_t));
+
+        if (existing)
+            set_tags(0, m_size, true);
+        else if (m_memory)
+            memcpy(file_data, m_memory, m_size);
+        else
+            memset(file_data, 0xFF, m_size);
+
+        free(m_memory);
+        m_memory = file_data;
+    } else {
+        if (!existing && m_memory) {
+            memcpy(file_data, m_memory, m_size);
+            memcpy(file_data + TAG_OFFSET(m_size), m_tag, tag_size);
+        }
+        else if (!existing) {
+            //The tags and the file tag of a new file are already zero
+            memset(file_data, 0xFF, m_size);
+        }
+
         free(m_memory);
         free(m_tag);
+
+        m_memory = file_data;
+        m_tag = (uint64_t*) (file_data + TAG_OFFSET(m_size));
+        m_file_tag = m_tag + TAG_WORDS(m_size);
     }
 
+    m_mapping = mapping;
+    m_mapping_size = file_size;
+    m_persisted = existing;
+    m_raw_mapping = raw;
+
+    return true;
+}
+
+/**
+   Map the NVM storage to a shared image. The current content is replaced by
+   the content of the image. The pages of the image are copied when the NVM
+   is modified, the image itself is never affected.
+   \param image image to map, which must have the same size as the NVM
+   \return true if the mapping succeeded
+ */
+bool NonVolatileMemory::map_image(const NonVolatileImage& image)
+{
+    if (!m_size || !image.valid() || image.size() != m_size) return false;
+
+    size_t file_size = TAG_OFFSET(m_size) + TAG_WORDS(m_size) * sizeof(uint64_t);
+
+#if defined _WIN32
+    void* mapping = MapViewOfFile((HANDLE) image.m_handle, FILE_MAP_COPY, 0, 0, file_size);
+    if (!mapping) return false;
+#else
+    void* mapping = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, (int) image.m_handle, 0);
+    if (mapping == MAP_FAILED) return false;
+#endif
+
+    release();
+
+    m_memory = (unsigned char*) mapping;
+    m_tag = (uint64_t*) (m_memory + TAG_OFFSET(m_size));
+    m_mapping = mapping;
+    m_mapping_size = file_size;
+
+    return true;
+}
+
+/**
+   Unmap the NVM storage from its backing file or image. The content is kept in memory and
+   the file is left with the content at the time of the call.
+ */
+void NonVolatileMemory::unmap_file()
+{
+    if (!m_mapping) return;
+
+    size_t tag_size = TAG_WORDS(m_size) * sizeof(uint64_t);
+    unsigned char* mem = (unsigned char*) malloc(m_size);
+    memcpy(mem, m_memory, m_size);
+    uint64_t* tag = (uint64_t*) malloc(tag_size);
+    memcpy(tag, m_tag, tag_size);
+
+    release();
+
+    m_memory = mem;
+    m_tag = tag;
+}
+
+/**
+   Return the tag stored in the backing file, or zero if the NVM is not
+   mapped to a file or if the mapping is raw.
+ */
+uint64_t NonVolatileMemory::file_tag() const
+{
+    return m_file_tag ? *m_file_tag : 0;
+}
+
+/**
+   Set the tag stored in the backing file. It has no effect if the NVM is not
+   mapped to a file or if the mapping is raw.
+   \return true if the tag could be stored
+ */
+bool NonVolatileMemory::set_file_tag(uint64_t tag)
+{
+    if (!m_file_tag) return false;
+    *m_file_tag = tag;
+    return true;
+}
+
+/**
+   Write the modified content of the NVM to its backing file. The file is otherwise
+   updated lazily by the operating system.
+   \return true if the operation succeeded or if the NVM is not mapped.
+ */
+bool NonVolatileMemory::sync()
+{
+    if (!m_mapping) return true;
+#if defined _WIN32
+    return FlushViewOfFile(m_mapping, m_mapping_size) != 0;
+#else
+    return !msync(m_mapping, m_mapping_size, MS_SYNC);
+#endif
+}
+
+
+/**
+   Copy the content of another NVM. The storage of the copy is always
+   allocated in memory, even if the other NVM is mapped to a file.
+ */
+NonVolatileMemory& NonVolatileMemory::operator=(const NonVolatileMemory& other)
+{
+    if (this == &other) return *this;
+
+    release();
+
     m_size = other.m_size;
     m_name = other.m_name;
 
     if (m_size) {
         m_memory = (unsigned char*) malloc(m_size);
         memcpy(m_memory, other.m_memory, m_size);
-        m_tag = (unsigned char*) malloc(m_size);
-        memcpy(m_tag, other.m_tag, m_size);
+        m_tag = (uint64_t*) malloc(TAG_WORDS(m_size) * sizeof(uint64_t));
+        memcpy(m_tag, other.m_tag, TAG_WORDS(m_size) * sizeof(uint64_t));
     } else {
-        m_memory = m_tag = nullptr;
+        m_memory = nullptr;
+        m_tag = nullptr;
     }
 
     return *this;
 }
+
+
+//=======================================================================================
+
+#if !defined _WIN32
+
+/*
+ * Create an anonymous shared memory object and return its file descriptor, or -1 on failure.
+ * The object has no name in the file system and is freed when the last descriptor
+ * or mapping is closed.
+ */
+static int create_shared_memory()
+{
+#if defined __linux__ && defined MFD_CLOEXEC
+    int fd = memfd_create("yasimavr_nvm_image", MFD_CLOEXEC);
+    if (fd >= 0) return fd;
+#endif
+
+    //Fallback on a POSIX shared memory object, unlinked right after its creation
+    static unsigned int counter = 0;
+    for (int attempt = 0; attempt < 16; ++attempt) {
+        char name[64];
+        snprintf(name, sizeof(name), "/yasimavr_nvm_%ld_%u", (long) getpid(), __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED));
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+        if (fd >= 0) {
+            shm_unlink(name);
+            return fd;
+        }
+        if (errno != EEXIST) break;
+    }
+
+    return -1;
+}
+
+#endif
+
+
+/**
+   Create a shared image with the content of a NVM.
+   \param source NVM to copy the content (data and programmed states) from
+ */
+NonVolatileImage::NonVolatileImage(const NonVolatileMemory& source)
+:m_handle(-1)
+,m_size(source.m_size)
+{
+    if (!m_size) return;
+
+    size_t tag_offset = TAG_OFFSET(m_size);
+    size_t file_size = tag_offset + TAG_WORDS(m_size) * sizeof(uint64_t);
+
+#if defined _WIN32
+
+    HANDLE mh = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                   (DWORD) ((uint64_t) file_size >> 32), (DWORD) file_size, NULL);
+    if (!mh) return;
+
+    unsigned char* p = (unsigned char*) MapViewOfFile(mh, FILE_MAP_WRITE, 0, 0, file_size);
+    if (!p) {
+        CloseHandle(mh);
+        return;
+    }
+
+    memcpy(p, source.m_memory, m_size);
+    memcpy(p + tag_offset, source.m_tag, file_size - tag_offset);
+    UnmapViewOfFile(p);
+
+    m_handle = (intptr_t) mh;
+
+#else
+
+    int fd = create_shared_memory();
+    if (fd < 0) return;
+
+    unsigned char* p = nullptr;
+    if (!ftruncate(fd, file_size)) {
+        void* m = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m != MAP_FAILED)
+            p = (unsigned char*) m;
+    }
+    if (!p) {
+        close(fd);
+        return;
+    }
+
+    memcpy(p, source.m_memory, m_size);
+    memcpy(p + tag_offset, source.m_tag, file_size - tag_offset);
+    munmap(p, file_size);
+
+    m_handle = fd;
+
+#endif
+}
+
+
+NonVolatileImage::~NonVolatileImage()
+{
+    if (m_handle == -1) return;
+#if defined _WIN32
+    CloseHandle((HANDLE) m_handle);
+#else
+    close((int) m_handle);
+#endif
+}
@@ -40,6 +40,9 @@ struct mem_block_t {
 };
 
 
+class NonVolatileImage;
+
+
 /**
    \brief Non-volatile memory model
 
@@ -47,12 +50,24 @@ struct mem_block_t {
    It has a memory block which simulates the NVM actual storage.
    Each byte has a state unprogrammed/programmed, i.e. it
    is erased or loaded with a meaningful value.
+   The programmed states are stored as a bitmap, one bit per byte.
+
+   The storage can be mapped to a file with map_file(), so that the content persists
+   across simulation runs. The file contains the data followed by the bitmap
+   of programmed states and a 64-bits tag, and is updated directly through the mapping.
+   In raw mode, the file contains only the data, like a binary image, and the
+   programmed states are kept in memory.
+
+   The storage can also be mapped to a NonVolatileImage with map_image(), in which case
+   the content is shared with the other memories mapped to the same image, and
+   each memory page is only copied when it is modified.
  */
 class AVR_CORE_PUBLIC_API NonVolatileMemory {
 
 public:
 
     explicit NonVolatileMemory(size_t size, const std::string& name = "");
+    NonVolatileMemory(size_t size, const std::string& name, const std::string& filename, bool raw = false);
     NonVolatileMemory(const NonVolatileMemory& other);
     ~NonVolatileMemory();
 
@@ -62,6 +77,8 @@ public:
     bool programmed(size_t pos) const;
     size_t programmed(unsigned char* buf, size_t base, size_t len) const;
 
+    bool compare(const unsigned char* buf, const unsigned char* buftag, size_t base, size_t len) const;
+
     unsigned char operator[](size_t pos) const;
 
     mem_block_t block() const;
@@ -81,17 +98,91 @@ public:
     void spm_write(unsigned char v, size_t pos);
     void spm_write(const unsigned char* buf, const unsigned char* bufset, size_t base, size_t len);
 
+    bool map_file(const std::string& filename, bool raw = false);
+    bool map_image(const NonVolatileImage& image);
+    void unmap_file();
+    bool sync();
+    bool mapped() const;
+    bool persisted() const;
+    uint64_t file_tag() const;
+    bool set_file_tag(uint64_t tag);
+
     NonVolatileMemory& operator=(const NonVolatileMemory& other);
 
 private:
 
+    friend class NonVolatileImage;
+
     size_t m_size;
     unsigned char* m_memory;
-    unsigned char* m_tag;
+    uint64_t* m_tag;
     std::string m_name;
+    //Mapping of the backing file, null if the storage is allocated in memory
+    void* m_mapping;
+    size_t m_mapping_size;
+    //Tag at the end of the backing file, null if not mapped to a file or if the mapping is raw
+    uint64_t* m_file_tag;
+    bool m_persisted;
+    //True if the mapping contains only the data, the bitmap being allocated in memory
+    bool m_raw_mapping;
+
+    void allocate();
+    bool map_storage(const std::string& filename, bool raw);
+    void set_tags(size_t base, size_t len, bool value);
+    void release();
 
 };
 
+//=======================================================================================
+/**
+   \brief Shared image of a non-volatile memory
+
+   Immutable copy of the content of a NVM, held in an anonymous shared memory object,
+   that can be mapped into several NonVolatileMemory objects with a copy-on-write
+   at page granularity.
+   This is typically used to load the same flash image into many device instances.
+   The mappings remain valid after the image is destroyed.
+ */
+class AVR_CORE_PUBLIC_API NonVolatileImage {
+
+public:
+
+    explicit NonVolatileImage(const NonVolatileMemory& source);
+    ~NonVolatileImage();
+
+    bool valid() const;
+    size_t size() const;
+
+    NonVolatileImage(const NonVolatileImage&) = delete;
+    NonVolatileImage& operator=(const NonVolatileImage&) = delete;
+
+private:
+
+    friend class NonVolatileMemory;
+
+    //File descriptor or handle of the shared memory object
+    intptr_t m_handle;
+    size_t m_size;
+
+};
+
+/**
+   Return true if the image could be created.
+ */
+inline bool NonVolatileImage::valid() const
+{
+    return m_handle != -1;
+}
+
+/**
+   Return the size of the image in bytes.
+ */
+inline size_t NonVolatileImage::size() const
+{
+    return m_size;
+}
+
+
 /**
    Return the size of the NVM.
  */
@@ -108,6 +199,23 @@ inline const std::string& NonVolatileMemory::name() const
     return m_name;
 }
 
+/**
+   Return true if the NVM storage is mapped to a file or an image.
+ */
+inline bool NonVolatileMemory::mapped() const
+{
+    return !!m_mapping;
+}
+
+/**
+   Return true if the NVM storage is mapped to a file that already existed,
+   i.e. the content of the NVM has been restored from a previous run.
+ */
+inline bool NonVolatileMemory::persisted() const
+{
+    return m_persisted;
+}
+
 /**
    Return the unprogrammed/programmed state of one NVM byte.
    \param pos address of the byte
@@ -115,7 +223,7 @@ inline const std::string& NonVolatileMemory::name() const
  */
 inline bool NonVolatileMemory::programmed(size_t pos) const
 {
-    return m_tag[pos];
+    return (m_tag[pos >> 6] >> (pos & 63)) & 1;
 }
 
 /**
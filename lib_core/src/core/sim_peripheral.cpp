@@ -110,6 +110,48 @@ void Peripheral::ioreg_write_handler(reg_addr_t addr, const ioreg_write_t& value
 void Peripheral::sleep(bool on, SleepMode mode)
 {}
 
+/**
+   Virtual method called when a snapshot of the device is captured, to save
+   the internal state of the peripheral, i.e. anything that is not stored
+   in the I/O registers. The scheduling of the cycle timers declared with
+   add_state_timer() is saved by the snapshot itself.
+   The default implementation has no internal state to save.
+   \param state buffer to append the state data to
+   \return false if the current state cannot be restored by load_state(),
+   for instance during a transfer, in which case the capture is refused
+   \sa DeviceSnapshot
+*/
+bool Peripheral::save_state(std::vector<uint8_t>& state) const
+{
+    return true;
+}
+
+/**
+   Virtual method called when a snapshot is restored, with the data saved
+   by save_state(). It is called after the I/O registers and the cycle counter
+   have been restored, with the register values set directly, and must
+   bring the peripheral in line with them. The timers declared with add_state_timer()
+   have already been rescheduled as they were at the capture.
+   \param state buffer containing the state data
+   \param len length of the state data
+   \return true if the state was restored successfully
+*/
+bool Peripheral::load_state(const uint8_t* state, size_t len)
+{
+    return !len;
+}
+
+/**
+   Declare a cycle timer owned by the peripheral, so that its scheduling is saved
+   and restored by the device snapshots together with the peripheral state.
+   It is meant to be called in init(), always in the same order.
+   \sa DeviceSnapshot
+ */
+void Peripheral::add_state_timer(CycleTimer& timer)
+{
+    m_state_timers.push_back(&timer);
+}
+
 void Peripheral::add_ioreg(const regbit_t& rb, bool readonly)
 {
     m_device->add_ioreg_handler(rb, *this, readonly);
@@ -195,6 +237,25 @@ Signal* Peripheral::get_signal(ctl_id_t ctl_id) const
 }
 
 
+//=======================================================================================
+
+CtlRequest::CtlRequest()
+:m_device(nullptr)
+,m_peripheral(nullptr)
+,m_id(0)
+,m_req(0)
+{}
+
+/*
+ * Slow path for the requests to the core or to a peripheral which could not be
+ * resolved. The device processes it (and logs the warning for a missing peripheral).
+ */
+bool CtlRequest::device_ctlreq(ctlreq_data_t* reqdata) const
+{
+    return m_device ? m_device->ctlreq(m_id, m_req, reqdata) : false;
+}
+
+
 //=======================================================================================
 
 DummyController::DummyController(ctl_id_t id, const std::vector<dummy_register_t>& regs)
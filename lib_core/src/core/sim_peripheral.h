@@ -279,6 +279,11 @@ public:
 
     virtual void sleep(bool on, SleepMode mode);
 
+    virtual bool save_state(std::vector<uint8_t>& state) const;
+    virtual bool load_state(const uint8_t* state, size_t len);
+
+    const std::vector<CycleTimer*>& state_timers() const;
+
     Peripheral(const Peripheral&) = delete;
     Peripheral& operator=(const Peripheral&) = delete;
 
@@ -292,6 +297,8 @@ protected:
     void add_ioreg(const regbit_compound_t& rbc, bool readonly = false);
     void add_ioreg(reg_addr_t addr, uint8_t mask = 0xFF, bool readonly = false);
 
+    void add_state_timer(CycleTimer& timer);
+
     //Primary methods to access a I/O register. Note that it's not limited to those
     //for which the peripheral has registered itself to.
     uint8_t read_ioreg(reg_addr_t reg) const;
@@ -333,6 +340,7 @@ private:
     ctl_id_t m_id;
     Device* m_device;
     Logger m_logger;
+    std::vector<CycleTimer*> m_state_timers;
 
 };
 
@@ -353,6 +361,12 @@ inline Logger& Peripheral::logger()
     return m_logger;
 }
 
+/// Cycle timers whose scheduling is saved by the device snapshots
+inline const std::vector<CycleTimer*>& Peripheral::state_timers() const
+{
+    return m_state_timers;
+}
+
 inline uint8_t Peripheral::read_ioreg(const regbit_t& rb) const
 {
     return rb.extract(read_ioreg(rb.addr));
@@ -439,6 +453,62 @@ inline void Peripheral::write_ioreg(reg_addr_t reg, uint8_t bit, uint8_t value)
 }
 
 
+//=======================================================================================
+/**
+   \ingroup core_peripheral
+   \brief Handle on a peripheral request
+
+   It is obtained with Device::resolve_ctlreq() and calling it is equivalent to
+   calling Device::ctlreq() with the same peripheral and request identifiers, without
+   the lookup of the peripheral. It is intended for the requests sent repeatedly
+   during the simulation.
+   A handle remains valid as long as no peripheral is attached to or removed
+   from the device.
+ */
+class AVR_CORE_PUBLIC_API CtlRequest {
+
+    friend class Device;
+
+public:
+
+    CtlRequest();
+
+    bool valid() const;
+
+    bool operator()(ctlreq_data_t* reqdata = nullptr) const;
+
+private:
+
+    Device* m_device;
+    Peripheral* m_peripheral;
+    ctl_id_t m_id;
+    ctlreq_id_t m_req;
+
+    bool device_ctlreq(ctlreq_data_t* reqdata) const;
+
+};
+
+/// Returns true if the handle has been resolved by a device
+inline bool CtlRequest::valid() const
+{
+    return !!m_device;
+}
+
+/**
+   Send the request.
+   \param reqdata data structure of the request
+   \return true if the request could be processed, false otherwise or if the
+   handle is not resolved.
+ */
+inline bool CtlRequest::operator()(ctlreq_data_t* reqdata) const
+{
+    if (m_peripheral)
+        return m_peripheral->ctlreq(m_req, reqdata);
+    else
+        return device_ctlreq(reqdata);
+}
+
+
 //=======================================================================================
 /**
    \brief Generic dummy peripheral.
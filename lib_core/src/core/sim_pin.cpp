@@ -22,6 +22,7 @@
 //=======================================================================================
 
 #include "sim_pin.h"
+#include "../ioctrl_common/sim_port.h"
 
 YASIMAVR_USING_NAMESPACE
 
@@ -62,6 +63,8 @@ const Pin::state_t ERROR_STATE = { Pin::State_Shorted, 0.5 };
  */
 Pin::Pin(pin_id_t id)
 :m_id(id)
+,m_port(nullptr)
+,m_port_num(0)
 ,m_ext_state(DEFAULT_STATE)
 ,m_gpio_state(DEFAULT_STATE)
 ,m_resolved_state(DEFAULT_STATE)
@@ -86,6 +89,7 @@ void Pin::set_external_state(State state, double voltage)
     voltage = normalise_level(state, voltage);
     m_ext_state = { state, voltage };
     update_resolved_state();
+    m_signal.raise(Signal_ExternalStateChange, (int) state);
 }
 
 
@@ -178,15 +182,22 @@ void Pin::update_resolved_state()
 
     m_resolved_state = resolved_state(m_gpio_state, m_ext_state);
 
-    if (m_resolved_state.state != old_state.state)
+    if (m_resolved_state.state != old_state.state) {
+        //The port controller is notified first so that its registers are
+        //up to date when the pin hooks are called
+        if (m_port)
+            m_port->pin_state_changed(m_port_num, m_resolved_state.state);
         m_signal.raise(Signal_StateChange, (int) m_resolved_state.state);
+    }
 
     if (m_resolved_state.level != old_state.level)
         m_signal.raise(Signal_VoltageChange, m_resolved_state.level);
 
     bool dig_state = digital_state();
-    if (dig_state != old_dig_state)
+    if (dig_state != old_dig_state) {
+        m_digital_signal.raise(dig_state);
         m_signal.raise(Signal_DigitalChange, (unsigned char) dig_state);
+    }
 }
 
 
@@ -44,6 +44,10 @@ typedef sim_id_t pin_id_t;
    which are resolved into a single electrical state. In case of conflict, the SHORTED state is
    set.
    Analog voltage levels are relative to VCC, hence limited to the range [0.0, 1.0].
+
+   The digital state changes are also raised through digital_signal(), a typed signal
+   for the internal consumers such as the external interrupt controllers. It is raised
+   just before the corresponding Signal_DigitalChange.
  */
 class AVR_CORE_PUBLIC_API Pin : public SignalHook {
 
@@ -93,6 +97,13 @@ public:
            data is set to the analog value (double, in range [0;1])
          */
         Signal_VoltageChange,
+        /**
+           Signal raised when the external state is set by set_external_state(),
+           whether the resolved state changes or not.
+           data is set to the new external state (one of State enum values),
+           the voltage value can be obtained with external_state().
+         */
+        Signal_ExternalStateChange,
     };
 
 
@@ -112,12 +123,14 @@ public:
     pin_id_t id() const;
 
     State state() const;
+    const state_t& external_state() const;
 
     bool digital_state() const;
 
     double voltage() const;
 
     DataSignal& signal();
+    TypedSignal<bool>& digital_signal();
 
     virtual void raised(const signal_data_t& sigdata, int hooktag) override;
 
@@ -126,10 +139,14 @@ private:
     friend class Port;
 
     pin_id_t m_id;
+    //Port controller owning the pin, notified directly of resolved state changes
+    Port* m_port;
+    uint8_t m_port_num;
     state_t m_ext_state;
     state_t m_gpio_state;
     state_t m_resolved_state;
     DataSignal m_signal;
+    TypedSignal<bool> m_digital_signal;
 
     static state_t resolved_state(const state_t& gpio, const state_t& ext);
     static double normalise_level(State state, double level);
@@ -154,6 +171,14 @@ inline Pin::State Pin::state() const
     return m_resolved_state.state;
 };
 
+/**
+   \return the electrical state set by the external circuit
+ */
+inline const Pin::state_t& Pin::external_state() const
+{
+    return m_ext_state;
+}
+
 /**
    \return the pin voltage value
  */
@@ -170,6 +195,14 @@ inline DataSignal& Pin::signal()
     return m_signal;
 }
 
+/**
+   \return the typed signal raising the digital state changes
+ */
+inline TypedSignal<bool>& Pin::digital_signal()
+{
+    return m_digital_signal;
+}
+
 
 YASIMAVR_END_NAMESPACE
 
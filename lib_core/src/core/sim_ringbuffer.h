@@ -0,0 +1,266 @@
+/*
+ * sim_ringbuffer.h
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#ifndef __YASIMAVR_RINGBUFFER_H__
+#define __YASIMAVR_RINGBUFFER_H__
+
+#include "sim_globals.h"
+#include <vector>
+#include <cstddef>
+
+YASIMAVR_BEGIN_NAMESPACE
+
+
+//=======================================================================================
+/**
+   \brief Fixed-capacity FIFO ring buffer
+
+   The capacity is rounded up to a power of 2 so that the positions are obtained by masking.
+   The buffer never allocates once constructed, unless the capacity is changed explicitly.
+   Pushing to a full buffer fails and leaves the content unchanged.
+ */
+template<typename T>
+class RingBuffer {
+
+public:
+
+    explicit RingBuffer(size_t capacity = 0);
+
+    void set_capacity(size_t capacity);
+    size_t capacity() const;
+
+    size_t size() const;
+    bool empty() const;
+    bool full() const;
+    void clear();
+
+    T& front();
+    const T& front() const;
+    T& back();
+    const T& back() const;
+    T& operator[](size_t index);
+    const T& operator[](size_t index) const;
+
+    bool push_back(const T& value);
+    void pop_front();
+    void pop_back();
+
+    size_t push(const T* values, size_t count);
+    size_t pop(T* values, size_t count);
+    size_t peek(T* values, size_t count) const;
+    void discard(size_t count);
+
+private:
+
+    std::vector<T> m_buffer;
+    size_t m_mask;
+    //Monotonic counters of the popped and pushed items, the difference is the size
+    size_t m_head;
+    size_t m_tail;
+
+};
+
+/**
+   Build a ring buffer.
+   \param capacity minimum capacity of the buffer, rounded up to a power of 2
+ */
+template<typename T>
+RingBuffer<T>::RingBuffer(size_t capacity)
+:m_mask(0)
+,m_head(0)
+,m_tail(0)
+{
+    set_capacity(capacity);
+}
+
+/**
+   Change the capacity of the buffer. The content is kept, up to the new capacity.
+   \param capacity minimum capacity of the buffer, rounded up to a power of 2
+ */
+template<typename T>
+void RingBuffer<T>::set_capacity(size_t capacity)
+{
+    size_t n = capacity ? 1 : 0;
+    while (n < capacity)
+        n <<= 1;
+
+    std::vector<T> v(n);
+    size_t count = pop(v.data(), n);
+
+    m_buffer.swap(v);
+    m_mask = n ? (n - 1) : 0;
+    m_head = 0;
+    m_tail = count;
+}
+
+/// Returns the capacity of the buffer
+template<typename T>
+inline size_t RingBuffer<T>::capacity() const
+{
+    return m_buffer.size();
+}
+
+/// Returns the number of items stored in the buffer
+template<typename T>
+inline size_t RingBuffer<T>::size() const
+{
+    return m_tail - m_head;
+}
+
+template<typename T>
+inline bool RingBuffer<T>::empty() const
+{
+    return m_tail == m_head;
+}
+
+template<typename T>
+inline bool RingBuffer<T>::full() const
+{
+    return size() == m_buffer.size();
+}
+
+/// Discard all the items stored in the buffer
+template<typename T>
+inline void RingBuffer<T>::clear()
+{
+    m_head = m_tail = 0;
+}
+
+/// Returns the oldest item. The buffer must not be empty.
+template<typename T>
+inline T& RingBuffer<T>::front()
+{
+    return m_buffer[m_head & m_mask];
+}
+
+template<typename T>
+inline const T& RingBuffer<T>::front() const
+{
+    return m_buffer[m_head & m_mask];
+}
+
+/// Returns the most recent item. The buffer must not be empty.
+template<typename T>
+inline T& RingBuffer<T>::back()
+{
+    return m_buffer[(m_tail - 1) & m_mask];
+}
+
+template<typename T>
+inline const T& RingBuffer<T>::back() const
+{
+    return m_buffer[(m_tail - 1) & m_mask];
+}
+
+/// Returns the item at the given position, counted from the front
+template<typename T>
+inline T& RingBuffer<T>::operator[](size_t index)
+{
+    return m_buffer[(m_head + index) & m_mask];
+}
+
+template<typename T>
+inline const T& RingBuffer<T>::operator[](size_t index) const
+{
+    return m_buffer[(m_head + index) & m_mask];
+}
+
+/**
+   Push an item at the back of the buffer.
+   \return true if the item was pushed, false if the buffer is full
+ */
+template<typename T>
+inline bool RingBuffer<T>::push_back(const T& value)
+{
+    if (full()) return false;
+    m_buffer[m_tail++ & m_mask] = value;
+    return true;
+}
+
+/// Remove the item at the front. The buffer must not be empty.
+template<typename T>
+inline void RingBuffer<T>::pop_front()
+{
+    ++m_head;
+}
+
+/// Remove the item at the back. The buffer must not be empty.
+template<typename T>
+inline void RingBuffer<T>::pop_back()
+{
+    --m_tail;
+}
+
+/**
+   Push several items at the back of the buffer, as many as the free space allows.
+   \return the number of items pushed
+ */
+template<typename T>
+size_t RingBuffer<T>::push(const T* values, size_t count)
+{
+    size_t n = m_buffer.size() - size();
+    if (count < n) n = count;
+    for (size_t i = 0; i < n; ++i)
+        m_buffer[m_tail++ & m_mask] = values[i];
+    return n;
+}
+
+/**
+   Pop several items from the front of the buffer.
+   \return the number of items popped
+ */
+template<typename T>
+size_t RingBuffer<T>::pop(T* values, size_t count)
+{
+    size_t n = size();
+    if (count < n) n = count;
+    for (size_t i = 0; i < n; ++i)
+        values[i] = m_buffer[m_head++ & m_mask];
+    return n;
+}
+
+/**
+   Copy several items from the front of the buffer, without removing them.
+   \return the number of items copied
+ */
+template<typename T>
+size_t RingBuffer<T>::peek(T* values, size_t count) const
+{
+    size_t n = size();
+    if (count < n) n = count;
+    for (size_t i = 0; i < n; ++i)
+        values[i] = m_buffer[(m_head + i) & m_mask];
+    return n;
+}
+
+/// Remove up to count items from the front of the buffer
+template<typename T>
+inline void RingBuffer<T>::discard(size_t count)
+{
+    m_head += (count < size()) ? count : size();
+}
+
+
+YASIMAVR_END_NAMESPACE
+
+#endif //__YASIMAVR_RINGBUFFER_H__
@@ -23,6 +23,8 @@
 
 #include "sim_signal.h"
 #include <assert.h>
+#include <algorithm>
+#include <string.h>
 
 YASIMAVR_USING_NAMESPACE
 
@@ -72,6 +74,7 @@ SignalHook& SignalHook::operator=(const SignalHook& other)
  */
 Signal::Signal()
 :m_busy(false)
+,m_queue(nullptr)
 {}
 
 
@@ -80,6 +83,7 @@ Signal::Signal()
  */
 Signal::Signal(const Signal& other)
 :m_busy(false)
+,m_queue(nullptr)
 {
     for (auto& slot : other.m_hooks)
         connect(*slot.hook, slot.tag);
@@ -92,6 +96,8 @@ Signal::Signal(const Signal& other)
  */
 Signal::~Signal()
 {
+    set_deferred(nullptr);
+
     std::vector<hook_slot_t> hook_slots = m_hooks;
     for (auto& slot : hook_slots) {
         int i = signal_index(*slot.hook);
@@ -136,10 +142,23 @@ void Signal::disconnect(SignalHook& hook)
 
 
 /**
-   Raise the signal with the given data
+   Raise the signal with the given data.
+   If the signal is deferred, the data is only enqueued.
    \param sigdata
  */
 void Signal::raise(const signal_data_t& sigdata)
+{
+    if (m_queue)
+        m_queue->push(*this, sigdata);
+    else
+        dispatch(sigdata);
+}
+
+
+/**
+   Call the hooks with the given data.
+ */
+void Signal::dispatch(const signal_data_t& sigdata)
 {
     if (m_busy) return;
     m_busy = true;
@@ -163,6 +182,33 @@ void Signal::raise(int sigid, const vardata_t& v, long long ix)
 }
 
 
+/**
+   Attach the signal to a queue for deferring its raises, or detach it.
+   The raises pending in the previous queue are cancelled.
+   \param queue queue to attach to, or null to make the raises immediate
+ */
+void Signal::set_deferred(SignalQueue* queue)
+{
+    if (queue == m_queue) return;
+
+    if (m_queue) {
+        m_queue->cancel(*this);
+        auto& v = m_queue->m_signals;
+        for (auto it = v.begin(); it != v.end(); ++it) {
+            if (*it == this) {
+                v.erase(it);
+                break;
+            }
+        }
+    }
+
+    m_queue = queue;
+
+    if (m_queue)
+        m_queue->m_signals.push_back(this);
+}
+
+
 int Signal::hook_index(const SignalHook& hook) const
 {
     int index = 0;
@@ -209,6 +255,120 @@ Signal& Signal::operator=(const Signal& other)
 }
 
 
+//=======================================================================================
+
+SignalQueue::SignalQueue()
+:m_head(0)
+,m_flushing(false)
+{}
+
+
+/**
+   Destroy the queue. The attached signals are reverted to immediate raises.
+ */
+SignalQueue::~SignalQueue()
+{
+    for (Signal* signal : m_signals)
+        signal->m_queue = nullptr;
+}
+
+
+bool SignalQueue::key_t::operator==(const key_t& other) const
+{
+    return signal == other.signal && sigid == other.sigid && index == other.index;
+}
+
+
+size_t SignalQueue::key_hash_t::operator()(const key_t& k) const
+{
+    size_t h = std::hash<const void*>()(k.signal);
+    h ^= std::hash<int>()(k.sigid) + 0x9E3779B9 + (h << 6) + (h >> 2);
+    h ^= std::hash<long long>()(k.index) + 0x9E3779B9 + (h << 6) + (h >> 2);
+    return h;
+}
+
+
+/**
+   Enqueue a raise. If a raise of the same signal with the same SIGID and index
+   is already pending, its data is replaced.
+   String and Bytes data are copied into the queue.
+ */
+void SignalQueue::push(Signal& signal, const signal_data_t& sigdata)
+{
+    key_t k = { &signal, sigdata.sigid, sigdata.index };
+    auto it = m_pending.find(k);
+
+    entry_t* e;
+    if (it != m_pending.end()) {
+        e = &m_entries[it->second];
+        e->sigdata.data = sigdata.data;
+    } else {
+        m_pending.emplace(k, m_entries.size());
+        m_entries.push_back({ &signal, sigdata, {} });
+        e = &m_entries.back();
+    }
+
+    const vardata_t& v = sigdata.data;
+    if (v.type() == vardata_t::String) {
+        const char* str = v.as_str();
+        e->payload.assign(str, str + strlen(str) + 1);
+    }
+    else if (v.type() == vardata_t::Bytes) {
+        e->payload.assign(v.as_bytes(), v.as_bytes() + v.size());
+    }
+    else {
+        e->payload.clear();
+    }
+}
+
+
+/**
+   Cancel all the pending raises of a signal.
+ */
+void SignalQueue::cancel(Signal& signal)
+{
+    for (size_t i = m_head; i < m_entries.size(); ++i) {
+        entry_t& e = m_entries[i];
+        if (e.signal == &signal) {
+            m_pending.erase({ e.signal, e.sigdata.sigid, e.sigdata.index });
+            e.signal = nullptr;
+        }
+    }
+}
+
+
+/**
+   Dispatch all the pending raises, including those enqueued by the hooks during the flush.
+ */
+void SignalQueue::flush()
+{
+    if (m_flushing) return;
+    m_flushing = true;
+
+    while (m_head < m_entries.size()) {
+        //Move the entry out as the hooks may enqueue new ones
+        entry_t e = std::move(m_entries[m_head++]);
+        if (!e.signal) continue;
+
+        //From here, a new raise with the same key is a new entry
+        m_pending.erase({ e.signal, e.sigdata.sigid, e.sigdata.index });
+
+        //Point the data to the copy owned by the entry
+        if (e.sigdata.data.type() == vardata_t::String)
+            e.sigdata.data = (const char*) e.payload.data();
+        else if (e.sigdata.data.type() == vardata_t::Bytes)
+            e.sigdata.data = vardata_t(e.payload.data(), e.payload.size());
+
+        e.signal->dispatch(e.sigdata);
+    }
+
+    m_entries.clear();
+    m_head = 0;
+
+    m_flushing = false;
+}
+
+
 //=======================================================================================
 
 /**
@@ -218,11 +378,11 @@ Signal& Signal::operator=(const Signal& other)
 vardata_t DataSignal::data(int sigid, long long index) const
 {
     key_t k = { sigid, index };
-    auto it = m_data.find(k);
+    auto it = find(k);
     if (it == m_data.end())
         return vardata_t();
     else
-        return it->second;
+        return it->data;
 }
 
 
@@ -232,7 +392,7 @@ vardata_t DataSignal::data(int sigid, long long index) const
 bool DataSignal::has_data(int sigid, long long index) const
 {
     key_t k = { sigid, index };
-    return m_data.find(k) != m_data.end();
+    return find(k) != m_data.end();
 }
 
 
@@ -242,7 +402,7 @@ bool DataSignal::has_data(int sigid, long long index) const
 void DataSignal::set_data(int sigid, const vardata_t& v, long long index)
 {
     key_t k = { sigid, index };
-    m_data[k] = v;
+    emplace(k) = v;
 }
 
 
@@ -258,20 +418,36 @@ void DataSignal::clear()
 void DataSignal::raise(const signal_data_t& sigdata)
 {
     key_t k = { sigdata.sigid, sigdata.index };
-    m_data[k] = sigdata.data;
+    emplace(k) = sigdata.data;
     Signal::raise(sigdata);
 }
 
 
-bool DataSignal::key_t::operator==(const key_t& other) const
+std::vector<DataSignal::entry_t>::const_iterator DataSignal::find(const key_t& key) const
+{
+    auto it = std::lower_bound(m_data.begin(), m_data.end(), key,
+                               [](const entry_t& e, const key_t& k) { return e.key < k; });
+    if (it != m_data.end() && !(key < it->key))
+        return it;
+    else
+        return m_data.end();
+}
+
+
+//Returns a reference to the data for a key, inserting an invalid one if not found
+vardata_t& DataSignal::emplace(const key_t& key)
 {
-    return sigid == other.sigid && index == other.index;
+    auto it = std::lower_bound(m_data.begin(), m_data.end(), key,
+                               [](const entry_t& e, const key_t& k) { return e.key < k; });
+    if (it == m_data.end() || key < it->key)
+        it = m_data.insert(it, { key, vardata_t() });
+    return it->data;
 }
 
 
-size_t DataSignal::keyhash_t::operator()(const key_t& k) const
+bool DataSignal::key_t::operator<(const key_t& other) const
 {
-    return ((long long)k.sigid) ^ k.index;
+    return sigid < other.sigid || (sigid == other.sigid && index < other.index);
 }
 
 
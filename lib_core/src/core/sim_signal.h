@@ -48,6 +48,7 @@ struct signal_data_t {
 //=======================================================================================
 
 class Signal;
+class SignalQueue;
 
 /**
    Abstract interface to be reimplemented to receive signal raises
@@ -93,6 +94,12 @@ private:
    Signals are connected to objects implementing the SignalHook interface.
    One signal can be connected to may hooks, whilst one hook can be connected to
    many signals.
+
+   By default, the hooks are called immediately by raise() and a raise nested in another
+   raise of the same signal is ignored.
+   A signal can be made deferred by attaching it to a SignalQueue. In this case, raise()
+   only enqueues the data and the hooks are called when the queue is flushed.
+   Nested raises are then enqueued instead of being ignored.
  */
 class AVR_CORE_PUBLIC_API Signal {
 
@@ -105,19 +112,30 @@ public:
 
     void connect(SignalHook& hook, int hooktag = 0);
     void disconnect(SignalHook& hook);
+    bool connected() const;
 
     virtual void raise(const signal_data_t& sigdata);
     void raise(int sigid = 0, const vardata_t& v = vardata_t(), long long index = 0);
 
+    void set_deferred(SignalQueue* queue);
+    SignalQueue* deferred_queue() const;
+
     Signal& operator=(const Signal&);
     Signal& operator=(const Signal&&) = delete;
 
+protected:
+
+    void dispatch(const signal_data_t& sigdata);
+
 private:
 
     friend class SignalHook;
+    friend class SignalQueue;
 
     //Flag used to avoid nested raises
     bool m_busy;
+    //Queue for deferred raises, null if the raises are immediate
+    SignalQueue* m_queue;
 
     struct hook_slot_t {
         SignalHook* hook;
@@ -131,6 +149,288 @@ private:
 
 };
 
+/// Returns true if at least one hook is connected
+inline bool Signal::connected() const
+{
+    return !m_hooks.empty();
+}
+
+/// Returns the queue the signal is deferred to, or null if the raises are immediate
+inline SignalQueue* Signal::deferred_queue() const
+{
+    return m_queue;
+}
+
+
+//=======================================================================================
+/**
+   \brief Queue for deferred signal raises
+
+   A signal queue collects the raises of the signals attached to it, and calls their hooks
+   when flush() is called, in the order of the raises.
+   Repeated raises of the same signal with the same SIGID and index are coalesced: only
+   the last data is dispatched, at the position of the first raise.
+   The raises done by the hooks during a flush are enqueued and dispatched in the same flush.
+   String and Bytes data are copied by the queue, the pointers given to raise() do not
+   need to remain valid until the flush.
+
+   A queue is owned by each CycleManager and flushed at the end of each call to
+   CycleManager::process_timers().
+   \sa CycleManager::signal_queue(), Signal::set_deferred()
+ */
+class AVR_CORE_PUBLIC_API SignalQueue {
+
+public:
+
+    SignalQueue();
+    ~SignalQueue();
+
+    void push(Signal& signal, const signal_data_t& sigdata);
+    void cancel(Signal& signal);
+    void flush();
+
+    bool empty() const;
+
+    SignalQueue(const SignalQueue&) = delete;
+    SignalQueue& operator=(const SignalQueue&) = delete;
+
+private:
+
+    friend class Signal;
+
+    struct entry_t {
+        Signal* signal;
+        signal_data_t sigdata;
+        //Copy of the String or Bytes data
+        std::vector<uint8_t> payload;
+    };
+
+    struct key_t {
+        const Signal* signal;
+        int sigid;
+        long long index;
+        bool operator==(const key_t& other) const;
+    };
+
+    struct key_hash_t {
+        size_t operator()(const key_t& k) const;
+    };
+
+    //Pending raises, the ones before m_head are already dispatched
+    std::vector<entry_t> m_entries;
+    size_t m_head;
+    //Position of the pending raises in m_entries, for coalescing
+    std::unordered_map<key_t, size_t, key_hash_t> m_pending;
+    bool m_flushing;
+    //Signals attached to this queue
+    std::vector<Signal*> m_signals;
+
+};
+
+/// Returns true if there is no pending raise
+inline bool SignalQueue::empty() const
+{
+    return m_head >= m_entries.size();
+}
+
+
+//=======================================================================================
+/**
+   \brief Typed signal with direct calls
+
+   Lightweight variant of Signal for the internal connections between models where the
+   raise rate is high, such as tick or pin updates. The data is passed by reference with
+   its own type, instead of being packed in a signal_data_t.
+   The receivers are called through a plain function pointer, without virtual
+   call, and the first connections are stored inline, without any allocation.
+
+   Contrary to Signal, the connections are not severed automatically when a receiver is
+   destroyed, it must be disconnected beforehand or outlive the signal.
+
+   A TypedSignal can be connected to a Signal, to which the raises are forwarded as
+   regular signal_data_t, so that SignalHook objects can still receive them.
+   This requires vardata_t to be constructible from T.
+
+   Example:
+   \code
+   signal.connect<Receiver, &Receiver::on_tick>(receiver);
+   \endcode
+ */
+template<typename T>
+class TypedSignal {
+
+public:
+
+    /// Signature of the receiver functions
+    typedef void (*callback_t)(void* receiver, const T& data, int tag);
+
+    TypedSignal();
+
+    template<class R, void (R::*M)(const T&, int)>
+    void connect(R& receiver, int tag = 0);
+    void connect(callback_t callback, void* receiver, int tag = 0);
+    void connect(Signal& signal, int sigid = 0);
+
+    void disconnect(void* receiver);
+    void disconnect(Signal& signal);
+
+    bool connected() const;
+
+    void raise(const T& data);
+
+    //Disable copy semantics, the receivers are bound to a specific signal
+    TypedSignal(const TypedSignal&) = delete;
+    TypedSignal& operator=(const TypedSignal&) = delete;
+
+private:
+
+    //Number of connections stored inline
+    static const size_t InlineSlots = 4;
+
+    struct slot_t {
+        callback_t callback;
+        void* receiver;
+        int tag;
+    };
+
+    slot_t m_slots[InlineSlots];
+    std::vector<slot_t> m_extra_slots;
+    size_t m_count;
+    //Flag used to avoid nested raises
+    bool m_busy;
+
+    slot_t& slot(size_t index);
+
+    template<class R, void (R::*M)(const T&, int)>
+    static void call(void* receiver, const T& data, int tag);
+    static void forward(void* signal, const T& data, int sigid);
+
+};
+
+template<typename T>
+TypedSignal<T>::TypedSignal()
+:m_count(0)
+,m_busy(false)
+{}
+
+/**
+   Connect a member function of a receiver object.
+   \param receiver receiver object
+   \param tag integer passed on to the function when called
+ */
+template<typename T>
+template<class R, void (R::*M)(const T&, int)>
+inline void TypedSignal<T>::connect(R& receiver, int tag)
+{
+    connect(&call<R, M>, &receiver, tag);
+}
+
+/**
+   Connect a receiver function. Connecting the same receiver several times
+   has no effect.
+   \param callback function called on raises
+   \param receiver pointer passed on to the function
+   \param tag integer passed on to the function
+ */
+template<typename T>
+void TypedSignal<T>::connect(callback_t callback, void* receiver, int tag)
+{
+    for (size_t i = 0; i < m_count; ++i)
+        if (slot(i).receiver == receiver) return;
+
+    slot_t s = { callback, receiver, tag };
+    if (m_count < InlineSlots)
+        m_slots[m_count] = s;
+    else
+        m_extra_slots.push_back(s);
+    ++m_count;
+}
+
+/**
+   Connect a Signal, to which all the raises are forwarded.
+   \param signal Signal to forward to
+   \param sigid Signal identifier used for the forwarded raises
+ */
+template<typename T>
+inline void TypedSignal<T>::connect(Signal& signal, int sigid)
+{
+    connect(&forward, &signal, sigid);
+}
+
+/**
+   Disconnect a receiver.
+ */
+template<typename T>
+void TypedSignal<T>::disconnect(void* receiver)
+{
+    for (size_t i = 0; i < m_count; ++i) {
+        if (slot(i).receiver == receiver) {
+            //Shift the following slots to keep the connection order
+            for (size_t j = i + 1; j < m_count; ++j)
+                slot(j - 1) = slot(j);
+            if (m_count > InlineSlots)
+                m_extra_slots.pop_back();
+            --m_count;
+            return;
+        }
+    }
+}
+
+/**
+   Disconnect a Signal.
+ */
+template<typename T>
+inline void TypedSignal<T>::disconnect(Signal& signal)
+{
+    disconnect((void*) &signal);
+}
+
+/// Returns true if at least one receiver is connected
+template<typename T>
+inline bool TypedSignal<T>::connected() const
+{
+    return m_count > 0;
+}
+
+/**
+   Raise the signal, calling all the receivers in the order of connection.
+ */
+template<typename T>
+inline void TypedSignal<T>::raise(const T& data)
+{
+    if (m_busy) return;
+    m_busy = true;
+
+    size_t n = m_count < InlineSlots ? m_count : InlineSlots;
+    for (size_t i = 0; i < n; ++i)
+        m_slots[i].callback(m_slots[i].receiver, data, m_slots[i].tag);
+    for (size_t i = InlineSlots; i < m_count; ++i) {
+        slot_t& s = m_extra_slots[i - InlineSlots];
+        s.callback(s.receiver, data, s.tag);
+    }
+
+    m_busy = false;
+}
+
+template<typename T>
+inline typename TypedSignal<T>::slot_t& TypedSignal<T>::slot(size_t index)
+{
+    return index < InlineSlots ? m_slots[index] : m_extra_slots[index - InlineSlots];
+}
+
+template<typename T>
+template<class R, void (R::*M)(const T&, int)>
+void TypedSignal<T>::call(void* receiver, const T& data, int tag)
+{
+    (static_cast<R*>(receiver)->*M)(data, tag);
+}
+
+template<typename T>
+void TypedSignal<T>::forward(void* signal, const T& data, int sigid)
+{
+    static_cast<Signal*>(signal)->raise(sigid, vardata_t(data));
+}
+
 
 //=======================================================================================
 
@@ -152,14 +452,20 @@ private:
     struct key_t {
         int sigid;
         long long index;
-        bool operator==(const key_t& other) const;
+        bool operator<(const key_t& other) const;
     };
 
-    struct keyhash_t {
-        size_t operator()(const key_t& k) const;
+    struct entry_t {
+        key_t key;
+        vardata_t data;
     };
 
-    std::unordered_map<key_t, vardata_t, keyhash_t> m_data;
+    //Data storage as a flat map sorted by key. Signals usually hold only a handful
+    //of entries so a binary search on a contiguous array is faster than hashing.
+    std::vector<entry_t> m_data;
+
+    std::vector<entry_t>::const_iterator find(const key_t& key) const;
+    vardata_t& emplace(const key_t& key);
 
 };
 
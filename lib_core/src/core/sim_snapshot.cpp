@@ -0,0 +1,923 @@
+/*
+ * sim_snapshot.cpp
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#include "sim_snapshot.h"
+#include "sim_ioreg.h"
+#include "sim_firmware.h"
+#include <cstring>
+#include <cstdio>
+#include <unordered_map>
+
+#if defined _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+YASIMAVR_USING_NAMESPACE
+
+
+//=======================================================================================
+
+/**
+   Construct a buffer of 'size' bytes, all set to 'fill'.
+   Pages of the same content are initially shared.
+ */
+SharedPageBuffer::SharedPageBuffer(size_t size, unsigned char fill)
+:m_size(size)
+{
+    size_t page_count = (size + PageSize - 1) / PageSize;
+    if (!page_count) return;
+
+    m_pages.reserve(page_count);
+
+    auto full_page = std::make_shared<page_t>(PageSize, fill);
+    for (size_t i = 0; i < page_count - 1; ++i)
+        m_pages.push_back(full_page);
+
+    size_t last_size = size - (page_count - 1) * PageSize;
+    if (last_size == PageSize)
+        m_pages.push_back(full_page);
+    else
+        m_pages.push_back(std::make_shared<page_t>(last_size, fill));
+}
+
+/**
+   Return the number of pages shared between this buffer and another.
+ */
+size_t SharedPageBuffer::shared_page_count(const SharedPageBuffer& other) const
+{
+    size_t n = 0;
+    for (size_t i = 0; i < m_pages.size() && i < other.m_pages.size(); ++i) {
+        if (m_pages[i] == other.m_pages[i])
+            ++n;
+    }
+    return n;
+}
+
+/**
+   Copy the buffer content into 'buf'.
+   \param buf buffer to copy the data into
+   \param base first address to be read
+   \param len length of the area to be read, in bytes
+   \return length of data actually read
+ */
+size_t SharedPageBuffer::read(unsigned char* buf, size_t base, size_t len) const
+{
+    if (base >= m_size) return 0;
+    if (base + len > m_size)
+        len = m_size - base;
+
+    size_t done = 0;
+    while (done < len) {
+        size_t pos = base + done;
+        size_t ofs = pos % PageSize;
+        size_t n = std::min(PageSize - ofs, len - done);
+        memcpy(buf + done, m_pages[pos / PageSize]->data() + ofs, n);
+        done += n;
+    }
+
+    return len;
+}
+
+/**
+   Write data into the buffer.
+   Only the pages whose content is actually changed are written. If such
+   a page is shared with another buffer, it is duplicated beforehand.
+   \param buf data to be copied
+   \param base first address to be written
+   \param len length of data to write
+   \return number of pages modified
+ */
+size_t SharedPageBuffer::write(const unsigned char* buf, size_t base, size_t len)
+{
+    if (base >= m_size) return 0;
+    if (base + len > m_size)
+        len = m_size - base;
+
+    size_t page_written = 0;
+    size_t done = 0;
+    while (done < len) {
+        size_t pos = base + done;
+        size_t ofs = pos % PageSize;
+        size_t n = std::min(PageSize - ofs, len - done);
+        std::shared_ptr<page_t>& page = m_pages[pos / PageSize];
+        if (memcmp(page->data() + ofs, buf + done, n)) {
+            if (page.use_count() > 1)
+                page = std::make_shared<page_t>(*page);
+            memcpy(page->data() + ofs, buf + done, n);
+            ++page_written;
+        }
+        done += n;
+    }
+
+    return page_written;
+}
+
+
+//=======================================================================================
+
+DeviceSnapshot::DeviceSnapshot()
+:m_valid(false)
+,m_model_hash(0)
+,m_firmware_hash(0)
+,m_state(Device::State_Limbo)
+,m_cycle(INVALID_CYCLE)
+,m_regs{0}
+,m_sreg(0)
+,m_pc(0)
+,m_int_inhib_counter(0)
+,m_unsaved_timers(0)
+,m_loaded(false)
+{}
+
+
+std::vector<NonVolatileMemory*> DeviceSnapshot::device_nvms(Device& device)
+{
+    ctlreq_data_t reqdata = { .data = (void*) nullptr, .index = Core::NVM_GetCount };
+    device.ctlreq(AVR_IOCTL_CORE, AVR_CTLREQ_CORE_NVM, &reqdata);
+    unsigned int count = reqdata.data.as_uint();
+    if (!count)
+        count = Core::NVM_CommonCount;
+
+    std::vector<NonVolatileMemory*> nvms(count, nullptr);
+    for (unsigned int i = 0; i < count; ++i) {
+        reqdata = { .data = (void*) nullptr, .index = (int) i };
+        device.ctlreq(AVR_IOCTL_CORE, AVR_CTLREQ_CORE_NVM, &reqdata);
+        nvms[i] = reinterpret_cast<NonVolatileMemory*>(reqdata.data.as_ptr());
+    }
+
+    return nvms;
+}
+
+typedef std::unordered_map<const CycleTimer*, std::pair<ctl_id_t, uint32_t>> timer_id_map_t;
+
+//Map the cycle timers declared by the peripherals to their owner id and their index
+static timer_id_map_t state_timer_ids(const std::vector<Peripheral*>& peripherals)
+{
+    timer_id_map_t ids;
+    for (Peripheral* per : peripherals) {
+        const std::vector<CycleTimer*>& timers = per->state_timers();
+        for (size_t i = 0; i < timers.size(); ++i)
+            ids[timers[i]] = { per->id(), (uint32_t) i };
+    }
+    return ids;
+}
+
+/**
+   Capture the state of a device.
+   If the snapshot already contains a state, only the memory pages
+   that differ from it are reallocated. In particular, if the snapshot was
+   obtained by a fork(), the pages that are unchanged remain shared with the
+   parent snapshot.
+   \param device device to capture. It must be initialised.
+   \return true if the capture succeeded
+ */
+bool DeviceSnapshot::capture(Device& device)
+{
+    if (device.state() == Device::State_Limbo || device.state() == Device::State_Destroying)
+        return false;
+
+    //The deferred signals are not part of the snapshot, so the capture
+    //must be done when none is pending
+    CycleManager* cycle_manager = device.cycle_manager();
+    if (!cycle_manager || !cycle_manager->signal_queue().empty())
+        return false;
+
+    //Peripheral internal states, collected first since a peripheral may refuse
+    //the capture, leaving the snapshot unchanged
+    std::vector<periph_state_t> peripherals;
+    for (Peripheral* per : device.m_peripherals) {
+        periph_state_t ps = { per->id() };
+        if (!per->save_state(ps.data)) {
+            device.logger().dbg("Snapshot capture refused by peripheral %s", per->name().c_str());
+            return false;
+        }
+        if (ps.data.size())
+            peripherals.push_back(std::move(ps));
+    }
+
+    Core& core = device.core();
+    const CoreConfiguration& config = core.config();
+
+    m_state = device.state();
+    m_cycle = device.cycle();
+    memcpy(m_regs, core.m_regs, 32);
+    m_sreg = core.read_sreg();
+    m_pc = core.m_pc;
+    m_int_inhib_counter = core.m_int_inhib_counter;
+
+    //I/O registers. Unallocated registers are stored as zero.
+    size_t ioreg_count = core.m_ioregs.size();
+    if (m_ioregs.size() != ioreg_count)
+        m_ioregs = SharedPageBuffer(ioreg_count);
+    std::vector<unsigned char> ioreg_values(ioreg_count, 0x00);
+    for (size_t i = 0; i < ioreg_count; ++i) {
+        IO_Register* ioreg = core.m_ioregs[i];
+        if (ioreg)
+            ioreg_values[i] = ioreg->value();
+    }
+    m_ioregs.write(ioreg_values.data(), 0, ioreg_count);
+
+    //SRAM
+    size_t sram_size = config.ramend - config.ramstart + 1;
+    if (m_sram.size() != sram_size)
+        m_sram = SharedPageBuffer(sram_size);
+    m_sram.write(core.m_sram, 0, sram_size);
+
+    //Non-volatile memories
+    std::vector<NonVolatileMemory*> nvms = device_nvms(device);
+    m_nvms.resize(nvms.size());
+    std::vector<unsigned char> tags;
+    for (size_t i = 0; i < nvms.size(); ++i) {
+        nvm_image_t& image = m_nvms[i];
+        NonVolatileMemory* nvm = nvms[i];
+        size_t nvm_size = nvm ? nvm->size() : 0;
+        if (image.data.size() != nvm_size) {
+            image.data = SharedPageBuffer(nvm_size, 0xFF);
+            image.tags = SharedPageBuffer(nvm_size, 0x00);
+        }
+        if (!nvm_size) continue;
+
+        image.data.write(nvm->block().buf, 0, nvm_size);
+        tags.resize(nvm_size);
+        nvm->programmed(tags.data(), 0, nvm_size);
+        image.tags.write(tags.data(), 0, nvm_size);
+    }
+
+    m_peripherals = std::move(peripherals);
+
+    //Cycle timers, identified by their owner peripheral and their index
+    timer_id_map_t timer_ids = state_timer_ids(device.m_peripherals);
+    m_timers.clear();
+    m_unsaved_timers = 0;
+    for (auto& slot : cycle_manager->timer_slots()) {
+        auto it = timer_ids.find(slot.timer);
+        if (it == timer_ids.end())
+            ++m_unsaved_timers;
+        else
+            m_timers.push_back({ it->second.first, it->second.second, slot.when, slot.paused });
+    }
+
+    m_model_hash = device_model_hash(device);
+    m_valid = true;
+    m_loaded = false;
+    return true;
+}
+
+/**
+   Restore the state of a device from the snapshot.
+   The device must be of the same model as the one used for the capture.
+   The CPU, the cycle counter and the I/O register values are set directly, then
+   each peripheral is brought in line with them by Peripheral::load_state(),
+   and its declared cycle timers are rescheduled as they were at the capture.
+   The memory contents are only written where they differ from the snapshot, page by page.
+   If the restoration fails, the device is left unchanged: the states saved by a
+   capture can always be loaded back, and for a snapshot loaded from a file, the
+   device is captured beforehand and restored back if a peripheral rejects its state.
+   \param device device to restore
+   \return true if the restoration succeeded
+ */
+bool DeviceSnapshot::restore(Device& device) const
+{
+    if (!m_loaded)
+        return apply(device);
+
+    DeviceSnapshot backup = fork();
+    if (!backup.capture(device)) {
+        device.logger().err("Snapshot restore failed: the current state cannot be saved");
+        return false;
+    }
+
+    if (apply(device))
+        return true;
+
+    backup.apply(device);
+    return false;
+}
+
+/*
+ * Apply the snapshot to the device. The compatibility checks are done before
+ * changing anything, but a peripheral may still reject its state at the end.
+ */
+bool DeviceSnapshot::apply(Device& device) const
+{
+    if (!m_valid) return false;
+    if (device.state() == Device::State_Limbo || device.state() == Device::State_Destroying)
+        return false;
+
+    if (device_model_hash(device) != m_model_hash) {
+        device.logger().err("Snapshot restore failed: device model mismatch");
+        return false;
+    }
+
+    Core& core = device.core();
+    const CoreConfiguration& config = core.config();
+
+    size_t sram_size = config.ramend - config.ramstart + 1;
+    std::vector<NonVolatileMemory*> nvms = device_nvms(device);
+    if (core.m_ioregs.size() != m_ioregs.size() ||
+        sram_size != m_sram.size() ||
+        nvms.size() != m_nvms.size())
+        return false;
+
+    for (size_t i = 0; i < nvms.size(); ++i) {
+        size_t nvm_size = nvms[i] ? nvms[i]->size() : 0;
+        if (nvm_size != m_nvms[i].data.size() || nvm_size != m_nvms[i].tags.size())
+            return false;
+    }
+
+    //Resolve the recorded timers before changing anything
+    std::vector<CycleTimer*> timers(m_timers.size());
+    for (size_t i = 0; i < m_timers.size(); ++i) {
+        Peripheral* per = device.find_peripheral(m_timers[i].id);
+        if (!per || m_timers[i].index >= per->state_timers().size()) {
+            device.logger().err("Snapshot restore failed: timer %u of %s not found",
+                                m_timers[i].index, id_to_str(m_timers[i].id).c_str());
+            return false;
+        }
+        timers[i] = per->state_timers()[m_timers[i].index];
+    }
+
+    CycleManager& cycle_manager = *device.cycle_manager();
+    cycle_manager.set_cycle(m_cycle);
+
+    memcpy(core.m_regs, m_regs, 32);
+    core.write_sreg(m_sreg);
+    core.m_pc = m_pc;
+    core.m_int_inhib_counter = m_int_inhib_counter;
+
+    //I/O registers and SRAM, only the pages that differ from the device are written
+    for (size_t p = 0; p < m_ioregs.page_count(); ++p) {
+        size_t base = p * SharedPageBuffer::PageSize;
+        size_t len = std::min(SharedPageBuffer::PageSize, m_ioregs.size() - base);
+        const unsigned char* img_page = m_ioregs.page(p);
+        for (size_t j = 0; j < len; ++j) {
+            IO_Register* ioreg = core.m_ioregs[base + j];
+            if (ioreg && ioreg->value() != img_page[j])
+                ioreg->set(img_page[j]);
+        }
+    }
+
+    for (size_t p = 0; p < m_sram.page_count(); ++p) {
+        size_t base = p * SharedPageBuffer::PageSize;
+        size_t len = std::min(SharedPageBuffer::PageSize, sram_size - base);
+        const unsigned char* img_page = m_sram.page(p);
+        if (memcmp(core.m_sram + base, img_page, len))
+            memcpy(core.m_sram + base, img_page, len);
+    }
+
+    std::vector<unsigned char> untags(SharedPageBuffer::PageSize);
+    for (size_t i = 0; i < nvms.size(); ++i) {
+        NonVolatileMemory* nvm = nvms[i];
+        if (!nvm) continue;
+
+        const nvm_image_t& image = m_nvms[i];
+        for (size_t p = 0; p < image.data.page_count(); ++p) {
+            size_t base = p * SharedPageBuffer::PageSize;
+            size_t len = std::min(SharedPageBuffer::PageSize, nvm->size() - base);
+            const unsigned char* img_data = image.data.page(p);
+            const unsigned char* img_tags = image.tags.page(p);
+
+            if (nvm->compare(img_data, img_tags, base, len))
+                continue;
+
+            //Restore the data and the programmed state of the page
+            for (size_t j = 0; j < len; ++j)
+                untags[j] = !img_tags[j];
+            nvm->program({ len, const_cast<unsigned char*>(img_data) }, base);
+            nvm->erase(untags.data(), base, len);
+            nvm->dbg_write(img_data, base, len);
+        }
+    }
+
+    //Reschedule the peripheral timers, in the order of the queue at the capture,
+    //before loading the states so that the peripherals may adjust them
+    for (Peripheral* per : device.m_peripherals) {
+        for (CycleTimer* timer : per->state_timers())
+            cycle_manager.cancel(*timer);
+    }
+
+    for (size_t i = 0; i < m_timers.size(); ++i) {
+        const timer_state_t& ts = m_timers[i];
+        if (ts.paused) {
+            cycle_manager.schedule(*timers[i], m_cycle + ts.when);
+            cycle_manager.pause(*timers[i]);
+        } else {
+            cycle_manager.schedule(*timers[i], ts.when);
+        }
+    }
+
+    bool status = true;
+    for (Peripheral* per : device.m_peripherals) {
+        const periph_state_t* ps = nullptr;
+        for (auto& p : m_peripherals) {
+            if (p.id == per->id()) {
+                ps = &p;
+                break;
+            }
+        }
+
+        bool ok = ps ? per->load_state(ps->data.data(), ps->data.size())
+                     : per->load_state(nullptr, 0);
+        if (!ok) {
+            device.logger().err("Snapshot restore failed for peripheral %s", per->name().c_str());
+            status = false;
+        }
+    }
+
+    device.set_state(m_state);
+
+    return status;
+}
+
+/**
+   Return the total number of memory pages held by the snapshot.
+ */
+size_t DeviceSnapshot::page_count() const
+{
+    size_t n = m_ioregs.page_count() + m_sram.page_count();
+    for (auto& image : m_nvms)
+        n += image.data.page_count() + image.tags.page_count();
+    return n;
+}
+
+/**
+   Return the number of memory pages shared between two snapshots.
+   This is an indication of how much memory a forked snapshot is actually using.
+ */
+size_t DeviceSnapshot::shared_page_count(const DeviceSnapshot& other) const
+{
+    size_t n = m_ioregs.shared_page_count(other.m_ioregs) +
+               m_sram.shared_page_count(other.m_sram);
+    for (size_t i = 0; i < m_nvms.size() && i < other.m_nvms.size(); ++i) {
+        n += m_nvms[i].data.shared_page_count(other.m_nvms[i].data);
+        n += m_nvms[i].tags.shared_page_count(other.m_nvms[i].tags);
+    }
+    return n;
+}
+
+
+//=======================================================================================
+//Hash and file format implementation
+
+//64-bits FNV-1a hash
+#define FNV_OFFSET_BASIS        0xcbf29ce484222325ULL
+#define FNV_PRIME               0x00000100000001b3ULL
+
+static uint64_t fnv1a(uint64_t h, const void* data, size_t len)
+{
+    const unsigned char* p = (const unsigned char*) data;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+template<typename T>
+static uint64_t fnv1a(uint64_t h, T value)
+{
+    return fnv1a(h, &value, sizeof(T));
+}
+
+/**
+   Count the timers currently scheduled with the cycle manager of a device that
+   would not be saved by a capture, i.e. not declared by its peripherals.
+ */
+size_t DeviceSnapshot::count_unsaved_timers(Device& device)
+{
+    if (!device.cycle_manager()) return 0;
+
+    timer_id_map_t timer_ids = state_timer_ids(device.m_peripherals);
+    size_t n = 0;
+    for (auto& slot : device.cycle_manager()->timer_slots()) {
+        if (timer_ids.find(slot.timer) == timer_ids.end())
+            ++n;
+    }
+    return n;
+}
+
+/**
+   Compute a hash identifying a device model, from its name, memory layout,
+   non-volatile memory sizes and the list of its peripherals.
+ */
+uint64_t DeviceSnapshot::device_model_hash(Device& device)
+{
+    const CoreConfiguration& config = device.core().config();
+
+    uint64_t h = FNV_OFFSET_BASIS;
+    h = fnv1a(h, device.config().name.data(), device.config().name.size());
+    h = fnv1a(h, (uint64_t) config.iostart);
+    h = fnv1a(h, (uint64_t) config.ioend);
+    h = fnv1a(h, (uint64_t) config.ramstart);
+    h = fnv1a(h, (uint64_t) config.ramend);
+    h = fnv1a(h, (uint64_t) config.flashend);
+
+    for (NonVolatileMemory* nvm : device_nvms(device))
+        h = fnv1a(h, (uint64_t) (nvm ? nvm->size() : 0));
+
+    for (Peripheral* per : device.m_peripherals)
+        h = fnv1a(h, (uint32_t) per->id());
+
+    return h;
+}
+
+/**
+   Compute a hash of the content of a firmware, i.e. all its memory blocks.
+ */
+uint64_t DeviceSnapshot::compute_firmware_hash(const Firmware& firmware)
+{
+    uint64_t h = FNV_OFFSET_BASIS;
+    for (Firmware::Area area : firmware.memories()) {
+        for (const Firmware::Block& block : firmware.blocks(area)) {
+            h = fnv1a(h, (uint32_t) area);
+            h = fnv1a(h, (uint64_t) block.base);
+            h = fnv1a(h, (uint64_t) block.size);
+            h = fnv1a(h, block.buf, block.size);
+        }
+    }
+    return h;
+}
+
+
+#define SNAPSHOT_MAGIC          "YASIMSNP"
+#define SNAPSHOT_ALIGNMENT      4096
+
+enum SectionType {
+    Section_CPU = 1,
+    Section_IORegs,
+    Section_SRAM,
+    Section_NVMData,
+    Section_NVMTags,
+    Section_Peripheral,
+    Section_Timers,
+};
+
+enum NVMSectionFlags {
+    NVMSection_Data = 0x01,
+    NVMSection_Tags = 0x02,
+};
+
+struct snapshot_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t section_count;
+    uint64_t model_hash;
+    uint64_t firmware_hash;
+    int64_t cycle;
+    uint32_t state;
+    uint32_t unsaved_timers;
+};
+
+struct snapshot_section_t {
+    uint32_t type;
+    uint32_t index;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct snapshot_cpu_t {
+    uint8_t regs[32];
+    uint8_t sreg;
+    uint8_t reserved[3];
+    uint32_t pc;
+    uint32_t int_inhib_counter;
+};
+
+struct snapshot_timer_t {
+    uint32_t id;
+    uint32_t index;
+    int64_t when;
+    uint32_t paused;
+    uint32_t reserved;
+};
+
+static bool valid_device_state(uint32_t state)
+{
+    switch (state) {
+        case Device::State_Limbo:
+        case Device::State_Ready:
+        case Device::State_Running:
+        case Device::State_Sleeping:
+        case Device::State_Halted:
+        case Device::State_Reset:
+        case Device::State_Break:
+        case Device::State_Done:
+        case Device::State_Crashed:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint64_t align_offset(uint64_t ofs)
+{
+    return (ofs + SNAPSHOT_ALIGNMENT - 1) & ~((uint64_t) SNAPSHOT_ALIGNMENT - 1);
+}
+
+static bool write_buffer(FILE* f, uint64_t offset, const SharedPageBuffer& buf)
+{
+    if (fseek(f, offset, SEEK_SET)) return false;
+    for (size_t i = 0; i < buf.page_count(); ++i) {
+        size_t n = std::min(SharedPageBuffer::PageSize, buf.size() - i * SharedPageBuffer::PageSize);
+        if (fwrite(buf.page(i), 1, n, f) != n)
+            return false;
+    }
+    return true;
+}
+
+/**
+   Save the snapshot to a file.
+   \param filename path of the file to write
+   \param firmware optional firmware, whose hash is recorded in the file. If not provided,
+   the hash stored in the snapshot (if loaded from a file) is used.
+   \return true if the file was written successfully
+ */
+bool DeviceSnapshot::save(const std::string& filename, const Firmware* firmware) const
+{
+    if (!m_valid) return false;
+
+    struct section_src_t {
+        snapshot_section_t desc;
+        const SharedPageBuffer* pages;
+        const void* data;
+    };
+
+    snapshot_cpu_t cpu = {};
+    memcpy(cpu.regs, m_regs, 32);
+    cpu.sreg = m_sreg;
+    cpu.pc = m_pc;
+    cpu.int_inhib_counter = m_int_inhib_counter;
+
+    std::vector<section_src_t> sections;
+    sections.push_back({ { Section_CPU, 0, 0, sizeof(cpu) }, nullptr, &cpu });
+    sections.push_back({ { Section_IORegs, 0, 0, m_ioregs.size() }, &m_ioregs, nullptr });
+    sections.push_back({ { Section_SRAM, 0, 0, m_sram.size() }, &m_sram, nullptr });
+    for (size_t i = 0; i < m_nvms.size(); ++i) {
+        uint32_t index = i;
+        sections.push_back({ { Section_NVMData, index, 0, m_nvms[i].data.size() }, &m_nvms[i].data, nullptr });
+        sections.push_back({ { Section_NVMTags, index, 0, m_nvms[i].tags.size() }, &m_nvms[i].tags, nullptr });
+    }
+    for (auto& ps : m_peripherals)
+        sections.push_back({ { Section_Peripheral, (uint32_t) ps.id, 0, ps.data.size() }, nullptr, ps.data.data() });
+
+    std::vector<snapshot_timer_t> timers;
+    for (auto& ts : m_timers)
+        timers.push_back({ (uint32_t) ts.id, ts.index, ts.when, ts.paused, 0 });
+    sections.push_back({ { Section_Timers, 0, 0, timers.size() * sizeof(snapshot_timer_t) }, nullptr, timers.data() });
+
+    uint64_t offset = align_offset(sizeof(snapshot_header_t) + sections.size() * sizeof(snapshot_section_t));
+    for (auto& sec : sections) {
+        sec.desc.offset = offset;
+        offset = align_offset(offset + sec.desc.size);
+    }
+
+    snapshot_header_t header = {};
+    memcpy(header.magic, SNAPSHOT_MAGIC, 8);
+    header.version = FormatVersion;
+    header.section_count = sections.size();
+    header.model_hash = m_model_hash;
+    header.firmware_hash = firmware ? compute_firmware_hash(*firmware) : m_firmware_hash;
+    header.cycle = m_cycle;
+    header.state = m_state;
+    header.unsaved_timers = m_unsaved_timers;
+
+    FILE* f = fopen(filename.c_str(), "wb");
+    if (!f) return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (auto& sec : sections) {
+        if (!ok) break;
+        ok = fwrite(&sec.desc, sizeof(snapshot_section_t), 1, f) == 1;
+    }
+
+    for (auto& sec : sections) {
+        if (!ok) break;
+        if (sec.pages)
+            ok = write_buffer(f, sec.desc.offset, *sec.pages);
+        else if (sec.desc.size)
+            ok = !fseek(f, sec.desc.offset, SEEK_SET) &&
+                 fwrite(sec.data, sec.desc.size, 1, f) == 1;
+    }
+
+    //Pad the file up to the end of the last section
+    if (ok && fseek(f, 0, SEEK_END) == 0 && (uint64_t) ftell(f) < offset) {
+        ok = !fseek(f, offset - 1, SEEK_SET) && fputc(0, f) != EOF;
+    }
+
+    ok &= !fclose(f);
+    return ok;
+}
+
+/**
+   Load the snapshot from a file written by save(). The file is mapped in memory
+   for the time of the loading.
+   \param filename path of the file to read
+   \param firmware optional firmware. If provided, its hash must match the one recorded
+   in the file.
+   \return true if the file was read successfully
+ */
+bool DeviceSnapshot::load(const std::string& filename, const Firmware* firmware)
+{
+    size_t file_size;
+    void* mapping;
+
+#if defined _WIN32
+
+    HANDLE fh = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fs;
+    if (!GetFileSizeEx(fh, &fs) || (uint64_t) fs.QuadPart < sizeof(snapshot_header_t)) {
+        CloseHandle(fh);
+        return false;
+    }
+    file_size = fs.QuadPart;
+
+    HANDLE mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(fh);
+    if (!mh) return false;
+
+    mapping = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, file_size);
+    CloseHandle(mh);
+    if (!mapping) return false;
+
+#else
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) || (uint64_t) st.st_size < sizeof(snapshot_header_t)) {
+        close(fd);
+        return false;
+    }
+    file_size = st.st_size;
+
+    mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+#endif
+
+    bool ok = load_mapping((const uint8_t*) mapping, file_size, firmware);
+
+#if defined _WIN32
+    UnmapViewOfFile(mapping);
+#else
+    munmap(mapping, file_size);
+#endif
+
+    return ok;
+}
+
+/*
+ * Parse the content of a snapshot file mapped in memory. All the sections are
+ * checked to lie within the file before their content is copied.
+ */
+bool DeviceSnapshot::load_mapping(const uint8_t* data, size_t size, const Firmware* firmware)
+{
+    snapshot_header_t header;
+    if (size < sizeof(header)) return false;
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, 8) || header.version != FormatVersion)
+        return false;
+
+    if (firmware && header.firmware_hash != compute_firmware_hash(*firmware))
+        return false;
+
+    if (header.section_count > (size - sizeof(header)) / sizeof(snapshot_section_t))
+        return false;
+
+    std::vector<snapshot_section_t> sections(header.section_count);
+    if (header.section_count)
+        memcpy(sections.data(), data + sizeof(header), header.section_count * sizeof(snapshot_section_t));
+
+    DeviceSnapshot s;
+    bool ok = true;
+    bool has_cpu = false;
+    //NVM sections found for each index, as a combination of NVMSectionFlags
+    std::vector<uint8_t> nvm_sections;
+    for (auto& sec : sections) {
+        ok = sec.offset <= size && sec.size <= size - sec.offset;
+        if (!ok) break;
+
+        const uint8_t* sec_data = data + sec.offset;
+        SharedPageBuffer* pages = nullptr;
+        switch (sec.type) {
+            case Section_CPU: {
+                snapshot_cpu_t cpu;
+                ok = sec.size == sizeof(cpu);
+                if (!ok) break;
+                memcpy(&cpu, sec_data, sizeof(cpu));
+                memcpy(s.m_regs, cpu.regs, 32);
+                s.m_sreg = cpu.sreg;
+                s.m_pc = cpu.pc;
+                s.m_int_inhib_counter = cpu.int_inhib_counter;
+                has_cpu = true;
+            } break;
+
+            case Section_IORegs:
+                s.m_ioregs = SharedPageBuffer(sec.size);
+                pages = &s.m_ioregs;
+                break;
+
+            case Section_SRAM:
+                s.m_sram = SharedPageBuffer(sec.size);
+                pages = &s.m_sram;
+                break;
+
+            case Section_NVMData:
+            case Section_NVMTags: {
+                //An NVM section comes with its pair, the index is bounded by the section count
+                ok = sec.index < header.section_count;
+                if (!ok) break;
+                if (s.m_nvms.size() <= sec.index) {
+                    s.m_nvms.resize(sec.index + 1);
+                    nvm_sections.resize(sec.index + 1, 0);
+                }
+                nvm_image_t& image = s.m_nvms[sec.index];
+                if (sec.type == Section_NVMData) {
+                    image.data = SharedPageBuffer(sec.size, 0xFF);
+                    pages = &image.data;
+                    nvm_sections[sec.index] |= NVMSection_Data;
+                } else {
+                    image.tags = SharedPageBuffer(sec.size, 0x00);
+                    pages = &image.tags;
+                    nvm_sections[sec.index] |= NVMSection_Tags;
+                }
+            } break;
+
+            case Section_Peripheral:
+                s.m_peripherals.push_back({ sec.index, std::vector<uint8_t>(sec_data, sec_data + sec.size) });
+                break;
+
+            case Section_Timers: {
+                ok = !(sec.size % sizeof(snapshot_timer_t));
+                if (!ok) break;
+                s.m_timers.clear();
+                for (size_t i = 0; i < sec.size / sizeof(snapshot_timer_t); ++i) {
+                    snapshot_timer_t t;
+                    memcpy(&t, sec_data + i * sizeof(t), sizeof(t));
+                    s.m_timers.push_back({ t.id, t.index, t.when, !!t.paused });
+                }
+            } break;
+
+            default: //Unknown sections are ignored
+                break;
+        }
+
+        if (!ok) break;
+
+        if (pages)
+            pages->write(sec_data, 0, sec.size);
+    }
+
+    if (!ok || !has_cpu || !valid_device_state(header.state))
+        return false;
+
+    //Every NVM must have both its data and its programmed states, of the same size
+    for (size_t i = 0; i < s.m_nvms.size(); ++i) {
+        if (nvm_sections[i] != (NVMSection_Data | NVMSection_Tags) ||
+            s.m_nvms[i].data.size() != s.m_nvms[i].tags.size())
+            return false;
+    }
+
+    s.m_valid = true;
+    s.m_model_hash = header.model_hash;
+    s.m_firmware_hash = header.firmware_hash;
+    s.m_cycle = header.cycle;
+    s.m_state = (Device::State) header.state;
+    s.m_unsaved_timers = header.unsaved_timers;
+    s.m_loaded = true;
+
+    *this = s;
+    return true;
+}
@@ -0,0 +1,289 @@
+/*
+ * sim_snapshot.h
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#ifndef __YASIMAVR_SNAPSHOT_H__
+#define __YASIMAVR_SNAPSHOT_H__
+
+#include "sim_device.h"
+#include <vector>
+#include <memory>
+
+YASIMAVR_BEGIN_NAMESPACE
+
+class Firmware;
+
+
+//=======================================================================================
+/**
+   \brief Copy-on-write paged memory buffer
+
+   Memory buffer split into fixed-size pages which can be shared between several
+   instances. Copying a SharedPageBuffer only copies the page table, the page contents
+   are shared until one of the copies writes into them, at which point the written
+   page is duplicated.
+ */
+class AVR_CORE_PUBLIC_API SharedPageBuffer {
+
+public:
+
+    ///Size in bytes of a page
+    static const size_t PageSize = 256;
+
+    explicit SharedPageBuffer(size_t size = 0, unsigned char fill = 0x00);
+
+    size_t size() const;
+    size_t page_count() const;
+    size_t shared_page_count(const SharedPageBuffer& other) const;
+
+    size_t read(unsigned char* buf, size_t base, size_t len) const;
+    size_t write(const unsigned char* buf, size_t base, size_t len);
+
+    const unsigned char* page(size_t index) const;
+
+private:
+
+    typedef std::vector<unsigned char> page_t;
+
+    size_t m_size;
+    std::vector<std::shared_ptr<page_t>> m_pages;
+
+};
+
+/**
+   Return the size of the buffer in bytes.
+ */
+inline size_t SharedPageBuffer::size() const
+{
+    return m_size;
+}
+
+/**
+   Return the number of pages in the buffer.
+ */
+inline size_t SharedPageBuffer::page_count() const
+{
+    return m_pages.size();
+}
+
+/**
+   Return a pointer to the content of a page, for read-only access.
+   The last page may be smaller than PageSize.
+ */
+inline const unsigned char* SharedPageBuffer::page(size_t index) const
+{
+    return m_pages[index]->data();
+}
+
+
+//=======================================================================================
+/**
+   \brief Device state snapshot
+
+   Records the state of a device: CPU registers, I/O register file, SRAM,
+   the non-volatile memories, the internal state of the peripherals and
+   the scheduling of their cycle timers, with the device state and cycle count.
+   The memory contents are stored in SharedPageBuffer objects so that copies
+   of a snapshot (obtained with fork()) are cheap and each copy only pays
+   for the pages that differ when it is captured again.
+   Conversely, a restoration compares each page with the device memory and only
+   writes the pages that differ. The device memories have no dirty page tracking,
+   so the comparison still reads all the pages.
+
+   A typical use is to run a device up to a point of interest, capture a snapshot,
+   and restore it before each of a series of short runs, such as
+   fuzzing iterations. Restoring a snapshot sets the cycle counter back to the
+   capture cycle and reschedules the peripheral timers as they were, so that the
+   restored device runs exactly as the captured one would have.
+
+   Snapshots can be saved to a file and loaded back by another process.
+   The file is made of a header, a table of sections and the section contents,
+   each section starting at a 4kB boundary so that the file can be mapped in memory,
+   which is how load() reads it. The sections are checked against the file size
+   before any data is copied.
+   The header contains a hash of the device model, checked when restoring, and
+   optionally a hash of the firmware.
+   Data are stored in the host byte order.
+
+   \note The internal state of a peripheral is only recorded if it implements
+   Peripheral::save_state() and Peripheral::load_state(), and its cycle timers only
+   if declared with Peripheral::add_state_timer(). The other timers scheduled at the
+   time of the capture are counted by unsaved_timer_count() and are left untouched
+   by a restoration.
+   \note A capture is only possible in-between two simulation steps, when no deferred
+   signal is pending in the queue of the cycle manager, and is refused by a peripheral
+   whose current state could not be restored, such as a TWI transfer in progress.
+ */
+class AVR_CORE_PUBLIC_API DeviceSnapshot {
+
+public:
+
+    ///Version of the file format
+    static const uint32_t FormatVersion = 2;
+
+    DeviceSnapshot();
+
+    bool capture(Device& device);
+    bool restore(Device& device) const;
+
+    DeviceSnapshot fork() const;
+
+    bool save(const std::string& filename, const Firmware* firmware = nullptr) const;
+    bool load(const std::string& filename, const Firmware* firmware = nullptr);
+
+    bool valid() const;
+    cycle_count_t cycle() const;
+    Device::State state() const;
+    size_t timer_count() const;
+    size_t unsaved_timer_count() const;
+    uint64_t model_hash() const;
+    uint64_t firmware_hash() const;
+
+    static size_t count_unsaved_timers(Device& device);
+    static uint64_t device_model_hash(Device& device);
+    static uint64_t compute_firmware_hash(const Firmware& firmware);
+
+    size_t page_count() const;
+    size_t shared_page_count(const DeviceSnapshot& other) const;
+
+private:
+
+    struct nvm_image_t {
+        SharedPageBuffer data;
+        SharedPageBuffer tags;
+    };
+
+    struct periph_state_t {
+        ctl_id_t id;
+        std::vector<uint8_t> data;
+    };
+
+    //Scheduling of a peripheral cycle timer, in the order of the cycle manager queue
+    struct timer_state_t {
+        //Id of the owner peripheral
+        ctl_id_t id;
+        //Index of the timer in Peripheral::state_timers()
+        uint32_t index;
+        //Same meaning as CycleManager::timer_slot_t
+        cycle_count_t when;
+        bool paused;
+    };
+
+    bool m_valid;
+    uint64_t m_model_hash;
+    uint64_t m_firmware_hash;
+    Device::State m_state;
+    cycle_count_t m_cycle;
+    uint8_t m_regs[32];
+    uint8_t m_sreg;
+    flash_addr_t m_pc;
+    unsigned int m_int_inhib_counter;
+    SharedPageBuffer m_ioregs;
+    SharedPageBuffer m_sram;
+    std::vector<nvm_image_t> m_nvms;
+    std::vector<periph_state_t> m_peripherals;
+    std::vector<timer_state_t> m_timers;
+    size_t m_unsaved_timers;
+    //True if loaded from a file, the peripheral states may then be rejected
+    bool m_loaded;
+
+    bool apply(Device& device) const;
+    bool load_mapping(const uint8_t* data, size_t size, const Firmware* firmware);
+
+    static std::vector<NonVolatileMemory*> device_nvms(Device& device);
+
+};
+
+/**
+   Return a copy of this snapshot, sharing all its memory pages.
+ */
+inline DeviceSnapshot DeviceSnapshot::fork() const
+{
+    return *this;
+}
+
+/**
+   Return true if the snapshot contains a captured state.
+ */
+inline bool DeviceSnapshot::valid() const
+{
+    return m_valid;
+}
+
+/**
+   Return the device cycle count at the time of the capture.
+ */
+inline cycle_count_t DeviceSnapshot::cycle() const
+{
+    return m_cycle;
+}
+
+/**
+   Return the device state at the time of the capture.
+ */
+inline Device::State DeviceSnapshot::state() const
+{
+    return m_state;
+}
+
+/**
+   Return the number of peripheral cycle timers recorded in the snapshot.
+ */
+inline size_t DeviceSnapshot::timer_count() const
+{
+    return m_timers.size();
+}
+
+/**
+   Return the number of cycle timers that were scheduled at the time of the capture
+   but are not recorded, because they are not declared by any peripheral.
+   A device restored from a snapshot with unsaved timers may not behave exactly as the
+   captured one.
+ */
+inline size_t DeviceSnapshot::unsaved_timer_count() const
+{
+    return m_unsaved_timers;
+}
+
+/**
+   Return the hash of the device model used for the capture.
+   \sa device_model_hash()
+ */
+inline uint64_t DeviceSnapshot::model_hash() const
+{
+    return m_model_hash;
+}
+
+/**
+   Return the hash of the firmware, as stored in the snapshot file, or zero
+   if not available.
+   \sa compute_firmware_hash()
+ */
+inline uint64_t DeviceSnapshot::firmware_hash() const
+{
+    return m_firmware_hash;
+}
+
+
+YASIMAVR_END_NAMESPACE
+
+#endif //__YASIMAVR_SNAPSHOT_H__
@@ -0,0 +1,171 @@
+/*
+ * sim_state.h
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#ifndef __YASIMAVR_STATE_H__
+#define __YASIMAVR_STATE_H__
+
+#include "sim_globals.h"
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+YASIMAVR_BEGIN_NAMESPACE
+
+
+//=======================================================================================
+/**
+   \brief Writer for the internal state of a peripheral
+
+   Helper to append plain values to the buffer passed to Peripheral::save_state().
+   Values are stored in the host byte order, without any padding.
+   \sa StateReader
+ */
+class StateWriter {
+
+public:
+
+    explicit StateWriter(std::vector<uint8_t>& buf);
+
+    void write(const void* data, size_t len);
+
+    template<typename T>
+    void write(const T& value);
+
+private:
+
+    std::vector<uint8_t>& m_buf;
+
+};
+
+inline StateWriter::StateWriter(std::vector<uint8_t>& buf)
+:m_buf(buf)
+{}
+
+/**
+   Append raw data to the state buffer.
+ */
+inline void StateWriter::write(const void* data, size_t len)
+{
+    const uint8_t* p = (const uint8_t*) data;
+    m_buf.insert(m_buf.end(), p, p + len);
+}
+
+/**
+   Append a value to the state buffer.
+ */
+template<typename T>
+inline void StateWriter::write(const T& value)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "State values must be trivially copyable");
+    write(&value, sizeof(T));
+}
+
+
+//=======================================================================================
+/**
+   \brief Reader for the internal state of a peripheral
+
+   Helper to read back, in Peripheral::load_state(), the values written by a StateWriter
+   in the same order. Reading past the end of the data fails and leaves
+   the destination unchanged; the failure is sticky so that the status can be checked
+   once, at the end, with complete().
+   \sa StateWriter
+ */
+class StateReader {
+
+public:
+
+    StateReader(const uint8_t* data, size_t len);
+
+    bool read(void* data, size_t len);
+
+    template<typename T>
+    bool read(T& value);
+
+    bool ok() const;
+    bool complete() const;
+
+private:
+
+    const uint8_t* m_data;
+    size_t m_len;
+    size_t m_pos;
+    bool m_ok;
+
+};
+
+inline StateReader::StateReader(const uint8_t* data, size_t len)
+:m_data(data)
+,m_len(data ? len : 0)
+,m_pos(0)
+,m_ok(true)
+{}
+
+/**
+   Read raw data from the state buffer.
+   \return true if the data was read successfully
+ */
+inline bool StateReader::read(void* data, size_t len)
+{
+    if (!m_ok || len > m_len - m_pos) {
+        m_ok = false;
+        return false;
+    }
+
+    memcpy(data, m_data + m_pos, len);
+    m_pos += len;
+    return true;
+}
+
+/**
+   Read a value from the state buffer.
+   \return true if the value was read successfully
+ */
+template<typename T>
+inline bool StateReader::read(T& value)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "State values must be trivially copyable");
+    return read(&value, sizeof(T));
+}
+
+/**
+   Return true if all the reads so far have succeeded.
+ */
+inline bool StateReader::ok() const
+{
+    return m_ok;
+}
+
+/**
+   Return true if all the reads have succeeded and the whole buffer has been read.
+ */
+inline bool StateReader::complete() const
+{
+    return m_ok && m_pos == m_len;
+}
+
+
+YASIMAVR_END_NAMESPACE
+
+#endif //__YASIMAVR_STATE_H__
@@ -23,6 +23,7 @@
 
 #include "sim_port.h"
 #include "../core/sim_device.h"
+#include "../core/sim_cycle_timer.h"
 
 YASIMAVR_USING_NAMESPACE
 
@@ -39,9 +40,24 @@ Port::Port(char name)
 ,m_pinmask(0)
 ,m_pins(8)
 ,m_port_value(0)
+,m_gpio_dir(0)
+,m_gpio_value(0)
+,m_gpio_pullup(0)
+,m_gpio_custom(0)
+,m_batch(false)
+,m_batch_changed(false)
 {}
 
 
+Port::~Port()
+{
+    for (Pin* pin : m_pins) {
+        if (pin && pin->m_port == this)
+            pin->m_port = nullptr;
+    }
+}
+
+
 bool Port::init(Device& device)
 {
     bool status = Peripheral::init(device);
@@ -50,11 +66,20 @@ bool Port::init(Device& device)
     //Pcx where c is the port letter and x is 0 to 7
     char pinname[4];
     m_pinmask = 0;
+
+    //Defer the signals of the port and its pins if enabled by the device
+    SignalQueue* queue = nullptr;
+    if (device.test_option(Device::Option_DeferPinSignals) && device.cycle_manager())
+        queue = &device.cycle_manager()->signal_queue();
+    m_signal.set_deferred(queue);
+
     for (int i = 0; i < 8; ++i) {
         std::sprintf(pinname, "P%c%d", m_name, i);
         Pin *pin = device.find_pin(pinname);
         if (pin) {
-            pin->signal().connect(*this, i);
+            pin->m_port = this;
+            pin->m_port_num = i;
+            pin->signal().set_deferred(queue);
             m_pinmask |= (1 << i);
         }
         m_pins[i] = pin;
@@ -67,12 +92,8 @@ bool Port::init(Device& device)
 void Port::reset()
 {
     //On reset, we set the internal state of all the pins to floating
-    uint8_t pinmask = m_pinmask;
-    for (int i = 0; i < 8; ++i) {
-        if (pinmask & 1)
-            m_pins[i]->set_gpio_state(Pin::State_Floating);
-        pinmask >>= 1;
-    }
+    m_gpio_custom = m_pinmask;
+    set_pin_internal_states(0x00, 0x00, 0x00);
 
     m_port_value = 0;
     m_signal.raise(0, m_port_value);
@@ -89,6 +110,36 @@ bool Port::ctlreq(ctlreq_id_t req, ctlreq_data_t* data)
 }
 
 
+bool Port::save_state(std::vector<uint8_t>& state) const
+{
+    //Internal state applied to each existing pin
+    for (Pin* pin : m_pins) {
+        if (pin)
+            state.push_back(pin->m_gpio_state.state);
+    }
+    return true;
+}
+
+
+bool Port::load_state(const uint8_t* state, size_t len)
+{
+    size_t n = 0;
+    for (Pin* pin : m_pins) {
+        if (pin) ++n;
+    }
+    if (len != n)
+        return false;
+
+    const uint8_t* p = state;
+    for (int i = 0; i < 8; ++i) {
+        if (m_pins[i])
+            set_pin_internal_state(i, (Pin::State) *(p++));
+    }
+
+    return true;
+}
+
+
 /**
    Set the pin internal state and raise the signal.
    \param num index of the pin (0 to 7)
@@ -99,24 +150,88 @@ void Port::set_pin_internal_state(uint8_t num, Pin::State state)
 {
     if (num < 8 && ((m_pinmask >> num) & 1)) {
         logger().dbg("Pin %d set to %s", num, Pin::StateName(state));
+
+        //Keep the bitmasks consistent with the state applied to the pin
+        uint8_t bit = 1 << num;
+        m_gpio_dir &= ~bit;
+        m_gpio_value &= ~bit;
+        m_gpio_pullup &= ~bit;
+        m_gpio_custom &= ~bit;
+        switch (state) {
+            case Pin::State_High: m_gpio_dir |= bit; m_gpio_value |= bit; break;
+            case Pin::State_Low: m_gpio_dir |= bit; break;
+            case Pin::State_PullUp: m_gpio_pullup |= bit; break;
+            case Pin::State_Floating: break;
+            default: m_gpio_custom |= bit;
+        }
+
         m_pins[num]->set_gpio_state(state);
     }
 }
 
 
-void Port::raised(const signal_data_t& sigdata, int hooktag)
+/**
+   Set the internal state of several pins at once, as resulting from the port registers.
+   For each pin selected by the mask, the state is High or Low if the pin is driven,
+   or else PullUp or Floating.
+   Only the pins whose state actually changes are updated and the port signal
+   is raised at most once for the whole update.
+   \param dir bitmask of the driven pins
+   \param value bitmask of the driven values
+   \param pullup bitmask of the pull-ups enabled on the pins not driven
+   \param mask bitmask of the pins to update
+   \sa set_pin_internal_state, pin_state_changed
+ */
+void Port::set_pin_internal_states(uint8_t dir, uint8_t value, uint8_t pullup, uint8_t mask)
 {
-    if (sigdata.sigid == Pin::Signal_StateChange) {
-        Pin::State pin_state = (Pin::State) sigdata.data.as_int();
-        uint8_t pin_num = hooktag;
-        pin_state_changed(pin_num, pin_state);
+    mask &= m_pinmask;
+
+    //Canonical form: the value is only relevant for driven pins and the pull-up
+    //only for the others
+    value &= dir;
+    pullup &= ~dir;
+
+    uint8_t changed = ((dir ^ m_gpio_dir) |
+                       (value ^ m_gpio_value) |
+                       (pullup ^ m_gpio_pullup) |
+                       m_gpio_custom) & mask;
+
+    m_gpio_dir = (m_gpio_dir & ~mask) | (dir & mask);
+    m_gpio_value = (m_gpio_value & ~mask) | (value & mask);
+    m_gpio_pullup = (m_gpio_pullup & ~mask) | (pullup & mask);
+    m_gpio_custom &= ~mask;
+
+    if (!changed) return;
+
+    m_batch = true;
+    m_batch_changed = false;
+
+    for (int i = 0; changed; ++i, changed >>= 1) {
+        if (!(changed & 1)) continue;
+
+        uint8_t bit = 1 << i;
+        Pin::State state;
+        if (dir & bit)
+            state = (value & bit) ? Pin::State_High : Pin::State_Low;
+        else
+            state = (pullup & bit) ? Pin::State_PullUp : Pin::State_Floating;
+
+        logger().dbg("Pin %d set to %s", i, Pin::StateName(state));
+        m_pins[i]->set_gpio_state(state);
     }
+
+    m_batch = false;
+
+    if (m_batch_changed)
+        m_signal.raise(0, m_port_value);
 }
 
 
 /**
    Callback method called when the resolved state of a pin has changed.
-   \sa set_pin_internal_state
+   If the change occurs outside of a batch update, the port signal is raised
+   immediately, otherwise it is raised once at the end of the batch.
+   \sa set_pin_internal_state, set_pin_internal_states
  */
 void Port::pin_state_changed(uint8_t num, Pin::State state)
 {
@@ -132,5 +247,8 @@ void Port::pin_state_changed(uint8_t num, Pin::State state)
     else
         m_port_value &= ~(1 << num);
 
-    m_signal.raise(0, m_port_value);
+    if (m_batch)
+        m_batch_changed = true;
+    else
+        m_signal.raise(0, m_port_value);
 }
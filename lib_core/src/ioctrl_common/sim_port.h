@@ -44,37 +44,59 @@ YASIMAVR_BEGIN_NAMESPACE
    CTLREQs supported:
     - AVR_CTLREQ_GET_SIGNAL
 
+   A write to the port registers is expected to be applied with set_pin_internal_states(),
+   which updates all the pins in one pass and raises the port signal once for the whole
+   batch, if any pin state has changed. Only the pins whose internal state actually changes are updated and raise
+   their own signals.
+   If the device option Option_DeferPinSignals is set, the signals of the port and of
+   its pins are deferred to the signal queue of the cycle manager.
+
    Signals :
       Id  |  Index  |  Trigger                          |  Data
       ----|---------|-----------------------------------|-----------------
-      0   | -       |  Digital state change by any pin  |  port IN value
+      0   | -       |  State change by any pin          |  port IN value
  */
-class AVR_CORE_PUBLIC_API Port : public Peripheral, public SignalHook {
+class AVR_CORE_PUBLIC_API Port : public Peripheral {
 
 public:
 
     explicit Port(char name);
+    virtual ~Port();
 
     virtual bool init(Device& device) override;
     virtual void reset() override;
     virtual bool ctlreq(ctlreq_id_t req, ctlreq_data_t* data) override;
-    virtual void raised(const signal_data_t& sigdata, int hooktag) override;
+    virtual bool save_state(std::vector<uint8_t>& state) const override;
+    virtual bool load_state(const uint8_t* state, size_t len) override;
 
 protected:
 
     uint8_t pin_mask() const;
     Pin* pin(uint8_t num) const;
     void set_pin_internal_state(uint8_t num, Pin::State state);
+    void set_pin_internal_states(uint8_t dir, uint8_t value, uint8_t pullup, uint8_t mask = 0xFF);
 
     virtual void pin_state_changed(uint8_t num, Pin::State state);
 
 private:
 
+    friend class Pin;
+
     const char m_name;
     uint8_t m_pinmask;
     Signal m_signal;
     std::vector<Pin*> m_pins;
     uint8_t m_port_value;
+    //Internal states applied to the pins, as bitmasks
+    uint8_t m_gpio_dir;
+    uint8_t m_gpio_value;
+    uint8_t m_gpio_pullup;
+    //Pins set to a state not representable by the bitmasks above
+    uint8_t m_gpio_custom;
+    //True while a batch of pin updates is in progress
+    bool m_batch;
+    //True if a pin state has changed during the batch in progress
+    bool m_batch_changed;
 
 };
 
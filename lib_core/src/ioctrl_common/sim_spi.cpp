@@ -22,6 +22,7 @@
 //=======================================================================================
 
 #include "sim_spi.h"
+#include <algorithm>
 
 YASIMAVR_USING_NAMESPACE
 
@@ -45,6 +46,22 @@ SPIClient::~SPIClient()
         m_host->remove_client(*this);
 }
 
+/**
+   Called by the SPI host to transfer a run of frames in one call.
+   The default implementation calls start_transfer() and end_transfer() for each frame
+   and can be reimplemented by clients able to process a run more efficiently.
+   \param mosi_frames MOSI frames emitted by the host
+   \param miso_frames buffer receiving the MISO frames emitted by the client
+   \param count number of frames of the run
+ */
+void SPIClient::transfer_burst(const uint8_t* mosi_frames, uint8_t* miso_frames, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        miso_frames[i] = start_transfer(mosi_frames[i]);
+        end_transfer(true);
+    }
+}
+
 SPIClient& SPIClient::operator=(const SPIClient& other)
 {
     if (m_host)
@@ -57,17 +74,36 @@ SPIClient& SPIClient::operator=(const SPIClient& other)
 }
 
 
+//=======================================================================================
+
+#define TX_BUFFER_CAPACITY      4
+#define RX_BUFFER_CAPACITY      4
+
+//Push a frame in a ring buffer, doubling its capacity if it is full
+static void push_frame(RingBuffer<uint8_t>& buffer, uint8_t frame)
+{
+    if (buffer.full())
+        buffer.set_capacity(buffer.capacity() * 2);
+    buffer.push_back(frame);
+}
+
+
 SPI::SPI()
 :m_cycle_manager(nullptr)
 ,m_logger(nullptr)
 ,m_delay(1)
+,m_burst(false)
 ,m_is_host(false)
 ,m_tfr_in_progress(false)
 ,m_selected(false)
 ,m_selected_client(nullptr)
 ,m_shift_reg(0)
+,m_tx_buffer(TX_BUFFER_CAPACITY)
 ,m_tx_limit(0)
+,m_rx_buffer(RX_BUFFER_CAPACITY)
 ,m_rx_limit(0)
+,m_run_start(0)
+,m_run_length(0)
 {}
 
 /**
@@ -92,6 +128,7 @@ void SPI::reset()
     m_selected = false;
     m_selected_client = nullptr;
     m_shift_reg = 0;
+    m_run_length = 0;
 
     m_tx_buffer.clear();
 
@@ -145,6 +182,16 @@ void SPI::set_frame_delay(cycle_count_t delay)
     m_delay = delay;
 }
 
+/**
+   Enable or disable the burst mode. (host mode only)
+   It is applied from the next transfer.
+   \note It has no effect on the frames written one at a time by the firmware.
+ */
+void SPI::set_burst_mode(bool enabled)
+{
+    m_burst = enabled;
+}
+
 /**
    Set the TX buffer limit and trim the buffer if necessary.
    \param limit New buffer limit. Zero means unlimited.
@@ -179,10 +226,28 @@ void SPI::push_tx(uint8_t frame)
     if (m_tx_limit > 0 && m_tx_buffer.size() == m_tx_limit)
         return;
 
-    m_tx_buffer.push_back(frame);
+    push_frame(m_tx_buffer, frame);
 
     if (m_is_host && !m_tfr_in_progress)
-        start_transfer_as_host();
+        start_transfer_as_host(m_cycle_manager->cycle());
+}
+
+/**
+   Push a block of 8-bits frames to be emitted by the interface.
+   It is equivalent to pushing the frames one by one, except that, in host mode,
+   all the frames are queued before a transfer starts so that they can be
+   transferred in a single run in burst mode.
+ */
+void SPI::push_tx(const uint8_t* frames, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (m_tx_limit > 0 && m_tx_buffer.size() == m_tx_limit)
+            break;
+        push_frame(m_tx_buffer, frames[i]);
+    }
+
+    if (m_is_host && !m_tfr_in_progress && m_tx_buffer.size())
+        start_transfer_as_host(m_cycle_manager->cycle());
 }
 
 /**
@@ -193,9 +258,11 @@ void SPI::cancel_tx()
     m_tx_buffer.clear();
 
     if (m_is_host && m_tfr_in_progress) {
-        m_signal.raise(Signal_HostTfrComplete, 0);
+        m_signal.raise(Signal_HostTfrComplete, 0, m_burst ? m_run_length : 0);
+        //Remove the frames of the run that are not complete
+        for (size_t n = rx_pending(); n > 0 && m_rx_buffer.size(); --n)
+            m_rx_buffer.pop_back();
         m_tfr_in_progress = false;
-        m_rx_buffer.pop_back();
         m_cycle_manager->cancel(*this);
 
         if (m_selected_client) {
@@ -205,6 +272,32 @@ void SPI::cancel_tx()
     }
 }
 
+/*
+   Number of frames at the back of the RX buffer whose transfer is not complete.
+ */
+size_t SPI::rx_pending() const
+{
+    if (!m_is_host || !m_tfr_in_progress)
+        return 0;
+
+    //Frames of the run completed so far, the last one completes with the timer
+    size_t done = m_delay ? ((m_cycle_manager->cycle() - m_run_start) / m_delay) : m_run_length;
+    if (done >= m_run_length)
+        done = m_run_length - 1;
+
+    return m_run_length - done;
+}
+
+/**
+   Getter for the count of frames in the RX buffer
+ */
+size_t SPI::rx_available() const
+{
+    size_t n = m_rx_buffer.size();
+    size_t p = rx_pending();
+    return (n > p) ? (n - p) : 0;
+}
+
 /**
    Pop a frame from the RX buffer, return 0 if there aren't any.
  */
@@ -220,11 +313,8 @@ uint8_t SPI::pop_rx()
     }
 }
 
-void SPI::start_transfer_as_host()
+void SPI::start_transfer_as_host(cycle_count_t when)
 {
-    uint8_t mosi_frame = m_tx_buffer.front();
-    m_tx_buffer.pop_front();
-
     //Find the selected client
     m_selected_client = nullptr;
     for (SPIClient* client : m_clients) {
@@ -234,29 +324,61 @@ void SPI::start_transfer_as_host()
         }
     }
 
-    //Call the selected client callback, giving it the MOSI frame
-    //and it returns the MISO frame.
-    //If not client is selected, the MISO line is normally pulled up therefore
-    //the acquired frame is read as 0xFF.
-    uint8_t miso_frame;
-    if (m_selected_client)
-        miso_frame = m_selected_client->start_transfer(mosi_frame);
-    else
-        miso_frame = 0xFF;
+    size_t count = m_burst ? m_tx_buffer.size() : 1;
+
+    if (count > 1) {
+        //Burst transfer, all the frames in the TX FIFO are exchanged with the client at once
+        m_burst_mosi.resize(count);
+        m_burst_miso.resize(count);
+        m_tx_buffer.pop(m_burst_mosi.data(), count);
+
+        if (m_selected_client) {
+            m_selected_client->transfer_burst(m_burst_mosi.data(), m_burst_miso.data(), count);
+            m_selected_client = nullptr;
+        } else {
+            std::fill(m_burst_miso.begin(), m_burst_miso.end(), 0xFF);
+        }
+
+        m_logger->dbg("Host burst tfr, %u frames", (unsigned int) count);
+
+        m_signal.raise(Signal_HostTfrStart, (m_burst_mosi[0] << 8) | m_burst_miso[0], count);
 
-    m_logger->dbg("Host tfr MOSI=0x%02x, MISO=0x%02x", mosi_frame, miso_frame);
+        for (uint8_t miso_frame : m_burst_miso)
+            push_frame(m_rx_buffer, miso_frame);
 
-    m_signal.raise(Signal_HostTfrStart, (mosi_frame << 8) | miso_frame);
+    } else {
+        uint8_t mosi_frame = m_tx_buffer.front();
+        m_tx_buffer.pop_front();
+
+        //Call the selected client callback, giving it the MOSI frame
+        //and it returns the MISO frame.
+        //If not client is selected, the MISO line is normally pulled up therefore
+        //the acquired frame is read as 0xFF.
+        uint8_t miso_frame;
+        if (m_selected_client)
+            miso_frame = m_selected_client->start_transfer(mosi_frame);
+        else
+            miso_frame = 0xFF;
+
+        m_logger->dbg("Host tfr MOSI=0x%02x, MISO=0x%02x", mosi_frame, miso_frame);
+
+        m_signal.raise(Signal_HostTfrStart, (mosi_frame << 8) | miso_frame, m_burst ? 1 : 0);
 
-    //Add the MISO frame to the RX buffer and trim it to the limit
-    m_rx_buffer.push_back(miso_frame);
+        //Add the MISO frame to the RX buffer
+        push_frame(m_rx_buffer, miso_frame);
+    }
+
+    //Trim the RX buffer to the limit
     while (m_rx_limit > 0 && m_rx_buffer.size() > m_rx_limit)
         m_rx_buffer.pop_front();
 
+    m_run_start = when;
+    m_run_length = count;
+
     //If this is the first transfer, we need to start the timer
     if (!m_tfr_in_progress) {
         m_tfr_in_progress = true;
-        m_cycle_manager->delay(*this, m_delay);
+        m_cycle_manager->delay(*this, m_delay * count);
     }
 }
 
@@ -269,19 +391,94 @@ cycle_count_t SPI::next(cycle_count_t when)
         m_selected_client = nullptr;
     }
 
-    m_signal.raise(Signal_HostTfrComplete, 1);
+    m_signal.raise(Signal_HostTfrComplete, 1, m_burst ? m_run_length : 0);
 
     //Is there another frame to send ? if so, restart a transfer and reschedule
     //the timer
     if (m_tx_buffer.size()) {
-        start_transfer_as_host();
-        return when + m_delay;
+        start_transfer_as_host(when);
+        return when + m_delay * m_run_length;
     } else {
         m_tfr_in_progress = false;
         return 0;
     }
 }
 
+static void save_frames(StateWriter& writer, const RingBuffer<uint8_t>& buffer)
+{
+    writer.write((uint32_t) buffer.size());
+    for (size_t i = 0; i < buffer.size(); ++i)
+        writer.write(buffer[i]);
+}
+
+static void load_frames(StateReader& reader, RingBuffer<uint8_t>& buffer)
+{
+    buffer.clear();
+    uint32_t n = 0;
+    reader.read(n);
+    for (uint32_t i = 0; i < n && reader.ok(); ++i) {
+        uint8_t frame;
+        if (reader.read(frame))
+            push_frame(buffer, frame);
+    }
+}
+
+/**
+   Save the state of the interface, including the frames in the buffers, for a
+   device snapshot. The client selected for the current host transfer is recorded
+   by its index, the state of the client itself is not included, nor the scheduling
+   of the interface.
+ */
+void SPI::save_state(StateWriter& writer) const
+{
+    int32_t client_index = -1;
+    for (size_t i = 0; i < m_clients.size(); ++i) {
+        if (m_clients[i] == m_selected_client)
+            client_index = i;
+    }
+
+    writer.write(m_delay);
+    writer.write(m_burst);
+    writer.write(m_is_host);
+    writer.write(m_tfr_in_progress);
+    writer.write(m_selected);
+    writer.write(client_index);
+    writer.write(m_shift_reg);
+    save_frames(writer, m_tx_buffer);
+    save_frames(writer, m_rx_buffer);
+    writer.write(m_run_start);
+    writer.write((uint64_t) m_run_length);
+}
+
+/**
+   Load the state saved by save_state(). No signal is raised and the interface is
+   not rescheduled.
+ */
+void SPI::load_state(StateReader& reader)
+{
+    int32_t client_index = -1;
+    uint64_t run_length = 0;
+
+    reader.read(m_delay);
+    reader.read(m_burst);
+    reader.read(m_is_host);
+    reader.read(m_tfr_in_progress);
+    reader.read(m_selected);
+    reader.read(client_index);
+    reader.read(m_shift_reg);
+    load_frames(reader, m_tx_buffer);
+    load_frames(reader, m_rx_buffer);
+    reader.read(m_run_start);
+    reader.read(run_length);
+
+    m_run_length = run_length;
+    if (client_index >= 0 && (size_t) client_index < m_clients.size())
+        m_selected_client = m_clients[client_index];
+    else
+        m_selected_client = nullptr;
+}
+
+
 //=======================================================================================
 /*
  * Implementation of the SPI client interface
@@ -327,7 +524,7 @@ void SPI::end_transfer(bool ok)
     if (ok) {
         //Push the MOSI frame into the RX buffer and remove old frames if the size limit
         //is reached
-        m_rx_buffer.push_back(m_shift_reg);
+        push_frame(m_rx_buffer, m_shift_reg);
         while (m_rx_limit > 0 && m_rx_buffer.size() > m_rx_limit)
             m_rx_buffer.pop_front();
     }
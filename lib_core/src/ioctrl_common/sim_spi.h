@@ -27,7 +27,8 @@
 #include "../core/sim_types.h"
 #include "../core/sim_device.h"
 #include "../core/sim_signal.h"
-#include <deque>
+#include "../core/sim_ringbuffer.h"
+#include "../core/sim_state.h"
 #include <vector>
 
 YASIMAVR_BEGIN_NAMESPACE
@@ -99,6 +100,8 @@ public:
      */
     virtual void end_transfer(bool ok) = 0;
 
+    virtual void transfer_burst(const uint8_t* mosi_frames, uint8_t* miso_frames, size_t count);
+
     SPIClient& operator=(const SPIClient& other);
 
 private:
@@ -118,6 +121,17 @@ private:
 
     The class is composed of two FIFOs, one for TX, the other for RX.
     The transfer of a frame starts immediately after pushing it in the TX FIFO.
+
+    In burst mode (host only), the frames queued in the TX FIFO when a transfer starts
+    are exchanged with the selected client in a single call, as a run of frames.
+    The timer is scheduled once for the whole run, which lasts the frame delay times the
+    number of frames, and the MISO frames are counted as available in the RX FIFO at the
+    end of their respective frame time. The transfer signals are raised once per run.
+    This mode is meant for upper layers that do not need to be notified of each frame.
+    It does not speed up the transfers driven by a firmware through the data register:
+    the firmware writes the next frame only after the previous one has completed, so
+    each run contains a single frame. Only the frames queued together, for instance
+    with a block push_tx(), are transferred as one run.
  */
 class AVR_CORE_PUBLIC_API SPI : public SPIClient, public CycleTimer {
 
@@ -144,6 +158,9 @@ public:
 
     void set_frame_delay(cycle_count_t delay);
 
+    void set_burst_mode(bool enabled);
+    bool burst_mode() const;
+
     void add_client(SPIClient& client);
 
     void remove_client(SPIClient& client);
@@ -153,6 +170,7 @@ public:
     void set_tx_buffer_limit(size_t limit);
 
     void push_tx(uint8_t frame);
+    void push_tx(const uint8_t* frames, size_t count);
 
     void cancel_tx();
 
@@ -166,6 +184,9 @@ public:
 
     uint8_t pop_rx();
 
+    void save_state(StateWriter& writer) const;
+    void load_state(StateReader& reader);
+
     //Reimplementation of CycleTimer interface
     virtual cycle_count_t next(cycle_count_t when) override;
 
@@ -179,6 +200,7 @@ private:
     CycleManager* m_cycle_manager;
     Logger* m_logger;
     cycle_count_t m_delay;
+    bool m_burst;
     bool m_is_host;
     bool m_tfr_in_progress;
     bool m_selected;
@@ -187,15 +209,23 @@ private:
 
     uint8_t m_shift_reg;
 
-    std::deque<uint8_t> m_tx_buffer;
+    RingBuffer<uint8_t> m_tx_buffer;
     size_t m_tx_limit;
 
-    std::deque<uint8_t> m_rx_buffer;
+    RingBuffer<uint8_t> m_rx_buffer;
     size_t m_rx_limit;
 
+    //Start cycle and number of frames of the current host transfer
+    cycle_count_t m_run_start;
+    size_t m_run_length;
+    //Scratch buffers for the burst transfers
+    std::vector<uint8_t> m_burst_mosi;
+    std::vector<uint8_t> m_burst_miso;
+
     Signal m_signal;
 
-    void start_transfer_as_host();
+    void start_transfer_as_host(cycle_count_t when);
+    size_t rx_pending() const;
 
 };
 
@@ -210,12 +240,10 @@ inline bool SPI::is_host_mode() const
     return m_is_host;
 }
 
-/// Getter for the count of frames in the RX buffer
-inline size_t SPI::rx_available() const
+/// Getter for the burst mode setting
+inline bool SPI::burst_mode() const
 {
-    size_t n = m_rx_buffer.size();
-    if (m_tfr_in_progress) --n;
-    return n;
+    return m_burst;
 }
 
 /// Getter indicating if a transfer is in progress
@@ -38,6 +38,7 @@ PrescaledTimer::PrescaledTimer()
 ,m_paused(false)
 ,m_updating(false)
 ,m_update_cycle(0)
+,m_tick_cycle(0)
 ,m_parent_timer(nullptr)
 {}
 
@@ -164,6 +165,22 @@ void PrescaledTimer::update(cycle_count_t when)
     m_updating = false;
 }
 
+/**
+   Return the cycle number of the last prescaler tick. During the raise of the signals,
+   it is the cycle of the last tick carried by the event. Otherwise, it is obtained from
+   the state of the prescaler at the last update.
+   \note Only valid for a timer that is not chained to a parent timer.
+ */
+cycle_count_t PrescaledTimer::last_tick_cycle() const
+{
+    if (m_updating)
+        return m_tick_cycle;
+    else if (m_ps_factor)
+        return m_update_cycle - (m_ps_counter % m_ps_factor);
+    else
+        return m_update_cycle;
+}
+
 void PrescaledTimer::update_timer(cycle_count_t when)
 {
     //Number of clock cycles since the last update
@@ -189,6 +206,7 @@ void PrescaledTimer::process_cycles(cycle_count_t cycles)
     //We loop by consuming the clock cycles we're catching up with and which generated the ticks
     //We exit the loop once there are not enough clock cycles to generate any tick, or we've
     //been disabled in the signal hook
+    cycle_count_t elapsed = 0;
     while (m_ps_factor && !m_paused) {
         //Calculate the nb of prescaler ticks that occurred in the update interval
         cycle_count_t ticks = (cycles + m_ps_counter % m_ps_factor) / m_ps_factor;
@@ -211,6 +229,7 @@ void PrescaledTimer::process_cycles(cycle_count_t cycles)
         //limiting it to the timeout delay, so that we can loop with the remaining amount
         cycle_count_t ticks_dt = (timeout ? m_delay : ticks) * m_ps_factor;
         cycles -= ticks_dt;
+        elapsed += ticks_dt;
 
         //Update the prescaler counter accordingly
         m_ps_counter = (ticks_dt + m_ps_counter) % m_ps_max;
@@ -219,18 +238,20 @@ void PrescaledTimer::process_cycles(cycle_count_t cycles)
 
         //Raise the signal to inform the parent peripheral of ticks to consume
         //Decrement the delay by the number of ticks
-        signal_data_t sigdata = { .sigid = 0 };
+        tick_event_t event;
         if (timeout) {
             m_logger->dbg("Prescaled timer generating %lld ticks, delay=%lld", ticks, m_delay);
-            sigdata.index = 1;
-            sigdata.data = m_delay;
+            event = { m_delay, true };
             m_delay = 0;
         } else {
-            sigdata.index = 0;
-            sigdata.data = ticks;
+            event = { ticks, false };
             m_delay -= ticks;
         }
-        m_signal.raise(sigdata);
+
+        m_tick_cycle = m_update_cycle + elapsed - (m_ps_counter % m_ps_factor);
+        m_tick_signal.raise(event);
+        if (m_signal.connected())
+            m_signal.raise(0, event.ticks, event.timeout ? 1 : 0);
 
     }
 }
@@ -292,6 +313,33 @@ cycle_count_t PrescaledTimer::next(cycle_count_t when)
     return calculate_when(when);
 }
 
+/**
+   Save the state of the prescaler and timer stages, for a device snapshot.
+   The scheduling of the timer is not included.
+ */
+void PrescaledTimer::save_state(StateWriter& writer) const
+{
+    writer.write(m_ps_max);
+    writer.write(m_ps_factor);
+    writer.write(m_ps_counter);
+    writer.write(m_delay);
+    writer.write(m_paused);
+    writer.write(m_update_cycle);
+}
+
+/**
+   Load the state saved by save_state(). The timer is not rescheduled.
+ */
+void PrescaledTimer::load_state(StateReader& reader)
+{
+    reader.read(m_ps_max);
+    reader.read(m_ps_factor);
+    reader.read(m_ps_counter);
+    reader.read(m_delay);
+    reader.read(m_paused);
+    reader.read(m_update_cycle);
+}
+
 /**
    Add a timer in the chain.
    \param timer will be added as a child to this timer.
@@ -339,27 +387,6 @@ cycle_count_t PrescaledTimer::ticks_to_event(cycle_count_t counter, cycle_count_
 
 //=======================================================================================
 
-/*
- * Implementation of a SignalHook for external clocking. It just forwards to the main class.
- */
-class TimerCounter::TimerHook : public SignalHook {
-
-public:
-
-    TimerHook(TimerCounter& timer) : m_timer(timer) {}
-
-    virtual void raised(const signal_data_t& sigdata, int) override
-    {
-        m_timer.timer_raised(sigdata);
-    }
-
-private:
-
-    TimerCounter& m_timer;
-
-};
-
-
 /*
  * Implementation of a SignalHook for external clocking. It just forwards to the main class.
  */
@@ -381,6 +408,17 @@ private:
 };
 
 
+//Delay in ticks to wake up the counter when none of the events is observed.
+//It is long enough to make the wake-ups negligible while avoiding any overflow
+//of the conversion to clock cycles.
+static const long MAX_WAKEUP_DELAY = 0x40000000L;
+
+//Combination of all the event types, excluding Compare
+static const uint8_t ALL_EVENTS = TimerCounter::Event_Max |
+                                  TimerCounter::Event_Top |
+                                  TimerCounter::Event_Bottom;
+
+
 /**
    Constructor
    \param wrap Wrapping value for the counter. For example, a 16-bits counter wrap is 0x10000.
@@ -396,18 +434,19 @@ TimerCounter::TimerCounter(PrescaledTimer& timer, long wrap, size_t comp_count)
 ,m_cmp(comp_count)
 ,m_timer(timer)
 ,m_next_event_type(0)
+,m_observed(ALL_EVENTS)
+,m_config_version(0)
 ,m_logger(nullptr)
 {
-    m_timer_hook = new TimerHook(*this);
     m_ext_hook = new ExtTickHook(*this);
 
-    m_timer.signal().connect(*m_timer_hook);
+    m_timer.tick_signal().connect<TimerCounter, &TimerCounter::timer_raised>(*this);
 }
 
 
 TimerCounter::~TimerCounter()
 {
-    delete m_timer_hook;
+    m_timer.tick_signal().disconnect(this);
     delete m_ext_hook;
 }
 
@@ -422,7 +461,7 @@ void TimerCounter::set_logger(Logger* logger)
 
 
 /**
-   Reset the counter
+   Reset the counter. All the events are observed after a reset.
  */
 void TimerCounter::reset()
 {
@@ -431,11 +470,15 @@ void TimerCounter::reset()
     m_counter = 0;
     m_countdown = false;
     m_top = m_wrap - 1;
+    m_observed = ALL_EVENTS;
 
     for (auto& comp : m_cmp) {
         comp.value = 0;
         comp.enabled = false;
+        comp.observed = true;
     }
+
+    ++m_config_version;
 }
 
 
@@ -445,17 +488,66 @@ void TimerCounter::reset()
 void TimerCounter::reschedule()
 {
     if (m_source == Tick_Timer)
-        m_timer.set_timer_delay(delay_to_event());
+        m_timer.set_timer_delay(delay_to_wakeup());
     else
         m_timer.set_timer_delay(0);
 }
 
 
+/**
+   Save the state and configuration of the counter, for a device snapshot.
+ */
+void TimerCounter::save_state(StateWriter& writer) const
+{
+    writer.write(m_source);
+    writer.write(m_counter);
+    writer.write(m_top);
+    writer.write(m_slope);
+    writer.write(m_countdown);
+    writer.write(m_next_event_type);
+    writer.write(m_observed);
+    for (auto& comp : m_cmp)
+        writer.write(comp);
+}
+
+/**
+   Load the state saved by save_state(). The prescaled timer is not rescheduled.
+ */
+void TimerCounter::load_state(StateReader& reader)
+{
+    reader.read(m_source);
+    reader.read(m_counter);
+    reader.read(m_top);
+    reader.read(m_slope);
+    reader.read(m_countdown);
+    reader.read(m_next_event_type);
+    reader.read(m_observed);
+    for (auto& comp : m_cmp)
+        reader.read(comp);
+
+    ++m_config_version;
+}
+
+
+/*
+ * Process the ticks elapsed since the last update of the timer, with the current
+ * configuration. It is a no-op when called from the processing of the ticks.
+ */
+void TimerCounter::catch_up()
+{
+    if (m_source == Tick_Timer)
+        m_timer.update();
+
+    ++m_config_version;
+}
+
+
 /**
    Change the tick source
  */
 void TimerCounter::set_tick_source(TickSource src)
 {
+    catch_up();
     m_source = src;
 }
 
@@ -465,6 +557,7 @@ void TimerCounter::set_tick_source(TickSource src)
  */
 void TimerCounter::set_top(long top)
 {
+    catch_up();
     m_top = top;
 }
 
@@ -474,6 +567,7 @@ void TimerCounter::set_top(long top)
  */
 void TimerCounter::set_slope_mode(SlopeMode mode)
 {
+    catch_up();
     m_slope = mode;
 
     if (mode == Slope_Up)
@@ -488,6 +582,7 @@ void TimerCounter::set_slope_mode(SlopeMode mode)
  */
 void TimerCounter::set_counter(long value)
 {
+    catch_up();
     m_counter = value;
 }
 
@@ -497,6 +592,7 @@ void TimerCounter::set_counter(long value)
  */
 void TimerCounter::set_comp_value(size_t index, long value)
 {
+    catch_up();
     m_cmp[index].value = value;
 }
 
@@ -506,68 +602,105 @@ void TimerCounter::set_comp_value(size_t index, long value)
  */
 void TimerCounter::set_comp_enabled(size_t index, bool enable)
 {
+    catch_up();
     m_cmp[index].enabled = enable;
 }
 
 
-long TimerCounter::ticks_to_event(long event)
+/**
+   Set the event types which require the counter to wake up when they are reached.
+   \param events combination of EventType flags, Event_Compare is ignored
+   \sa set_comp_observed()
+ */
+void TimerCounter::set_observed_events(uint8_t events)
 {
-    if (m_countdown)
-        return PrescaledTimer::ticks_to_event(event, m_counter, m_wrap);
+    catch_up();
+    m_observed = events & ALL_EVENTS;
+}
+
+
+/**
+   Set whether a compare channel requires the counter to wake up when it is reached.
+ */
+void TimerCounter::set_comp_observed(size_t index, bool observed)
+{
+    catch_up();
+    m_cmp[index].observed = observed;
+}
+
+
+long TimerCounter::ticks_to_event(long counter, bool countdown, long event) const
+{
+    if (countdown)
+        return PrescaledTimer::ticks_to_event(event, counter, m_wrap);
     else
-        return PrescaledTimer::ticks_to_event(m_counter, event, m_wrap);
+        return PrescaledTimer::ticks_to_event(counter, event, m_wrap);
 }
 
 
 /*
    Calculates the delay in prescaler ticks and the type of the next timer/counter event
+   from a counter state.
    1st step : calculate the delays in ticks to each possible event, determine the
               smallest of them and store it in 'ticks_to_next_event' to be the returned value.
-   2st step : store in 'm_next_event_type' the combination of flags TimerEventType corresponding
+   2st step : store in 'type' the combination of flags TimerEventType corresponding
               to the event, or combination thereof, reached at 'ticks_to_next_event'.
  */
-long TimerCounter::delay_to_event()
+long TimerCounter::next_event(long counter, bool countdown, uint8_t& type) const
 {
     //Ticks count to reach MAX, i.e. the max value of the counter.
     //Only relevant if counting up
-    long ticks_to_max = m_countdown ? m_wrap : ticks_to_event(m_wrap - 1);
+    long ticks_to_max = countdown ? m_wrap : ticks_to_event(counter, countdown, m_wrap - 1);
     long ticks_to_next_event = ticks_to_max;
 
-    //List of ticks counts to each Output Compare unit
-    std::vector<long> comp_ticks = std::vector<long>(m_cmp.size());
-    for (size_t i = 0; i < m_cmp.size(); ++i) {
-        if (m_cmp[i].enabled) {
-            long t = ticks_to_event(m_cmp[i].value);
-            comp_ticks[i] = t;
-            if (t < ticks_to_next_event)
-                ticks_to_next_event = t;
+    //Ticks counts to each Output Compare unit
+    long ticks_to_comp = ticks_to_next_event + 1;
+    for (auto& comp : m_cmp) {
+        if (comp.enabled) {
+            long t = ticks_to_event(counter, countdown, comp.value);
+            if (t < ticks_to_comp)
+                ticks_to_comp = t;
         }
     }
+    if (ticks_to_comp < ticks_to_next_event)
+        ticks_to_next_event = ticks_to_comp;
 
     //Ticks for the counter to reach TOP.
-    long ticks_to_top = ticks_to_event(m_top);
+    long ticks_to_top = ticks_to_event(counter, countdown, m_top);
     if (ticks_to_top < ticks_to_next_event)
         ticks_to_next_event = ticks_to_top;
 
     //Ticks count to the bottom value
-    long ticks_to_bottom = ticks_to_event(0);
+    long ticks_to_bottom = ticks_to_event(counter, countdown, 0);
     if (ticks_to_bottom < ticks_to_next_event)
         ticks_to_next_event = ticks_to_bottom;
 
     //Compile the flag for the next event
-    m_next_event_type = 0;
+    type = 0;
     if (ticks_to_next_event == ticks_to_max)
-        m_next_event_type |= Event_Max;
+        type |= Event_Max;
     if (ticks_to_next_event == ticks_to_top)
-        m_next_event_type |= Event_Top;
+        type |= Event_Top;
     if (ticks_to_next_event == ticks_to_bottom)
-        m_next_event_type |= Event_Bottom;
+        type |= Event_Bottom;
+    if (ticks_to_next_event == ticks_to_comp)
+        type |= Event_Compare;
 
-    for (size_t i = 0; i < m_cmp.size(); ++i) {
-        bool is_next_event = (m_cmp[i].enabled && ticks_to_next_event == comp_ticks[i]);
-        m_cmp[i].is_next_event = is_next_event;
-        if (is_next_event)
-            m_next_event_type |= Event_Compare;
+    return ticks_to_next_event;
+}
+
+
+/*
+   Calculates the delay in prescaler ticks to the next timer/counter event from the
+   current state and stores its type in 'm_next_event_type' and in the compare units.
+ */
+long TimerCounter::delay_to_event()
+{
+    long ticks_to_next_event = next_event(m_counter, m_countdown, m_next_event_type);
+
+    for (auto& comp : m_cmp) {
+        comp.is_next_event = (m_next_event_type & Event_Compare) && comp.enabled &&
+                             ticks_to_event(m_counter, m_countdown, comp.value) == ticks_to_next_event;
     }
 
     if (m_logger)
@@ -577,16 +710,183 @@ long TimerCounter::delay_to_event()
 }
 
 
+bool TimerCounter::fully_observed() const
+{
+    if (m_observed != ALL_EVENTS)
+        return false;
+
+    for (auto& comp : m_cmp) {
+        if (!comp.observed)
+            return false;
+    }
+
+    return true;
+}
+
+
+/*
+   Calculates the delay in prescaler ticks to the next observed event.
+   The events are stepped through without side effect until one of them is observed,
+   or until the counter is back to a previous state, meaning that no observed event
+   will ever be reached with the current configuration.
+ */
+long TimerCounter::delay_to_wakeup()
+{
+    long delay = delay_to_event();
+    if (fully_observed())
+        return delay;
+
+    long counter = m_counter;
+    bool countdown = m_countdown;
+    uint8_t type = m_next_event_type;
+
+    long ref_counter = 0;
+    bool ref_countdown = false;
+    bool has_ref = false;
+
+    long total = 0;
+    while (true) {
+        if (type & m_observed)
+            return total + delay;
+
+        if (type & Event_Compare) {
+            for (auto& comp : m_cmp) {
+                if (comp.enabled && comp.observed &&
+                    ticks_to_event(counter, countdown, comp.value) == delay)
+                    return total + delay;
+            }
+        }
+
+        total += delay;
+        if (total >= MAX_WAKEUP_DELAY)
+            break;
+
+        step_counter(counter, countdown, delay, type);
+
+        if (!has_ref) {
+            ref_counter = counter;
+            ref_countdown = countdown;
+            has_ref = true;
+        }
+        else if (counter == ref_counter && countdown == ref_countdown) {
+            break;
+        }
+
+        delay = next_event(counter, countdown, type);
+    }
+
+    return MAX_WAKEUP_DELAY;
+}
+
+
+/**
+   List the events that the counter will reach over one period, with the current configuration.
+   The first event of the list is the next one reached from the current state, the
+   list ends with the event preceding its next occurrence.
+   \param events list of events to be filled in
+   \return the period in ticks, or 0 if no event can be reached
+ */
+long TimerCounter::period_events(std::vector<event_t>& events) const
+{
+    events.clear();
+
+    long counter = m_counter;
+    bool countdown = m_countdown;
+    long ref_counter = 0;
+    bool ref_countdown = false;
+    long period = 0;
+
+    //A period cannot contain more than two occurrences, one in each direction,
+    //of each compare value, TOP, BOTTOM and MAX
+    size_t max_count = 2 * (m_cmp.size() + 3) + 1;
+
+    while (events.size() <= max_count) {
+        event_t ev;
+        ev.delay = next_event(counter, countdown, ev.type);
+        ev.countdown = countdown;
+        ev.comp_mask = 0;
+
+        if (ev.type & Event_Compare) {
+            for (size_t i = 0; i < m_cmp.size(); ++i) {
+                if (m_cmp[i].enabled && ticks_to_event(counter, countdown, m_cmp[i].value) == ev.delay)
+                    ev.comp_mask |= 1UL << i;
+            }
+        }
+
+        step_counter(counter, countdown, ev.delay, ev.type);
+
+        if (events.empty()) {
+            ref_counter = counter;
+            ref_countdown = countdown;
+        } else {
+            period += ev.delay;
+            //Back to the state following the first event, the period is complete
+            if (counter == ref_counter && countdown == ref_countdown)
+                return period;
+        }
+
+        events.push_back(ev);
+    }
+
+    events.clear();
+    return 0;
+}
+
+
 /*
    Callback from the internal prescaled timer
    Process the timer ticks, by updating the counter
  */
-void TimerCounter::timer_raised(const signal_data_t& sigdata)
+void TimerCounter::timer_raised(const PrescaledTimer::tick_event_t& event, int)
 {
     if (m_logger)
         m_logger->dbg("Updating counters");
 
-    process_ticks(sigdata.data.as_int(), sigdata.index);
+    process_timer_ticks(event.ticks);
+
+    //Set the timer to the next event
+    if (m_source == Tick_Timer)
+        m_timer.set_timer_delay(delay_to_wakeup());
+}
+
+
+/*
+   Processes the ticks generated by the prescaled timer, with all the events they reach.
+   If the counter goes back to a previous state with the configuration unchanged,
+   the remaining whole periods are skipped as they would generate the same events again.
+ */
+void TimerCounter::process_timer_ticks(long ticks)
+{
+    long ref_counter = 0;
+    bool ref_countdown = false;
+    unsigned long ref_version = 0;
+    long ref_ticks = 0;
+    bool has_ref = false;
+
+    while (ticks && m_source == Tick_Timer) {
+        long delay = delay_to_event();
+        if (ticks < delay) {
+            process_ticks(ticks, false);
+            break;
+        }
+
+        process_ticks(delay, true);
+        ticks -= delay;
+
+        if (!has_ref || m_config_version != ref_version) {
+            ref_counter = m_counter;
+            ref_countdown = m_countdown;
+            ref_version = m_config_version;
+            ref_ticks = ticks;
+            has_ref = true;
+        }
+        else if (m_counter == ref_counter && m_countdown == ref_countdown) {
+            long period = ref_ticks - ticks;
+            ticks %= period;
+            //Avoid detecting the period again
+            ref_version = ~m_config_version;
+        }
+    }
 }
 
 
@@ -620,6 +920,42 @@ void TimerCounter::extclock_raised()
 }
 
 
+/*
+   Advances a counter state by a number of ticks, reaching an event of the given type.
+   It is the side-effect free version of process_ticks().
+ */
+void TimerCounter::step_counter(long& counter, bool& countdown, long ticks, uint8_t type) const
+{
+    if (countdown)
+        counter -= ticks;
+    else
+        counter += ticks;
+
+    if ((type & Event_Max) && !(type & Event_Top))
+        counter = 0;
+
+    if (type & Event_Top) {
+        if (m_slope == Slope_Up || !m_top) {
+            counter = 0;
+        }
+        else if (m_slope == Slope_Double && !countdown) {
+            countdown = true;
+            counter = m_top - 1;
+        }
+    }
+
+    if ((type & Event_Bottom) && m_top) {
+        if (m_slope == Slope_Down) {
+            counter = m_top;
+        }
+        else if (m_slope == Slope_Double && countdown) {
+            countdown = false;
+            counter = 1;
+        }
+    }
+}
+
+
 /*
    Processes the timer clock ticks to update the counter and raise
    the signals for any event reached.
@@ -649,7 +985,7 @@ void TimerCounter::process_ticks(long ticks, bool event_reached)
         for (size_t i = 0; i < m_cmp.size(); ++i) {
             if (m_cmp[i].is_next_event) {
                 if (m_logger)
-                    m_logger->dbg("Triggering Compare Match %u" , i);
+                    m_logger->dbg("Triggering Compare Match %zu" , i);
                 m_signal.raise(Signal_CompMatch, m_next_event_type, i);
             }
         }
@@ -698,8 +1034,4 @@ void TimerCounter::process_ticks(long ticks, bool event_reached)
         m_logger->dbg("Counter value: %ld", m_counter);
 
     m_signal.raise(Signal_Event, m_next_event_type);
-
-    //Set the timer to the next event
-    if (m_source == Tick_Timer)
-        m_timer.set_timer_delay(delay_to_event());
 }
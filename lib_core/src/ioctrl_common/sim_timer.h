@@ -27,6 +27,7 @@
 #include "../core/sim_cycle_timer.h"
 #include "../core/sim_signal.h"
 #include "../core/sim_device.h"
+#include "../core/sim_state.h"
 
 YASIMAVR_BEGIN_NAMESPACE
 
@@ -56,6 +57,9 @@ YASIMAVR_BEGIN_NAMESPACE
    If, during the update, the number of generated ticks is enough to reach the timer delay,
    the signal index is set to 1, otherwise it is set to 0. The signal data field is set to the
    generated tick count.
+   The same event is also raised beforehand through tick_signal(), a typed signal for the
+   internal consumers such as TimerCounter. The regular signal is only raised if
+   a hook is connected to it.
 
    Timers can be daisy-chained, so that the prescaler tick output of a timer feeds into the
    prescaler clock input of another.
@@ -64,6 +68,14 @@ class AVR_CORE_PUBLIC_API PrescaledTimer : public CycleTimer {
 
 public:
 
+    /// Event data of the tick signal
+    struct tick_event_t {
+        /// Number of generated ticks
+        cycle_count_t ticks;
+        /// True if the timer delay is reached
+        bool timeout;
+    };
+
     PrescaledTimer();
     virtual ~PrescaledTimer();
 
@@ -83,9 +95,15 @@ public:
 
     void update(cycle_count_t when = INVALID_CYCLE);
 
+    cycle_count_t last_tick_cycle() const;
+
     virtual cycle_count_t next(cycle_count_t when) override;
 
+    void save_state(StateWriter& writer) const;
+    void load_state(StateReader& reader);
+
     Signal& signal();
+    TypedSignal<tick_event_t>& tick_signal();
 
     void register_chained_timer(PrescaledTimer& timer);
     void unregister_chained_timer(PrescaledTimer& timer);
@@ -113,7 +131,9 @@ private:
     bool m_paused;                      //Boolean indicating if the timer is paused
     bool m_updating;                    //Boolean used to avoid infinite updating reentrance
     cycle_count_t m_update_cycle;       //Cycle number of the last update
+    cycle_count_t m_tick_cycle;         //Cycle number of the last tick generated by the current update
     Signal m_signal;                //Signal raised for processing ticks
+    TypedSignal<tick_event_t> m_tick_signal;
 
     //***** Timer chain management *****
     std::vector<PrescaledTimer*> m_chained_timers;
@@ -147,6 +167,12 @@ inline Signal& PrescaledTimer::signal()
     return m_signal;
 }
 
+/// Getter for the typed signal raised with counter updates
+inline TypedSignal<PrescaledTimer::tick_event_t>& PrescaledTimer::tick_signal()
+{
+    return m_tick_signal;
+}
+
 
 //=======================================================================================
 /**
@@ -159,6 +185,16 @@ inline Signal& PrescaledTimer::signal()
     - Up/down counting and dual slope
     - Arbitrary number of compare channels
     - Signalling on top, bottom, max and compare value
+
+   By default, the counter wakes up on every event to process it. The owner peripheral
+   may restrict the wake-ups to the events that have an observable effect with
+   set_observed_events() and set_comp_observed(), for example an enabled interrupt or
+   an active output. The other events are then processed in closed form, together with
+   the counter value, when the prescaled timer is updated (typically when the counter or
+   the flag registers are read). The signals are still raised for these events but only
+   once for each, whatever the number of counter periods elapsed in-between.
+   The counter configuration must then be changed through the setters only, which
+   catch up with the elapsed ticks before applying the change.
  */
 class AVR_CORE_PUBLIC_API TimerCounter {
 
@@ -210,6 +246,18 @@ public:
         Signal_CompMatch,
     };
 
+    /// Event reached by the counter, as listed by period_events()
+    struct event_t {
+        /// Delay in ticks from the previous event of the list, or from the current state for the first one
+        long delay;
+        /// Combination of EventType flags
+        uint8_t type;
+        /// Counting direction when the event is reached
+        bool countdown;
+        /// Bitset of the compare channels reached by the event
+        unsigned long comp_mask;
+    };
+
     TimerCounter(PrescaledTimer& timer, long wrap, size_t comp_count);
     ~TimerCounter();
 
@@ -236,8 +284,19 @@ public:
     void set_comp_enabled(size_t index, bool enable);
     bool comp_enabled(size_t index) const;
 
+    void set_observed_events(uint8_t events);
+    uint8_t observed_events() const;
+
+    void set_comp_observed(size_t index, bool observed);
+    bool comp_observed(size_t index) const;
+
     bool countdown() const;
 
+    long period_events(std::vector<event_t>& events) const;
+
+    void save_state(StateWriter& writer) const;
+    void load_state(StateReader& reader);
+
     Signal& signal();
     SignalHook& ext_tick_hook();
 
@@ -249,15 +308,13 @@ public:
 
 private:
 
-    class TimerHook;
-    friend class TimerHook;
-
     class ExtTickHook;
     friend class ExtTickHook;
 
     struct CompareUnit {
         long value = 0;
         bool enabled = false;
+        bool observed = true;
         bool is_next_event = false;
     };
 
@@ -279,18 +336,27 @@ private:
     PrescaledTimer& m_timer;
     //Flag variable storing the next event type(s)
     uint8_t m_next_event_type;
+    //Event types (except compare) waking up the counter
+    uint8_t m_observed;
+    //Incremented on each configuration change, used by the period detection
+    unsigned long m_config_version;
     //Signal management
     DataSignal m_signal;
-    TimerHook* m_timer_hook;
     ExtTickHook* m_ext_hook;
     //Logging
     Logger* m_logger;
 
     long delay_to_event();
-    void timer_raised(const signal_data_t& sigdata);
+    long delay_to_wakeup();
+    void timer_raised(const PrescaledTimer::tick_event_t& event, int);
     void extclock_raised();
-    long ticks_to_event(long event);
+    long ticks_to_event(long counter, bool countdown, long event) const;
+    long next_event(long counter, bool countdown, uint8_t& type) const;
+    bool fully_observed() const;
+    void catch_up();
+    void process_timer_ticks(long ticks);
     void process_ticks(long ticks, bool event_reached);
+    void step_counter(long& counter, bool& countdown, long ticks, uint8_t type) const;
 
 };
 
@@ -336,6 +402,18 @@ inline bool TimerCounter::comp_enabled(size_t index) const
     return m_cmp[index].enabled;
 }
 
+/// Getter for the event types waking up the counter
+inline uint8_t TimerCounter::observed_events() const
+{
+    return m_observed;
+}
+
+/// Getter for the wake-up on a compare channel
+inline bool TimerCounter::comp_observed(size_t index) const
+{
+    return m_cmp[index].observed;
+}
+
 /// Getter for the current counting direction
 inline bool TimerCounter::countdown() const
 {
@@ -145,6 +145,74 @@ void TWIEndPoint::end_packet(TWIPacket& packet)
 }
 
 
+//=======================================================================================
+
+TWISlaveModel::TWISlaveModel()
+:m_active(false)
+,m_rw(false)
+{}
+
+void TWISlaveModel::transfer_stop()
+{}
+
+/**
+   Called by a transaction-level master to write a sequence of bytes in one call.
+   The default implementation calls write_byte() for each byte and stops at the first NACK.
+   \return the number of bytes acknowledged
+ */
+size_t TWISlaveModel::write_data(const uint8_t* data, size_t length)
+{
+    for (size_t i = 0; i < length; ++i) {
+        if (!write_byte(data[i]))
+            return i;
+    }
+    return length;
+}
+
+/**
+   Called by a transaction-level master to read a sequence of bytes in one call.
+   The default implementation calls read_byte() for each byte.
+   \return the number of bytes read
+ */
+size_t TWISlaveModel::read_data(uint8_t* data, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+        data[i] = read_byte();
+    return length;
+}
+
+void TWISlaveModel::packet(TWIPacket&)
+{}
+
+void TWISlaveModel::packet_ended(TWIPacket& packet)
+{
+    if (packet.cmd == TWIPacket::Cmd_Address) {
+        m_active = address_match(packet.addr, packet.rw);
+        m_rw = packet.rw;
+        packet.ack = m_active ? TWIPacket::Ack : TWIPacket::Nack;
+        packet.hold = 0;
+    }
+    else if (packet.cmd == TWIPacket::Cmd_DataRequest && m_active) {
+        if (m_rw)
+            packet.data = read_byte();
+        else
+            packet.ack = write_byte(packet.data) ? TWIPacket::Ack : TWIPacket::Nack;
+        packet.hold = 0;
+    }
+}
+
+void TWISlaveModel::bus_acquired()
+{}
+
+void TWISlaveModel::bus_released()
+{
+    if (m_active) {
+        m_active = false;
+        transfer_stop();
+    }
+}
+
+
 //=======================================================================================
 
 TWIBus::TWIBus()
@@ -171,6 +239,10 @@ void TWIBus::add_endpoint(TWIEndPoint& endpoint)
 
         m_endpoints.push_back(&endpoint);
         endpoint.m_bus = this;
+
+        TWISlaveModel* model = dynamic_cast<TWISlaveModel*>(&endpoint);
+        if (model)
+            m_models.push_back(model);
     }
 }
 
@@ -187,7 +259,86 @@ void TWIBus::remove_endpoint(TWIEndPoint& endpoint)
                 break;
             }
         }
+
+        for (auto it = m_models.begin(); it != m_models.end(); ++it) {
+            if (*it == &endpoint) {
+                m_models.erase(it);
+                break;
+            }
+        }
+    }
+}
+
+/**
+   Check if transactions can be performed with the slave models without circulating packets.
+   \param master endpoint acting as master, excluded from the check (may be null)
+   \return true if all the endpoints on the bus, except the master, are slave models.
+ */
+bool TWIBus::transaction_capable(const TWIEndPoint* master) const
+{
+    size_t n = m_endpoints.size();
+    for (auto endpoint : m_endpoints) {
+        if (endpoint == master) {
+            --n;
+            break;
+        }
     }
+    return n == m_models.size();
+}
+
+/**
+   Send an address to all the slave models, for a transaction without packets.
+   Every model is given the address, as they would be by an address packet, and the first
+   one to acknowledge is selected as the active slave.
+   \return the selected model or null if the address is not acknowledged
+ */
+TWISlaveModel* TWIBus::select_model(uint8_t addr, bool rw)
+{
+    TWISlaveModel* selected = nullptr;
+    for (auto model : m_models) {
+        model->m_active = model->address_match(addr, rw);
+        model->m_rw = rw;
+        if (model->m_active && !selected)
+            selected = model;
+    }
+
+    m_slave = selected;
+    return selected;
+}
+
+/**
+   Perform a complete transfer with the slave models in one call, from START to STOP.
+   The transfer is instantaneous, no packet is circulated and no signal is raised.
+   \param addr 7-bits address of the slave
+   \param rw true for a read, false for a write
+   \param data buffer of the data to write or to receive the data read
+   \param length number of bytes to transfer, set on return to the number of bytes
+   acknowledged (for a write) or read
+   \return true if the address was acknowledged, false if it was not or if the transfer
+   cannot be performed because the bus is owned or has endpoints other than slave models.
+ */
+bool TWIBus::transfer(uint8_t addr, bool rw, uint8_t* data, size_t& length)
+{
+    if (m_master || !transaction_capable(nullptr)) {
+        length = 0;
+        return false;
+    }
+
+    TWISlaveModel* model = select_model(addr & 0x7F, rw);
+    if (model) {
+        if (rw)
+            length = model->read_data(data, length);
+        else
+            length = model->write_data(data, length);
+    } else {
+        length = 0;
+    }
+
+    m_slave = nullptr;
+    for (auto m : m_models)
+        m->bus_released();
+
+    return !!model;
 }
 
 bool TWIBus::acquire(TWIEndPoint* endpoint)
@@ -386,6 +537,9 @@ TWI::TWI()
 ,m_tx_data(0)
 ,m_mst_state(State_Disabled)
 ,m_bitdelay(1)
+,m_tlm_mode(false)
+,m_tlm_active(false)
+,m_tlm_slave(nullptr)
 ,m_slv_state(State_Disabled)
 ,m_slv_hold(false)
 {
@@ -421,12 +575,95 @@ void TWI::reset()
 
     m_mst_state = State_Disabled;
     m_bitdelay = 1;
+    m_tlm_active = false;
+    m_tlm_slave = nullptr;
     m_cycle_manager->cancel(*m_timer);
 
     m_slv_state = State_Disabled;
     m_slv_hold = false;
 }
 
+/**
+   Save the state of the interface, for a device snapshot.
+   \return false if a transfer is in progress, the state cannot be saved
+ */
+bool TWI::save_state(StateWriter& writer) const
+{
+    //A transfer in progress cannot be restored by load_state()
+    if ((m_mst_state != State_Disabled && m_mst_state != State_Idle) ||
+        (m_slv_state != State_Disabled && m_slv_state != State_Idle))
+        return false;
+
+    writer.write(m_mst_state);
+    writer.write(m_slv_state);
+    writer.write(m_bitdelay);
+    writer.write(m_tlm_mode);
+    writer.write(m_tx_data);
+    writer.write(m_has_deferred_raise);
+    writer.write(m_deferred_sigdata.sigid);
+    writer.write(m_deferred_sigdata.index);
+    writer.write(m_deferred_sigdata.data.as_uint());
+    return true;
+}
+
+/**
+   Load the state saved by save_state(). Any transfer in progress is ended first,
+   the scheduling of the timer restored by the snapshot is kept.
+   \return false if the saved state cannot be restored because a transfer was in progress
+ */
+bool TWI::load_state(StateReader& reader)
+{
+    State mst_state = State_Disabled, slv_state = State_Disabled;
+    reader.read(mst_state);
+    reader.read(slv_state);
+    if (!reader.ok()) return false;
+
+    if ((mst_state != State_Disabled && mst_state != State_Idle) ||
+        (slv_state != State_Disabled && slv_state != State_Idle))
+        return false;
+
+    cycle_count_t when = INVALID_CYCLE;
+    for (auto& slot : m_cycle_manager->timer_slots()) {
+        if (slot.timer == m_timer && !slot.paused)
+            when = slot.when;
+    }
+
+    set_master_enabled(false);
+    set_slave_enabled(false);
+
+    m_cycle_manager->cancel(*m_timer);
+    if (when != INVALID_CYCLE)
+        m_cycle_manager->schedule(*m_timer, when);
+    m_timer_next_when = 0;
+
+    m_mst_state = mst_state;
+    m_slv_state = slv_state;
+    m_slv_hold = false;
+    reader.read(m_bitdelay);
+    reader.read(m_tlm_mode);
+    reader.read(m_tx_data);
+
+    int sigid = 0;
+    long long index = 0;
+    unsigned long long data = 0;
+    reader.read(m_has_deferred_raise);
+    reader.read(sigid);
+    reader.read(index);
+    reader.read(data);
+    m_deferred_sigdata = { .sigid = sigid, .index = index, .data = data };
+
+    return reader.ok();
+}
+
+/**
+   Return the cycle timer of the interface, to be declared by the owner peripheral
+   with Peripheral::add_state_timer().
+ */
+std::vector<CycleTimer*> TWI::state_timers() const
+{
+    return { m_timer };
+}
+
 //=======================================================================================
 /*
  * Master operations
@@ -443,6 +680,8 @@ void TWI::set_master_enabled(bool enabled)
             release_bus();
 
         m_cycle_manager->cancel(*m_timer);
+        m_tlm_active = false;
+        m_tlm_slave = nullptr;
 
         set_master_state(State_Disabled);
     }
@@ -465,6 +704,21 @@ void TWI::set_bit_delay(cycle_count_t delay)
     m_bitdelay = delay;
 }
 
+/**
+   Enable or disable the transaction mode for the master part.
+   In transaction mode, if all the other endpoints on the bus are slave models, the master
+   exchanges the address and data bytes directly with the models instead of circulating
+   packets on the bus. The timing of each byte and of the signals to the upper layer is
+   unchanged but the bus does not raise any packet signal and the intermediate busy states
+   of the master are not signalled.
+   The slave part of this interface does not take part in such transactions.
+   The setting is applied from the next address sent.
+ */
+void TWI::set_transaction_mode(bool enabled)
+{
+    m_tlm_mode = enabled;
+}
+
 /**
    Start a transfer. Tries to obtain the ownership of the bus.
    Master-side only.
@@ -479,7 +733,7 @@ bool TWI::start_transfer()
 
     //try to acquire the bus ownership
     if (acquire_bus()) {
-        m_logger->dbg("Ownership of bus acquired");
+        LOGGER_DBG(*m_logger, "Ownership of bus acquired");
         set_master_state(State_Addr);
         m_signal.raise(Signal_BusStateChange, Bus_Owned, Cpt_Any);
         return true;
@@ -502,11 +756,17 @@ bool TWI::send_address(uint8_t remote_addr, bool rw)
     if (!State_Active(m_mst_state) || State_Busy(m_mst_state))
         return false;
 
-    set_master_state(State_Addr_Busy);
-
-    //Prepare and send the address packet
+    //Prepare the address packet and send it, unless the transaction can be
+    //performed directly with slave models
     fill_address_packet(m_current_packet, remote_addr, rw);
-    send_packet(m_current_packet);
+    m_tlm_active = m_tlm_mode && bus()->transaction_capable(this);
+    m_tlm_slave = nullptr;
+    if (m_tlm_active) {
+        m_mst_state = State_Addr_Busy;
+    } else {
+        set_master_state(State_Addr_Busy);
+        send_packet(m_current_packet);
+    }
 
     start_timer(m_bitdelay * 9); //ADDR (7 bits) + RW + ACK
 
@@ -538,6 +798,12 @@ bool TWI::start_master_tx(uint8_t data)
 
     m_tx_data = data;
 
+    if (m_tlm_active) {
+        m_mst_state = State_TX_Busy;
+        start_timer(m_bitdelay * 9); //DATA (8 bits) + ACK
+        return true;
+    }
+
     //Prepare and send a DataRequest packet
     fill_write_req_packet(m_current_packet, data);
     send_packet(m_current_packet);
@@ -562,6 +828,12 @@ bool TWI::start_master_rx()
     if (m_mst_state != State_RX)
         return false;
 
+    if (m_tlm_active) {
+        m_mst_state = State_RX_Busy;
+        start_timer(m_bitdelay * 9); //DATA (8 bits) + ACK
+        return true;
+    }
+
     //Send a DataRequest packet
     fill_read_req_packet(m_current_packet);
     send_packet(m_current_packet);
@@ -589,7 +861,8 @@ void TWI::set_master_ack(bool ack)
         //Prepare and send the ReadAck packet
         m_current_packet.cmd = TWIPacket::Cmd_DataAck;
         m_current_packet.ack = ack ? TWIPacket::Ack : TWIPacket::Nack;
-        send_packet(m_current_packet);
+        if (!m_tlm_active)
+            send_packet(m_current_packet);
         //If acked, transit to RX to read the next data byte
         //If nacked, the only valid next moves are a new Address packet
         //or a transaction end
@@ -615,11 +888,15 @@ cycle_count_t TWI::timer_next(cycle_count_t when)
     //is to avoid TWIBus callbacks directly calling TWIBus functions as it
     //may lead to infinite loops or deadlocks
     if (m_has_deferred_raise) {
-        m_logger->dbg("Deferred signal raise, id=%d", m_deferred_sigdata.sigid);
+        LOGGER_DBG(*m_logger, "Deferred signal raise, id=%d", m_deferred_sigdata.sigid);
         m_signal.raise(m_deferred_sigdata);
         m_has_deferred_raise = false;
     }
 
+    else if (m_tlm_active) {
+        tlm_timer_next();
+    }
+
     else if (m_mst_state == State_Addr_Busy) {
         //We're here at the end of an Address packet
         end_packet(m_current_packet);
@@ -672,6 +949,44 @@ cycle_count_t TWI::timer_next(cycle_count_t when)
     return m_timer_next_when;
 }
 
+/*
+   Transaction mode equivalent of the timer processing, the bytes are
+   exchanged directly with the selected slave model.
+ */
+void TWI::tlm_timer_next()
+{
+    if (m_mst_state == State_Addr_Busy) {
+        m_tlm_slave = bus()->select_model(m_current_packet.addr, m_current_packet.rw);
+        m_current_packet.ack = m_tlm_slave ? TWIPacket::Ack : TWIPacket::Nack;
+
+        if (!m_tlm_slave)
+            set_master_state(State_Addr);
+        else if (m_current_packet.rw)
+            set_master_state(State_RX);
+        else
+            set_master_state(State_TX);
+
+        m_signal.raise(Signal_AddrAck, m_current_packet.ack, Cpt_Master);
+    }
+
+    else if (m_mst_state == State_TX_Busy) {
+        bool ack = m_tlm_slave && m_tlm_slave->write_byte(m_tx_data);
+        m_current_packet.data = m_tx_data;
+        m_current_packet.ack = ack ? TWIPacket::Ack : TWIPacket::Nack;
+        set_master_state(State_TX);
+        m_signal.raise(Signal_TxComplete, m_current_packet.ack, Cpt_Master);
+    }
+
+    else if (m_mst_state == State_RX_Busy) {
+        m_current_packet.data = m_tlm_slave ? m_tlm_slave->read_byte() : 0xFF;
+        set_master_state(State_RX_Ack);
+        m_signal.raise(Signal_RxComplete, m_current_packet.data, Cpt_Master);
+    }
+
+    else
+        abort();
+}
+
 void TWI::defer_signal_raise(int sigid, long long index, unsigned long long u)
 {
     signal_data_t sig = { .sigid = sigid, .index = index, .data = u };
@@ -825,7 +1140,7 @@ void TWI::set_slave_ack(bool ack)
 
 void TWI::packet(TWIPacket& packet)
 {
-    m_logger->dbg("Packet received Command=%d", packet.cmd);
+    LOGGER_DBG(*m_logger, "Packet received Command=%d", packet.cmd);
 
     switch(packet.cmd) {
 
@@ -928,7 +1243,7 @@ void TWI::packet(TWIPacket& packet)
 
 void TWI::packet_ended(TWIPacket& packet)
 {
-    m_logger->dbg("Packet ended, Command=%d", packet.cmd);
+    LOGGER_DBG(*m_logger, "Packet ended, Command=%d", packet.cmd);
 
     //Upon receiving a packet end for an address (slave only),
     //hold the bus and send the address to the higher layer to
@@ -976,7 +1291,7 @@ void TWI::packet_ended(TWIPacket& packet)
 
 void TWI::bus_acquired()
 {
-    m_logger->dbg("Bus acquired");
+    LOGGER_DBG(*m_logger, "Bus acquired");
 
     if (m_mst_state == State_Idle) {
         set_master_state(State_Waiting);
@@ -986,7 +1301,7 @@ void TWI::bus_acquired()
 
 void TWI::bus_released()
 {
-    m_logger->dbg("Bus released");
+    LOGGER_DBG(*m_logger, "Bus released");
 
     defer_signal_raise(Signal_BusStateChange, Cpt_Any, Bus_Idle);
 
@@ -28,6 +28,7 @@
 #include "../core/sim_signal.h"
 #include "../core/sim_cycle_timer.h"
 #include "../core/sim_device.h"
+#include "../core/sim_state.h"
 #include <deque>
 #include <vector>
 
@@ -46,14 +47,19 @@ YASIMAVR_BEGIN_NAMESPACE
     It does not support arbitration beyond the START condition and (currently) is not
     multi-thread safe.
 
-    It is implemented by 4 classes:
+    It is implemented by 5 classes:
      - TWIPacket defines a packet circulating on a bus simulating the successive exchange
        of information between mater and slave.
      - TWIEndPoint is an abstract interface defining a generic device connected to a TWI bus.
+     - TWISlaveModel is an endpoint for slave models, with a transaction-level interface
+       exchanging whole bytes instead of packets.
      - TWIBus defines a central object to circulate packets between multiple endpoints.
      - TWI is an implementation of a TWI interface for an AVR MCU, as generic
        as possible. It manages master and slave operations independently and communicates
        with upper layers via signals.
+
+    When all the other endpoints on a bus are slave models, a TWI master in transaction mode
+    exchanges the bytes directly with the models, without circulating packets on the bus.
    @{
  */
 
@@ -121,6 +127,7 @@ public:
 //=======================================================================================
 
 class TWIBus;
+class TWISlaveModel;
 
 /**
    \ingroup api_twi
@@ -168,6 +175,70 @@ private:
 };
 
 
+//=======================================================================================
+
+/**
+   \ingroup api_twi
+   \brief Slave endpoint with a transaction-level interface.
+
+   A slave model only has to implement the byte-level callbacks below. They are called
+   by the packet processing when the bus is used in packet mode, or directly by the master
+   when the bus is used in transaction mode.
+   A slave model never holds the bus, i.e. it responds within the duration of each packet.
+   \sa TWIBus::transfer, TWI::set_transaction_mode
+ */
+class AVR_CORE_PUBLIC_API TWISlaveModel : public TWIEndPoint {
+
+public:
+
+    TWISlaveModel();
+
+    bool active() const;
+
+    /**
+       Called at a START or a repeated START with the address and RW flag sent by the master.
+       \return true to acknowledge the address, false otherwise
+     */
+    virtual bool address_match(uint8_t addr, bool rw) = 0;
+    /**
+       Called for each byte written by the master.
+       \return true to acknowledge the byte, false otherwise
+     */
+    virtual bool write_byte(uint8_t data) = 0;
+    /**
+       Called for each byte read by the master.
+       \return the byte to send to the master
+     */
+    virtual uint8_t read_byte() = 0;
+    /// Called when the bus is released at the end of a transaction.
+    virtual void transfer_stop();
+
+    virtual size_t write_data(const uint8_t* data, size_t length);
+    virtual size_t read_data(uint8_t* data, size_t length);
+
+protected:
+
+    virtual void packet(TWIPacket& packet) override;
+    virtual void packet_ended(TWIPacket& packet) override;
+    virtual void bus_acquired() override;
+    virtual void bus_released() override;
+
+private:
+
+    friend class TWIBus;
+
+    bool m_active;
+    bool m_rw;
+
+};
+
+/// Returns true if the model is currently addressed by a master.
+inline bool TWISlaveModel::active() const
+{
+    return m_active;
+}
+
+
 //=======================================================================================
 
 /**
@@ -209,6 +280,10 @@ public:
     void add_endpoint(TWIEndPoint& endpoint);
     void remove_endpoint(TWIEndPoint& endpoint);
 
+    bool transaction_capable(const TWIEndPoint* master) const;
+    TWISlaveModel* select_model(uint8_t addr, bool rw);
+    bool transfer(uint8_t addr, bool rw, uint8_t* data, size_t& length);
+
     //Disable copy semantics
     TWIBus(const TWIBus&) = delete;
     TWIBus& operator=(const TWIBus&) = delete;
@@ -220,6 +295,8 @@ private:
     Signal m_signal;
     //List of all the endpoints connected to this bus
     std::vector<TWIEndPoint*> m_endpoints;
+    //Subset of the endpoints that are slave models
+    std::vector<TWISlaveModel*> m_models;
     //Pointer to the master currently owning the bus
     TWIEndPoint* m_master;
     //Pointer to the currently active slave
@@ -258,6 +335,10 @@ inline Signal& TWIBus::signal()
 
    The interface has a Master side and a Slave side that are independent
    of each other and can even communicate with each other;
+
+   The state saved for a device snapshot can only be loaded back if neither side was
+   taking part in a transfer at the time of the capture, as the state of the bus and of
+   the other endpoints is not included.
  */
 class AVR_CORE_PUBLIC_API TWI : public TWIEndPoint {
 
@@ -373,6 +454,8 @@ public:
 
     void set_master_enabled(bool enabled);
     void set_bit_delay(cycle_count_t delay);
+    void set_transaction_mode(bool enabled);
+    bool transaction_mode() const;
     bool start_transfer();
     void end_transfer();
     bool send_address(uint8_t remote_addr, bool rw);
@@ -388,6 +471,10 @@ public:
     State master_state() const;
     State slave_state() const;
 
+    bool save_state(StateWriter& writer) const;
+    bool load_state(StateReader& reader);
+    std::vector<CycleTimer*> state_timers() const;
+
     //Disable copy semantics
     TWI(const TWI&) = delete;
     TWI& operator=(const TWI&) = delete;
@@ -421,6 +508,13 @@ private:
     State m_mst_state;
     cycle_count_t m_bitdelay;
 
+    //Transaction mode setting
+    bool m_tlm_mode;
+    //True if the current master transfer is performed in transaction mode
+    bool m_tlm_active;
+    //Slave model addressed by the current master transfer in transaction mode
+    TWISlaveModel* m_tlm_slave;
+
     State m_slv_state;
     bool m_slv_hold;
 
@@ -429,6 +523,7 @@ private:
 
     void start_timer(cycle_count_t delay);
     cycle_count_t timer_next(cycle_count_t when);
+    void tlm_timer_next();
     void defer_signal_raise(int sigid, long long index, unsigned long long u);
 
 };
@@ -438,6 +533,14 @@ inline Signal& TWI::signal()
     return m_signal;
 }
 
+/**
+   Returns true if the transaction mode is enabled.
+ */
+inline bool TWI::transaction_mode() const
+{
+    return m_tlm_mode;
+}
+
 /**
    Returns the current state of the master-side.
  */
@@ -70,17 +70,37 @@ private:
 
 //=======================================================================================
 
+#define TX_BUFFER_CAPACITY      4
+#define RX_FIFO_CAPACITY        4
+#define RX_BACKLOG_CAPACITY     256
+
+//Push a frame in a ring buffer, doubling its capacity if it is full
+static void push_frame(RingBuffer<uint8_t>& buffer, uint8_t frame)
+{
+    if (buffer.full())
+        buffer.set_capacity(buffer.capacity() * 2);
+    buffer.push_back(frame);
+}
+
+
 UART::UART()
 :m_cycle_manager(nullptr)
 ,m_logger(nullptr)
 ,m_delay(1)
+,m_tx_buffer(TX_BUFFER_CAPACITY)
 ,m_tx_limit(0)
 ,m_tx_collision(false)
 ,m_rx_enabled(false)
-,m_rx_count(0)
+,m_rx_fifo(RX_FIFO_CAPACITY)
+,m_rx_backlog(RX_BACKLOG_CAPACITY)
 ,m_rx_limit(0)
 ,m_rx_overflow(false)
+,m_rx_next(0)
+,m_rx_event(0)
+,m_rx_updating(false)
+,m_rx_start_observed(false)
 ,m_paused(false)
+,m_fast(false)
 {
     m_rx_timer = new RxTimer(*this);
     m_tx_timer = new TxTimer(*this);
@@ -103,17 +123,31 @@ void UART::init(CycleManager& cycle_manager, Logger& logger)
     m_logger = &logger;
 }
 
+/*
+ * Raise an event to the typed signal, then to the regular signal if any hook is connected.
+ */
+void UART::raise_event(SignalId sigid, unsigned int data)
+{
+    m_event_signal.raise({ sigid, data });
+    if (m_signal.connected())
+        m_signal.raise(sigid, data);
+}
+
 /**
    Reset the interface.
  */
 void UART::reset()
 {
+    //Process the frames received up to now, so that the signals are
+    //raised in order
+    process_rx();
+
     m_delay = 1;
 
     //Reset the TX part
     //Raise the signal to inform that the TX is canceled
     if (tx_in_progress())
-        m_signal.raise(Signal_TX_Complete, 0);
+        raise_event(Signal_TX_Complete, 0);
 
     m_tx_buffer.clear();
     m_tx_collision = false;
@@ -122,14 +156,26 @@ void UART::reset()
     //Reset the RX part
     //Raise the signal to inform that the RX is canceled
     if (rx_in_progress())
-        m_signal.raise(Signal_RX_Complete, 0);
+        raise_event(Signal_RX_Complete, 0);
 
     m_rx_enabled = false;
-    m_rx_buffer.clear();
-    m_rx_count = 0;
+    m_rx_fifo.clear();
+    m_rx_backlog.clear();
     m_rx_overflow = false;
     m_paused = false;
     m_cycle_manager->cancel(*m_rx_timer);
+    m_rx_event = 0;
+}
+
+/**
+   Set the delay in clock ticks to emit or receive a frame. The minimum valid value is 1.
+   A frame being emitted or received is not affected.
+ */
+void UART::set_frame_delay(cycle_count_t delay)
+{
+    process_rx();
+    m_delay = delay ? delay : 1;
+    update_rx();
 }
 
 
@@ -146,6 +192,9 @@ void UART::set_tx_buffer_limit(size_t limit)
     m_tx_limit = limit;
     while (limit > 0 && m_tx_buffer.size() > limit)
         m_tx_buffer.pop_back();
+
+    if (m_tx_buffer.capacity() < limit)
+        m_tx_buffer.set_capacity(limit);
 }
 
 /**
@@ -154,7 +203,7 @@ void UART::set_tx_buffer_limit(size_t limit)
  */
 void UART::push_tx(uint8_t frame)
 {
-    m_logger->dbg("TX push: 0x%02x ('%c')", frame, frame);
+    LOGGER_DBG(*m_logger, "TX push: 0x%02x ('%c')", frame, frame);
 
     bool tx = tx_in_progress();
 
@@ -163,12 +212,12 @@ void UART::push_tx(uint8_t frame)
         m_tx_collision = true;
     }
 
-    m_tx_buffer.push_back(frame);
+    push_frame(m_tx_buffer, frame);
 
     if (!tx) {
-        m_logger->dbg("TX start: 0x%02x ('%c')", frame, frame);
-        m_signal.raise(Signal_TX_Start, frame);
-        m_cycle_manager->delay(*m_tx_timer, m_delay);
+        LOGGER_DBG(*m_logger, "TX start: 0x%02x ('%c')", frame, frame);
+        raise_event(Signal_TX_Start, frame);
+        m_cycle_manager->delay(*m_tx_timer, frame_delay());
     }
 }
 
@@ -186,16 +235,16 @@ cycle_count_t UART::tx_timer_next(cycle_count_t when)
     uint8_t frame = m_tx_buffer.front();
     m_tx_buffer.pop_front();
 
-    m_logger->dbg("TX complete");
+    LOGGER_DBG(*m_logger, "TX complete");
 
-    m_signal.raise(Signal_DataFrame, frame);
-    m_signal.raise(Signal_TX_Complete, 1);
+    raise_event(Signal_DataFrame, frame);
+    raise_event(Signal_TX_Complete, 1);
 
     if (m_tx_buffer.size() && !m_paused) {
         uint8_t next_frame = m_tx_buffer.front();
-        m_logger->dbg("TX start: 0x%02x ('%c')", next_frame, next_frame);
-        m_signal.raise(Signal_TX_Start, next_frame);
-        return when + m_delay;
+        LOGGER_DBG(*m_logger, "TX start: 0x%02x ('%c')", next_frame, next_frame);
+        raise_event(Signal_TX_Start, next_frame);
+        return when + frame_delay();
     } else {
         return 0;
     }
@@ -212,11 +261,16 @@ cycle_count_t UART::tx_timer_next(cycle_count_t when)
  */
 void UART::set_rx_buffer_limit(size_t limit)
 {
+    process_rx();
+
     m_rx_limit = limit;
-    while (limit > 0 && m_rx_count > limit) {
-        m_rx_buffer.pop_front();
-        --m_rx_count;
-    }
+    while (limit > 0 && m_rx_fifo.size() > limit)
+        m_rx_fifo.pop_front();
+
+    if (m_rx_fifo.capacity() < limit)
+        m_rx_fifo.set_capacity(limit);
+
+    update_rx();
 }
 
 /**
@@ -224,23 +278,45 @@ void UART::set_rx_buffer_limit(size_t limit)
  */
 void UART::set_rx_enabled(bool enabled)
 {
+    process_rx();
+
     m_rx_enabled = enabled;
 
     //If it's disabled, we need to cancel any RX in progress
-    //and flush the front part of the FIFO
+    //and flush the device FIFO
     if (!enabled) {
         if (rx_in_progress()) {
-            m_signal.raise(Signal_RX_Complete, 0);
-            m_cycle_manager->cancel(*m_rx_timer);
-        }
-
-        while (m_rx_count) {
-            m_rx_buffer.pop_front();
-            --m_rx_count;
+            raise_event(Signal_RX_Complete, 0);
+            m_rx_backlog.pop_front();
+            if (rx_in_progress()) {
+                m_rx_next = m_cycle_manager->cycle() + frame_delay();
+                start_rx();
+            }
         }
 
+        m_rx_fifo.clear();
         m_rx_overflow = false;
     }
+
+    update_rx();
+}
+
+/**
+   Getter for the number of frames stored in the device RX FIFO.
+ */
+size_t UART::rx_available() const
+{
+    const_cast<UART*>(this)->update_rx();
+    return m_rx_fifo.size();
+}
+
+/**
+   Getter for the number of frames yet to be received by the device.
+ */
+size_t UART::rx_pending() const
+{
+    const_cast<UART*>(this)->update_rx();
+    return m_rx_backlog.size();
 }
 
 /**
@@ -250,66 +326,240 @@ void UART::set_rx_enabled(bool enabled)
  */
 uint8_t UART::pop_rx()
 {
-    if (m_rx_count) {
-        uint8_t frame = m_rx_buffer.front();
-        m_rx_buffer.pop_front();
-        --m_rx_count;
-        m_logger->dbg("RX pop: 0x%02x ('%c')", frame, frame);
-        return frame;
-    } else {
-        return 0;
+    process_rx();
+
+    uint8_t frame = 0;
+    bool popped = m_rx_fifo.size();
+    if (popped) {
+        frame = m_rx_fifo.front();
+        m_rx_fifo.pop_front();
+        LOGGER_DBG(*m_logger, "RX pop: 0x%02x ('%c')", frame, frame);
+    }
+
+    update_rx();
+
+    if (popped)
+        raise_event(Signal_RX_Pop, frame);
+
+    return frame;
+}
+
+/// Getter for the RX overflow flag
+bool UART::has_rx_overflow() const
+{
+    const_cast<UART*>(this)->update_rx();
+    return m_rx_overflow;
+}
+
+/// Clear the RX overflow flag
+void UART::clear_rx_overflow()
+{
+    update_rx();
+    m_rx_overflow = false;
+}
+
+/**
+   Set whether the start of each received frame must be signaled on time.
+   By default, only the frame arrivals which can be observed through the
+   device FIFO are processed on time.
+ */
+void UART::set_rx_start_observed(bool observed)
+{
+    process_rx();
+    m_rx_start_observed = observed;
+    update_rx();
+}
+
+static void save_frames(StateWriter& writer, const RingBuffer<uint8_t>& buffer)
+{
+    writer.write((uint32_t) buffer.size());
+    for (size_t i = 0; i < buffer.size(); ++i)
+        writer.write(buffer[i]);
+}
+
+static void load_frames(StateReader& reader, RingBuffer<uint8_t>& buffer)
+{
+    buffer.clear();
+    uint32_t n = 0;
+    reader.read(n);
+    for (uint32_t i = 0; i < n && reader.ok(); ++i) {
+        uint8_t frame;
+        if (reader.read(frame))
+            push_frame(buffer, frame);
     }
 }
 
+/**
+   Save the state of the interface, including the frames in the TX buffer, in the device
+   RX FIFO and in the RX backlog, for a device snapshot.
+   The scheduling of the timers is not included.
+   \sa state_timers()
+ */
+void UART::save_state(StateWriter& writer) const
+{
+    writer.write(m_delay);
+    writer.write(m_tx_collision);
+    save_frames(writer, m_tx_buffer);
+    writer.write(m_rx_enabled);
+    writer.write(m_rx_overflow);
+    writer.write(m_rx_next);
+    writer.write(m_rx_event);
+    save_frames(writer, m_rx_fifo);
+    save_frames(writer, m_rx_backlog);
+    writer.write(m_paused);
+    writer.write(m_fast);
+}
+
+/**
+   Load the state saved by save_state(). No signal is raised and the timers
+   are not rescheduled.
+ */
+void UART::load_state(StateReader& reader)
+{
+    reader.read(m_delay);
+    reader.read(m_tx_collision);
+    load_frames(reader, m_tx_buffer);
+    reader.read(m_rx_enabled);
+    reader.read(m_rx_overflow);
+    reader.read(m_rx_next);
+    reader.read(m_rx_event);
+    load_frames(reader, m_rx_fifo);
+    load_frames(reader, m_rx_backlog);
+    reader.read(m_paused);
+    reader.read(m_fast);
+}
+
+/**
+   Return the cycle timers of the interface, to be declared by the owner peripheral
+   with Peripheral::add_state_timer().
+ */
+std::vector<CycleTimer*> UART::state_timers() const
+{
+    return { m_tx_timer, m_rx_timer };
+}
+
+/*
+   Start the reception of the frame at the front of the backlog
+ */
 void UART::start_rx()
 {
     //If the MCU RX buffer is full, we discard the front of the FIFO
     //and set the overrun flag
-    if (m_rx_limit > 0 && m_rx_count == m_rx_limit) {
-        m_rx_buffer.pop_front();
-        --m_rx_count;
+    if (m_rx_limit > 0 && m_rx_fifo.size() == m_rx_limit) {
+        m_rx_fifo.pop_front();
         m_rx_overflow = true;
     }
 
     //Raise a signal for the next frame to be actually received by
-    //the device. It's in the front slot of the back part of the RX FIFO
-    m_signal.raise(Signal_RX_Start, m_rx_buffer[m_rx_count]);
+    //the device.
+    raise_event(Signal_RX_Start, m_rx_backlog.front());
 }
 
-cycle_count_t UART::rx_timer_next(cycle_count_t when)
+/*
+   Complete the reception of the frame at the front of the backlog
+   and start the next one, if any.
+ */
+void UART::complete_rx()
 {
-    m_logger->dbg("RX complete");
+    LOGGER_DBG(*m_logger, "RX complete");
+
+    uint8_t frame = m_rx_backlog.front();
+    m_rx_backlog.pop_front();
+    //If the backlog is empty, the frames added by the hooks below
+    //are started by add_rx_frame()
+    bool more = rx_in_progress();
 
     if (m_rx_enabled && !m_paused) {
-        ++m_rx_count;
+        push_frame(m_rx_fifo, frame);
         //Signal that we received a frame and kept it
-        m_signal.raise(Signal_RX_Complete, 1);
+        raise_event(Signal_RX_Complete, 1);
     } else {
-        //if disabled or paused, discard the frame just received,
-        //which is in the front slot of the back part of the FIFO
-        m_rx_buffer.erase(m_rx_buffer.begin() + m_rx_count);
+        //if disabled or paused, discard the frame just received
         //Signal that we received a frame but discarded it
-        m_signal.raise(Signal_RX_Complete, 0);
+        raise_event(Signal_RX_Complete, 0);
     }
 
     //Do we have further frames to receive ?
-    if (m_rx_count < m_rx_buffer.size()) {
+    if (more) {
+        m_rx_next += frame_delay();
         start_rx();
-        return when + m_delay;
-    } else {
-        return 0;
     }
 }
 
+/*
+   Process all the frame arrivals up to the current cycle.
+ */
+void UART::process_rx()
+{
+    if (m_rx_updating || !m_cycle_manager) return;
+
+    m_rx_updating = true;
+
+    cycle_count_t now = m_cycle_manager->cycle();
+    while (rx_in_progress() && m_rx_next <= now)
+        complete_rx();
+
+    m_rx_updating = false;
+}
+
+/*
+   Returns the cycle of the next frame arrival observable by the device,
+   or 0 if there's no frame to receive.
+ */
+cycle_count_t UART::next_rx_event() const
+{
+    if (!rx_in_progress()) return 0;
+
+    //Index of the frame in the backlog at the completion of which the timer must fire
+    size_t index;
+    if (m_rx_start_observed || (m_rx_enabled && !m_paused && m_rx_fifo.empty()))
+        index = 0;
+    else
+        index = m_rx_backlog.size() - 1;
+
+    return m_rx_next + index * frame_delay();
+}
+
+/*
+   Process the frame arrivals up to the current cycle and reschedule the RX timer
+   for the next observable one.
+ */
+void UART::update_rx()
+{
+    if (m_rx_updating || !m_cycle_manager) return;
+
+    process_rx();
+
+    cycle_count_t event = next_rx_event();
+    if (event != m_rx_event) {
+        if (event)
+            m_cycle_manager->schedule(*m_rx_timer, event);
+        else
+            m_cycle_manager->cancel(*m_rx_timer);
+        m_rx_event = event;
+    }
+}
+
+cycle_count_t UART::rx_timer_next(cycle_count_t)
+{
+    process_rx();
+    m_rx_event = next_rx_event();
+    return m_rx_event;
+}
+
 void UART::add_rx_frame(uint8_t frame)
 {
-    bool timer_running = rx_in_progress();
+    bool receiving = rx_in_progress();
 
-    m_rx_buffer.push_back(frame);
+    push_frame(m_rx_backlog, frame);
 
-    if (!timer_running) {
+    //If the RX is idle, start the reception now or, if the frame is added
+    //while processing the arrivals, at the completion of the last frame
+    if (!receiving) {
+        if (!m_rx_updating)
+            m_rx_next = m_cycle_manager->cycle();
+        m_rx_next += frame_delay();
         start_rx();
-        m_cycle_manager->delay(*m_rx_timer, m_delay);
     }
 }
 
@@ -319,23 +569,29 @@ void UART::add_rx_frame(uint8_t frame)
  */
 void UART::raised(const signal_data_t& sigdata, int)
 {
+    //Process the arrivals up to now so that the new frames are queued
+    //after an accurate backlog
+    process_rx();
+
     if (sigdata.sigid == Signal_DataFrame) {
-        m_logger->dbg("RX frame received");
+        LOGGER_DBG(*m_logger, "RX frame received");
         add_rx_frame(sigdata.data.as_uint());
     }
     else if (sigdata.sigid == Signal_DataString) {
-        m_logger->dbg("RX string received");
+        LOGGER_DBG(*m_logger, "RX string received");
         const char* s = sigdata.data.as_str();
         for (size_t i = 0; i < strlen(s); ++i)
             add_rx_frame(s[i]);
     }
     else if (sigdata.sigid == Signal_DataBytes) {
-        m_logger->dbg("RX bytes received");
+        LOGGER_DBG(*m_logger, "RX bytes received");
         const uint8_t* frames = sigdata.data.as_bytes();
         size_t frame_count = sigdata.data.size();
         for (size_t i = 0; i < frame_count; i++)
             add_rx_frame(frames[i]);
     }
+
+    update_rx();
 }
 
 //=======================================================================================
@@ -350,13 +606,33 @@ void UART::raised(const signal_data_t& sigdata, int)
  */
 void UART::set_paused(bool paused)
 {
+    process_rx();
+
     //If going out of pause and there are TX frames pending, resume the transmission
     if (m_paused && !paused && m_tx_buffer.size()) {
         uint8_t next_frame = m_tx_buffer.front();
-        m_logger->dbg("TX start: 0x%02x ('%c')", next_frame, next_frame);
-        m_signal.raise(Signal_TX_Start, next_frame);
-        m_cycle_manager->delay(*m_tx_timer, m_delay);
+        LOGGER_DBG(*m_logger, "TX start: 0x%02x ('%c')", next_frame, next_frame);
+        raise_event(Signal_TX_Start, next_frame);
+        m_cycle_manager->delay(*m_tx_timer, frame_delay());
     }
 
     m_paused = paused;
+
+    update_rx();
+}
+
+
+/**
+   Enable/disable the fast mode.
+
+   In fast mode, the frames are emitted and received in a single cycle, regardless
+   of the frame delay. It does not respect the timing of the interface, but allows
+   to move large amounts of data in and out of the device as fast as the firmware
+   can process it. The setting is kept across resets.
+ */
+void UART::set_fast_mode(bool enabled)
+{
+    process_rx();
+    m_fast = enabled;
+    update_rx();
 }
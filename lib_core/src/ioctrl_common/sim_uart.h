@@ -27,7 +27,8 @@
 #include "../core/sim_types.h"
 #include "../core/sim_device.h"
 #include "../core/sim_signal.h"
-#include <deque>
+#include "../core/sim_ringbuffer.h"
+#include "../core/sim_state.h"
 
 YASIMAVR_BEGIN_NAMESPACE
 
@@ -83,17 +84,32 @@ struct UARTEndPoint {
    On-going TX can only be canceled by a reset.
 
    \par Receiver
-   The RX part is composed of a FIFO with two sub-parts:
-   The front part is the actual device FIFO, from which received frames are read and popped.
-   The back part has the frames yet to be received by the device. This is
+   The RX part is composed of two FIFOs:
+   The device FIFO, from which received frames are read and popped.
+   The backlog, which has the frames yet to be received by the device. This is
    a convenient system that allows to send a whole string to the device in one signal, while
    the device will still receive the characters one by one with a proper timing.
    Disabling the RX does not prevent receiving frames. They are simply discarded when actually
-   received by the device. (i.e. when moved from the back FIFO to the front FIFO)
+   received by the device. (i.e. when moved from the backlog to the device FIFO)
    Frames are received when signaled with UART_Data_Frame or UART_Data_String.
    The signal UART_RX_Start is emitted at the start of a reception.
    The signal UART_RX_Complete are emitted at the end of a reception, with data = 1 if the frame
    if kept or data = 0 if canceled or discarded.
+
+   \par RX batching
+   The arrival cycles of the frames in the backlog are known in advance, so the RX timer
+   is only woken up when a frame arrival can be observed by the device: when a frame is
+   received into an empty device FIFO (raising the RX complete flag), at every frame start
+   if it is observed (see set_rx_start_observed()), and at the end of the backlog.
+   The other arrivals, including the overflows, are processed when the RX state is
+   accessed by any of the methods of the interface, so the timing seen by the device is
+   unchanged. The RX_Start and RX_Complete signals of these arrivals are raised late,
+   in order.
+
+   \par Typed signal
+   The same events are raised beforehand through event_signal(), a typed signal for the
+   internal consumers such as the USART peripherals. The regular signal is only raised if
+   a hook is connected to it.
  */
 class AVR_CORE_PUBLIC_API UART : public SignalHook {
 
@@ -116,6 +132,16 @@ public:
         /// Raised at the end of a frame reception.
         /// sigdata contains 1 if the frame is received successfully or 0 if it was discarded.
         Signal_RX_Complete,
+        /// Raised when a frame is popped from the device RX FIFO, with sigdata containing the frame.
+        Signal_RX_Pop,
+    };
+
+    /// Event data of the typed signal
+    struct event_t {
+        /// Signal identifier
+        SignalId sigid;
+        /// Signal data, a frame or a completion flag
+        unsigned int data;
     };
 
     UART();
@@ -126,6 +152,7 @@ public:
     void reset();
 
     Signal& signal();
+    TypedSignal<event_t>& event_signal();
 
     void set_frame_delay(cycle_count_t delay);
 
@@ -137,14 +164,25 @@ public:
     void clear_tx_collision();
 
     void set_rx_buffer_limit(size_t limit);
+    size_t rx_buffer_limit() const;
     void set_rx_enabled(bool enabled);
     size_t rx_available() const;
+    size_t rx_pending() const;
     uint8_t pop_rx();
     bool has_rx_overflow() const;
     void clear_rx_overflow();
 
     void set_paused(bool enabled);
 
+    void set_fast_mode(bool enabled);
+    bool fast_mode() const;
+
+    void set_rx_start_observed(bool observed);
+
+    void save_state(StateWriter& writer) const;
+    void load_state(StateReader& reader);
+    std::vector<CycleTimer*> state_timers() const;
+
     //Disable copy semantics
     UART(const UART&) = delete;
     UART& operator=(const UART&) = delete;
@@ -164,11 +202,12 @@ private:
     Logger* m_logger;
 
     Signal m_signal;
+    TypedSignal<event_t> m_event_signal;
 
     //Frame delay in clock cycles
     cycle_count_t m_delay;
     //TX FIFO buffer. The front is the TX shift register
-    std::deque<uint8_t> m_tx_buffer;
+    RingBuffer<uint8_t> m_tx_buffer;
     //Size limit for the TX FIFO, including the shift register
     size_t m_tx_limit;
     //Collision flag
@@ -178,33 +217,48 @@ private:
 
     //Enable/disable flag for RX
     bool m_rx_enabled;
-    //RX FIFO buffer, it has two parts, delimited by m_rx_count
-    //the front part is the device actual FIFO, the back part
-    //is the buffer for frames yet to be received
-    std::deque<uint8_t> m_rx_buffer;
-    //It is actually the no of frames in the device FIFO,
-    //hence delimiting the FIFO two sub-parts
-    size_t m_rx_count;
-    //Size limit for the device part of the RX FIFO
-    //The back part of the FIFO is not limited
+    //Device RX FIFO
+    RingBuffer<uint8_t> m_rx_fifo;
+    //Backlog of frames yet to be received, the front one is being received
+    RingBuffer<uint8_t> m_rx_backlog;
+    //Size limit for the device RX FIFO, the backlog is not limited
     size_t m_rx_limit;
     //RX overflow flag
     bool m_rx_overflow;
+    //Cycle at which the front frame of the backlog is completely received
+    cycle_count_t m_rx_next;
+    //Cycle at which the RX timer is scheduled, 0 if not scheduled
+    cycle_count_t m_rx_event;
+    //Flag set while the frame arrivals are being processed
+    bool m_rx_updating;
+    //Flag indicating that the RX start of each frame must be signaled on time
+    bool m_rx_start_observed;
     //Cycle timer to simulate the delay to receive a frame
     RxTimer* m_rx_timer;
 
     //Pause flag for both RX and TX
     bool m_paused;
+    //Fast mode flag, frames take a single cycle to be emitted or received
+    bool m_fast;
 
+    void raise_event(SignalId sigid, unsigned int data);
     void add_rx_frame(uint8_t frame);
     void start_rx();
+    void complete_rx();
+    void process_rx();
+    void update_rx();
+    cycle_count_t next_rx_event() const;
 
-    inline bool tx_in_progress() {
+    inline bool tx_in_progress() const {
         return m_tx_buffer.size() > 0;
     }
 
-    inline bool rx_in_progress() {
-        return m_rx_count < m_rx_buffer.size();
+    inline bool rx_in_progress() const {
+        return !m_rx_backlog.empty();
+    }
+
+    inline cycle_count_t frame_delay() const {
+        return m_fast ? 1 : m_delay;
     }
 
     cycle_count_t rx_timer_next(cycle_count_t when);
@@ -218,16 +272,10 @@ inline Signal& UART::signal()
     return m_signal;
 }
 
-/// Getter for the number of frames stored in the RX buffer.
-inline size_t UART::rx_available() const
-{
-    return m_rx_count;
-}
-
-/// Set the delay in clock ticks to emit or receive a frame. The minimum valid value is 1.
-inline void UART::set_frame_delay(cycle_count_t delay)
+/// Getter for the typed signal used for operation signaling.
+inline TypedSignal<UART::event_t>& UART::event_signal()
 {
-    m_delay = delay ? delay : 1;
+    return m_event_signal;
 }
 
 /// Getter for the no of frames waiting in the buffer to be emitted.
@@ -248,16 +296,16 @@ inline void UART::clear_tx_collision()
     m_tx_collision = false;
 }
 
-/// Getter for the RX overflow flag
-inline bool UART::has_rx_overflow() const
+/// Getter for the size limit of the device RX FIFO, 0 if unlimited
+inline size_t UART::rx_buffer_limit() const
 {
-    return m_rx_overflow;
+    return m_rx_limit;
 }
 
-/// Clear the RX overflow flag
-inline void UART::clear_rx_overflow()
+/// Getter for the fast mode flag
+inline bool UART::fast_mode() const
 {
-    m_rx_overflow = false;
+    return m_fast;
 }
 
 
@@ -23,6 +23,7 @@
 
 #include "sim_wdt.h"
 #include "../core/sim_device.h"
+#include "../core/sim_state.h"
 
 YASIMAVR_USING_NAMESPACE
 
@@ -89,6 +90,19 @@ WatchdogTimer::~WatchdogTimer()
     delete m_wdr_sync_timer;
 }
 
+/*
+ * Declare the two timers to the device snapshots
+ */
+bool WatchdogTimer::init(Device& device)
+{
+    bool status = Peripheral::init(device);
+
+    add_state_timer(*m_wd_timer);
+    add_state_timer(*m_wdr_sync_timer);
+
+    return status;
+}
+
 /*
  * On a reset, cancel the two timers
  */
@@ -140,6 +154,29 @@ bool WatchdogTimer::ctlreq(ctlreq_id_t req, ctlreq_data_t*)
     return false;
 }
 
+/*
+ * Save the timer configuration and the cycle of the last WDR
+ */
+bool WatchdogTimer::save_state(std::vector<uint8_t>& state) const
+{
+    StateWriter writer(state);
+    writer.write(m_clk_factor);
+    writer.write(m_win_start);
+    writer.write(m_win_end);
+    writer.write(m_wdr_cycle);
+    return true;
+}
+
+bool WatchdogTimer::load_state(const uint8_t* state, size_t len)
+{
+    StateReader reader(state, len);
+    reader.read(m_clk_factor);
+    reader.read(m_win_start);
+    reader.read(m_win_end);
+    reader.read(m_wdr_cycle);
+    return reader.complete();
+}
+
 /*
  * Watchdog timeout notification.
  */
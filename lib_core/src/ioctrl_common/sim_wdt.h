@@ -47,9 +47,12 @@ public:
     WatchdogTimer();
     virtual ~WatchdogTimer();
 
+    virtual bool init(Device& device) override;
     virtual void reset() override;
     /// Override to handle the core request AVR_CTLREQ_WATCHDOG_RESET
     virtual bool ctlreq(ctlreq_id_t req, ctlreq_data_t* data) override;
+    virtual bool save_state(std::vector<uint8_t>& state) const override;
+    virtual bool load_state(const uint8_t* state, size_t len) override;
 
 protected:
 
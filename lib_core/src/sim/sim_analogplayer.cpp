@@ -0,0 +1,466 @@
+/*
+ * sim_analogplayer.cpp
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#include "sim_analogplayer.h"
+#include "../ioctrl_common/sim_adc.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+YASIMAVR_USING_NAMESPACE
+
+
+//=======================================================================================
+
+#define CSV_LINE_SIZE       4096
+
+
+/*
+   Parse a line of CSV values separated by commas, semicolons or blanks.
+   Returns false if the line contains anything else than numbers.
+ */
+static bool parse_csv_line(const char* line, std::vector<float>& values)
+{
+    values.clear();
+
+    const char* p = line;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',' || *p == ';' || *p == '\r' || *p == '\n')
+            ++p;
+        if (!*p) break;
+
+        char* end;
+        double v = strtod(p, &end);
+        if (end == p) return false;
+        values.push_back(v);
+        p = end;
+    }
+
+    return true;
+}
+
+
+//=======================================================================================
+
+AnalogStimulusPlayer::AnalogStimulusPlayer(Device& device)
+:m_device(device)
+,m_data(nullptr)
+,m_format(Format_Float32)
+,m_channels(0)
+,m_count(0)
+,m_mapping(nullptr)
+,m_mapping_size(0)
+,m_rate(0.0)
+,m_scale(1.0)
+,m_offset(0.0)
+,m_interpolation(true)
+,m_repeat(false)
+,m_has_timed(false)
+,m_running(false)
+,m_start(0)
+,m_period(1.0)
+,m_next_sample(0)
+{}
+
+
+AnalogStimulusPlayer::~AnalogStimulusPlayer()
+{
+    close();
+}
+
+
+/**
+   Load the samples from a CSV file, with one row per sample and one column per channel.
+   Empty lines, lines starting with '#' and a header line are skipped.
+   \return true if the file was read successfully
+ */
+bool AnalogStimulusPlayer::load_csv(const std::string& filename)
+{
+    close();
+
+    FILE* f = fopen(filename.c_str(), "r");
+    if (!f) return false;
+
+    std::vector<float> buffer;
+    std::vector<float> values;
+    unsigned int channels = 0;
+    bool ok = true;
+    char line[CSV_LINE_SIZE];
+
+    while (ok && fgets(line, CSV_LINE_SIZE, f)) {
+        if (line[0] == '#') continue;
+
+        if (!parse_csv_line(line, values)) {
+            //Only the first line can be a header
+            ok = !channels && buffer.empty();
+            continue;
+        }
+
+        if (values.empty()) continue;
+
+        if (!channels)
+            channels = values.size();
+        else if (values.size() != channels)
+            ok = false;
+
+        buffer.insert(buffer.end(), values.begin(), values.end());
+    }
+
+    fclose(f);
+
+    if (!ok || !channels) {
+        m_device.logger().err("Analog player: invalid CSV file %s", filename.c_str());
+        return false;
+    }
+
+    m_buffer.swap(buffer);
+    m_data = m_buffer.data();
+    m_format = Format_Float32;
+    m_channels = channels;
+    m_count = m_buffer.size() / channels;
+
+    return true;
+}
+
+
+/**
+   Map a raw binary file of interleaved samples. The file is accessed read-only and is
+   not loaded in memory. A trailing incomplete sample is ignored.
+   \param filename path of the file
+   \param format format of the values
+   \param channels number of channels
+   \return true if the mapping succeeded
+ */
+bool AnalogStimulusPlayer::load_raw(const std::string& filename, Format format, unsigned int channels)
+{
+    close();
+
+    if (!channels) return false;
+
+    size_t file_size;
+    void* mapping;
+
+#if defined _WIN32
+
+    HANDLE fh = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fs;
+    if (!GetFileSizeEx(fh, &fs) || !fs.QuadPart) {
+        CloseHandle(fh);
+        return false;
+    }
+    file_size = fs.QuadPart;
+
+    HANDLE mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(fh);
+    if (!mh) return false;
+
+    mapping = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, file_size);
+    CloseHandle(mh);
+    if (!mapping) return false;
+
+#else
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) || !st.st_size) {
+        ::close(fd);
+        return false;
+    }
+    file_size = st.st_size;
+
+    mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+#endif
+
+    m_mapping = mapping;
+    m_mapping_size = file_size;
+    m_data = mapping;
+    m_format = format;
+    m_channels = channels;
+    m_count = file_size / ((format == Format_Int16 ? sizeof(int16_t) : sizeof(float)) * channels);
+
+    return true;
+}
+
+
+/**
+   Stop the player and release the samples.
+ */
+void AnalogStimulusPlayer::close()
+{
+    stop();
+
+    if (m_mapping) {
+#if defined _WIN32
+        UnmapViewOfFile(m_mapping);
+#else
+        munmap(m_mapping, m_mapping_size);
+#endif
+        m_mapping = nullptr;
+        m_mapping_size = 0;
+    }
+
+    m_buffer.clear();
+    m_data = nullptr;
+    m_channels = 0;
+    m_count = 0;
+}
+
+
+/**
+   Set the sample rate of the stream, in Hz. It is taken into account at the next start.
+ */
+void AnalogStimulusPlayer::set_sample_rate(double rate)
+{
+    m_rate = rate;
+}
+
+
+/**
+   Set the transformation applied to the sample values : value = sample * scale + offset.
+   For int16 samples, a scale of 1/32768 gives values in the range [-1.0; 1.0].
+ */
+void AnalogStimulusPlayer::set_scale(double scale, double offset)
+{
+    m_scale = scale;
+    m_offset = offset;
+}
+
+
+/**
+   Enable or disable the linear interpolation between samples for the pins in
+   on-demand mode. If disabled, the value of the last sample is applied.
+ */
+void AnalogStimulusPlayer::set_interpolation(bool enabled)
+{
+    m_interpolation = enabled;
+}
+
+
+/**
+   Enable or disable the repeat of the stream when the end is reached.
+ */
+void AnalogStimulusPlayer::set_repeat(bool enabled)
+{
+    m_repeat = enabled;
+}
+
+
+/**
+   Add a pin to drive with a channel of the stream.
+   \param pin pin to drive
+   \param channel index of the channel in the stream
+   \param mode update mode of the pin
+ */
+void AnalogStimulusPlayer::add_pin(Pin& pin, unsigned int channel, Mode mode)
+{
+    m_pins.push_back({ &pin, channel, mode, NAN });
+    if (mode == Mode_Timed)
+        m_has_timed = true;
+}
+
+
+/**
+   Attach an ADC to the player, so that the pins in on-demand mode are updated
+   each time the ADC is about to sample its inputs.
+   \param adc_id identifier of the ADC peripheral, e.g. AVR_IOCTL_ADC
+   \return true if the attachment succeeded
+ */
+bool AnalogStimulusPlayer::attach_adc(ctl_id_t adc_id)
+{
+    ctlreq_data_t reqdata;
+    if (!m_device.ctlreq(adc_id, AVR_CTLREQ_GET_SIGNAL, &reqdata))
+        return false;
+
+    Signal* signal = reinterpret_cast<Signal*>(reqdata.data.as_ptr());
+    if (!signal) return false;
+
+    signal->connect(*this);
+    return true;
+}
+
+
+/**
+   Start the playing of the stream from its first sample, at the current cycle.
+   The initial values are applied to all the pins.
+   \return true if the player is started
+ */
+bool AnalogStimulusPlayer::start()
+{
+    stop();
+
+    CycleManager* cm = m_device.cycle_manager();
+    if (!cm || !m_count || m_rate <= 0.0 || !m_device.frequency()) {
+        m_device.logger().err("Analog player: cannot start, no data or invalid sample rate");
+        return false;
+    }
+
+    m_start = cm->cycle();
+    m_period = m_device.frequency() / m_rate;
+    if (m_period < 1.0)
+        m_period = 1.0;
+
+    m_running = true;
+
+    for (auto& entry : m_pins)
+        apply(entry, value(entry.channel));
+
+    m_next_sample = 1;
+    if (m_has_timed && (m_repeat || m_count > 1))
+        cm->schedule(*this, sample_cycle(m_next_sample));
+
+    return true;
+}
+
+
+/**
+   Stop the player. The pins keep their last value.
+ */
+void AnalogStimulusPlayer::stop()
+{
+    m_running = false;
+
+    CycleManager* cm = m_device.cycle_manager();
+    if (cm)
+        cm->cancel(*this);
+}
+
+
+/**
+   Return the value of a channel at the current cycle, including the interpolation.
+   If the player is not running, the value of the first sample is returned.
+ */
+double AnalogStimulusPlayer::value(unsigned int channel) const
+{
+    if (!m_count || channel >= m_channels)
+        return 0.0;
+
+    CycleManager* cm = m_device.cycle_manager();
+    if (!m_running || !cm)
+        return sample(0, channel);
+
+    return value_at(cm->cycle(), channel);
+}
+
+
+double AnalogStimulusPlayer::sample(size_t index, unsigned int channel) const
+{
+    size_t pos = index * m_channels + channel;
+    double v;
+    if (m_format == Format_Int16)
+        v = ((const int16_t*) m_data)[pos];
+    else
+        v = ((const float*) m_data)[pos];
+    return v * m_scale + m_offset;
+}
+
+
+double AnalogStimulusPlayer::value_at(cycle_count_t cycle, unsigned int channel) const
+{
+    double t = (cycle - m_start) / m_period;
+    unsigned long long k = (unsigned long long) t;
+    double frac = t - k;
+
+    //Past the end of the stream, the last sample is held
+    if (!m_repeat && k >= m_count - 1)
+        return sample(m_count - 1, channel);
+
+    double v0 = sample(k % m_count, channel);
+    if (!m_interpolation || frac == 0.0)
+        return v0;
+
+    double v1 = sample((k + 1) % m_count, channel);
+    return v0 + (v1 - v0) * frac;
+}
+
+
+/*
+   Returns the first cycle at or after the start of the given sample.
+ */
+cycle_count_t AnalogStimulusPlayer::sample_cycle(unsigned long long index) const
+{
+    return m_start + (cycle_count_t) ceil(index * m_period);
+}
+
+
+void AnalogStimulusPlayer::apply(pin_entry_t& entry, double value)
+{
+    //Skip the pin update if the value is unchanged, which is common for slow waveforms
+    if (value == entry.last_value && entry.pin->external_state().state == Pin::State_Analog)
+        return;
+
+    entry.last_value = value;
+    entry.pin->set_external_state(Pin::State_Analog, value);
+}
+
+
+void AnalogStimulusPlayer::apply_on_demand()
+{
+    CycleManager* cm = m_device.cycle_manager();
+    if (!m_running || !cm) return;
+
+    cycle_count_t cycle = cm->cycle();
+    for (auto& entry : m_pins) {
+        if (entry.mode == Mode_OnDemand && entry.channel < m_channels)
+            apply(entry, value_at(cycle, entry.channel));
+    }
+}
+
+
+cycle_count_t AnalogStimulusPlayer::next(cycle_count_t when)
+{
+    size_t index = m_repeat ? (m_next_sample % m_count) : m_next_sample;
+    for (auto& entry : m_pins) {
+        if (entry.mode == Mode_Timed && entry.channel < m_channels)
+            apply(entry, sample(index, entry.channel));
+    }
+
+    ++m_next_sample;
+    if (!m_repeat && m_next_sample >= m_count)
+        return 0;
+
+    return sample_cycle(m_next_sample);
+}
+
+
+void AnalogStimulusPlayer::raised(const signal_data_t& sigdata, int)
+{
+    if (sigdata.sigid == ADC::Signal_AboutToSample)
+        apply_on_demand();
+}
@@ -0,0 +1,169 @@
+/*
+ * sim_analogplayer.h
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+#ifndef __YASIMAVR_ANALOGPLAYER_H__
+#define __YASIMAVR_ANALOGPLAYER_H__
+
+#include "../core/sim_device.h"
+#include <string>
+#include <vector>
+
+YASIMAVR_BEGIN_NAMESPACE
+
+
+//=======================================================================================
+/**
+   \brief Player of analog waveforms on device pins
+
+   The player reads a stream of samples at a fixed sample rate and applies the values
+   to pins as analog external states. The stream has one or more channels and can be
+   loaded from a CSV text file, or memory-mapped from a raw binary file of interleaved
+   float32 or int16 values (in the host byte order), so that very long recordings are
+   not loaded in memory. The values are transformed by a scale and offset and are
+   voltages relative to VCC, as for Pin::set_external_state().
+
+   Each pin is driven in one of two modes:
+    - On demand : the value is applied only when an ADC attached to the player is about
+      to sample its inputs, interpolated at the current cycle. No timer event is
+      required per sample.
+    - Timed : each sample is applied at its exact cycle by a cycle timer, which is
+      required for peripherals reacting to the voltage changes, like analog comparators.
+
+   At the end of the stream, the last values are held unless the repeat is enabled.
+ */
+class AVR_CORE_PUBLIC_API AnalogStimulusPlayer : public CycleTimer, public SignalHook {
+
+public:
+
+    enum Format {
+        Format_Float32 = 0,
+        Format_Int16,
+    };
+
+    enum Mode {
+        Mode_OnDemand = 0,
+        Mode_Timed,
+    };
+
+    explicit AnalogStimulusPlayer(Device& device);
+    virtual ~AnalogStimulusPlayer();
+
+    bool load_csv(const std::string& filename);
+    bool load_raw(const std::string& filename, Format format, unsigned int channels);
+    void close();
+
+    unsigned int channels() const;
+    size_t sample_count() const;
+
+    void set_sample_rate(double rate);
+    double sample_rate() const;
+    void set_scale(double scale, double offset = 0.0);
+    void set_interpolation(bool enabled);
+    void set_repeat(bool enabled);
+
+    void add_pin(Pin& pin, unsigned int channel, Mode mode = Mode_OnDemand);
+    bool attach_adc(ctl_id_t adc_id);
+
+    bool start();
+    void stop();
+    bool running() const;
+
+    double value(unsigned int channel) const;
+
+    virtual cycle_count_t next(cycle_count_t when) override;
+    virtual void raised(const signal_data_t& sigdata, int hooktag) override;
+
+    AnalogStimulusPlayer(const AnalogStimulusPlayer&) = delete;
+    AnalogStimulusPlayer& operator=(const AnalogStimulusPlayer&) = delete;
+
+private:
+
+    struct pin_entry_t {
+        Pin* pin;
+        unsigned int channel;
+        Mode mode;
+        double last_value;
+    };
+
+    Device& m_device;
+
+    //Sample data, either loaded in m_buffer or mapped from a file
+    std::vector<float> m_buffer;
+    const void* m_data;
+    Format m_format;
+    unsigned int m_channels;
+    size_t m_count;
+    void* m_mapping;
+    size_t m_mapping_size;
+
+    double m_rate;
+    double m_scale;
+    double m_offset;
+    bool m_interpolation;
+    bool m_repeat;
+
+    std::vector<pin_entry_t> m_pins;
+    bool m_has_timed;
+
+    bool m_running;
+    cycle_count_t m_start;
+    //Duration of a sample in cycles
+    double m_period;
+    //Index of the next sample to apply to the timed pins
+    unsigned long long m_next_sample;
+
+    double sample(size_t index, unsigned int channel) const;
+    double value_at(cycle_count_t cycle, unsigned int channel) const;
+    cycle_count_t sample_cycle(unsigned long long index) const;
+    void apply(pin_entry_t& entry, double value);
+    void apply_on_demand();
+
+};
+
+/// Returns the number of channels of the stream
+inline unsigned int AnalogStimulusPlayer::channels() const
+{
+    return m_channels;
+}
+
+/// Returns the number of samples of the stream, per channel
+inline size_t AnalogStimulusPlayer::sample_count() const
+{
+    return m_count;
+}
+
+/// Returns the sample rate, in Hz
+inline double AnalogStimulusPlayer::sample_rate() const
+{
+    return m_rate;
+}
+
+/// Returns true if the player is started
+inline bool AnalogStimulusPlayer::running() const
+{
+    return m_running;
+}
+
+
+YASIMAVR_END_NAMESPACE
+
+#endif //__YASIMAVR_ANALOGPLAYER_H__
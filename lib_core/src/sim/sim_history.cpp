@@ -0,0 +1,372 @@
+/*
+ * sim_history.cpp
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#include "sim_history.h"
+#include "../core/sim_core.h"
+#include "../core/sim_signal.h"
+
+YASIMAVR_USING_NAMESPACE
+
+
+//=======================================================================================
+
+/**
+   Construct the history.
+   \param probe debug probe attached to the device, used to preserve the breakpoints
+   \param interval number of cycles between two snapshots
+   \param max_count maximum number of snapshots kept, the oldest ones being discarded
+ */
+ExecutionHistory::ExecutionHistory(DeviceDebugProbe& probe, cycle_count_t interval, size_t max_count)
+:m_interval(interval > 0 ? interval : 1)
+,m_max_count(max_count > 0 ? max_count : 1)
+{
+    m_probe.attach(probe);
+}
+
+
+ExecutionHistory::~ExecutionHistory()
+{
+    m_probe.detach();
+}
+
+/**
+   Start recording the history. The current state of the device is captured
+   immediately, the following snapshots are captured periodically.
+   It must be called in-between two simulation loop steps.
+   \return true if the recording could be started
+ */
+bool ExecutionHistory::start()
+{
+    Device* device = m_probe.device();
+    if (!device || !device->cycle_manager()) return false;
+
+    CycleManager& cm = *device->cycle_manager();
+    cm.cancel(*this);
+    clear();
+    if (!capture(cm.cycle()))
+        return false;
+
+    cm.schedule(*this, cm.cycle() + m_interval);
+
+    return true;
+}
+
+/**
+   Stop recording the history. The snapshots already captured are kept.
+ */
+void ExecutionHistory::stop()
+{
+    Device* device = m_probe.device();
+    if (device && device->cycle_manager())
+        device->cycle_manager()->cancel(*this);
+}
+
+/**
+   Discard all the snapshots.
+ */
+void ExecutionHistory::clear()
+{
+    m_entries.clear();
+}
+
+cycle_count_t ExecutionHistory::next(cycle_count_t when)
+{
+    Device& device = *m_probe.device();
+    CycleManager& cm = *device.cycle_manager();
+
+    //The capture is deferred while other timers or deferred signals of the current
+    //cycle remain to be processed, the restored device would miss them.
+    cycle_count_t next_when = cm.next_when();
+    if ((next_when != INVALID_CYCLE && next_when <= cm.cycle()) || !cm.signal_queue().empty())
+        return cm.cycle() + 1;
+
+    //The timer is called after the execution of the current instruction but before
+    //the cycle counter is incremented. The execution resumes at the next instruction.
+    if (!capture(cm.cycle() + device.last_cycle_delta()))
+        return cm.cycle() + 1;
+
+    return cm.cycle() + m_interval;
+}
+
+bool ExecutionHistory::capture(cycle_count_t cycle)
+{
+    entry_t entry;
+    //Forking the last snapshot allows to share the pages that have not changed since
+    if (m_entries.size())
+        entry.snapshot = m_entries.back().snapshot.fork();
+    if (!entry.snapshot.capture(*m_probe.device()))
+        return false;
+    entry.cycle = cycle;
+
+    m_entries.push_back(std::move(entry));
+    if (m_entries.size() > m_max_count)
+        m_entries.pop_front();
+
+    return true;
+}
+
+/*
+ * Check that a snapshot and the current state of the cycle manager only involve
+ * timers that the snapshots restore. Any other timer would not be rewound.
+ */
+bool ExecutionHistory::can_restore(size_t index) const
+{
+    return !m_entries[index].snapshot.unsaved_timer_count() &&
+           !DeviceSnapshot::count_unsaved_timers(*m_probe.device());
+}
+
+bool ExecutionHistory::restore(size_t index)
+{
+    Device& device = *m_probe.device();
+    const entry_t& entry = m_entries[index];
+
+    //Backup the flash to keep the breakpoints inserted since the snapshot
+    flash_addr_t flash_size = device.config().core.flashend + 1;
+    std::vector<uint8_t> flash(flash_size);
+    m_probe.read_flash(0, flash.data(), flash_size);
+
+    if (!entry.snapshot.restore(device))
+        return false;
+
+    m_probe.write_flash(0, flash.data(), flash_size);
+    device.cycle_manager()->set_cycle(entry.cycle);
+
+    return true;
+}
+
+bool ExecutionHistory::is_break(flash_addr_t pc) const
+{
+    uint8_t opcode[2];
+    if (m_probe.read_flash(pc, opcode, 2) < 2) return false;
+    return (opcode[0] | (opcode[1] << 8)) == AVR_BREAK_OPCODE;
+}
+
+/*
+ * Execute one step of the simulation loop, in the same way as AbstractSimLoop.
+ * hit is set if a breakpoint or a watchpoint is hit by the step.
+ * Returns false if the execution cannot progress further.
+ */
+bool ExecutionHistory::step(bool& hit)
+{
+    Device& device = *m_probe.device();
+    CycleManager& cm = *device.cycle_manager();
+
+    if (device.state() == Device::State_Break)
+        m_probe.set_device_state(Device::State_Running);
+
+    //If the PC is on a breakpoint, the original instruction is restored
+    //for the time of its execution.
+    flash_addr_t pc = m_probe.read_pc();
+    bool on_bp = device.state() == Device::State_Running && is_break(pc);
+    //The breakpoint condition must be evaluated before the instruction executes
+    bool bp_active = on_bp && m_probe.test_breakpoint(pc);
+    DebugCondition bp_cond;
+    if (on_bp) {
+        bp_cond = m_probe.breakpoint_condition(pc);
+        m_probe.remove_breakpoint(pc);
+        //If the BREAK is still there, it's part of the firmware
+        if (is_break(pc)) {
+            hit = true;
+            return false;
+        }
+    }
+
+    cycle_count_t cycle_delta = device.exec_cycle();
+
+    if (on_bp) {
+        m_probe.insert_breakpoint(pc);
+        m_probe.set_breakpoint_condition(pc, bp_cond);
+    }
+
+    hit = (on_bp && bp_active) || device.state() == Device::State_Break;
+
+    if (!cycle_delta) return false;
+
+    cm.process_timers();
+
+    if (device.state() == Device::State_Sleeping) {
+        cycle_count_t next_timer_cycle = cm.next_when();
+        if (next_timer_cycle == INVALID_CYCLE) {
+            cm.increment_cycle(cycle_delta);
+            return false;
+        }
+        else if (next_timer_cycle > cm.cycle()) {
+            cycle_delta = next_timer_cycle - cm.cycle();
+        }
+    }
+
+    cm.increment_cycle(cycle_delta);
+
+    return true;
+}
+
+/*
+ * Restore a snapshot and re-execute until reaching the cycle 'until'.
+ * Returns the start cycle of the last step executed, or the snapshot cycle if none.
+ * If hit is not null, it is set to the start cycle of the last step that hit a
+ * breakpoint or a watchpoint, or INVALID_CYCLE if none.
+ */
+cycle_count_t ExecutionHistory::run_from(size_t index, cycle_count_t until, cycle_count_t* hit)
+{
+    if (hit) *hit = INVALID_CYCLE;
+    if (!restore(index)) return INVALID_CYCLE;
+
+    CycleManager& cm = *m_probe.device()->cycle_manager();
+    cycle_count_t last = cm.cycle();
+    while (cm.cycle() < until) {
+        cycle_count_t start = cm.cycle();
+        bool step_hit = false;
+        bool ok = step(step_hit);
+        last = start;
+        if (step_hit && hit)
+            *hit = start;
+        if (!ok) break;
+    }
+
+    return last;
+}
+
+/*
+ * Discard the snapshots now in the future.
+ */
+void ExecutionHistory::finish(cycle_count_t cycle)
+{
+    while (m_entries.size() > 1 && m_entries.back().cycle > cycle)
+        m_entries.pop_back();
+}
+
+/**
+   Move the execution back to the last instruction starting at or before a cycle.
+   \param cycle target cycle, must be in the past
+   \return Reverse_Done if the target was reached, Reverse_HistoryStart if the target
+   is older than the history (the device is then at the oldest snapshot),
+   or Reverse_Failed, for instance if a cycle timer cannot be rewound
+ */
+ExecutionHistory::Result ExecutionHistory::rewind_to(cycle_count_t cycle)
+{
+    Device* device = m_probe.device();
+    if (!device || !m_entries.size()) return Reverse_Failed;
+
+    CycleManager& cm = *device->cycle_manager();
+    if (cycle >= cm.cycle()) return Reverse_Failed;
+
+    bool recording = scheduled();
+    cm.cancel(*this);
+
+    Result result;
+    size_t index = m_entries.size();
+    while (index > 0 && m_entries[index - 1].cycle > cycle)
+        --index;
+
+    if (!can_restore(index ? index - 1 : 0)) {
+        result = Reverse_Failed;
+    }
+    else if (!index) {
+        result = restore(0) ? Reverse_HistoryStart : Reverse_Failed;
+    } else {
+        //First run to find the start of the target instruction, then run again
+        //to stop on it.
+        --index;
+        cycle_count_t target = run_from(index, cycle + 1, nullptr);
+        if (target != INVALID_CYCLE && run_from(index, target, nullptr) != INVALID_CYCLE)
+            result = Reverse_Done;
+        else
+            result = Reverse_Failed;
+    }
+
+    finish(cm.cycle());
+    if (recording)
+        cm.schedule(*this, cm.cycle() + m_interval);
+
+    return result;
+}
+
+/**
+   Move the execution back by one instruction.
+   \return Reverse_Done if successful, Reverse_HistoryStart if the current position
+   is the start of the history, or Reverse_Failed
+ */
+ExecutionHistory::Result ExecutionHistory::reverse_step()
+{
+    Device* device = m_probe.device();
+    if (!device || !m_entries.size()) return Reverse_Failed;
+
+    cycle_count_t cycle = device->cycle_manager()->cycle();
+    if (cycle <= m_entries.front().cycle)
+        return Reverse_HistoryStart;
+
+    return rewind_to(cycle - 1);
+}
+
+/**
+   Move the execution back to the last breakpoint or watchpoint hit.
+   For a watchpoint, the execution stops on the instruction that triggered it.
+   \return Reverse_Break if a hit was found, Reverse_HistoryStart if not (the device
+   is then at the oldest snapshot), or Reverse_Failed
+ */
+ExecutionHistory::Result ExecutionHistory::reverse_continue()
+{
+    Device* device = m_probe.device();
+    if (!device || !m_entries.size()) return Reverse_Failed;
+
+    CycleManager& cm = *device->cycle_manager();
+    bool recording = scheduled();
+    cm.cancel(*this);
+
+    //Scan the history segments, from the most recent one, for the last hit
+    Result result = Reverse_HistoryStart;
+    cycle_count_t upper = cm.cycle();
+    size_t index = m_entries.size();
+    while (index > 0) {
+        --index;
+        if (m_entries[index].cycle >= upper) continue;
+
+        if (!can_restore(index)) {
+            result = Reverse_Failed;
+            break;
+        }
+
+        cycle_count_t hit;
+        if (run_from(index, upper, &hit) == INVALID_CYCLE) {
+            result = Reverse_Failed;
+            break;
+        }
+
+        if (hit != INVALID_CYCLE) {
+            run_from(index, hit, nullptr);
+            result = Reverse_Break;
+            break;
+        }
+
+        upper = m_entries[index].cycle;
+    }
+
+    if (result == Reverse_HistoryStart && (!can_restore(0) || !restore(0)))
+        result = Reverse_Failed;
+
+    finish(cm.cycle());
+    if (recording)
+        cm.schedule(*this, cm.cycle() + m_interval);
+
+    return result;
+}
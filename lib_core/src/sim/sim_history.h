@@ -0,0 +1,136 @@
+/*
+ * sim_history.h
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#ifndef __YASIMAVR_HISTORY_H__
+#define __YASIMAVR_HISTORY_H__
+
+#include "../core/sim_snapshot.h"
+#include "../core/sim_debug.h"
+#include <deque>
+
+YASIMAVR_BEGIN_NAMESPACE
+
+
+//=======================================================================================
+/**
+   \brief Execution history for reverse debugging
+
+   The history captures a snapshot of the device every 'interval' cycles, keeping
+   at most a given number of them. Consecutive snapshots share their unchanged
+   memory pages.
+   Going back in time is done by restoring the nearest snapshot before the target
+   cycle and re-executing the firmware from there, which is deterministic.
+   The flash content is preserved across the moves so that the breakpoints
+   currently inserted are kept.
+
+   The re-execution is exact for the CPU, the memories and the peripherals
+   implementing Peripheral::save_state() and Peripheral::load_state(), whose cycle
+   timers are restored by the snapshots with their scheduling.
+   A snapshot is only captured once all the timers and deferred signals of the
+   current cycle have been processed. Moving back fails if other cycle timers, not
+   declared by a peripheral, are scheduled at the time of the move or were at the
+   time of the snapshot capture, since they cannot be rewound.
+
+   The device must not be run by a simulation loop during the calls to rewind_to(),
+   reverse_step() and reverse_continue().
+ */
+class AVR_CORE_PUBLIC_API ExecutionHistory : public CycleTimer {
+
+public:
+
+    enum Result {
+        ///The move failed, the device state is unchanged
+        Reverse_Failed = 0,
+        ///The target was reached
+        Reverse_Done,
+        ///A breakpoint or a watchpoint was hit
+        Reverse_Break,
+        ///The start of the history was reached
+        Reverse_HistoryStart,
+    };
+
+    ExecutionHistory(DeviceDebugProbe& probe, cycle_count_t interval, size_t max_count = 64);
+    virtual ~ExecutionHistory();
+
+    bool start();
+    void stop();
+    void clear();
+
+    cycle_count_t interval() const;
+    size_t count() const;
+    cycle_count_t oldest_cycle() const;
+
+    Result rewind_to(cycle_count_t cycle);
+    Result reverse_step();
+    Result reverse_continue();
+
+    virtual cycle_count_t next(cycle_count_t when) override;
+
+    ExecutionHistory(const ExecutionHistory&) = delete;
+    ExecutionHistory& operator=(const ExecutionHistory&) = delete;
+
+private:
+
+    struct entry_t {
+        DeviceSnapshot snapshot;
+        //Cycle at which the execution resumes from the snapshot
+        cycle_count_t cycle;
+    };
+
+    DeviceDebugProbe m_probe;
+    cycle_count_t m_interval;
+    size_t m_max_count;
+    std::deque<entry_t> m_entries;
+
+    bool capture(cycle_count_t cycle);
+    bool can_restore(size_t index) const;
+    bool restore(size_t index);
+    bool step(bool& hit);
+    cycle_count_t run_from(size_t index, cycle_count_t until, cycle_count_t* hit);
+    void finish(cycle_count_t cycle);
+    bool is_break(flash_addr_t pc) const;
+
+};
+
+/// Returns the number of cycles between two snapshots
+inline cycle_count_t ExecutionHistory::interval() const
+{
+    return m_interval;
+}
+
+/// Returns the number of snapshots in the history
+inline size_t ExecutionHistory::count() const
+{
+    return m_entries.size();
+}
+
+/// Returns the cycle of the oldest snapshot, or INVALID_CYCLE if the history is empty
+inline cycle_count_t ExecutionHistory::oldest_cycle() const
+{
+    return m_entries.size() ? m_entries.front().cycle : INVALID_CYCLE;
+}
+
+
+YASIMAVR_END_NAMESPACE
+
+#endif //__YASIMAVR_HISTORY_H__
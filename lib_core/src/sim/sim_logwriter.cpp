@@ -0,0 +1,694 @@
+/*
+ * sim_logwriter.cpp
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#include "sim_logwriter.h"
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+
+YASIMAVR_USING_NAMESPACE
+
+
+//=======================================================================================
+
+//Maximum size of a record, the arguments being truncated beyond
+#define MAX_RECORD_SIZE         1024
+//Maximum size of a formatted argument
+#define MAX_FORMATTED_SIZE      512
+//Polling period of the background thread when the buffer is empty
+#define IDLE_PERIOD             std::chrono::milliseconds(1)
+
+static const char BINARY_MAGIC[8] = { 'Y', 'S', 'A', 'L', 'O', 'G', 1, 0 };
+
+enum {
+    Tag_Format = 'F',
+    Tag_Message = 'M',
+};
+
+//Header of the records in the ring buffer, followed by the format string
+//(with its terminating zero) and the packed arguments
+struct record_header_t {
+    uint32_t size;
+    int32_t level;
+    ctl_id_t id;
+    cycle_count_t cycle;
+    uint32_t format_len;
+};
+
+
+//=======================================================================================
+//Format string parsing, shared by the producer side to extract the raw arguments and by
+//the consumer side to format them.
+
+enum ArgType {
+    //No argument, the conversion is written verbatim
+    Arg_None,
+    Arg_Int,
+    Arg_Long,
+    Arg_LongLong,
+    Arg_IntMax,
+    Arg_Size,
+    Arg_PtrDiff,
+    Arg_Double,
+    Arg_LongDouble,
+    Arg_Pointer,
+    Arg_String,
+    //Pointer argument consumed but not printed (%n, wide strings)
+    Arg_Skip,
+};
+
+struct conversion_t {
+    //Start ('%') and end (after the conversion character) of the specification
+    const char* start;
+    const char* end;
+    //Number of '*' for the width and the precision
+    int stars;
+    ArgType type;
+};
+
+/*
+ * Find the next conversion in a format string, starting at p.
+ * On return, p points after the conversion.
+ */
+static bool next_conversion(const char*& p, conversion_t& conv)
+{
+    while (*p) {
+        if (*p != '%') {
+            ++p;
+            continue;
+        }
+
+        conv.start = p++;
+        if (*p == '%') {
+            ++p;
+            continue;
+        }
+
+        conv.stars = 0;
+
+        //Flags
+        while (*p && strchr("-+ #0'", *p)) ++p;
+        //Width
+        if (*p == '*') {
+            ++conv.stars;
+            ++p;
+        } else {
+            while (*p >= '0' && *p <= '9') ++p;
+        }
+        //Precision
+        if (*p == '.') {
+            ++p;
+            if (*p == '*') {
+                ++conv.stars;
+                ++p;
+            } else {
+                while (*p >= '0' && *p <= '9') ++p;
+            }
+        }
+
+        //Length modifier
+        enum { L_None, L_Char, L_Short, L_Long, L_LongLong, L_IntMax, L_Size, L_PtrDiff, L_Double } len = L_None;
+        switch (*p) {
+            case 'h': ++p; if (*p == 'h') { ++p; len = L_Char; } else len = L_Short; break;
+            case 'l': ++p; if (*p == 'l') { ++p; len = L_LongLong; } else len = L_Long; break;
+            case 'q': ++p; len = L_LongLong; break;
+            case 'j': ++p; len = L_IntMax; break;
+            case 'z': ++p; len = L_Size; break;
+            case 't': ++p; len = L_PtrDiff; break;
+            case 'L': ++p; len = L_Double; break;
+        }
+
+        //Conversion
+        char c = *p;
+        if (c) ++p;
+        conv.end = p;
+
+        switch (c) {
+            case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+                switch (len) {
+                    case L_Long: conv.type = Arg_Long; break;
+                    case L_LongLong: conv.type = Arg_LongLong; break;
+                    case L_IntMax: conv.type = Arg_IntMax; break;
+                    case L_Size: conv.type = Arg_Size; break;
+                    case L_PtrDiff: conv.type = Arg_PtrDiff; break;
+                    default: conv.type = Arg_Int; break;
+                }
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                conv.type = (len == L_Double) ? Arg_LongDouble : Arg_Double;
+                break;
+            case 's':
+                conv.type = (len == L_Long) ? Arg_Skip : Arg_String;
+                break;
+            case 'p':
+                conv.type = Arg_Pointer;
+                break;
+            case 'n':
+                conv.type = Arg_Skip;
+                break;
+            default:
+                conv.type = Arg_None;
+                conv.stars = 0;
+                break;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+
+//Sequential writer of raw arguments, with bound check
+class ArgPacker {
+
+public:
+
+    ArgPacker(uint8_t* buf, size_t size) : m_buf(buf), m_size(size), m_pos(0), m_full(false) {}
+
+    template<typename T>
+    void put(T v)
+    {
+        if (m_full || m_pos + sizeof(T) > m_size) {
+            m_full = true;
+            return;
+        }
+        memcpy(m_buf + m_pos, &v, sizeof(T));
+        m_pos += sizeof(T);
+    }
+
+    void put_string(const char* s)
+    {
+        if (!s) s = "(null)";
+        size_t avail = (m_pos + sizeof(uint32_t) < m_size) ? (m_size - m_pos - sizeof(uint32_t)) : 0;
+        size_t n = strlen(s);
+        if (n > avail) n = avail;
+        put<uint32_t>(n);
+        if (m_full) return;
+        memcpy(m_buf + m_pos, s, n);
+        m_pos += n;
+    }
+
+    size_t size() const { return m_pos; }
+
+private:
+
+    uint8_t* m_buf;
+    size_t m_size;
+    size_t m_pos;
+    bool m_full;
+
+};
+
+
+//Sequential reader of raw arguments, with bound check
+class ArgReader {
+
+public:
+
+    ArgReader(const uint8_t* buf, size_t size) : m_buf(buf), m_size(size), m_pos(0) {}
+
+    template<typename T>
+    bool get(T& v)
+    {
+        if (m_pos + sizeof(T) > m_size) return false;
+        memcpy(&v, m_buf + m_pos, sizeof(T));
+        m_pos += sizeof(T);
+        return true;
+    }
+
+    bool get_string(std::string& s)
+    {
+        uint32_t n;
+        if (!get(n) || m_pos + n > m_size) return false;
+        s.assign((const char*) m_buf + m_pos, n);
+        m_pos += n;
+        return true;
+    }
+
+private:
+
+    const uint8_t* m_buf;
+    size_t m_size;
+    size_t m_pos;
+
+};
+
+
+/*
+ * Extract the raw arguments from a va_list, according to the format string.
+ * Returns the size of the packed data.
+ */
+static size_t pack_args(const char* fmt, std::va_list args, uint8_t* buf, size_t size)
+{
+    ArgPacker packer(buf, size);
+    const char* p = fmt;
+    conversion_t conv;
+
+    while (next_conversion(p, conv)) {
+        for (int i = 0; i < conv.stars; ++i)
+            packer.put<int>(va_arg(args, int));
+
+        switch (conv.type) {
+            case Arg_Int: packer.put<long long>(va_arg(args, int)); break;
+            case Arg_Long: packer.put<long long>(va_arg(args, long)); break;
+            case Arg_LongLong: packer.put<long long>(va_arg(args, long long)); break;
+            case Arg_IntMax: packer.put<intmax_t>(va_arg(args, intmax_t)); break;
+            case Arg_Size: packer.put<size_t>(va_arg(args, size_t)); break;
+            case Arg_PtrDiff: packer.put<ptrdiff_t>(va_arg(args, ptrdiff_t)); break;
+            case Arg_Double: packer.put<double>(va_arg(args, double)); break;
+            case Arg_LongDouble: packer.put<long double>(va_arg(args, long double)); break;
+            case Arg_Pointer: packer.put<void*>(va_arg(args, void*)); break;
+            case Arg_String: packer.put_string(va_arg(args, const char*)); break;
+            case Arg_Skip: va_arg(args, void*); break;
+            default: break;
+        }
+    }
+
+    return packer.size();
+}
+
+
+template<typename T>
+static void format_value(std::string& out, const char* spec, int stars, const int* w, T v)
+{
+    char buf[MAX_FORMATTED_SIZE];
+    int n;
+    if (stars == 2)
+        n = snprintf(buf, sizeof(buf), spec, w[0], w[1], v);
+    else if (stars == 1)
+        n = snprintf(buf, sizeof(buf), spec, w[0], v);
+    else
+        n = snprintf(buf, sizeof(buf), spec, v);
+
+    if (n > 0)
+        out.append(buf, ((size_t) n < sizeof(buf)) ? n : (sizeof(buf) - 1));
+}
+
+
+//Append a literal part of a format string, unescaping the '%%' sequences
+static void append_literal(std::string& out, const char* start, const char* end)
+{
+    while (start < end) {
+        out.push_back(*start);
+        start += (start[0] == '%' && start + 1 < end && start[1] == '%') ? 2 : 1;
+    }
+}
+
+
+/*
+ * Format a message from the format string and the packed arguments.
+ */
+static void format_message(const char* fmt, const uint8_t* args, size_t size, std::string& out)
+{
+    ArgReader reader(args, size);
+    const char* p = fmt;
+    const char* lit = fmt;
+    conversion_t conv;
+
+    while (next_conversion(p, conv)) {
+        append_literal(out, lit, conv.start);
+        lit = conv.end;
+
+        if (conv.type == Arg_None) {
+            out.append(conv.start, conv.end - conv.start);
+            continue;
+        }
+
+        char spec[32];
+        size_t spec_len = conv.end - conv.start;
+        if (spec_len >= sizeof(spec)) {
+            out.append("<?>");
+            return;
+        }
+        memcpy(spec, conv.start, spec_len);
+        spec[spec_len] = 0;
+
+        int w[2] = { 0, 0 };
+        bool ok = true;
+        for (int i = 0; i < conv.stars; ++i)
+            ok = ok && reader.get(w[i]);
+
+        switch (conv.type) {
+            case Arg_Int: { long long v; if ((ok = ok && reader.get(v))) format_value(out, spec, conv.stars, w, (int) v); } break;
+            case Arg_Long: { long long v; if ((ok = ok && reader.get(v))) format_value(out, spec, conv.stars, w, (long) v); } break;
+            case Arg_LongLong: { long long v; if ((ok = ok && reader.get(v))) format_value(out, spec, conv.stars, w, v); } break;
+            case Arg_IntMax: { intmax_t v; if ((ok = ok && reader.get(v))) format_value(out, spec, conv.stars, w, v); } break;
+            case Arg_Size: { size_t v; if ((ok = ok && reader.get(v))) format_value(out, spec, conv.stars, w, v); } break;
+            case Arg_PtrDiff: { ptrdiff_t v; if ((ok = ok && reader.get(v))) format_value(out, spec, conv.stars, w, v); } break;
+            case Arg_Double: { double v; if ((ok = ok && reader.get(v))) format_value(out, spec, conv.stars, w, v); } break;
+            case Arg_LongDouble: { long double v; if ((ok = ok && reader.get(v))) format_value(out, spec, conv.stars, w, v); } break;
+            case Arg_Pointer: { void* v; if ((ok = ok && reader.get(v))) format_value(out, spec, conv.stars, w, v); } break;
+            case Arg_String: { std::string v; if ((ok = ok && reader.get_string(v))) format_value(out, spec, conv.stars, w, v.c_str()); } break;
+            default: break;
+        }
+
+        //The arguments were truncated by the producer
+        if (!ok) {
+            out.append("...");
+            return;
+        }
+    }
+
+    append_literal(out, lit, p);
+}
+
+
+//Returns the string of an id, using a cache to avoid converting it for every message
+static const char* id_name(std::unordered_map<ctl_id_t, std::string>& cache, ctl_id_t id)
+{
+    if (!id) return "";
+    auto it = cache.find(id);
+    if (it == cache.end())
+        it = cache.emplace(id, id_to_str(id)).first;
+    return it->second.c_str();
+}
+
+
+static void write_text_line(std::FILE* f, cycle_count_t cycle, int level, const char* sid, const std::string& msg)
+{
+    fprintf(f, "[%08lld] %s %s : %s\n", cycle, LogWriter::level_name(level), sid, msg.c_str());
+}
+
+
+//=======================================================================================
+
+/**
+   Construct the writer. It must then be opened to start the background thread.
+   \param buffer_size size in bytes of the ring buffer, rounded up to a power of 2
+ */
+AsyncLogWriter::AsyncLogWriter(size_t buffer_size)
+:m_head(0)
+,m_tail(0)
+,m_synced(0)
+,m_running(false)
+,m_file(nullptr)
+,m_format(Format_Text)
+{
+    size_t n = 4 * MAX_RECORD_SIZE;
+    while (n < buffer_size) n <<= 1;
+    m_buffer.resize(n);
+    m_write_lock.clear();
+}
+
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+    close();
+}
+
+/**
+   Open the output and start the background thread. If the writer is already opened,
+   it is closed first.
+   \param filename path of the output file, if empty the output is the standard output
+   \param format output format
+   \return true if the output could be opened
+ */
+bool AsyncLogWriter::open(const std::string& filename, Format format)
+{
+    close();
+
+    if (filename.empty()) {
+        m_file = stdout;
+    } else {
+        m_file = fopen(filename.c_str(), format == Format_Binary ? "wb" : "w");
+        if (!m_file) return false;
+    }
+
+    m_format = format;
+    m_format_ids.clear();
+    m_id_names.clear();
+    if (format == Format_Binary)
+        fwrite(BINARY_MAGIC, 1, sizeof(BINARY_MAGIC), m_file);
+
+    m_running.store(true);
+    m_thread = std::thread(&AsyncLogWriter::run, this);
+
+    return true;
+}
+
+/**
+   Write all the pending records, stop the background thread and close the output.
+   It must not be called while a simulation thread is still logging.
+ */
+void AsyncLogWriter::close()
+{
+    if (!m_running.load()) return;
+
+    m_running.store(false);
+    m_thread.join();
+
+    if (m_file != stdout)
+        fclose(m_file);
+    else
+        fflush(m_file);
+    m_file = nullptr;
+}
+
+/**
+   Wait until all the records written so far are output.
+ */
+void AsyncLogWriter::flush()
+{
+    size_t head = m_head.load(std::memory_order_acquire);
+    while (m_running.load() && m_synced.load(std::memory_order_acquire) < head)
+        std::this_thread::sleep_for(IDLE_PERIOD);
+}
+
+/**
+   Enqueue a record. The format string and the raw arguments are copied into
+   the record, the formatting is done by the background thread.
+ */
+void AsyncLogWriter::write(cycle_count_t cycle, int level, ctl_id_t id, const char* format, std::va_list args)
+{
+    if (!m_running.load(std::memory_order_relaxed)) {
+        LogWriter::write(cycle, level, id, format, args);
+        return;
+    }
+
+    //The format string is copied as well because the formats passed on from
+    //the Python side are temporary. An over-long format is truncated and the
+    //arguments are packed from the truncated copy, so that they match the
+    //conversions seen by the formatting.
+    uint8_t record[MAX_RECORD_SIZE];
+    size_t format_len = strlen(format);
+    if (format_len > MAX_RECORD_SIZE / 2)
+        format_len = MAX_RECORD_SIZE / 2;
+    record_header_t hdr = { 0, level, id, cycle, (uint32_t) format_len };
+    char* stored_format = (char*) record + sizeof(hdr);
+    memcpy(stored_format, format, format_len);
+    stored_format[format_len] = 0;
+    size_t args_ofs = sizeof(hdr) + format_len + 1;
+    hdr.size = args_ofs + pack_args(stored_format, args, record + args_ofs, MAX_RECORD_SIZE - args_ofs);
+    memcpy(record, &hdr, sizeof(hdr));
+
+    while (m_write_lock.test_and_set(std::memory_order_acquire))
+        std::this_thread::yield();
+
+    //If the ring buffer is full, wait for the background thread to consume
+    size_t head = m_head.load(std::memory_order_relaxed);
+    while (m_buffer.size() - (head - m_tail.load(std::memory_order_acquire)) < hdr.size)
+        std::this_thread::yield();
+
+    ring_write(head, record, hdr.size);
+    m_head.store(head + hdr.size, std::memory_order_release);
+
+    m_write_lock.clear(std::memory_order_release);
+}
+
+void AsyncLogWriter::ring_write(size_t pos, const uint8_t* buf, size_t len)
+{
+    size_t mask = m_buffer.size() - 1;
+    size_t ofs = pos & mask;
+    size_t n = std::min(len, m_buffer.size() - ofs);
+    memcpy(m_buffer.data() + ofs, buf, n);
+    memcpy(m_buffer.data(), buf + n, len - n);
+}
+
+void AsyncLogWriter::ring_read(size_t pos, uint8_t* buf, size_t len) const
+{
+    size_t mask = m_buffer.size() - 1;
+    size_t ofs = pos & mask;
+    size_t n = std::min(len, m_buffer.size() - ofs);
+    memcpy(buf, m_buffer.data() + ofs, n);
+    memcpy(buf + n, m_buffer.data(), len - n);
+}
+
+/*
+ * Body of the background thread
+ */
+void AsyncLogWriter::run()
+{
+    uint8_t record[MAX_RECORD_SIZE];
+
+    while (true) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t head = m_head.load(std::memory_order_acquire);
+
+        if (tail == head) {
+            //The output is flushed only when the buffer is empty, to write by batches
+            if (m_synced.load(std::memory_order_relaxed) != tail) {
+                fflush(m_file);
+                m_synced.store(tail, std::memory_order_release);
+            }
+
+            if (!m_running.load(std::memory_order_acquire)) {
+                //Last check for records written just before stopping
+                if (m_head.load(std::memory_order_acquire) == tail)
+                    break;
+            } else {
+                std::this_thread::sleep_for(IDLE_PERIOD);
+            }
+            continue;
+        }
+
+        while (tail != head) {
+            uint32_t size;
+            ring_read(tail, (uint8_t*) &size, sizeof(size));
+            ring_read(tail, record, size);
+            tail += size;
+            m_tail.store(tail, std::memory_order_release);
+            process(record, size);
+        }
+    }
+}
+
+/*
+ * Output a record, formatted in text or in binary
+ */
+void AsyncLogWriter::process(const uint8_t* record, size_t len)
+{
+    record_header_t hdr;
+    memcpy(&hdr, record, sizeof(hdr));
+    const char* format = (const char*) record + sizeof(hdr);
+    const uint8_t* args = record + sizeof(hdr) + hdr.format_len + 1;
+    uint32_t args_size = len - sizeof(hdr) - hdr.format_len - 1;
+
+    if (m_format == Format_Text) {
+        m_message.clear();
+        format_message(format, args, args_size, m_message);
+        write_text_line(m_file, hdr.cycle, hdr.level, id_name(m_id_names, hdr.id), m_message);
+        return;
+    }
+
+    //For the binary format, the format strings are written once, and referred by an index
+    auto it = m_format_ids.find(format);
+    uint32_t fmt_index;
+    if (it == m_format_ids.end()) {
+        fmt_index = m_format_ids.size();
+        m_format_ids[format] = fmt_index;
+        uint32_t fmt_len = hdr.format_len;
+        fputc(Tag_Format, m_file);
+        fwrite(&fmt_index, sizeof(fmt_index), 1, m_file);
+        fwrite(&fmt_len, sizeof(fmt_len), 1, m_file);
+        fwrite(format, 1, fmt_len, m_file);
+    } else {
+        fmt_index = it->second;
+    }
+
+    int32_t level = hdr.level;
+    uint32_t id = hdr.id;
+    int64_t cycle = hdr.cycle;
+    fputc(Tag_Message, m_file);
+    fwrite(&fmt_index, sizeof(fmt_index), 1, m_file);
+    fwrite(&level, sizeof(level), 1, m_file);
+    fwrite(&id, sizeof(id), 1, m_file);
+    fwrite(&cycle, sizeof(cycle), 1, m_file);
+    fwrite(&args_size, sizeof(args_size), 1, m_file);
+    fwrite(args, 1, args_size, m_file);
+}
+
+/**
+   Convert a binary log file to text.
+   \param in_filename path of the binary log file
+   \param out_filename path of the text file, if empty the text is written to the
+   standard output
+   \return true if the conversion succeeded
+ */
+bool AsyncLogWriter::decode(const std::string& in_filename, const std::string& out_filename)
+{
+    std::FILE* fin = fopen(in_filename.c_str(), "rb");
+    if (!fin) return false;
+
+    char magic[sizeof(BINARY_MAGIC)];
+    if (fread(magic, 1, sizeof(magic), fin) != sizeof(magic) || memcmp(magic, BINARY_MAGIC, sizeof(magic))) {
+        fclose(fin);
+        return false;
+    }
+
+    std::FILE* fout = out_filename.empty() ? stdout : fopen(out_filename.c_str(), "w");
+    if (!fout) {
+        fclose(fin);
+        return false;
+    }
+
+    std::vector<std::string> formats;
+    std::vector<uint8_t> args;
+    std::unordered_map<ctl_id_t, std::string> id_names;
+    bool ok = true;
+    int tag;
+    while (ok && (tag = fgetc(fin)) != EOF) {
+        uint32_t index;
+        ok = fread(&index, sizeof(index), 1, fin) == 1;
+        if (!ok) break;
+
+        if (tag == Tag_Format) {
+            uint32_t len;
+            ok = fread(&len, sizeof(len), 1, fin) == 1 && index == formats.size();
+            if (!ok) break;
+            std::string s(len, '\0');
+            ok = fread(&s[0], 1, len, fin) == len;
+            formats.push_back(s);
+        }
+        else if (tag == Tag_Message) {
+            int32_t level;
+            uint32_t id, args_size;
+            int64_t cycle;
+            ok = fread(&level, sizeof(level), 1, fin) == 1 &&
+                 fread(&id, sizeof(id), 1, fin) == 1 &&
+                 fread(&cycle, sizeof(cycle), 1, fin) == 1 &&
+                 fread(&args_size, sizeof(args_size), 1, fin) == 1 &&
+                 index < formats.size() && args_size <= MAX_RECORD_SIZE;
+            if (!ok) break;
+            args.resize(args_size);
+            ok = fread(args.data(), 1, args_size, fin) == args_size;
+            if (!ok) break;
+
+            std::string msg;
+            format_message(formats[index].c_str(), args.data(), args_size, msg);
+            write_text_line(fout, cycle, level, id_name(id_names, id), msg);
+        }
+        else {
+            ok = false;
+        }
+    }
+
+    fclose(fin);
+    if (fout != stdout)
+        fclose(fout);
+    else
+        fflush(fout);
+
+    return ok;
+}
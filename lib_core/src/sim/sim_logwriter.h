@@ -0,0 +1,126 @@
+/*
+ * sim_logwriter.h
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#ifndef __YASIMAVR_LOGWRITER_H__
+#define __YASIMAVR_LOGWRITER_H__
+
+#include "../core/sim_logger.h"
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdio>
+
+YASIMAVR_BEGIN_NAMESPACE
+
+
+//=======================================================================================
+/**
+   \brief Asynchronous log writer
+
+   Log writer moving the formatting and the output of the messages out of the
+   simulation thread.
+   The writer does not format the messages. It copies the format string, the level, the id,
+   the cycle and the raw arguments into a lock-free ring buffer, consumed by a background
+   thread which formats and writes the records. String arguments are copied as well,
+   truncated if very long.
+   If the ring buffer is full, write() waits for the background thread to free space so
+   that no message is lost.
+
+   The output is either text, identical to the default writer, or binary. The binary
+   format is compact and can be converted to text offline with decode(), on the same
+   platform.
+
+   When the writer is not opened, the messages are written synchronously
+   by the default implementation.
+ */
+class AVR_CORE_PUBLIC_API AsyncLogWriter : public LogWriter {
+
+public:
+
+    enum Format {
+        Format_Text = 0,
+        Format_Binary,
+    };
+
+    explicit AsyncLogWriter(size_t buffer_size = 0x100000);
+    virtual ~AsyncLogWriter();
+
+    bool open(const std::string& filename = "", Format format = Format_Text);
+    void close();
+    bool is_open() const;
+
+    void flush();
+
+    virtual void write(cycle_count_t cycle,
+                       int level,
+                       ctl_id_t id,
+                       const char* format,
+                       std::va_list args) override;
+
+    static bool decode(const std::string& in_filename, const std::string& out_filename = "");
+
+    AsyncLogWriter(const AsyncLogWriter&) = delete;
+    AsyncLogWriter& operator=(const AsyncLogWriter&) = delete;
+
+private:
+
+    //Ring buffer, its size is a power of 2
+    std::vector<uint8_t> m_buffer;
+    //Total number of bytes written by the producers
+    std::atomic<size_t> m_head;
+    //Total number of bytes consumed by the background thread
+    std::atomic<size_t> m_tail;
+    //Position up to which the records have been written to the file
+    std::atomic<size_t> m_synced;
+    //Flag serializing the producers, in case several threads are logging
+    std::atomic_flag m_write_lock;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+
+    std::FILE* m_file;
+    Format m_format;
+    //Indexes of the format strings already written in the binary output
+    std::unordered_map<std::string, uint32_t> m_format_ids;
+    //Cache of the id strings and buffer for the messages, used for the text format
+    std::unordered_map<ctl_id_t, std::string> m_id_names;
+    std::string m_message;
+
+    void ring_write(size_t pos, const uint8_t* buf, size_t len);
+    void ring_read(size_t pos, uint8_t* buf, size_t len) const;
+    void run();
+    void process(const uint8_t* record, size_t len);
+
+};
+
+/// Returns true if the writer is opened and the background thread is running
+inline bool AsyncLogWriter::is_open() const
+{
+    return m_running.load(std::memory_order_relaxed);
+}
+
+
+YASIMAVR_END_NAMESPACE
+
+#endif //__YASIMAVR_LOGWRITER_H__
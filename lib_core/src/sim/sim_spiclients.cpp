@@ -0,0 +1,634 @@
+/*
+ * sim_spiclients.cpp
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#include "sim_spiclients.h"
+#include <algorithm>
+#include <cstring>
+
+YASIMAVR_USING_NAMESPACE
+
+
+//=======================================================================================
+
+SPIClientModel::SPIClientModel()
+:m_select_pin(nullptr)
+,m_selected(false)
+{}
+
+/**
+   Set the pin driving the chip select, active low.
+   \param pin device pin to use as chip select, or null to drive the selection with set_selected()
+ */
+void SPIClientModel::set_select_pin(Pin* pin)
+{
+    if (m_select_pin)
+        m_select_pin->signal().disconnect(*this);
+
+    m_select_pin = pin;
+
+    if (pin) {
+        pin->signal().connect(*this);
+        set_selected(!pin->digital_state());
+    }
+}
+
+/**
+   Set the chip select state.
+ */
+void SPIClientModel::set_selected(bool selected)
+{
+    if (selected != m_selected) {
+        m_selected = selected;
+        select_changed(selected);
+    }
+}
+
+bool SPIClientModel::selected() const
+{
+    return m_selected;
+}
+
+void SPIClientModel::end_transfer(bool)
+{}
+
+void SPIClientModel::raised(const signal_data_t& sigdata, int)
+{
+    if (sigdata.sigid == Pin::Signal_DigitalChange)
+        set_selected(!m_select_pin->digital_state());
+}
+
+
+//=======================================================================================
+
+#define FLASH_PAGE_SIZE         256
+
+#define FLASH_CMD_WRSR          0x01
+#define FLASH_CMD_PP            0x02
+#define FLASH_CMD_READ          0x03
+#define FLASH_CMD_WRDI          0x04
+#define FLASH_CMD_RDSR          0x05
+#define FLASH_CMD_WREN          0x06
+#define FLASH_CMD_FAST_READ     0x0B
+#define FLASH_CMD_SE            0x20
+#define FLASH_CMD_BE32          0x52
+#define FLASH_CMD_CE            0x60
+#define FLASH_CMD_RDID          0x90
+#define FLASH_CMD_JEDEC_ID      0x9F
+#define FLASH_CMD_RES           0xAB
+#define FLASH_CMD_DP            0xB9
+#define FLASH_CMD_CE2           0xC7
+#define FLASH_CMD_BE64          0xD8
+
+#define FLASH_STATUS_WIP        0x01
+#define FLASH_STATUS_WEL        0x02
+
+
+/**
+   Build a NOR flash model.
+   A size of zero is invalid, the model is then disabled and never
+   responds to the commands.
+   \param size size of the memory, in bytes
+   \param jedec_id identifier returned by the READ_JEDEC_ID command, on 3 bytes
+   (manufacturer, memory type, capacity)
+   \param filename path of a raw image file backing the memory, if empty the memory
+   is allocated in memory
+ */
+SPIFlash::SPIFlash(size_t size, uint32_t jedec_id, const std::string& filename)
+:m_memory(size, "spi_flash", filename, true)
+,m_jedec_id(jedec_id)
+,m_cmd(0)
+,m_cmd_count(0)
+,m_addr(0)
+,m_wel(false)
+,m_power_down(false)
+,m_page(std::min<size_t>(size, FLASH_PAGE_SIZE))
+,m_page_set(m_page.size())
+,m_page_dirty(false)
+,m_erase_size(0)
+,m_cycle_manager(nullptr)
+,m_program_delay(0)
+,m_erase_delay(0)
+,m_busy_until(0)
+{}
+
+/**
+   Set the durations of the program and erase operations, during which the
+   device is busy and ignores the write commands.
+   \param cycle_manager cycle manager used as time reference, null to disable the delays
+   \param program_delay duration of a page programming in clock cycles
+   \param erase_delay duration of a sector, block or chip erase in clock cycles
+ */
+void SPIFlash::set_delays(CycleManager* cycle_manager, cycle_count_t program_delay,
+                          cycle_count_t erase_delay)
+{
+    m_cycle_manager = cycle_manager;
+    m_program_delay = program_delay;
+    m_erase_delay = erase_delay;
+    m_busy_until = 0;
+}
+
+/**
+   Returns true if a program or erase operation is in progress.
+ */
+bool SPIFlash::busy() const
+{
+    return m_cycle_manager && m_cycle_manager->cycle() < m_busy_until;
+}
+
+/**
+   Returns the value of the status register.
+ */
+uint8_t SPIFlash::status() const
+{
+    return (busy() ? FLASH_STATUS_WIP : 0) | (m_wel ? FLASH_STATUS_WEL : 0);
+}
+
+void SPIFlash::set_busy(cycle_count_t delay)
+{
+    m_wel = false;
+    if (m_cycle_manager && delay)
+        m_busy_until = m_cycle_manager->cycle() + delay;
+}
+
+/*
+   Returns true if the current command is a read and the address is received,
+   i.e. the next frames are data.
+ */
+bool SPIFlash::reading() const
+{
+    return (m_cmd == FLASH_CMD_READ && m_cmd_count >= 4) ||
+           (m_cmd == FLASH_CMD_FAST_READ && m_cmd_count >= 5);
+}
+
+uint8_t SPIFlash::start_transfer(uint8_t mosi_frame)
+{
+    //A model with a zero-size memory is disabled
+    if (!selected() || !size()) return 0xFF;
+
+    size_t index = m_cmd_count++;
+
+    //First byte : command opcode, the single byte commands are executed immediately
+    if (!index) {
+        m_cmd = mosi_frame;
+
+        //In power-down, only the release command is accepted
+        if (m_power_down && m_cmd != FLASH_CMD_RES) {
+            m_cmd = 0;
+            return 0xFF;
+        }
+
+        switch (m_cmd) {
+            case FLASH_CMD_WREN:
+                if (!busy()) m_wel = true;
+                break;
+
+            case FLASH_CMD_WRDI:
+                if (!busy()) m_wel = false;
+                break;
+
+            case FLASH_CMD_CE:
+            case FLASH_CMD_CE2:
+                if (m_wel && !busy()) {
+                    m_addr = 0;
+                    m_erase_size = size();
+                }
+                break;
+
+            case FLASH_CMD_DP:
+                m_power_down = true;
+                break;
+
+            case FLASH_CMD_RES:
+                m_power_down = false;
+                break;
+        }
+
+        return 0xFF;
+    }
+
+    //Bytes 1 to 3 : address, MSB first, for the commands using one
+    if (index <= 3 && m_cmd != FLASH_CMD_RDSR && m_cmd != FLASH_CMD_JEDEC_ID) {
+        m_addr = (index == 1) ? mosi_frame : ((m_addr << 8) | mosi_frame);
+        if (index < 3) return 0xFF;
+
+        m_addr %= size();
+
+        switch (m_cmd) {
+            case FLASH_CMD_SE:
+                if (m_wel && !busy()) m_erase_size = 0x1000;
+                break;
+
+            case FLASH_CMD_BE32:
+                if (m_wel && !busy()) m_erase_size = 0x8000;
+                break;
+
+            case FLASH_CMD_BE64:
+                if (m_wel && !busy()) m_erase_size = 0x10000;
+                break;
+
+            case FLASH_CMD_PP:
+                m_page_dirty = false;
+                break;
+        }
+
+        return 0xFF;
+    }
+
+    switch (m_cmd) {
+        case FLASH_CMD_READ:
+        case FLASH_CMD_FAST_READ: {
+            //Dummy byte of the fast read
+            if (m_cmd == FLASH_CMD_FAST_READ && index == 4) return 0xFF;
+            uint8_t v = m_memory[m_addr];
+            m_addr = (m_addr + 1) % size();
+            return v;
+        }
+
+        case FLASH_CMD_PP: {
+            if (!m_wel || busy()) return 0xFF;
+            //Latch the data in the page buffer and roll over within the page
+            size_t offset = m_addr % m_page.size();
+            if (!m_page_dirty) {
+                std::fill(m_page_set.begin(), m_page_set.end(), 0);
+                m_page_dirty = true;
+            }
+            m_page[offset] = mosi_frame;
+            m_page_set[offset] = 1;
+            m_addr = (m_addr - offset) + ((offset + 1) % m_page.size());
+            return 0xFF;
+        }
+
+        case FLASH_CMD_RDSR:
+            return status();
+
+        case FLASH_CMD_JEDEC_ID:
+            return (index <= 3) ? ((m_jedec_id >> (8 * (3 - index))) & 0xFF) : 0xFF;
+
+        case FLASH_CMD_RDID:
+            //Manufacturer and device id, in the order given by the address LSB
+            if ((index & 1) == (m_addr & 1))
+                return (m_jedec_id >> 16) & 0xFF;
+            else
+                return (m_jedec_id & 0xFF) - 1;
+
+        case FLASH_CMD_RES:
+            return (m_jedec_id & 0xFF) - 1;
+
+        default:
+            return 0xFF;
+    }
+}
+
+/*
+   Override for bulk reads : once the address is received, the data frames are copied
+   directly from the storage.
+ */
+void SPIFlash::transfer_burst(const uint8_t* mosi_frames, uint8_t* miso_frames, size_t count)
+{
+    if (!size()) {
+        memset(miso_frames, 0xFF, count);
+        return;
+    }
+
+    size_t i = 0;
+    for (; i < count && !(selected() && reading()); ++i)
+        miso_frames[i] = start_transfer(mosi_frames[i]);
+
+    m_cmd_count += count - i;
+
+    while (i < count) {
+        size_t len = std::min(count - i, size() - m_addr);
+        m_memory.dbg_read(miso_frames + i, m_addr, len);
+        i += len;
+        m_addr = (m_addr + len) % size();
+    }
+}
+
+void SPIFlash::select_changed(bool selected)
+{
+    m_cmd_count = 0;
+    if (selected) return;
+
+    //The program and erase operations are executed at the end of the command
+    if (m_page_dirty) {
+        m_page_dirty = false;
+        size_t base = m_addr - (m_addr % m_page.size());
+        m_memory.spm_write(m_page.data(), m_page_set.data(), base, m_page.size());
+        set_busy(m_program_delay);
+    }
+    else if (m_erase_size) {
+        size_t base = m_addr - (m_addr % m_erase_size);
+        m_memory.erase(base, m_erase_size);
+        m_erase_size = 0;
+        set_busy(m_erase_delay);
+    }
+}
+
+
+//=======================================================================================
+
+#define SD_BLOCK_SIZE           512
+
+#define SD_R1_IDLE              0x01
+#define SD_R1_ILLEGAL_CMD       0x04
+#define SD_R1_ADDRESS_ERROR     0x20
+#define SD_R1_PARAM_ERROR       0x40
+
+#define SD_TOKEN_START          0xFE
+#define SD_TOKEN_START_MULTI    0xFC
+#define SD_TOKEN_STOP           0xFD
+#define SD_DATA_ACCEPTED        0x05
+
+//Card identification register, CRC not computed
+static const uint8_t SD_CID[16] = {
+    0x00, 'Y', 'S', 'S', 'D', 'C', 'A', 'R', 0x10, 0x00, 0x00, 0x00, 0x01, 0x01, 0x6A, 0x01
+};
+
+
+/**
+   Build a SD card model.
+   \param size size of the card, in bytes
+   \param filename path of a raw image file backing the card, if empty the card
+   is allocated in memory
+ */
+SPISDCard::SPISDCard(size_t size, const std::string& filename)
+:m_memory(((size + SD_BLOCK_SIZE - 1) / SD_BLOCK_SIZE) * SD_BLOCK_SIZE, "sd_card", filename, true)
+,m_state(State_Command)
+,m_idle(true)
+,m_app_cmd(false)
+,m_cmd_count(0)
+,m_output(2 * SD_BLOCK_SIZE)
+,m_block(0)
+,m_multi(false)
+,m_block_buf(SD_BLOCK_SIZE + 2)
+,m_block_count(0)
+{}
+
+void SPISDCard::push_output(uint8_t frame)
+{
+    m_output.push_back(frame);
+}
+
+/*
+   Queue a R1 response, after one byte of response delay.
+ */
+void SPISDCard::queue_r1(uint8_t r1)
+{
+    push_output(0xFF);
+    push_output(r1);
+}
+
+/*
+   Queue a 16-bytes register as a data block.
+ */
+void SPISDCard::queue_register(const uint8_t* reg)
+{
+    push_output(0xFF);
+    push_output(SD_TOKEN_START);
+    m_output.push(reg, 16);
+    push_output(0xFF);
+    push_output(0xFF);
+}
+
+/*
+   Queue the current block as a data block and advance to the next one.
+ */
+void SPISDCard::queue_block()
+{
+    uint8_t buf[SD_BLOCK_SIZE];
+    m_memory.dbg_read(buf, m_block * SD_BLOCK_SIZE, SD_BLOCK_SIZE);
+
+    push_output(0xFF);
+    push_output(SD_TOKEN_START);
+    m_output.push(buf, SD_BLOCK_SIZE);
+    push_output(0xFF);
+    push_output(0xFF);
+
+    ++m_block;
+}
+
+uint8_t SPISDCard::start_transfer(uint8_t mosi_frame)
+{
+    if (!selected()) return 0xFF;
+
+    //Multiple block read : the next block is queued as soon as the previous one is sent
+    if (m_state == State_ReadBlocks && m_output.empty()) {
+        if (m_block < size() / SD_BLOCK_SIZE)
+            queue_block();
+        else
+            m_state = State_Command;
+    }
+
+    uint8_t miso = 0xFF;
+    if (!m_output.empty()) {
+        miso = m_output.front();
+        m_output.pop_front();
+    }
+
+    switch (m_state) {
+        case State_Command:
+        case State_ReadBlocks:
+            //A command starts with the bits '01'
+            if (!m_cmd_count && (mosi_frame & 0xC0) != 0x40)
+                break;
+            m_cmd[m_cmd_count++] = mosi_frame;
+            if (m_cmd_count == 6) {
+                m_cmd_count = 0;
+                process_command();
+            }
+            break;
+
+        case State_WriteToken:
+            if (mosi_frame == SD_TOKEN_START || (m_multi && mosi_frame == SD_TOKEN_START_MULTI)) {
+                m_block_count = 0;
+                m_state = State_WriteData;
+            }
+            else if (m_multi && mosi_frame == SD_TOKEN_STOP) {
+                push_output(0xFF);
+                push_output(0x00);
+                m_state = State_Command;
+            }
+            break;
+
+        case State_WriteData:
+            m_block_buf[m_block_count++] = mosi_frame;
+            //Block complete, including the CRC
+            if (m_block_count == m_block_buf.size()) {
+                if (m_block < size() / SD_BLOCK_SIZE) {
+                    m_memory.program({ SD_BLOCK_SIZE, m_block_buf.data() }, m_block * SD_BLOCK_SIZE);
+                    ++m_block;
+                }
+                //Data response followed by one busy byte
+                push_output(SD_DATA_ACCEPTED);
+                push_output(0x00);
+                m_state = m_multi ? State_WriteToken : State_Command;
+            }
+            break;
+    }
+
+    return miso;
+}
+
+void SPISDCard::process_command()
+{
+    uint8_t cmd = m_cmd[0] & 0x3F;
+    uint32_t arg = ((uint32_t) m_cmd[1] << 24) | ((uint32_t) m_cmd[2] << 16) |
+                   ((uint32_t) m_cmd[3] << 8) | m_cmd[4];
+    bool app_cmd = m_app_cmd;
+    m_app_cmd = false;
+
+    uint8_t r1 = m_idle ? SD_R1_IDLE : 0x00;
+    size_t block_count = size() / SD_BLOCK_SIZE;
+
+    //Stop transmission : the block being sent is abandoned
+    if (cmd == 12) {
+        if (m_state == State_ReadBlocks) {
+            m_output.clear();
+            m_state = State_Command;
+        }
+        queue_r1(r1);
+        return;
+    }
+
+    //Any other command received during a multiple block read is ignored
+    if (m_state != State_Command) return;
+
+    switch (cmd) {
+        case 0: //GO_IDLE_STATE
+            m_idle = true;
+            m_output.clear();
+            queue_r1(SD_R1_IDLE);
+            break;
+
+        case 1: //SEND_OP_COND
+            m_idle = false;
+            queue_r1(0x00);
+            break;
+
+        case 8: //SEND_IF_COND, echo of the voltage and check pattern
+            queue_r1(r1);
+            push_output(0x00);
+            push_output(0x00);
+            push_output((arg >> 8) & 0x0F);
+            push_output(arg & 0xFF);
+            break;
+
+        case 9: { //SEND_CSD, version 2.0
+            uint32_t c_size = block_count / 1024;
+            if (c_size) --c_size;
+            const uint8_t csd[16] = {
+                0x40, 0x0E, 0x00, 0x32, 0x5B, 0x59, 0x00,
+                (uint8_t) ((c_size >> 16) & 0x3F), (uint8_t) (c_size >> 8), (uint8_t) c_size,
+                0x7F, 0x80, 0x0A, 0x40, 0x00, 0x01
+            };
+            queue_r1(r1);
+            queue_register(csd);
+        } break;
+
+        case 10: //SEND_CID
+            queue_r1(r1);
+            queue_register(SD_CID);
+            break;
+
+        case 13: //SEND_STATUS
+            queue_r1(r1);
+            push_output(0x00);
+            break;
+
+        case 16: //SET_BLOCKLEN, only the default length is supported
+            queue_r1(arg == SD_BLOCK_SIZE ? r1 : (r1 | SD_R1_PARAM_ERROR));
+            break;
+
+        case 17: //READ_SINGLE_BLOCK
+        case 18: //READ_MULTIPLE_BLOCK
+            if (m_idle) {
+                queue_r1(r1 | SD_R1_ILLEGAL_CMD);
+            }
+            else if (arg >= block_count) {
+                queue_r1(r1 | SD_R1_ADDRESS_ERROR);
+            }
+            else {
+                queue_r1(r1);
+                m_block = arg;
+                if (cmd == 17)
+                    queue_block();
+                else
+                    m_state = State_ReadBlocks;
+            }
+            break;
+
+        case 24: //WRITE_BLOCK
+        case 25: //WRITE_MULTIPLE_BLOCK
+            if (m_idle) {
+                queue_r1(r1 | SD_R1_ILLEGAL_CMD);
+            }
+            else if (arg >= block_count) {
+                queue_r1(r1 | SD_R1_ADDRESS_ERROR);
+            }
+            else {
+                queue_r1(r1);
+                m_block = arg;
+                m_multi = (cmd == 25);
+                m_state = State_WriteToken;
+            }
+            break;
+
+        case 23: //SET_WR_BLK_ERASE_COUNT, accepted and ignored
+            queue_r1(app_cmd ? r1 : (r1 | SD_R1_ILLEGAL_CMD));
+            break;
+
+        case 41: //SD_SEND_OP_COND, the initialisation completes immediately
+            if (app_cmd) {
+                m_idle = false;
+                queue_r1(0x00);
+            } else {
+                queue_r1(r1 | SD_R1_ILLEGAL_CMD);
+            }
+            break;
+
+        case 55: //APP_CMD
+            m_app_cmd = true;
+            queue_r1(r1);
+            break;
+
+        case 58: //READ_OCR, powered up and high capacity
+            queue_r1(r1);
+            push_output(0xC0);
+            push_output(0xFF);
+            push_output(0x80);
+            push_output(0x00);
+            break;
+
+        case 59: //CRC_ON_OFF, the CRC are never checked
+            queue_r1(r1);
+            break;
+
+        default:
+            queue_r1(r1 | SD_R1_ILLEGAL_CMD);
+    }
+}
+
+void SPISDCard::select_changed(bool)
+{
+    m_cmd_count = 0;
+}
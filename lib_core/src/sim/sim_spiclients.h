@@ -0,0 +1,227 @@
+/*
+ * sim_spiclients.h
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+#ifndef __YASIMAVR_SPICLIENTS_H__
+#define __YASIMAVR_SPICLIENTS_H__
+
+#include "../core/sim_memory.h"
+#include "../core/sim_pin.h"
+#include "../ioctrl_common/sim_spi.h"
+
+YASIMAVR_BEGIN_NAMESPACE
+
+
+//=======================================================================================
+/**
+   \ingroup api_spi
+   \brief Base class for SPI client models with a chip select.
+
+   The chip select can be driven by a device pin, active low, or set directly.
+   The model is notified of the select changes, which delimit the commands.
+ */
+class AVR_CORE_PUBLIC_API SPIClientModel : public SPIClient, public SignalHook {
+
+public:
+
+    SPIClientModel();
+
+    void set_select_pin(Pin* pin);
+    void set_selected(bool selected);
+
+    virtual bool selected() const override;
+    virtual void end_transfer(bool ok) override;
+
+    virtual void raised(const signal_data_t& sigdata, int hooktag) override;
+
+protected:
+
+    /// Called when the chip select changes.
+    virtual void select_changed(bool selected) = 0;
+
+private:
+
+    Pin* m_select_pin;
+    bool m_selected;
+
+};
+
+
+//=======================================================================================
+/**
+   \ingroup api_spi
+   \brief Model of a SPI NOR flash memory, with the common 25-series command set
+
+   Supported commands: READ (0x03), FAST_READ (0x0B), PAGE_PROGRAM (0x02),
+   SECTOR_ERASE 4kB (0x20), BLOCK_ERASE 32kB (0x52) and 64kB (0xD8),
+   CHIP_ERASE (0x60/0xC7), WRITE_ENABLE (0x06), WRITE_DISABLE (0x04),
+   READ_STATUS (0x05), WRITE_STATUS (0x01), READ_JEDEC_ID (0x9F),
+   READ_ID (0x90), POWER_DOWN (0xB9) and RELEASE_POWER_DOWN (0xAB).
+   Addresses are 3 bytes long.
+
+   Programming only clears bits, as on the real device, and the programming and erase
+   operations are executed when the chip is deselected. If delays are set, the device
+   is then busy (WIP bit set in the status) for the corresponding duration.
+   Reads in a burst transfer are served directly from the storage.
+
+   The storage is a NonVolatileMemory, which can be mapped to a raw image file given
+   to the constructor, in which case it is not allocated in memory. It can also be
+   mapped afterwards with memory().map_file(filename, true).
+ */
+class AVR_CORE_PUBLIC_API SPIFlash : public SPIClientModel {
+
+public:
+
+    explicit SPIFlash(size_t size, uint32_t jedec_id = 0xEF4016, const std::string& filename = "");
+
+    size_t size() const;
+    NonVolatileMemory& memory();
+
+    void set_delays(CycleManager* cycle_manager, cycle_count_t program_delay,
+                    cycle_count_t erase_delay);
+    bool busy() const;
+    uint8_t status() const;
+
+    virtual uint8_t start_transfer(uint8_t mosi_frame) override;
+    virtual void transfer_burst(const uint8_t* mosi_frames, uint8_t* miso_frames, size_t count) override;
+
+protected:
+
+    virtual void select_changed(bool selected) override;
+
+private:
+
+    NonVolatileMemory m_memory;
+    uint32_t m_jedec_id;
+    //Current command and number of bytes received for it
+    uint8_t m_cmd;
+    size_t m_cmd_count;
+    uint32_t m_addr;
+    bool m_wel;
+    bool m_power_down;
+    //Page buffer and flags of the bytes programmed in it
+    std::vector<uint8_t> m_page;
+    std::vector<uint8_t> m_page_set;
+    bool m_page_dirty;
+    //Erase operation to execute at the end of the command, with its size
+    size_t m_erase_size;
+
+    CycleManager* m_cycle_manager;
+    cycle_count_t m_program_delay;
+    cycle_count_t m_erase_delay;
+    cycle_count_t m_busy_until;
+
+    bool reading() const;
+    void set_busy(cycle_count_t delay);
+
+};
+
+/// Returns the size of the memory, in bytes.
+inline size_t SPIFlash::size() const
+{
+    return m_memory.size();
+}
+
+/// Returns the storage of the memory.
+inline NonVolatileMemory& SPIFlash::memory()
+{
+    return m_memory;
+}
+
+
+//=======================================================================================
+/**
+   \ingroup api_spi
+   \brief Model of a SD card in SPI mode
+
+   The card is a SDHC card, with block addressing and 512-bytes blocks.
+   Supported commands: CMD0, CMD1, CMD8, CMD9, CMD10, CMD12, CMD13, CMD16, CMD17, CMD18,
+   CMD24, CMD25, CMD55, CMD58, CMD59, ACMD23 and ACMD41. The CRC are not checked and
+   are sent as 0xFFFF.
+
+   The storage is a NonVolatileMemory, which can be mapped to a raw image file given
+   to the constructor, in which case it is not allocated in memory. It can also be
+   mapped afterwards with memory().map_file(filename, true).
+   The size is rounded up to a multiple of the 512-bytes block size.
+ */
+class AVR_CORE_PUBLIC_API SPISDCard : public SPIClientModel {
+
+public:
+
+    explicit SPISDCard(size_t size, const std::string& filename = "");
+
+    size_t size() const;
+    NonVolatileMemory& memory();
+
+    virtual uint8_t start_transfer(uint8_t mosi_frame) override;
+
+protected:
+
+    virtual void select_changed(bool selected) override;
+
+private:
+
+    enum State {
+        State_Command,
+        State_ReadBlocks,
+        State_WriteToken,
+        State_WriteData,
+    };
+
+    NonVolatileMemory m_memory;
+    State m_state;
+    bool m_idle;
+    bool m_app_cmd;
+    uint8_t m_cmd[6];
+    unsigned int m_cmd_count;
+    //Bytes waiting to be sent on MISO
+    RingBuffer<uint8_t> m_output;
+    //Current block address and flag for multiple block operations
+    size_t m_block;
+    bool m_multi;
+    //Block being received
+    std::vector<uint8_t> m_block_buf;
+    size_t m_block_count;
+
+    void process_command();
+    void queue_r1(uint8_t r1);
+    void queue_register(const uint8_t* reg);
+    void queue_block();
+    void push_output(uint8_t frame);
+
+};
+
+/// Returns the size of the card, in bytes.
+inline size_t SPISDCard::size() const
+{
+    return m_memory.size();
+}
+
+/// Returns the storage of the card.
+inline NonVolatileMemory& SPISDCard::memory()
+{
+    return m_memory;
+}
+
+
+YASIMAVR_END_NAMESPACE
+
+#endif //__YASIMAVR_SPICLIENTS_H__
@@ -0,0 +1,915 @@
+/*
+ * sim_stimulus.cpp
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#include "sim_stimulus.h"
+#include "sim_twislaves.h"
+#include "../ioctrl_common/sim_uart.h"
+#include "../ioctrl_common/sim_spi.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+YASIMAVR_USING_NAMESPACE
+
+
+//=======================================================================================
+
+/**
+   Set the data of the stimulus. String and bytes data are copied.
+ */
+void stimulus_t::set_data(const vardata_t& v)
+{
+    m_payload.clear();
+    m_value = v;
+
+    if (v.type() == vardata_t::String) {
+        const char* s = v.as_str();
+        m_payload.assign(s, s + strlen(s) + 1);
+    }
+    else if (v.type() == vardata_t::Bytes) {
+        m_payload.assign(v.as_bytes(), v.as_bytes() + v.size());
+    }
+}
+
+/**
+   Return the data of the stimulus. For string and bytes data, the value
+   points to the stimulus internal storage.
+ */
+vardata_t stimulus_t::data() const
+{
+    if (m_value.type() == vardata_t::String)
+        return vardata_t((const char*) m_payload.data());
+    else if (m_value.type() == vardata_t::Bytes)
+        return vardata_t((uint8_t*) m_payload.data(), m_payload.size());
+    else
+        return m_value;
+}
+
+
+//=======================================================================================
+
+class StimulusRecorder::PinHook : public SignalHook {
+
+public:
+
+    PinHook(StimulusRecorder& recorder) : m_recorder(recorder) {}
+
+    void add_pin(Pin& pin)
+    {
+        pin.signal().connect(*this, m_pins.size());
+        m_pins.push_back(&pin);
+    }
+
+    virtual void raised(const signal_data_t& sigdata, int hooktag) override
+    {
+        if (sigdata.sigid != Pin::Signal_ExternalStateChange) return;
+
+        Pin* pin = m_pins[hooktag];
+        stimulus_t s;
+        s.type = stimulus_t::Stimulus_Pin;
+        s.target = pin->id();
+        s.id = pin->external_state().state;
+        m_recorder.record(s, pin->external_state().level);
+    }
+
+private:
+
+    StimulusRecorder& m_recorder;
+    std::vector<Pin*> m_pins;
+
+};
+
+
+class StimulusRecorder::ProxyHook : public SignalHook {
+
+public:
+
+    ProxyHook(StimulusRecorder& recorder, SignalHook& target, unsigned int channel)
+    :m_recorder(recorder), m_target(target), m_channel(channel) {}
+
+    virtual void raised(const signal_data_t& sigdata, int hooktag) override
+    {
+        stimulus_t s;
+        s.type = stimulus_t::Stimulus_Hook;
+        s.target = m_channel;
+        s.id = sigdata.sigid;
+        s.index = sigdata.index;
+        s.hooktag = hooktag;
+        m_recorder.record(s, sigdata.data);
+
+        m_target.raised(sigdata, hooktag);
+    }
+
+private:
+
+    StimulusRecorder& m_recorder;
+    SignalHook& m_target;
+    unsigned int m_channel;
+
+};
+
+
+/**
+   Build a recorder for a device. The recording is enabled by default.
+ */
+StimulusRecorder::StimulusRecorder(Device& device)
+:m_device(device)
+,m_recording(true)
+{
+    m_pin_hook = new PinHook(*this);
+}
+
+
+StimulusRecorder::~StimulusRecorder()
+{
+    delete m_pin_hook;
+    for (ProxyHook* p : m_proxies)
+        delete p;
+}
+
+/**
+   Add a pin to the recording. All the changes of the pin external state are recorded.
+ */
+void StimulusRecorder::add_pin(Pin& pin)
+{
+    m_pin_hook->add_pin(pin);
+}
+
+/**
+   Add a signal hook to the recording.
+   \param target hook receiving the stimuli
+   \return a proxy hook to be used in place of the target.
+   The proxy is owned by the recorder.
+ */
+SignalHook& StimulusRecorder::add_hook(SignalHook& target)
+{
+    ProxyHook* proxy = new ProxyHook(*this, target, m_proxies.size());
+    m_proxies.push_back(proxy);
+    return *proxy;
+}
+
+/**
+   Forward a controller request to the device and record it.
+   The arguments and return value are the same as Device::ctlreq().
+   \note Only the requests with numeric, string or bytes data are recorded.
+ */
+bool StimulusRecorder::ctlreq(ctl_id_t id, ctlreq_id_t req, ctlreq_data_t* reqdata)
+{
+    ctlreq_data_t d;
+    if (!reqdata)
+        reqdata = &d;
+
+    if (reqdata->data.type() == vardata_t::Pointer) {
+        m_device.logger().wng("Stimulus recorder: request with pointer data not recorded");
+    } else {
+        stimulus_t s;
+        s.type = stimulus_t::Stimulus_CtlReq;
+        s.target = id;
+        s.id = req;
+        s.index = reqdata->index;
+        record(s, reqdata->data);
+    }
+
+    return m_device.ctlreq(id, req, reqdata);
+}
+
+/**
+   Enable or disable the recording.
+ */
+void StimulusRecorder::set_recording(bool enabled)
+{
+    m_recording = enabled;
+}
+
+/**
+   Clear all the stimuli recorded so far.
+ */
+void StimulusRecorder::clear()
+{
+    m_stimuli.clear();
+}
+
+
+cycle_count_t StimulusRecorder::stimulus_cycle() const
+{
+    CycleManager* cm = m_device.cycle_manager();
+    return cm ? cm->processed_cycle() : INVALID_CYCLE;
+}
+
+
+void StimulusRecorder::record(stimulus_t& s, const vardata_t& data)
+{
+    if (!m_recording) return;
+
+    s.cycle = stimulus_cycle();
+    s.set_data(data);
+    m_stimuli.push_back(s);
+}
+
+
+//=======================================================================================
+/*
+ * File format for the stimuli:
+ *  - Header : magic string "YASIMSTM" and format version (uint32)
+ *  - Records, each as:
+ *      . cycle delta from the previous record (varint)
+ *      . type (byte)
+ *      . target (varint)
+ *      . id (signed varint)
+ *      . index (signed varint)
+ *      . hooktag (signed varint)
+ *      . data type (byte), followed by:
+ *          Double: 8 bytes
+ *          Uinteger: varint
+ *          Integer: signed varint
+ *          String, Bytes: length (varint) then the content
+ * Varints use the LEB128 encoding and signed varints use a zigzag encoding.
+ */
+
+#define STIMULUS_MAGIC          "YASIMSTM"
+#define STIMULUS_VERSION        1
+
+static void write_varint(FILE* f, unsigned long long v)
+{
+    do {
+        uint8_t b = v & 0x7F;
+        v >>= 7;
+        if (v) b |= 0x80;
+        fputc(b, f);
+    } while (v);
+}
+
+static void write_svarint(FILE* f, long long v)
+{
+    write_varint(f, ((unsigned long long) v << 1) ^ (unsigned long long) (v >> 63));
+}
+
+static bool read_varint(FILE* f, unsigned long long& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(f);
+        if (c == EOF) return false;
+        v |= (unsigned long long) (c & 0x7F) << shift;
+        if (!(c & 0x80)) return true;
+    }
+    return false;
+}
+
+static bool read_svarint(FILE* f, long long& v)
+{
+    unsigned long long u;
+    if (!read_varint(f, u)) return false;
+    v = (long long) (u >> 1) ^ -(long long) (u & 1);
+    return true;
+}
+
+/**
+   Save the recorded stimuli to a file.
+   \return true if the file was written successfully
+ */
+bool StimulusRecorder::save(const std::string& filename) const
+{
+    FILE* f = fopen(filename.c_str(), "wb");
+    if (!f) return false;
+
+    uint32_t version = STIMULUS_VERSION;
+    fwrite(STIMULUS_MAGIC, 1, 8, f);
+    fwrite(&version, sizeof(version), 1, f);
+
+    cycle_count_t prev_cycle = INVALID_CYCLE;
+    for (const stimulus_t& s : m_stimuli) {
+        write_varint(f, s.cycle - prev_cycle);
+        prev_cycle = s.cycle;
+        fputc(s.type, f);
+        write_varint(f, s.target);
+        write_svarint(f, s.id);
+        write_svarint(f, s.index);
+        write_svarint(f, s.hooktag);
+
+        vardata_t::Type t = s.m_value.type();
+        fputc(t, f);
+        if (t == vardata_t::Double) {
+            double d = s.m_value.as_double();
+            fwrite(&d, sizeof(d), 1, f);
+        }
+        else if (t == vardata_t::Uinteger) {
+            write_varint(f, s.m_value.as_uint());
+        }
+        else if (t == vardata_t::Integer) {
+            write_svarint(f, s.m_value.as_int());
+        }
+        else if (t == vardata_t::String || t == vardata_t::Bytes) {
+            write_varint(f, s.m_payload.size());
+            fwrite(s.m_payload.data(), 1, s.m_payload.size(), f);
+        }
+    }
+
+    bool ok = !ferror(f);
+    ok &= !fclose(f);
+    return ok;
+}
+
+
+//=======================================================================================
+
+/*
+ * Hook receiving the deferred raises of the replayer, at the end of the
+ * processing of the cycle timers.
+ */
+class StimulusReplayer::ApplyHook : public SignalHook {
+
+public:
+
+    ApplyHook(StimulusReplayer& replayer) : m_replayer(replayer) {}
+
+    virtual void raised(const signal_data_t& sigdata, int) override
+    {
+        m_replayer.apply_until(sigdata.data.as_int());
+    }
+
+private:
+
+    StimulusReplayer& m_replayer;
+
+};
+
+
+StimulusReplayer::StimulusReplayer(Device& device)
+:m_device(device)
+,m_pos(0)
+{
+    m_apply_hook = new ApplyHook(*this);
+    m_apply_signal.connect(*m_apply_hook);
+}
+
+
+StimulusReplayer::~StimulusReplayer()
+{
+    m_apply_signal.disconnect(*m_apply_hook);
+    delete m_apply_hook;
+}
+
+/**
+   Add a signal hook target for replaying the stimuli of the next channel index.
+ */
+void StimulusReplayer::add_hook(SignalHook& target)
+{
+    m_hooks.push_back(&target);
+}
+
+/**
+   Add a TWI register map target for replaying the stimuli of the next channel index.
+ */
+void StimulusReplayer::add_register_map(TWIRegisterMap& target)
+{
+    m_register_maps.push_back(&target);
+}
+
+/**
+   Set the sequence of stimuli to replay. It must be sorted by cycle.
+ */
+void StimulusReplayer::set_stimuli(const std::vector<stimulus_t>& stimuli)
+{
+    stop();
+    m_stimuli = stimuli;
+    m_pos = 0;
+}
+
+/**
+   Load a sequence of stimuli from a file written by StimulusRecorder::save().
+   \return true if the file was read successfully. The load fails if the file
+   contains a stimulus or a data type which is not known.
+ */
+bool StimulusReplayer::load(const std::string& filename)
+{
+    FILE* f = fopen(filename.c_str(), "rb");
+    if (!f) return false;
+
+    char magic[8];
+    uint32_t version;
+    bool ok = fread(magic, 1, 8, f) == 8 &&
+              !memcmp(magic, STIMULUS_MAGIC, 8) &&
+              fread(&version, sizeof(version), 1, f) == 1 &&
+              version == STIMULUS_VERSION;
+
+    std::vector<stimulus_t> stimuli;
+    cycle_count_t cycle = INVALID_CYCLE;
+    int c;
+    while (ok && (c = fgetc(f)) != EOF) {
+        ungetc(c, f);
+
+        stimulus_t s;
+        unsigned long long u = 0;
+        long long i = 0;
+        ok = read_varint(f, u);
+        cycle += u;
+        s.cycle = cycle;
+
+        ok = ok && (c = fgetc(f)) != EOF &&
+             c >= stimulus_t::Stimulus_Pin && c <= stimulus_t::Stimulus_TWI;
+        s.type = (stimulus_t::Type) c;
+        ok = ok && read_varint(f, u);
+        s.target = u;
+        ok = ok && read_svarint(f, i);
+        s.id = i;
+        ok = ok && read_svarint(f, s.index);
+        ok = ok && read_svarint(f, i);
+        s.hooktag = i;
+
+        ok = ok && (c = fgetc(f)) != EOF;
+        if (!ok) break;
+
+        switch (c) {
+            case vardata_t::Double: {
+                double d;
+                ok = fread(&d, sizeof(d), 1, f) == 1;
+                s.m_value = d;
+            } break;
+
+            case vardata_t::Uinteger:
+                ok = read_varint(f, u);
+                s.m_value = u;
+                break;
+
+            case vardata_t::Integer:
+                ok = read_svarint(f, i);
+                s.m_value = i;
+                break;
+
+            case vardata_t::String:
+            case vardata_t::Bytes:
+                ok = read_varint(f, u);
+                if (!ok) break;
+                s.m_payload.resize(u);
+                ok = !u || fread(s.m_payload.data(), 1, u, f) == u;
+                if (c == vardata_t::String)
+                    s.m_value = "";
+                else
+                    s.m_value = vardata_t(nullptr, 0);
+                break;
+
+            case vardata_t::Invalid:
+                break;
+
+            default: //Unknown data type
+                ok = false;
+        }
+
+        stimuli.push_back(s);
+    }
+
+    fclose(f);
+
+    if (ok)
+        set_stimuli(stimuli);
+
+    return ok;
+}
+
+/**
+   Start the replay. The stimuli whose cycle is past are applied immediately,
+   the others are scheduled.
+   \return true if the replay is started
+ */
+bool StimulusReplayer::start()
+{
+    CycleManager* cm = m_device.cycle_manager();
+    if (!cm) return false;
+
+    stop();
+    m_apply_signal.set_deferred(&cm->signal_queue());
+
+    while (m_pos < m_stimuli.size() && m_stimuli[m_pos].cycle < cm->cycle())
+        apply(m_stimuli[m_pos++]);
+
+    if (m_pos < m_stimuli.size())
+        cm->schedule(*this, m_stimuli[m_pos].cycle);
+
+    return true;
+}
+
+/**
+   Stop the replay. It can be resumed with start().
+ */
+void StimulusReplayer::stop()
+{
+    CycleManager* cm = m_device.cycle_manager();
+    if (cm)
+        cm->cancel(*this);
+
+    m_apply_signal.set_deferred(nullptr);
+}
+
+/*
+ * The stimuli of the cycle are not applied by the timer itself but when the deferred
+ * raise is dispatched, after all the timers of the cycle.
+ */
+cycle_count_t StimulusReplayer::next(cycle_count_t when)
+{
+    m_apply_signal.raise(0, when);
+
+    size_t pos = m_pos;
+    while (pos < m_stimuli.size() && m_stimuli[pos].cycle <= when)
+        ++pos;
+
+    return (pos < m_stimuli.size()) ? m_stimuli[pos].cycle : 0;
+}
+
+
+void StimulusReplayer::apply_until(cycle_count_t cycle)
+{
+    while (m_pos < m_stimuli.size() && m_stimuli[m_pos].cycle <= cycle)
+        apply(m_stimuli[m_pos++]);
+}
+
+
+void StimulusReplayer::apply(const stimulus_t& s)
+{
+    switch (s.type) {
+        case stimulus_t::Stimulus_Pin: {
+            Pin* pin = m_device.find_pin(s.target);
+            if (pin)
+                pin->set_external_state((Pin::State) s.id, s.m_value.as_double());
+            else
+                m_device.logger().wng("Stimulus replay: pin %s not found", id_to_str(s.target).c_str());
+        } break;
+
+        case stimulus_t::Stimulus_Hook: {
+            if (s.target < m_hooks.size()) {
+                signal_data_t sigdata = { s.id, s.index, s.data() };
+                m_hooks[s.target]->raised(sigdata, s.hooktag);
+            } else {
+                m_device.logger().wng("Stimulus replay: invalid hook channel %d", (int) s.target);
+            }
+        } break;
+
+        case stimulus_t::Stimulus_CtlReq: {
+            ctlreq_data_t d = { s.data(), s.index };
+            m_device.ctlreq(s.target, s.id, &d);
+        } break;
+
+        case stimulus_t::Stimulus_UART: {
+            ctlreq_data_t d;
+            UARTEndPoint* endpoint = nullptr;
+            if (m_device.ctlreq(s.target, AVR_CTLREQ_UART_ENDPOINT, &d))
+                endpoint = reinterpret_cast<UARTEndPoint*>(d.data.as_ptr());
+            if (endpoint && endpoint->rx_hook) {
+                signal_data_t sigdata = { UART::Signal_DataBytes, 0, s.data() };
+                endpoint->rx_hook->raised(sigdata, 0);
+            } else {
+                m_device.logger().wng("Stimulus replay: UART %s not found", id_to_str(s.target).c_str());
+            }
+        } break;
+
+        case stimulus_t::Stimulus_SPI: {
+            ctlreq_data_t d;
+            SPIClient* client = nullptr;
+            if (m_device.ctlreq(s.target, AVR_CTLREQ_SPI_CLIENT, &d))
+                client = reinterpret_cast<SPIClient*>(d.data.as_ptr());
+            if (client) {
+                ctlreq_data_t sel = { 1 };
+                m_device.ctlreq(s.target, AVR_CTLREQ_SPI_SELECT, &sel);
+                client->start_transfer(s.m_value.as_uint());
+                client->end_transfer(true);
+                if (s.index) {
+                    sel.data = 0;
+                    m_device.ctlreq(s.target, AVR_CTLREQ_SPI_SELECT, &sel);
+                }
+            } else {
+                m_device.logger().wng("Stimulus replay: SPI %s not found", id_to_str(s.target).c_str());
+            }
+        } break;
+
+        case stimulus_t::Stimulus_TWI: {
+            if (s.target < m_register_maps.size())
+                m_register_maps[s.target]->write_registers(s.m_payload.data(), s.index, s.m_payload.size());
+            else
+                m_device.logger().wng("Stimulus replay: invalid register map channel %d", (int) s.target);
+        } break;
+    }
+}
+
+
+//=======================================================================================
+
+/*
+   Split a line into tokens separated by blanks. Quoted strings are single tokens,
+   kept with their quotes, and a '#' outside of a string starts a comment.
+ */
+static bool tokenize(const char* line, std::vector<std::string>& tokens)
+{
+    tokens.clear();
+
+    const char* p = line;
+    while (true) {
+        while (*p && isspace((unsigned char) *p)) ++p;
+        if (!*p || *p == '#') break;
+
+        const char* start = p;
+        if (*p == '"') {
+            for (++p; *p && *p != '"'; ++p) {
+                if (*p == '\\' && p[1]) ++p;
+            }
+            if (*p != '"') return false;
+            ++p;
+        } else {
+            while (*p && !isspace((unsigned char) *p)) ++p;
+        }
+
+        tokens.emplace_back(start, p - start);
+    }
+
+    return true;
+}
+
+/*
+   Decode a quoted string token, with the C escape sequences.
+   Returns false if a \x escape is not followed by a hexadecimal digit.
+ */
+static bool decode_string(const std::string& token, std::vector<uint8_t>& data)
+{
+    for (size_t i = 1; i + 1 < token.size(); ++i) {
+        char c = token[i];
+        if (c == '\\' && i + 2 < token.size()) {
+            c = token[++i];
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case '0': c = '\0'; break;
+                case 'x': {
+                    std::string hex = token.substr(i + 1, 2);
+                    char* end;
+                    c = (char) strtoul(hex.c_str(), &end, 16);
+                    if (end == hex.c_str()) return false;
+                    i += end - hex.c_str();
+                } break;
+            }
+        }
+        data.push_back(c);
+    }
+    return true;
+}
+
+/*
+   Parse a list of data tokens, as strings or byte values, starting at the given token.
+ */
+static bool parse_data(const std::vector<std::string>& tokens, size_t first, std::vector<uint8_t>& data)
+{
+    data.clear();
+    for (size_t i = first; i < tokens.size(); ++i) {
+        const std::string& t = tokens[i];
+        if (t[0] == '"') {
+            if (!decode_string(t, data)) return false;
+        } else {
+            char* end;
+            unsigned long v = strtoul(t.c_str(), &end, 0);
+            if (*end || v > 0xFF) return false;
+            data.push_back(v);
+        }
+    }
+    return data.size() > 0;
+}
+
+static bool parse_uint(const std::string& s, unsigned long long& v)
+{
+    char* end;
+    v = strtoull(s.c_str(), &end, 0);
+    return !s.empty() && !*end;
+}
+
+
+/**
+   Build a schedule for a device.
+ */
+StimulusSchedule::StimulusSchedule(Device& device)
+:StimulusReplayer(device)
+,m_frame_interval(1)
+{}
+
+/**
+   Set the interval, in cycles, between the frames of a SPI event.
+ */
+void StimulusSchedule::set_frame_interval(cycle_count_t interval)
+{
+    m_frame_interval = interval > 0 ? interval : 1;
+}
+
+/**
+   Load the schedule from a text file. The events replace any previous stimuli.
+   \return true if the file was read and parsed successfully
+ */
+bool StimulusSchedule::load_text(const std::string& filename)
+{
+    FILE* f = fopen(filename.c_str(), "r");
+    if (!f) return false;
+
+    std::string text;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        text.append(buf, n);
+
+    bool ok = !ferror(f);
+    fclose(f);
+
+    return ok && parse(text);
+}
+
+/**
+   Parse a schedule from a text. The events replace any previous stimuli.
+   \return true if the text was parsed successfully. Errors are reported to the
+   device logger with the line number.
+ */
+bool StimulusSchedule::parse(const std::string& text)
+{
+    std::vector<stimulus_t> stimuli;
+    cycle_count_t time = 0;
+    unsigned int line_num = 0;
+    size_t pos = 0;
+
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string::npos) eol = text.size();
+        std::string line = text.substr(pos, eol - pos);
+        pos = eol + 1;
+        ++line_num;
+
+        if (!parse_line(line.c_str(), time, stimuli)) {
+            m_device.logger().err("Stimulus schedule: syntax error line %u", line_num);
+            return false;
+        }
+    }
+
+    std::stable_sort(stimuli.begin(), stimuli.end(),
+                     [](const stimulus_t& a, const stimulus_t& b) { return a.cycle < b.cycle; });
+
+    set_stimuli(stimuli);
+
+    return true;
+}
+
+/*
+   Parse a time token. A duration is converted into cycles with the device frequency.
+ */
+bool StimulusSchedule::parse_time(const std::string& s, cycle_count_t prev, cycle_count_t& time)
+{
+    bool relative = s[0] == '+';
+    const char* start = s.c_str() + (relative ? 1 : 0);
+
+    char* end;
+    double v = strtod(start, &end);
+    if (end == start || v < 0.0) return false;
+
+    double unit;
+    if (!*end) {
+        unit = 0.0;
+    }
+    else if (!strcmp(end, "s")) unit = 1.0;
+    else if (!strcmp(end, "ms")) unit = 1e-3;
+    else if (!strcmp(end, "us")) unit = 1e-6;
+    else if (!strcmp(end, "ns")) unit = 1e-9;
+    else return false;
+
+    cycle_count_t c;
+    if (unit == 0.0) {
+        c = (cycle_count_t) v;
+    } else {
+        if (!m_device.frequency()) return false;
+        c = (cycle_count_t) llround(v * unit * m_device.frequency());
+    }
+
+    time = relative ? (prev + c) : c;
+    return true;
+}
+
+bool StimulusSchedule::parse_line(const char* line, cycle_count_t& time, std::vector<stimulus_t>& stimuli)
+{
+    std::vector<std::string> tokens;
+    if (!tokenize(line, tokens)) return false;
+    if (tokens.empty()) return true;
+    if (tokens.size() < 3) return false;
+
+    if (!parse_time(tokens[0], time, time)) return false;
+
+    const std::string& cmd = tokens[1];
+    std::vector<uint8_t> data;
+    stimulus_t s;
+    s.cycle = time;
+
+    if (cmd == "pin") {
+        if (tokens.size() != 4) return false;
+        Pin* pin = m_device.find_pin(str_to_id(tokens[2].c_str()));
+        if (!pin) return false;
+
+        const std::string& st = tokens[3];
+        double level = 0.0;
+        if (st == "H") s.id = Pin::State_High;
+        else if (st == "L") s.id = Pin::State_Low;
+        else if (st == "U") s.id = Pin::State_PullUp;
+        else if (st == "D") s.id = Pin::State_PullDown;
+        else if (st == "Z") s.id = Pin::State_Floating;
+        else {
+            char* end;
+            level = strtod(st.c_str(), &end);
+            if (*end) return false;
+            s.id = Pin::State_Analog;
+        }
+
+        s.type = stimulus_t::Stimulus_Pin;
+        s.target = pin->id();
+        s.set_data(level);
+        stimuli.push_back(s);
+    }
+    else if (cmd == "uart" || cmd == "spi") {
+        if (tokens[2].size() != 1 || !parse_data(tokens, 3, data)) return false;
+
+        if (cmd == "uart") {
+            s.type = stimulus_t::Stimulus_UART;
+            s.target = AVR_IOCTL_UART(tokens[2][0]);
+            s.set_data(vardata_t(data.data(), data.size()));
+            stimuli.push_back(s);
+        } else {
+            s.type = stimulus_t::Stimulus_SPI;
+            s.target = AVR_IOCTL_SPI(tokens[2][0]);
+            for (size_t i = 0; i < data.size(); ++i) {
+                s.cycle = time + i * m_frame_interval;
+                s.index = (i == data.size() - 1) ? 1 : 0;
+                s.set_data(data[i]);
+                stimuli.push_back(s);
+            }
+        }
+    }
+    else if (cmd == "twi") {
+        unsigned long long channel, reg;
+        if (tokens.size() < 5 || !parse_uint(tokens[2], channel) || !parse_uint(tokens[3], reg) ||
+            !parse_data(tokens, 4, data))
+            return false;
+
+        s.type = stimulus_t::Stimulus_TWI;
+        s.target = channel;
+        s.index = reg;
+        s.set_data(vardata_t(data.data(), data.size()));
+        stimuli.push_back(s);
+    }
+    else if (cmd == "hook") {
+        unsigned long long channel, sigid;
+        char* end;
+        if (tokens.size() != 6 || !parse_uint(tokens[2], channel) || !parse_uint(tokens[3], sigid))
+            return false;
+        long long index = strtoll(tokens[4].c_str(), &end, 0);
+        if (*end) return false;
+
+        const std::string& v = tokens[5];
+        if (v[0] == '"') {
+            if (!decode_string(v, data)) return false;
+            data.push_back(0);
+            s.set_data((const char*) data.data());
+        }
+        else if (v.find_first_of(".eE") != std::string::npos && v.find("0x") != 0) {
+            s.set_data(strtod(v.c_str(), &end));
+        }
+        else if (v[0] == '-') {
+            s.set_data(strtoll(v.c_str(), &end, 0));
+        }
+        else {
+            s.set_data(strtoull(v.c_str(), &end, 0));
+        }
+        if (v[0] != '"' && *end) return false;
+
+        s.type = stimulus_t::Stimulus_Hook;
+        s.target = channel;
+        s.id = sigid;
+        s.index = index;
+        stimuli.push_back(s);
+    }
+    else {
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,286 @@
+/*
+ * sim_stimulus.h
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#ifndef __YASIMAVR_STIMULUS_H__
+#define __YASIMAVR_STIMULUS_H__
+
+#include "../core/sim_types.h"
+#include "../core/sim_device.h"
+#include <vector>
+#include <string>
+
+YASIMAVR_BEGIN_NAMESPACE
+
+class TWIRegisterMap;
+
+
+//=======================================================================================
+/**
+   \brief External stimulus record
+
+   Record of a single stimulus applied to a device from the outside of the simulation,
+   with the cycle at which it was applied.
+ */
+struct AVR_CORE_PUBLIC_API stimulus_t {
+
+    enum Type {
+        ///Change of the external state of a pin. target is the pin ID, id is the state
+        ///and the data is the voltage.
+        Stimulus_Pin = 1,
+        ///Signal raised to a hook. target is the channel index, id, index and data are
+        ///the signal data.
+        Stimulus_Hook,
+        ///Controller request. target is the CTL ID, id is the request, index and data
+        ///are the request data.
+        Stimulus_CtlReq,
+        ///Frames received by a UART. target is the CTL ID of the UART, the data is
+        ///the frames as bytes.
+        Stimulus_UART,
+        ///Frame received by a SPI interface in client mode. target is the CTL ID of the SPI,
+        ///the data is the frame. The interface is selected for the transfer, and deselected
+        ///after it if index is non-zero.
+        Stimulus_SPI,
+        ///Write of registers of a TWI register map. target is the channel index of the map,
+        ///index is the first register and the data is the register values as bytes.
+        Stimulus_TWI,
+    };
+
+    ///Cycle at which the stimulus is applied, it's equivalent to a timer
+    ///scheduled at this cycle. INVALID_CYCLE means before the first cycle.
+    cycle_count_t cycle = INVALID_CYCLE;
+    Type type = Stimulus_Pin;
+    sim_id_t target = 0;
+    int id = 0;
+    long long index = 0;
+    int hooktag = 0;
+
+    void set_data(const vardata_t& v);
+    vardata_t data() const;
+
+private:
+
+    friend class StimulusRecorder;
+    friend class StimulusReplayer;
+
+    //Numeric value of the data
+    vardata_t m_value;
+    //Storage for string and bytes data
+    std::vector<uint8_t> m_payload;
+
+};
+
+
+//=======================================================================================
+/**
+   \brief Recorder of external stimuli
+
+   The recorder logs stimuli applied to a device with their exact cycle number, so that
+   they can be replayed later by a StimulusReplayer.
+
+   Stimuli can come from:
+    - Pins added with add_pin(): any call to Pin::set_external_state() is recorded.
+    - Signal hooks: add_hook() returns a proxy hook to connect to instead of the target hook
+      (for example the rx_hook of a UART endpoint). Signals raised to the proxy
+      are recorded and forwarded to the target.
+    - Controller requests made through ctlreq(), for instance the ADC or VREF settings.
+      Requests with pointer data cannot be recorded.
+
+   The cycle recorded is the one of the last processing of the cycle timers, so
+   that stimuli applied in-between simulation loop steps (from a AsyncSimLoop transaction
+   for example) are replayed at the same point of the execution.
+ */
+class AVR_CORE_PUBLIC_API StimulusRecorder {
+
+public:
+
+    explicit StimulusRecorder(Device& device);
+    ~StimulusRecorder();
+
+    void add_pin(Pin& pin);
+    SignalHook& add_hook(SignalHook& target);
+
+    bool ctlreq(ctl_id_t id, ctlreq_id_t req, ctlreq_data_t* reqdata = nullptr);
+
+    void set_recording(bool enabled);
+    bool recording() const;
+
+    const std::vector<stimulus_t>& stimuli() const;
+    size_t count() const;
+    void clear();
+
+    bool save(const std::string& filename) const;
+
+    StimulusRecorder(const StimulusRecorder&) = delete;
+    StimulusRecorder& operator=(const StimulusRecorder&) = delete;
+
+private:
+
+    class PinHook;
+    class ProxyHook;
+    friend class PinHook;
+    friend class ProxyHook;
+
+    Device& m_device;
+    bool m_recording;
+    PinHook* m_pin_hook;
+    std::vector<ProxyHook*> m_proxies;
+    std::vector<stimulus_t> m_stimuli;
+
+    cycle_count_t stimulus_cycle() const;
+    void record(stimulus_t& s, const vardata_t& data);
+
+};
+
+/// Returns true if the recording is enabled
+inline bool StimulusRecorder::recording() const
+{
+    return m_recording;
+}
+
+/// Returns the stimuli recorded so far
+inline const std::vector<stimulus_t>& StimulusRecorder::stimuli() const
+{
+    return m_stimuli;
+}
+
+/// Returns the number of stimuli recorded so far
+inline size_t StimulusRecorder::count() const
+{
+    return m_stimuli.size();
+}
+
+
+//=======================================================================================
+/**
+   \brief Replayer of external stimuli
+
+   The replayer re-injects a sequence of stimuli recorded by a StimulusRecorder, at
+   their recorded cycles, using a cycle timer.
+   As the stimuli were recorded in-between simulation steps, they are applied after
+   all the cycle timers of their cycle, through the deferred signal queue of the
+   cycle manager.
+   The signal hooks must be added in the same order as for the recording so that
+   the channel indexes match. The same applies to the TWI register maps.
+ */
+class AVR_CORE_PUBLIC_API StimulusReplayer : public CycleTimer {
+
+public:
+
+    explicit StimulusReplayer(Device& device);
+    virtual ~StimulusReplayer();
+
+    void add_hook(SignalHook& target);
+    void add_register_map(TWIRegisterMap& target);
+
+    void set_stimuli(const std::vector<stimulus_t>& stimuli);
+    bool load(const std::string& filename);
+
+    bool start();
+    void stop();
+    size_t remaining() const;
+
+    virtual cycle_count_t next(cycle_count_t when) override;
+
+    StimulusReplayer(const StimulusReplayer&) = delete;
+    StimulusReplayer& operator=(const StimulusReplayer&) = delete;
+
+protected:
+
+    Device& m_device;
+
+private:
+
+    class ApplyHook;
+    friend class ApplyHook;
+
+    //Signal deferred to the cycle manager queue, to apply the stimuli after the timers
+    Signal m_apply_signal;
+    ApplyHook* m_apply_hook;
+    std::vector<SignalHook*> m_hooks;
+    std::vector<TWIRegisterMap*> m_register_maps;
+    std::vector<stimulus_t> m_stimuli;
+    size_t m_pos;
+
+    void apply(const stimulus_t& s);
+    void apply_until(cycle_count_t cycle);
+
+};
+
+/// Returns the number of stimuli yet to be replayed
+inline size_t StimulusReplayer::remaining() const
+{
+    return m_stimuli.size() - m_pos;
+}
+
+
+//=======================================================================================
+/**
+   \brief Schedule of stimuli loaded from a text file
+
+   The schedule is a replayer whose stimuli are written by hand in a text file,
+   one event per line:
+   \code
+   # comment
+   <time> pin <pin> <state>
+   <time> uart <n> <data>
+   <time> spi <n> <data>
+   <time> twi <channel> <register> <data>
+   <time> hook <channel> <sigid> <index> <value>
+   \endcode
+   - time is a number of cycles, or a duration with a unit among 'ns', 'us', 'ms' and 's',
+     converted with the device frequency. With a '+' prefix, it is relative to the
+     previous event. The events are sorted by time when loaded.
+   - pin is the pin name, state is H (high), L (low), U (pull-up), D (pull-down),
+     Z (floating) or a number for an analog voltage relative to VCC.
+   - n is the peripheral index character, as in AVR_IOCTL_UART(n).
+   - data is a quoted string with C escapes (\\n, \\r, \\t, \\\\, \\", \\xHH)
+     or a list of byte values.
+   - The SPI frames are transferred to the interface in client mode, one frame per
+     frame interval, the interface being selected for the duration of the event.
+   - channel is the index of a hook or register map added to the replayer.
+   - value is an integer, a number with a decimal point or a quoted string.
+ */
+class AVR_CORE_PUBLIC_API StimulusSchedule : public StimulusReplayer {
+
+public:
+
+    explicit StimulusSchedule(Device& device);
+
+    void set_frame_interval(cycle_count_t interval);
+
+    bool load_text(const std::string& filename);
+    bool parse(const std::string& text);
+
+private:
+
+    cycle_count_t m_frame_interval;
+
+    bool parse_line(const char* line, cycle_count_t& time, std::vector<stimulus_t>& stimuli);
+    bool parse_time(const std::string& s, cycle_count_t prev, cycle_count_t& time);
+
+};
+
+
+YASIMAVR_END_NAMESPACE
+
+#endif //__YASIMAVR_STIMULUS_H__
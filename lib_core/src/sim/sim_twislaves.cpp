@@ -0,0 +1,340 @@
+/*
+ * sim_twislaves.cpp
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+#include "sim_twislaves.h"
+#include <algorithm>
+#include <cstdio>
+
+YASIMAVR_USING_NAMESPACE
+
+
+//=======================================================================================
+
+/**
+   Build an EEPROM model owning its storage.
+   A size of zero is invalid, the model is then disabled and never
+   acknowledges its address.
+   \param size size of the memory, in bytes
+   \param page_size size of the write pages, in bytes
+   \param address base device address (7 bits)
+ */
+TWIEEPROM::TWIEEPROM(size_t size, size_t page_size, uint8_t address)
+:m_memory(new NonVolatileMemory(size, "twi_eeprom"))
+,m_owns_memory(true)
+,m_page_size(page_size)
+,m_address(address)
+{
+    setup();
+}
+
+/**
+   Build an EEPROM model using a storage provided by the caller.
+   The storage must outlive the model. As for the other constructor, a storage
+   of size zero disables the model.
+   \param memory storage of the memory
+   \param page_size size of the write pages, in bytes
+   \param address base device address (7 bits)
+ */
+TWIEEPROM::TWIEEPROM(NonVolatileMemory& memory, size_t page_size, uint8_t address)
+:m_memory(&memory)
+,m_owns_memory(false)
+,m_page_size(page_size)
+,m_address(address)
+{
+    setup();
+}
+
+TWIEEPROM::~TWIEEPROM()
+{
+    if (m_owns_memory)
+        delete m_memory;
+}
+
+void TWIEEPROM::setup()
+{
+    size_t size = m_memory->size();
+
+    if (!m_page_size || m_page_size > size)
+        m_page_size = size ? size : 1;
+
+    m_addr_bytes = (size > 2048) ? 2 : 1;
+
+    //Number of memory address bits not covered by the word address
+    unsigned int block_bits = 0;
+    while (block_bits < 3 && ((size_t) 1 << (8 * m_addr_bytes + block_bits)) < size)
+        ++block_bits;
+    m_block_mask = (1 << block_bits) - 1;
+
+    m_address &= 0x7F;
+    m_pointer = 0;
+    m_addr_count = 0;
+    m_page.resize(m_page_size);
+    m_page_set.resize(m_page_size);
+    m_page_dirty = false;
+
+    m_cycle_manager = nullptr;
+    m_write_delay = 0;
+    m_busy_until = 0;
+}
+
+/**
+   Set the base device address. The bits used as memory address bits are ignored.
+ */
+void TWIEEPROM::set_address(uint8_t address)
+{
+    m_address = address & 0x7F;
+}
+
+/**
+   Set the duration of the write cycle, during which the device does not
+   acknowledge its address.
+   \param cycle_manager cycle manager used as time reference, null to disable the delay
+   \param delay duration of the write cycle in clock cycles
+ */
+void TWIEEPROM::set_write_delay(CycleManager* cycle_manager, cycle_count_t delay)
+{
+    m_cycle_manager = cycle_manager;
+    m_write_delay = delay;
+    m_busy_until = 0;
+}
+
+/**
+   Returns true if a write cycle is in progress.
+ */
+bool TWIEEPROM::busy() const
+{
+    return m_cycle_manager && m_cycle_manager->cycle() < m_busy_until;
+}
+
+bool TWIEEPROM::address_match(uint8_t addr, bool rw)
+{
+    //A START discards any page data not committed
+    m_page_dirty = false;
+
+    //A model with a zero-size memory is disabled
+    if (!size())
+        return false;
+
+    if ((addr & ~m_block_mask) != (m_address & ~m_block_mask) || busy())
+        return false;
+
+    size_t block = (size_t) (addr & m_block_mask) << (8 * m_addr_bytes);
+    if (rw) {
+        m_pointer = (block | (m_pointer & (((size_t) 1 << (8 * m_addr_bytes)) - 1))) % size();
+        m_addr_count = 0;
+    } else {
+        m_pointer = block;
+        m_addr_count = m_addr_bytes;
+    }
+
+    return true;
+}
+
+bool TWIEEPROM::write_byte(uint8_t data)
+{
+    //The first bytes are the word address
+    if (m_addr_count) {
+        m_pointer |= (size_t) data << (8 * --m_addr_count);
+        if (!m_addr_count)
+            m_pointer %= size();
+        return true;
+    }
+
+    //Latch the data in the page buffer and roll over within the page
+    size_t offset = m_pointer % m_page_size;
+    if (!m_page_dirty) {
+        std::fill(m_page_set.begin(), m_page_set.end(), 0);
+        m_page_dirty = true;
+    }
+    m_page[offset] = data;
+    m_page_set[offset] = 1;
+
+    m_pointer = (m_pointer - offset) + ((offset + 1) % m_page_size);
+
+    return true;
+}
+
+uint8_t TWIEEPROM::read_byte()
+{
+    uint8_t v = (*m_memory)[m_pointer];
+    m_pointer = (m_pointer + 1) % size();
+    return v;
+}
+
+size_t TWIEEPROM::read_data(uint8_t* data, size_t length)
+{
+    if (!size()) return 0;
+
+    size_t n = 0;
+    while (n < length) {
+        size_t len = length - n;
+        if (len > size() - m_pointer)
+            len = size() - m_pointer;
+        m_memory->dbg_read(data + n, m_pointer, len);
+        n += len;
+        m_pointer = (m_pointer + len) % size();
+    }
+    return length;
+}
+
+void TWIEEPROM::transfer_stop()
+{
+    if (!m_page_dirty) return;
+    m_page_dirty = false;
+
+    //Commit the page buffer to the storage
+    size_t base = m_pointer - (m_pointer % m_page_size);
+    for (size_t i = 0; i < m_page_size; ++i) {
+        if (m_page_set[i])
+            m_memory->program({ 1, &m_page[i] }, base + i);
+    }
+
+    if (m_cycle_manager)
+        m_busy_until = m_cycle_manager->cycle() + m_write_delay;
+}
+
+
+//=======================================================================================
+
+/**
+   Build a register map model.
+   \param address device address (7 bits)
+   \param size number of registers
+ */
+TWIRegisterMap::TWIRegisterMap(uint8_t address, size_t size)
+:m_address(address & 0x7F)
+,m_registers(size ? size : 1)
+,m_index_bytes((size > 256) ? 2 : 1)
+,m_index(0)
+,m_index_count(0)
+{
+    m_buffer = m_registers.data();
+}
+
+/**
+   Set the device address.
+ */
+void TWIRegisterMap::set_address(uint8_t address)
+{
+    m_address = address & 0x7F;
+}
+
+/**
+   Returns the content of a register, or 0 if the index is out of range.
+ */
+uint8_t TWIRegisterMap::read_register(size_t index) const
+{
+    return (index < size()) ? m_buffer[index] : 0;
+}
+
+/**
+   Set the content of a register. Does nothing if the index is out of range.
+ */
+void TWIRegisterMap::write_register(size_t index, uint8_t value)
+{
+    if (index < size())
+        m_buffer[index] = value;
+}
+
+/**
+   Set the content of a range of registers.
+   \param values new register contents
+   \param base index of the first register to set
+   \param len number of registers to set, truncated to the size of the map
+ */
+void TWIRegisterMap::write_registers(const uint8_t* values, size_t base, size_t len)
+{
+    for (size_t i = 0; i < len && (base + i) < size(); ++i)
+        m_buffer[base + i] = values[i];
+}
+
+/**
+   Load the register contents from a binary file.
+   \param filename path of the file
+   \param base index of the first register to load, the file content
+   is truncated to the size of the map
+   \return true if the file could be read
+ */
+bool TWIRegisterMap::load_file(const std::string& filename, size_t base)
+{
+    if (base >= size()) return false;
+
+    FILE* f = fopen(filename.c_str(), "rb");
+    if (!f) return false;
+
+    fread(m_buffer + base, 1, size() - base, f);
+    bool ok = !ferror(f);
+    fclose(f);
+
+    return ok;
+}
+
+/**
+   Set a buffer provided by the caller as storage for the registers.
+   The buffer must be at least as large as the map and outlive the model, or be reset
+   before. The content is read and written directly by the transfers.
+   \param buffer storage for the registers, null to revert to the internal storage
+ */
+void TWIRegisterMap::set_buffer(uint8_t* buffer)
+{
+    m_buffer = buffer ? buffer : m_registers.data();
+}
+
+bool TWIRegisterMap::address_match(uint8_t addr, bool rw)
+{
+    if (addr != m_address)
+        return false;
+
+    if (rw) {
+        m_index_count = 0;
+        m_signal.raise(Signal_Read, 0, m_index);
+    } else {
+        m_index = 0;
+        m_index_count = m_index_bytes;
+    }
+
+    return true;
+}
+
+bool TWIRegisterMap::write_byte(uint8_t data)
+{
+    //The first bytes are the index of the register
+    if (m_index_count) {
+        m_index |= (size_t) data << (8 * --m_index_count);
+        if (!m_index_count)
+            m_index %= size();
+        return true;
+    }
+
+    m_buffer[m_index] = data;
+    m_signal.raise(Signal_Write, data, m_index);
+    m_index = (m_index + 1) % size();
+
+    return true;
+}
+
+uint8_t TWIRegisterMap::read_byte()
+{
+    uint8_t v = m_buffer[m_index];
+    m_index = (m_index + 1) % size();
+    return v;
+}
@@ -0,0 +1,206 @@
+/*
+ * sim_twislaves.h
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+#ifndef __YASIMAVR_TWISLAVES_H__
+#define __YASIMAVR_TWISLAVES_H__
+
+#include "../core/sim_memory.h"
+#include "../ioctrl_common/sim_twi.h"
+#include <string>
+
+YASIMAVR_BEGIN_NAMESPACE
+
+
+//=======================================================================================
+/**
+   \ingroup api_twi
+   \brief Model of a 24Cxx-style paged TWI EEPROM
+
+   The word address is sent in 1 byte for memories up to 2kB and in 2 bytes above.
+   If the word address does not cover the whole memory, the extra address bits are taken
+   from the LSBs of the device address, as on the 24C04/08/16 or the 24C1024.
+
+   Written bytes are latched in a page buffer, rolling over within the page, and are
+   committed to the storage when the master releases the bus. If a write delay is set,
+   the device then does not acknowledge its address until the write cycle is complete,
+   which allows acknowledge polling by the firmware.
+   Reads are sequential from the current address and roll over the whole memory.
+
+   The storage is a NonVolatileMemory, which can be owned by the model or provided by the
+   caller. It can be mapped to a file so that the content persists across runs.
+ */
+class AVR_CORE_PUBLIC_API TWIEEPROM : public TWISlaveModel {
+
+public:
+
+    TWIEEPROM(size_t size, size_t page_size, uint8_t address = 0x50);
+    TWIEEPROM(NonVolatileMemory& memory, size_t page_size, uint8_t address = 0x50);
+    virtual ~TWIEEPROM();
+
+    void set_address(uint8_t address);
+    uint8_t address() const;
+
+    size_t size() const;
+    size_t page_size() const;
+    NonVolatileMemory& memory();
+
+    void set_write_delay(CycleManager* cycle_manager, cycle_count_t delay);
+    bool busy() const;
+
+    virtual bool address_match(uint8_t addr, bool rw) override;
+    virtual bool write_byte(uint8_t data) override;
+    virtual uint8_t read_byte() override;
+    virtual void transfer_stop() override;
+    virtual size_t read_data(uint8_t* data, size_t length) override;
+
+private:
+
+    NonVolatileMemory* m_memory;
+    bool m_owns_memory;
+    size_t m_page_size;
+    uint8_t m_address;
+    //Number of bytes of the word address
+    unsigned int m_addr_bytes;
+    //Mask of the device address bits used as memory address bits
+    uint8_t m_block_mask;
+    //Current memory address
+    size_t m_pointer;
+    //Number of word address bytes still expected in a write transfer
+    unsigned int m_addr_count;
+    //Page buffer and flags of the bytes written in it
+    std::vector<uint8_t> m_page;
+    std::vector<uint8_t> m_page_set;
+    bool m_page_dirty;
+
+    CycleManager* m_cycle_manager;
+    cycle_count_t m_write_delay;
+    cycle_count_t m_busy_until;
+
+    void setup();
+
+};
+
+/// Returns the base device address.
+inline uint8_t TWIEEPROM::address() const
+{
+    return m_address;
+}
+
+/// Returns the size of the memory, in bytes.
+inline size_t TWIEEPROM::size() const
+{
+    return m_memory->size();
+}
+
+/// Returns the size of the write pages, in bytes.
+inline size_t TWIEEPROM::page_size() const
+{
+    return m_page_size;
+}
+
+/// Returns the storage of the memory.
+inline NonVolatileMemory& TWIEEPROM::memory()
+{
+    return *m_memory;
+}
+
+
+//=======================================================================================
+/**
+   \ingroup api_twi
+   \brief Model of a generic TWI slave with a map of registers, such as a sensor
+
+   The master selects a register by writing its index (1 byte for maps up to 256
+   registers, 2 bytes above), then reads or writes the following registers,
+   with auto-increment of the index.
+
+   The register contents can be set with write_register(s), loaded from a binary file,
+   or read directly from a buffer provided by the caller. Signal_Read is raised at the
+   start of each read transfer so that a hook can update the contents just in time.
+ */
+class AVR_CORE_PUBLIC_API TWIRegisterMap : public TWISlaveModel {
+
+public:
+
+    enum SignalId {
+        /// Raised when the address is acknowledged for a read transfer, before the
+        /// first register is read. index is set to the index of the register.
+        Signal_Read,
+        /// Raised when a register is written by the master. index is set to the
+        /// index of the register and data to the byte written.
+        Signal_Write,
+    };
+
+    explicit TWIRegisterMap(uint8_t address, size_t size = 256);
+
+    void set_address(uint8_t address);
+    uint8_t address() const;
+
+    size_t size() const;
+
+    Signal& signal();
+
+    uint8_t read_register(size_t index) const;
+    void write_register(size_t index, uint8_t value);
+    void write_registers(const uint8_t* values, size_t base, size_t len);
+    bool load_file(const std::string& filename, size_t base = 0);
+    void set_buffer(uint8_t* buffer);
+
+    virtual bool address_match(uint8_t addr, bool rw) override;
+    virtual bool write_byte(uint8_t data) override;
+    virtual uint8_t read_byte() override;
+
+private:
+
+    uint8_t m_address;
+    std::vector<uint8_t> m_registers;
+    //Register storage, either m_registers or a buffer provided by the caller
+    uint8_t* m_buffer;
+    unsigned int m_index_bytes;
+    size_t m_index;
+    //Number of register index bytes still expected in a write transfer
+    unsigned int m_index_count;
+    Signal m_signal;
+
+};
+
+/// Returns the device address.
+inline uint8_t TWIRegisterMap::address() const
+{
+    return m_address;
+}
+
+/// Returns the number of registers.
+inline size_t TWIRegisterMap::size() const
+{
+    return m_registers.size();
+}
+
+inline Signal& TWIRegisterMap::signal()
+{
+    return m_signal;
+}
+
+
+YASIMAVR_END_NAMESPACE
+
+#endif //__YASIMAVR_TWISLAVES_H__
@@ -0,0 +1,466 @@
+/*
+ * sim_uartbridge.cpp
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#include "sim_uartbridge.h"
+#include <cerrno>
+#include <thread>
+
+#if defined _WIN32
+#include <io.h>
+#include <fcntl.h>
+#define bridge_open     _open
+#define bridge_read     _read
+#define bridge_write    _write
+#define bridge_close    _close
+#define O_NONBLOCK      0
+#define O_NOCTTY        0
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#define bridge_open     ::open
+#define bridge_read     ::read
+#define bridge_write    ::write
+#define bridge_close    ::close
+#endif
+
+YASIMAVR_USING_NAMESPACE
+
+
+//=======================================================================================
+
+#define DEFAULT_POLL_PERIOD     1000
+#define DEFAULT_RX_WINDOW       256
+#define CHUNK_SIZE              4096
+
+
+static void set_non_blocking(int fd)
+{
+#if !defined _WIN32
+    int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0)
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
+
+static bool is_fifo(int fd)
+{
+#if !defined _WIN32
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+#else
+    return false;
+#endif
+}
+
+
+//=======================================================================================
+
+/**
+   Build a UART bridge.
+   \param device device containing the UART to connect to
+   \param buffer_size capacity of each of the RX and TX ring buffers
+ */
+UARTBridge::UARTBridge(Device& device, size_t buffer_size)
+:m_device(device)
+,m_endpoint(nullptr)
+,m_uart(nullptr)
+,m_mode(Mode_Timed)
+,m_poll_period(DEFAULT_POLL_PERIOD)
+,m_rx_window(DEFAULT_RX_WINDOW)
+,m_in_fd(-1)
+,m_out_fd(-1)
+,m_owns_in(false)
+,m_owns_out(false)
+,m_in_eof(false)
+,m_in_fifo(false)
+,m_rx_buffer(buffer_size)
+,m_tx_buffer(buffer_size)
+,m_chunk(CHUNK_SIZE)
+,m_rx_count(0)
+,m_tx_count(0)
+,m_tx_dropped(0)
+{}
+
+
+UARTBridge::~UARTBridge()
+{
+    detach();
+    close();
+}
+
+
+/**
+   Attach the bridge to a device UART. The device must be initialised.
+   \param uart_id identifier of the UART peripheral, e.g. AVR_IOCTL_UART('0')
+   \return true if the attachment succeeded
+ */
+bool UARTBridge::attach(ctl_id_t uart_id)
+{
+    detach();
+
+    ctlreq_data_t reqdata;
+    if (!m_device.ctlreq(uart_id, AVR_CTLREQ_UART_ENDPOINT, &reqdata))
+        return false;
+
+    UARTEndPoint* endpoint = reinterpret_cast<UARTEndPoint*>(reqdata.data.as_ptr());
+    UART* uart = endpoint ? dynamic_cast<UART*>(endpoint->rx_hook) : nullptr;
+    if (!uart) {
+        m_device.logger().err("UART bridge: end point of %s is not a UART", id_to_str(uart_id).c_str());
+        return false;
+    }
+
+    m_endpoint = endpoint;
+    m_uart = uart;
+    m_uart->set_fast_mode(m_mode == Mode_Fast);
+    m_endpoint->tx_signal->connect(*this);
+
+    start_polling();
+
+    return true;
+}
+
+
+/**
+   Detach the bridge from the device UART. The data already buffered is kept.
+ */
+void UARTBridge::detach()
+{
+    if (!m_endpoint) return;
+
+    m_endpoint->tx_signal->disconnect(*this);
+    m_uart->set_fast_mode(false);
+    m_endpoint = nullptr;
+    m_uart = nullptr;
+
+    if (scheduled())
+        m_device.cycle_manager()->cancel(*this);
+}
+
+
+/**
+   Set the mode of the bridge.
+   \sa Mode
+ */
+void UARTBridge::set_mode(Mode mode)
+{
+    m_mode = mode;
+    if (m_uart)
+        m_uart->set_fast_mode(mode == Mode_Fast);
+}
+
+
+/**
+   Set the period, in cycles, at which the host descriptors are polled.
+ */
+void UARTBridge::set_poll_period(cycle_count_t period)
+{
+    m_poll_period = period > 0 ? period : 1;
+}
+
+
+/**
+   Set the maximum number of frames queued in the UART at any time.
+ */
+void UARTBridge::set_rx_window(size_t window)
+{
+    m_rx_window = window ? window : 1;
+}
+
+
+/**
+   Open host files to connect to the UART.
+   If both paths are identical, the file is opened once for reading and writing,
+   which is the use case of a pseudo-terminal.
+   \param in_path path of the file to read the data to inject from, empty to disable RX
+   \param out_path path of the file to write the emitted frames to, empty to disable TX.
+   A regular file is created or truncated.
+   \return true if the files were opened successfully
+ */
+bool UARTBridge::open(const std::string& in_path, const std::string& out_path)
+{
+    close();
+
+    if (in_path.size() && in_path == out_path) {
+        int fd = bridge_open(in_path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (fd < 0) return false;
+        m_in_fd = m_out_fd = fd;
+        m_owns_in = true;
+    } else {
+        if (in_path.size()) {
+            m_in_fd = bridge_open(in_path.c_str(), O_RDONLY | O_NONBLOCK);
+            m_owns_in = true;
+            if (m_in_fd < 0) {
+                close();
+                return false;
+            }
+        }
+        if (out_path.size()) {
+            m_out_fd = bridge_open(out_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK, 0644);
+            m_owns_out = true;
+            if (m_out_fd < 0) {
+                close();
+                return false;
+            }
+        }
+    }
+
+    m_in_fifo = m_in_fd >= 0 && is_fifo(m_in_fd);
+
+    start_polling();
+
+    return true;
+}
+
+
+/**
+   Connect the UART to already opened host descriptors. The descriptors are switched
+   to non-blocking mode and are not closed by the bridge.
+   \param in_fd descriptor to read the data to inject from, -1 to disable RX
+   \param out_fd descriptor to write the emitted frames to, -1 to disable TX
+   \return true if at least one descriptor is valid
+ */
+bool UARTBridge::open_fd(int in_fd, int out_fd)
+{
+    close();
+
+    m_in_fd = in_fd >= 0 ? in_fd : -1;
+    m_out_fd = out_fd >= 0 ? out_fd : -1;
+    if (m_in_fd >= 0) set_non_blocking(m_in_fd);
+    if (m_out_fd >= 0) set_non_blocking(m_out_fd);
+
+    m_in_fifo = m_in_fd >= 0 && is_fifo(m_in_fd);
+
+    start_polling();
+
+    return is_open();
+}
+
+
+/**
+   Close the host descriptors. The frames pending for the output are written if
+   it can be done without waiting, and are discarded otherwise.
+ */
+void UARTBridge::close()
+{
+    write_output();
+
+    if (m_owns_in && m_in_fd >= 0)
+        bridge_close(m_in_fd);
+    if (m_owns_out && m_out_fd >= 0 && m_out_fd != m_in_fd)
+        bridge_close(m_out_fd);
+
+    m_in_fd = m_out_fd = -1;
+    m_owns_in = m_owns_out = false;
+    m_in_eof = false;
+    m_in_fifo = false;
+    m_rx_buffer.clear();
+    m_tx_buffer.clear();
+
+    if (scheduled())
+        m_device.cycle_manager()->cancel(*this);
+}
+
+
+/**
+   Write all the frames pending for the output, waiting for the host if necessary.
+   It returns early if the output fails.
+ */
+void UARTBridge::flush()
+{
+    while (m_out_fd >= 0 && !m_tx_buffer.empty()) {
+        size_t n = m_tx_buffer.size();
+        if (!write_output())
+            break;
+        if (m_tx_buffer.size() == n)
+            std::this_thread::yield();
+    }
+}
+
+
+void UARTBridge::start_polling()
+{
+    CycleManager* cm = m_device.cycle_manager();
+    if (m_endpoint && is_open() && cm && !scheduled())
+        cm->delay(*this, 1);
+}
+
+
+/*
+   Read the host input into the RX ring buffer, as much as available without waiting.
+ */
+void UARTBridge::read_input()
+{
+    if (m_in_fd < 0 || m_in_eof) return;
+
+    while (!m_rx_buffer.full()) {
+        size_t n = m_rx_buffer.capacity() - m_rx_buffer.size();
+        if (n > m_chunk.size()) n = m_chunk.size();
+
+        auto r = bridge_read(m_in_fd, m_chunk.data(), n);
+        if (r > 0) {
+            m_rx_buffer.push(m_chunk.data(), r);
+        }
+        else if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        else {
+            //A FIFO without any writer reads as empty, a writer may connect later
+            if (r == 0 && m_in_fifo)
+                break;
+            //End of input (or the other side of the terminal closed)
+            if (r == 0 || errno != EAGAIN)
+                m_in_eof = true;
+            break;
+        }
+    }
+}
+
+
+/*
+   Write the TX ring buffer to the host output, as much as accepted without waiting.
+   Returns false if the output failed.
+ */
+bool UARTBridge::write_output()
+{
+    if (m_out_fd < 0) return false;
+
+    while (!m_tx_buffer.empty()) {
+        size_t n = m_tx_buffer.peek(m_chunk.data(), m_chunk.size());
+        auto r = bridge_write(m_out_fd, m_chunk.data(), n);
+        if (r > 0) {
+            m_tx_buffer.discard(r);
+            m_tx_count += r;
+        }
+        else if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        else if (r < 0 && errno != EAGAIN) {
+            return false;
+        }
+        else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+
+/*
+   Wait for the host output to accept data, until the TX ring buffer has room
+   or the output fails.
+ */
+void UARTBridge::wait_output()
+{
+    while (m_tx_buffer.full()) {
+        size_t n = m_tx_buffer.size();
+        if (!write_output())
+            break;
+        if (m_tx_buffer.size() == n)
+            std::this_thread::yield();
+    }
+}
+
+
+/*
+   Returns the number of frames that can be injected into the UART.
+ */
+size_t UARTBridge::rx_room() const
+{
+    size_t queued = m_uart->rx_pending();
+    size_t limit = m_rx_window;
+
+    //In fast mode, the frames arrive faster than the firmware reads them, so only
+    //as many frames as the device FIFO can hold are queued, counting those in it
+    if (m_mode == Mode_Fast && m_uart->rx_buffer_limit()) {
+        queued += m_uart->rx_available();
+        if (limit > m_uart->rx_buffer_limit())
+            limit = m_uart->rx_buffer_limit();
+    }
+
+    return queued < limit ? (limit - queued) : 0;
+}
+
+
+/*
+   Inject the bytes read from the host into the UART, as many as it has room for.
+ */
+void UARTBridge::inject_rx()
+{
+    if (!m_uart) return;
+
+    size_t room = rx_room();
+    if (!room) return;
+
+    size_t n = m_rx_buffer.pop(m_chunk.data(), room < m_chunk.size() ? room : m_chunk.size());
+    if (n) {
+        signal_data_t sigdata = { UART::Signal_DataBytes, 0, vardata_t(m_chunk.data(), n) };
+        m_endpoint->rx_hook->raised(sigdata, 0);
+        m_rx_count += n;
+    }
+}
+
+
+cycle_count_t UARTBridge::next(cycle_count_t when)
+{
+    read_input();
+    inject_rx();
+    write_output();
+
+    return is_open() ? (when + m_poll_period) : 0;
+}
+
+
+void UARTBridge::raised(const signal_data_t& sigdata, int)
+{
+    //Frame emitted by the device, buffered for the output which is written
+    //in batches
+    if (sigdata.sigid == UART::Signal_DataFrame) {
+        if (m_out_fd < 0) return;
+
+        //If the output can't keep up, wait for it rather than losing the frame
+        if (m_tx_buffer.full())
+            wait_output();
+
+        if (!m_tx_buffer.push_back(sigdata.data.as_uint()))
+            ++m_tx_dropped;
+
+        if (m_tx_buffer.size() >= m_chunk.size())
+            write_output();
+    }
+    //Frame received by the device, or read by the firmware in fast mode, refill the UART.
+    //In timed mode, it is refilled when half of the window is consumed.
+    else if (sigdata.sigid == UART::Signal_RX_Complete ||
+             (sigdata.sigid == UART::Signal_RX_Pop && m_mode == Mode_Fast)) {
+        if (m_in_fd < 0) return;
+
+        if (m_mode == Mode_Timed && m_uart->rx_pending() > m_rx_window / 2) return;
+
+        if (m_rx_buffer.size() < m_rx_window)
+            read_input();
+
+        inject_rx();
+    }
+}
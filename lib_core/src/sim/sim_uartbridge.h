@@ -0,0 +1,176 @@
+/*
+ * sim_uartbridge.h
+ *
+ *  Copyright 2021 Clement Savergne <csavergne@yahoo.com>
+
+    This file is part of yasim-avr.
+
+    yasim-avr is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    yasim-avr is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//=======================================================================================
+
+#ifndef __YASIMAVR_UARTBRIDGE_H__
+#define __YASIMAVR_UARTBRIDGE_H__
+
+#include "../core/sim_device.h"
+#include "../core/sim_ringbuffer.h"
+#include "../ioctrl_common/sim_uart.h"
+#include <string>
+
+YASIMAVR_BEGIN_NAMESPACE
+
+
+//=======================================================================================
+/**
+   \brief Bridge between a device UART and host file descriptors
+
+   The bridge connects the end point of a device UART to a pair of host file descriptors,
+   which can be regular files, FIFOs or pseudo-terminals.
+   Bytes read from the input descriptor are injected into the UART RX in batches, using
+   Signal_DataBytes. Frames emitted by the UART TX are collected in a ring buffer and
+   written to the output descriptor in batches.
+
+   The descriptors are polled by a cycle timer and are used in non-blocking mode, so
+   that the simulation does not wait for the host input. If the TX ring buffer is full
+   because the output cannot keep up, the simulation waits for the host to accept more
+   data. The frames are only dropped, and counted, if the output fails.
+   An input FIFO may be opened before its writer: the bridge keeps polling it until data
+   is written into it, and after the writer has closed it.
+
+   Two modes are available:
+    - Timed : the frames are exchanged with the frame timing of the UART.
+    - Fast : the UART is put in fast mode and the frames take a single cycle each.
+      The firmware receives the data as fast as it can process it: the frames are
+      injected only when the device RX FIFO has room for them, as the firmware
+      reads it, so that it never overflows.
+
+   In timed mode, the number of frames queued in the UART at any time is limited to a
+   window, which is refilled as the frames are received by the device.
+
+   The bridge must be attached after the device initialisation, and detached or
+   destroyed before the device.
+ */
+class AVR_CORE_PUBLIC_API UARTBridge : public CycleTimer, public SignalHook {
+
+public:
+
+    enum Mode {
+        Mode_Timed = 0,
+        Mode_Fast,
+    };
+
+    explicit UARTBridge(Device& device, size_t buffer_size = 0x10000);
+    virtual ~UARTBridge();
+
+    bool attach(ctl_id_t uart_id);
+    void detach();
+
+    void set_mode(Mode mode);
+    Mode mode() const;
+
+    void set_poll_period(cycle_count_t period);
+    void set_rx_window(size_t window);
+
+    bool open(const std::string& in_path, const std::string& out_path = "");
+    bool open_fd(int in_fd, int out_fd);
+    void close();
+    bool is_open() const;
+
+    void flush();
+
+    unsigned long long rx_count() const;
+    unsigned long long tx_count() const;
+    unsigned long long tx_dropped() const;
+
+    virtual cycle_count_t next(cycle_count_t when) override;
+    virtual void raised(const signal_data_t& sigdata, int hooktag) override;
+
+    UARTBridge(const UARTBridge&) = delete;
+    UARTBridge& operator=(const UARTBridge&) = delete;
+
+private:
+
+    Device& m_device;
+    UARTEndPoint* m_endpoint;
+    UART* m_uart;
+    Mode m_mode;
+    cycle_count_t m_poll_period;
+    size_t m_rx_window;
+
+    //Host descriptors, -1 if not used
+    int m_in_fd;
+    int m_out_fd;
+    //Flags indicating the descriptors to close with the bridge
+    bool m_owns_in;
+    bool m_owns_out;
+    //Set when the end of the input is reached
+    bool m_in_eof;
+    //Set if the input is a FIFO, whose end is never final
+    bool m_in_fifo;
+
+    //Bytes read from the host and not yet injected into the UART
+    RingBuffer<uint8_t> m_rx_buffer;
+    //Frames emitted by the UART and not yet written to the host
+    RingBuffer<uint8_t> m_tx_buffer;
+    //Scratch buffer for the batch transfers
+    std::vector<uint8_t> m_chunk;
+
+    unsigned long long m_rx_count;
+    unsigned long long m_tx_count;
+    unsigned long long m_tx_dropped;
+
+    void read_input();
+    bool write_output();
+    void wait_output();
+    size_t rx_room() const;
+    void inject_rx();
+    void start_polling();
+
+};
+
+/// Returns the mode of the bridge
+inline UARTBridge::Mode UARTBridge::mode() const
+{
+    return m_mode;
+}
+
+/// Returns true if at least one host descriptor is opened
+inline bool UARTBridge::is_open() const
+{
+    return m_in_fd >= 0 || m_out_fd >= 0;
+}
+
+/// Returns the number of bytes injected into the UART RX
+inline unsigned long long UARTBridge::rx_count() const
+{
+    return m_rx_count;
+}
+
+/// Returns the number of frames written to the host output
+inline unsigned long long UARTBridge::tx_count() const
+{
+    return m_tx_count;
+}
+
+/// Returns the number of frames emitted by the UART and dropped because the output could not keep up
+inline unsigned long long UARTBridge::tx_dropped() const
+{
+    return m_tx_dropped;
+}
+
+
+YASIMAVR_END_NAMESPACE
+
+#endif //__YASIMAVR_UARTBRIDGE_H__
@@ -0,0 +1,53 @@
+# logdecode.py
+#
+# Copyright 2023 Clement Savergne <csavergne@yahoo.com>
+#
+# This file is part of yasim-avr.
+#
+# yasim-avr is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# yasim-avr is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+
+
+import argparse
+
+from ..lib import core as _corelib
+
+__all__ = ['main']
+
+
+def _create_argparser():
+    """ Create the parser for the command line.
+    """
+
+    p = argparse.ArgumentParser(description="Converts a binary log file to text")
+
+    p.add_argument('-o', '--output',
+                   metavar='PATH',
+                   help="Text file to write, the standard output if not set")
+
+    p.add_argument('input',
+                   help='Binary log file written by simrun with --log-binary')
+
+    return p
+
+
+def main(args=None):
+    parser = _create_argparser()
+    run_args = parser.parse_args(args=args)
+
+    if not _corelib.AsyncLogWriter.decode(run_args.input, run_args.output or ''):
+        raise Exception('Unable to decode the log file ' + run_args.input)
+
+
+if __name__ == '__main__':
+    main()
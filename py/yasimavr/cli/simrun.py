@@ -70,10 +70,22 @@ def _create_argparser():
                    metavar='PORT', nargs = '?', default=None, const=1234, type=int,
                    help="Enable GDB mode. Listen for GDB connection on localhost:<PORT> (default 1234)")
 
+    p.add_argument('--gdb-reverse',
+                   metavar='CYCLES', type=int, default=0,
+                   help="In GDB mode, enable reverse execution with a snapshot every <CYCLES>")
+
     p.add_argument('-v', '--verbose',
                    metavar='LEVEL', action='store', default=0, type=int,
                    help='Set the verbosity level (0-4)')
 
+    p.add_argument('-l', '--log',
+                   metavar='PATH',
+                   help="Write the log messages into a file, formatted by a background thread")
+
+    p.add_argument('--log-binary',
+                   action='store_true',
+                   help="Write the log file in binary, to be converted with yasimavr.cli.logdecode")
+
     p.add_argument('-a', '--analog',
                    metavar='VCC', nargs='?', default=None, const=5.0, type=float,
                    help="Enable analog features with <VCC> as main supply voltage (default 5.0 Volts)")
@@ -107,6 +119,7 @@ _firmware = None
 _simloop = None
 _vcd_out = None
 _probe = None
+_log_writer = None
 
 
 class _WatchDataTrace(Formatter):
@@ -280,7 +293,8 @@ def _run_asyncloop(args):
 
     gdb = GDB_Stub(conn_point=('127.0.0.1', args.gdb),
                    fw_source=args.firmware,
-                   simloop=_simloop)
+                   simloop=_simloop,
+                   reverse_interval=args.gdb_reverse)
 
     if args.verbose:
         gdb.set_verbose(True)
@@ -321,6 +335,9 @@ def main(args=None):
     _corelib.global_logger().set_level(log_level)
     _device.logger().set_level(log_level)
 
+    if _run_args.log:
+        _init_log_writer()
+
     try:
         if _run_args.gdb is None:
             _run_syncloop()
@@ -337,12 +354,29 @@ def main(args=None):
         sim_dump(_simloop, open(_run_args.dump, 'w'))
 
 
+def _init_log_writer():
+    global _log_writer
+
+    fmt = _corelib.AsyncLogWriter.Format
+    _log_writer = _corelib.AsyncLogWriter()
+    if not _log_writer.open(_run_args.log, fmt.Binary if _run_args.log_binary else fmt.Text):
+        raise Exception('Unable to open the log file ' + _run_args.log)
+
+    _device.log_handler().set_writer(_log_writer)
+
+
 def clean():
-    global _device, _firmware, _probe, _simloop, _vcd_out
+    global _device, _firmware, _probe, _simloop, _vcd_out, _log_writer
 
     if _vcd_out:
         _vcd_out.close()
 
+    if _log_writer:
+        if _device:
+            _device.log_handler().set_writer(_corelib.LogWriter.default_writer())
+        _log_writer.close()
+
+    _log_writer = None
     _vcd_out = None
     _probe = None
     _simloop = None
@@ -24,7 +24,8 @@ import threading
 import socketserver
 import time
 import os, sys
-from yasimavr.lib.core import DeviceDebugProbe, AsyncSimLoop, Device
+from yasimavr.lib.core import DeviceDebugProbe, AsyncSimLoop, Device, ExecutionHistory, \
+                                DebugCondition
 
 
 #Templates for query replies and register descriptions
@@ -83,14 +84,21 @@ class GDB_Stub:
     :param str fw_source: path to the firmware source code
     :param AsyncSimLoop simloop: Simulation loop to connect to
     :param Device device: Device simulation model to connect to
+    :param int reverse_interval: Interval in cycles between snapshots for reverse execution.
+        If zero (the default), reverse execution is disabled.
+    :param int reverse_depth: Maximum number of snapshots kept for reverse execution
 
     .. note:: At least one of simloop or device should be specified.
 
     If simloop is provided, the stub will take control of it.
     If device is provided, the stub will create a simulation loop for it and dispose of it on shutdown.
+
+    If reverse execution is enabled, the stub supports the reverse-step and reverse-continue
+    commands of GDB, going back at most reverse_interval * reverse_depth cycles.
     """
 
-    def __init__(self, conn_point, fw_source, simloop=None, device=None):
+    def __init__(self, conn_point, fw_source, simloop=None, device=None,
+                 reverse_interval=0, reverse_depth=64):
         self._source = os.path.normpath(os.path.abspath(fw_source))
         self._source = self._source.replace('\\', '/')
 
@@ -107,6 +115,11 @@ class GDB_Stub:
 
         self._probe = DeviceDebugProbe(self._device)
 
+        self._reverse_interval = reverse_interval
+        self._reverse_depth = reverse_depth
+        self._history = None
+        self.__create_history()
+
         self._server = _GDB_StubServer(conn_point, self)
         self._socket = None
 
@@ -118,22 +131,41 @@ class GDB_Stub:
 
     def set_simloop(self, simloop):
         if self._ownloop: return
+        self.__destroy_history()
         self._probe.detach()
         self._simloop = simloop
         self._device = simloop.device()
         self._probe = DeviceDebugProbe()
         self._probe.attach(self._device)
+        self.__create_history()
+
+
+    def __create_history(self):
+        if self._reverse_interval > 0:
+            self._history = ExecutionHistory(self._probe, self._reverse_interval, self._reverse_depth)
+
+
+    def __destroy_history(self):
+        if self._history is not None:
+            with self._simloop:
+                self._history.stop()
+            self._history = None
 
 
     def start(self):
         self._server.start()
 
+        if self._history is not None:
+            with self._simloop:
+                self._history.start()
+
         if self._ownloop:
             self._simloopthread = threading.Thread(target=self._simloop.run)
             self._simloopthread.start()
 
 
     def shutdown(self):
+        self.__destroy_history()
         self._probe.detach()
         self._server.shutdown()
         if self._ownloop:
@@ -261,6 +293,8 @@ class GDB_Stub:
             self.__handle_cmd_continue()
         elif cmd == 's':
             self.__handle_cmd_step()
+        elif cmd == 'b':
+            self.__handle_cmd_reverse(cmdargs)
         elif cmd == 'k':
             self.__handle_cmd_kill()
         elif cmd == 'D':
@@ -275,7 +309,10 @@ class GDB_Stub:
 
     def __handle_cmd_query(self, cmdargs):
         if cmdargs.startswith('Supported'):
-            self.__send_reply("qXfer:memory-map:read+;qXfer:exec-file:read+")
+            features = "qXfer:memory-map:read+;qXfer:exec-file:read+"
+            if self._history is not None:
+                features += ";ReverseStep+;ReverseContinue+"
+            self.__send_reply(features)
 
         elif cmdargs == 'Attached':
             self.__send_reply('1')
@@ -315,6 +352,9 @@ class GDB_Stub:
             elif rcmd == 'halt':
                 with self._simloop:
                     self._probe.set_device_state(Device.State.Stopped)
+            elif rcmd.startswith(('bcond ', 'wcond ')):
+                self.__handle_rcmd_condition(rcmd)
+                return
 
             self.__send_reply('OK')
 
@@ -487,6 +527,25 @@ class GDB_Stub:
         self.__start_simloop_join_thread()
 
 
+    def __handle_cmd_reverse(self, cmdargs):
+        if self._history is None or cmdargs not in ('s', 'c'):
+            self.__send_reply('')
+            return
+
+        with self._simloop:
+            if cmdargs == 's':
+                res = self._history.reverse_step()
+            else:
+                res = self._history.reverse_continue()
+
+        if res == ExecutionHistory.Result.Reverse_Failed:
+            self.__send_reply('E01')
+        elif res == ExecutionHistory.Result.Reverse_HistoryStart:
+            self.__send_reply('T05replaylog:begin;')
+        else:
+            self.__send_reply('S05')
+
+
     def __handle_cmd_kill(self):
         with self._simloop:
             self._simloop.loop_kill()
@@ -529,6 +588,34 @@ class GDB_Stub:
             self.__send_reply('')
 
 
+    def __handle_rcmd_condition(self, rcmd):
+        #Syntax: 'bcond <addr> [expr]' or 'wcond <addr> [expr]'
+        #No expression removes the condition
+        args = rcmd.split(None, 2)
+        try:
+            addr = int(args[1], 16) & 0xffffff
+        except (IndexError, ValueError):
+            self.__send_reply('E01')
+            return
+
+        cond = DebugCondition()
+        if len(args) > 2 and not cond.compile(args[2]):
+            if self._verbose:
+                print('GDB condition error:', cond.error())
+            self.__send_reply('E01')
+            return
+
+        with self._simloop:
+            if args[0] == 'bcond':
+                self._probe.set_breakpoint_condition(addr, cond)
+            else:
+                if 0x800000 <= addr < 0x810000:
+                    addr -= 0x800000
+                self._probe.set_watchpoint_condition(addr, cond)
+
+        self.__send_reply('OK')
+
+
     def __handle_cmd_remove_breakpoints(self, cmdargs):
         args = cmdargs.split(',')
         if args[0] == '0':
@@ -20,6 +20,10 @@
 '''
 This module defines TWI_Slave which is a simple reimplementation of
 a TWI Endpoint that can be used for simple TWI/I2C part simulation.
+
+For EEPROM or register-based parts, the native models TWIEEPROM and
+TWIRegisterMap of the core library are much faster as they do not
+run any Python code during the transfers.
 '''
 
 
@@ -22,6 +22,8 @@ This module defines UartIO which is a reimplementation of io.RawIOBase
 that can connect to a AVR device USART peripheral to exchange data with
 it as if writing to/reading from a file.
 See the serial_echo.py example for how to use it.
+For high data rates, the native UARTBridge of the core library connects a USART
+directly to host files, FIFOs or pseudo-terminals without going through Python.
 '''
 
 import collections
@@ -18,6 +18,7 @@
 # along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
 
 import pytest
+import yasimavr.lib.core as corelib
 from _test_bench_avr import BenchAVR
 from _test_utils import PinState, DictSignalHook
 
@@ -74,3 +75,55 @@ def test_avr_port_pullup(bench):
     port.PORT = 0x01
     assert bench.dev.pins['PB0'].state() == PinState.PullUp
     assert port.PIN == 0x01
+
+
+def test_avr_port_toggle(bench):
+    port = bench.dev.PORTB
+    pinB0 = bench.dev.pins['PB0']
+    pinB2 = bench.dev.pins['PB2']
+    port.DDR = 0xFF
+    port.PORT = 0x0F
+
+    #Writing 1s to PIN toggles PORT, PIN keeps reading the pin values
+    port.PIN = 0x03
+    assert port.PORT == 0x0C
+    assert port.PIN == 0x0C
+    assert pinB0.state() == PinState.Low
+    assert pinB2.state() == PinState.High
+
+    #The pull-ups follow the toggled PORT value when the pins become inputs
+    port.DDR = 0x00
+    assert pinB0.state() == PinState.Floating
+    assert pinB2.state() == PinState.PullUp
+    assert port.PIN == 0x0C
+
+
+class CountSignalHook(corelib.SignalHook):
+
+    def __init__(self, signal):
+        super().__init__()
+        signal.connect(self)
+        self.values = []
+
+    def raised(self, sigdata, tag):
+        self.values.append((sigdata.sigid, sigdata.index, sigdata.data.as_uint()))
+
+
+def test_avr_port_single_raise(bench):
+    port = bench.dev.PORTB
+    port.PORT = 0x00
+    port.DDR = 0x00
+    hook = CountSignalHook(port.signal())
+
+    #A write changing all the pins at once raises the port signal once
+    port.DDR = 0xFF
+    assert hook.values == [(0, 0, 0x00)]
+    hook.values.clear()
+
+    port.PORT = 0x5A
+    assert hook.values == [(0, 0, 0x5A)]
+    hook.values.clear()
+
+    #No raise if no pin state changes
+    port.PORT = 0x5A
+    assert hook.values == []
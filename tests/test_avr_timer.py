@@ -0,0 +1,145 @@
+# test_avr_timer.py
+#
+# Copyright 2023 Clement Savergne <csavergne@yahoo.com>
+#
+# This file is part of yasim-avr.
+#
+# yasim-avr is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# yasim-avr is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+
+import pytest
+import yasimavr.lib.core as corelib
+import yasimavr.lib.arch_avr as archlib
+from _test_bench_avr import BenchAVR
+from _test_utils import DictSignalHook
+
+
+'''
+Test of the Timer/Counter 0 on ATMega328
+'''
+
+TimerSignal = archlib.ArchAVR_Timer.SignalId
+WaveformSignal = archlib.ArchAVR_Timer.WaveformSignalId
+
+
+@pytest.fixture
+def bench():
+    return BenchAVR()
+
+
+def waveform_signal(bench):
+    ok, d = bench.dev_model.ctlreq(corelib.str_to_id('TC0'), archlib.CTLREQ_TMR_GET_WAVEFORM_SIGNAL)
+    assert ok
+    return d.data.as_ptr(corelib.DataSignal)
+
+
+def start_fast_pwm(bench):
+    tc = bench.dev.TC0
+    tc.OCR0A = 64
+    #Keep the compare match B away from BOTTOM, it would hide the BOTTOM event from channel A
+    tc.OCR0B = 200
+    #Fast PWM mode, non-inverting output on channel A, no prescaler
+    tc.TCCR0A = 0x83
+    tc.TCCR0B = 0x01
+
+
+def test_avr_timer_edges_by_default(bench):
+    hook = DictSignalHook(bench.dev.TC0.signal())
+    start_fast_pwm(bench)
+
+    for _ in range(3):
+        bench.sim_advance(300)
+        assert hook.has_data(TimerSignal.CompOutput, 0)
+        hook.pop(TimerSignal.CompOutput, 0)
+
+
+def test_avr_timer_waveform(bench):
+    wf_signal = waveform_signal(bench)
+    wf_hook = DictSignalHook(wf_signal)
+    start_fast_pwm(bench)
+
+    bench.sim_advance(2000)
+    assert wf_hook.pop_data(WaveformSignal.Period, 0) == 256
+    duty = wf_signal.data(WaveformSignal.Duty, 0).as_uint()
+    assert 64 <= duty <= 65
+    wf_hook.pop(WaveformSignal.Level, 0)
+
+    #The waveform stays steady and is not raised again
+    bench.sim_advance(2000)
+    assert not wf_hook.has_data(WaveformSignal.Period, 0)
+    assert not wf_hook.has_data(WaveformSignal.Level, 0)
+
+    #A change of the duty cycle is described again
+    bench.dev.TC0.OCR0A = 128
+    bench.sim_advance(2000)
+    assert wf_hook.pop_data(WaveformSignal.Period, 0) == 256
+    duty = wf_signal.data(WaveformSignal.Duty, 0).as_uint()
+    assert 128 <= duty <= 129
+
+    #Disabling the output ends the steady state
+    bench.dev.TC0.TCCR0A = 0x03
+    bench.sim_advance(10)
+    assert wf_hook.has_data(WaveformSignal.Period, 0)
+    assert wf_hook.pop(WaveformSignal.Period, 0)[0].data.type() == corelib.vardata_t.Type.Invalid
+
+
+def test_avr_timer_edges_with_waveform(bench):
+    wf_hook = DictSignalHook(waveform_signal(bench))
+    start_fast_pwm(bench)
+    bench.sim_advance(2000)
+    assert wf_hook.has_data(WaveformSignal.Period, 0)
+
+    #A subscriber to the timer signal receives every edge, even if the
+    #waveform is steady
+    hook = DictSignalHook(bench.dev.TC0.signal())
+    for _ in range(3):
+        bench.sim_advance(300)
+        assert hook.has_data(TimerSignal.CompOutput, 0)
+        hook.pop(TimerSignal.CompOutput, 0)
+
+
+def test_avr_timer_counter_unobserved(bench):
+    tc = bench.dev.TC0
+    #Normal mode, no prescaler and no interrupt enabled, the counter events
+    #are not observed
+    tc.TIMSK0 = 0x00
+    tc.TCCR0A = 0x00
+    start = bench.loop.cycle()
+    tc.TCCR0B = 0x01
+
+    #The counter value is calculated when read
+    for _ in range(5):
+        bench.sim_advance(700)
+        elapsed = bench.loop.cycle() - start
+        assert int(tc.TCNT0) == elapsed % 256
+
+
+def test_avr_timer_flags_unobserved(bench):
+    tc = bench.dev.TC0
+    tc.TIMSK0 = 0x00
+    tc.OCR0A = 100
+    tc.TCCR0A = 0x00
+    tc.TCCR0B = 0x01
+
+    #The flags of the events not observed are set when read
+    bench.sim_advance(300)
+    assert tc.TIFR0.TOV
+    assert tc.TIFR0.OCFA
+
+    tc.TIFR0 = 0x07
+    assert not tc.TIFR0.TOV
+    assert not tc.TIFR0.OCFA
+
+    bench.sim_advance(300)
+    assert tc.TIFR0.TOV
+    assert tc.TIFR0.OCFA
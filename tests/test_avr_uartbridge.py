@@ -0,0 +1,124 @@
+# test_avr_uartbridge.py
+#
+# Copyright 2023 Clement Savergne <csavergne@yahoo.com>
+#
+# This file is part of yasim-avr.
+#
+# yasim-avr is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# yasim-avr is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+
+import pytest
+import yasimavr.lib.core as corelib
+from _test_bench_avr import BenchAVR
+
+
+'''
+Test of the UART bridge to host files on ATMega328
+'''
+
+UARTSignal = corelib.UART.SignalId
+BridgeMode = corelib.UARTBridge.Mode
+
+DATA = bytes((i * 7 + 1) & 0xFF for i in range(32))
+
+#UBRR=1 and U2X=0 gives 32 cycles per bit, i.e. 320 cycles per 10-bits frame
+FRAME_DELAY = 320
+
+POLL_PERIOD = 10
+
+
+class RxCompleteHook(corelib.SignalHook):
+
+    def __init__(self, bench, signal):
+        super().__init__()
+        signal.connect(self)
+        self._bench = bench
+        self.cycles = []
+
+    def raised(self, sigdata, tag):
+        if sigdata.sigid == UARTSignal.RX_Complete and sigdata.data.as_uint():
+            self.cycles.append(self._bench.loop.cycle())
+
+
+@pytest.fixture
+def bench():
+    b = BenchAVR()
+    b.dev.USART.UBRR = 1
+    b.dev.USART.UCSRB = 0x18
+    return b
+
+
+def open_bridge(bench, tmp_path, mode):
+    in_path = tmp_path / 'uart_in.bin'
+    out_path = tmp_path / 'uart_out.bin'
+    in_path.write_bytes(DATA)
+
+    bridge = corelib.UARTBridge(bench.dev_model)
+    bridge.set_mode(mode)
+    bridge.set_poll_period(POLL_PERIOD)
+    assert bridge.attach(corelib.IOCTL_UART('0'))
+    assert bridge.open(str(in_path), str(out_path))
+    assert bridge.is_open()
+    return bridge, out_path
+
+
+def echo(bench, cycles):
+    '''Emulate a firmware sending back each frame as soon as it is received'''
+    usart = bench.dev.USART
+    final_cycle = bench.loop.cycle() + cycles
+    while bench.loop.cycle() < final_cycle:
+        bench.sim_advance(1)
+        if usart.UCSRA.RXC and usart.UCSRA.UDRE:
+            usart.UDR = int(usart.UDR)
+
+
+@pytest.mark.parametrize('mode', [BridgeMode.Timed, BridgeMode.Fast])
+def test_avr_uartbridge_passthrough(bench, tmp_path, mode):
+    bridge, out_path = open_bridge(bench, tmp_path, mode)
+    echo(bench, (len(DATA) + 4) * FRAME_DELAY)
+
+    bridge.flush()
+    assert bridge.rx_count() == len(DATA)
+    assert bridge.tx_count() == len(DATA)
+    assert bridge.tx_dropped() == 0
+
+    bridge.close()
+    assert not bridge.is_open()
+    assert out_path.read_bytes() == DATA
+
+
+def test_avr_uartbridge_timed(bench, tmp_path):
+    hook = RxCompleteHook(bench, bench.dev.USART.signal())
+    start = bench.loop.cycle()
+    bridge, _ = open_bridge(bench, tmp_path, BridgeMode.Timed)
+    echo(bench, (len(DATA) + 4) * FRAME_DELAY)
+    bridge.close()
+
+    #The frames are injected at the first poll and arrive back to back,
+    #at the baud rate of the UART
+    assert len(hook.cycles) == len(DATA)
+    assert hook.cycles[0] - start <= FRAME_DELAY + POLL_PERIOD
+    assert all(b - a == FRAME_DELAY for a, b in zip(hook.cycles, hook.cycles[1:]))
+
+
+def test_avr_uartbridge_fast(bench, tmp_path):
+    hook = RxCompleteHook(bench, bench.dev.USART.signal())
+    start = bench.loop.cycle()
+    bridge, _ = open_bridge(bench, tmp_path, BridgeMode.Fast)
+    echo(bench, FRAME_DELAY)
+    bridge.close()
+
+    #In fast mode, the frames are paced by the reads of the firmware instead
+    #of the baud rate
+    assert len(hook.cycles) == len(DATA)
+    assert hook.cycles[-1] - start < FRAME_DELAY
@@ -0,0 +1,105 @@
+# test_avr_usart.py
+#
+# Copyright 2023 Clement Savergne <csavergne@yahoo.com>
+#
+# This file is part of yasim-avr.
+#
+# yasim-avr is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# yasim-avr is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+
+import pytest
+import yasimavr.lib.core as corelib
+from _test_bench_avr import BenchAVR
+
+
+'''
+Test of the USART reception on ATMega328
+'''
+
+UARTSignal = corelib.UART.SignalId
+
+DATA = b'\x11\x22\x33\x44\x55'
+
+#UBRR=1 and U2X=0 gives 32 cycles per bit, i.e. 320 cycles per 10-bits frame
+FRAME_DELAY = 320
+
+
+class RxCompleteHook(corelib.SignalHook):
+
+    def __init__(self, bench, signal):
+        super().__init__()
+        signal.connect(self)
+        self._bench = bench
+        self.cycles = []
+
+    def raised(self, sigdata, tag):
+        if sigdata.sigid == UARTSignal.RX_Complete and sigdata.data.as_uint():
+            self.cycles.append(self._bench.loop.cycle())
+
+
+@pytest.fixture
+def bench():
+    b = BenchAVR()
+    b.dev.USART.UBRR = 1
+    b.dev.USART.UCSRB = 0x10
+    return b
+
+
+def rx_signal(bench):
+    ok, reqdata = bench.dev_model.ctlreq(corelib.IOCTL_UART('0'), corelib.CTLREQ_UART_ENDPOINT)
+    assert ok
+    signal = corelib.Signal()
+    signal.connect(reqdata.data.as_ptr(corelib.UARTEndPoint).rx_hook)
+    return signal
+
+
+def inject(bench, batched):
+    signal = rx_signal(bench)
+    if batched:
+        signal.raise_(UARTSignal.DataBytes, DATA)
+    else:
+        for b in DATA:
+            signal.raise_(UARTSignal.DataFrame, b)
+    return signal
+
+
+@pytest.mark.parametrize('batched', [True, False])
+def test_avr_usart_rx_timing(bench, batched):
+    usart = bench.dev.USART
+    hook = RxCompleteHook(bench, usart.signal())
+    start = bench.loop.cycle()
+    signal = inject(bench, batched)
+
+    #The firmware is emulated by reading the data as soon as it is received,
+    #the frames arrive back to back, one per frame delay
+    received = []
+    while bench.loop.cycle() < start + (len(DATA) + 1) * FRAME_DELAY:
+        bench.sim_advance(1)
+        if usart.UCSRA.RXC:
+            received.append(int(usart.UDR))
+
+    assert bytes(received) == DATA
+    assert hook.cycles == [start + (i + 1) * FRAME_DELAY for i in range(len(DATA))]
+
+
+@pytest.mark.parametrize('batched', [True, False])
+def test_avr_usart_rx_overflow(bench, batched):
+    usart = bench.dev.USART
+    signal = inject(bench, batched)
+    bench.sim_advance((len(DATA) + 1) * FRAME_DELAY)
+
+    #Without any read, the device FIFO keeps the last frames received
+    received = []
+    while usart.UCSRA.RXC:
+        received.append(int(usart.UDR))
+    assert bytes(received) == DATA[-3:]
@@ -0,0 +1,208 @@
+# test_core_analogplayer.py
+#
+# Copyright 2023 Clement Savergne <csavergne@yahoo.com>
+#
+# This file is part of yasim-avr.
+#
+# yasim-avr is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# yasim-avr is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+
+import array
+import pytest
+import yasimavr.lib.core as corelib
+from _test_bench_avr import BenchAVR
+
+
+'''
+Test of the analog stimulus player on ATMega328
+'''
+
+PlayerMode = corelib.AnalogStimulusPlayer.Mode
+PlayerFormat = corelib.AnalogStimulusPlayer.Format
+
+CSV_DATA = '''# comment line
+ch0,ch1
+0.0,1.0
+0.5, 0.5
+1.0 ; 0
+0.25 0.25
+'''
+
+CH0 = [0.0, 0.5, 1.0, 0.25]
+CH1 = [1.0, 0.5, 0.0, 0.25]
+
+#The firmware runs at 1kHz, so 10 samples/s gives 100 cycles per sample
+SAMPLE_RATE = 10
+PERIOD = 100
+
+
+class VoltageHook(corelib.SignalHook):
+
+    def __init__(self, bench, pin):
+        super().__init__()
+        pin.signal().connect(self)
+        self._bench = bench
+        self.events = []
+
+    def raised(self, sigdata, tag):
+        if sigdata.sigid == corelib.Pin.SignalId.VoltageChange:
+            self.events.append((self._bench.loop.cycle(), sigdata.data.as_double()))
+
+
+@pytest.fixture
+def bench():
+    return BenchAVR()
+
+
+@pytest.fixture
+def csv_path(tmp_path):
+    path = tmp_path / 'stimulus.csv'
+    path.write_text(CSV_DATA)
+    return str(path)
+
+
+def make_player(bench, path):
+    player = corelib.AnalogStimulusPlayer(bench.dev_model)
+    assert player.load_csv(path)
+    player.set_sample_rate(SAMPLE_RATE)
+    return player
+
+
+def sample_request(player):
+    '''Emulate an ADC about to sample its input'''
+    signal = corelib.Signal()
+    signal.connect(player)
+    signal.raise_(corelib.ADC.SignalId.AboutToSample)
+
+
+def expected_value(samples, t, interpolation=True):
+    k = int(t)
+    if k >= len(samples) - 1:
+        return samples[-1]
+    if not interpolation:
+        return samples[k]
+    return samples[k] + (samples[k + 1] - samples[k]) * (t - k)
+
+
+def test_analogplayer_load_csv(bench, csv_path, tmp_path):
+    player = make_player(bench, csv_path)
+    assert player.channels() == 2
+    assert player.sample_count() == 4
+    assert player.value(0) == CH0[0]
+    assert player.value(1) == CH1[0]
+
+    bad_path = tmp_path / 'bad.csv'
+    bad_path.write_text('0.0,1.0\nabc,1.0\n')
+    assert not player.load_csv(str(bad_path))
+    assert not player.load_csv(str(tmp_path / 'missing.csv'))
+
+
+@pytest.mark.parametrize('interpolation', [True, False])
+def test_analogplayer_on_demand(bench, csv_path, interpolation):
+    pin = bench.dev.pins['PC0']
+    player = make_player(bench, csv_path)
+    player.set_interpolation(interpolation)
+    player.add_pin(pin, 0, PlayerMode.OnDemand)
+
+    start = bench.loop.cycle()
+    assert player.start()
+    assert pin.voltage() == pytest.approx(CH0[0])
+
+    #Without sampling request, the pin is not updated
+    bench.sim_advance(PERIOD + PERIOD // 2)
+    assert pin.voltage() == pytest.approx(CH0[0])
+
+    #The value is computed at the cycle of the request
+    for _ in range(4):
+        sample_request(player)
+        t = (bench.loop.cycle() - start) / PERIOD
+        assert pin.voltage() == pytest.approx(expected_value(CH0, t, interpolation))
+        bench.sim_advance(PERIOD // 2 + 7)
+
+    #At the end of the stream, the last value is held
+    bench.sim_advance(10 * PERIOD)
+    sample_request(player)
+    assert pin.voltage() == pytest.approx(CH0[-1])
+
+
+def test_analogplayer_timed(bench, csv_path):
+    pin = bench.dev.pins['PC1']
+    hook = VoltageHook(bench, pin)
+    player = make_player(bench, csv_path)
+    player.add_pin(pin, 1, PlayerMode.Timed)
+
+    start = bench.loop.cycle()
+    assert player.start()
+    bench.sim_advance(10 * PERIOD)
+
+    #Each sample is applied at its exact cycle, then the last one is held
+    assert hook.events == [(start + i * PERIOD, pytest.approx(v)) for i, v in enumerate(CH1)]
+    assert pin.voltage() == pytest.approx(CH1[-1])
+    assert not player.scheduled()
+
+
+def test_analogplayer_repeat(bench, csv_path):
+    pin = bench.dev.pins['PC1']
+    hook = VoltageHook(bench, pin)
+    player = make_player(bench, csv_path)
+    player.set_repeat(True)
+    player.add_pin(pin, 1, PlayerMode.Timed)
+
+    start = bench.loop.cycle()
+    assert player.start()
+    bench.sim_advance(6 * PERIOD + PERIOD // 2)
+
+    expected = [(start + i * PERIOD, pytest.approx(CH1[i % 4])) for i in range(7)]
+    assert hook.events == expected
+
+    player.stop()
+    assert not player.running()
+    bench.sim_advance(2 * PERIOD)
+    assert hook.events == expected
+
+
+@pytest.mark.parametrize('fmt', [PlayerFormat.Int16, PlayerFormat.Float32])
+def test_analogplayer_raw(bench, tmp_path, fmt):
+    #Interleaved samples of 2 channels, in the host byte order
+    if fmt == PlayerFormat.Int16:
+        raw = array.array('h', [0, 16384, 8192, -16384, 16384, 0])
+        scale = 1.0 / 32768
+    else:
+        raw = array.array('f', [0.0, 0.5, 0.25, -0.5, 0.5, 0.0])
+        scale = 1.0
+    path = tmp_path / 'stimulus.raw'
+    path.write_bytes(raw.tobytes())
+
+    pin = bench.dev.pins['PC0']
+    player = corelib.AnalogStimulusPlayer(bench.dev_model)
+    assert player.load_raw(str(path), fmt, 2)
+    assert player.channels() == 2
+    assert player.sample_count() == 3
+
+    #The values are transformed by the scale and offset
+    player.set_scale(scale, 0.25)
+    player.set_sample_rate(SAMPLE_RATE)
+    player.set_interpolation(False)
+    player.add_pin(pin, 0, PlayerMode.OnDemand)
+    assert player.start()
+
+    values = []
+    for _ in range(3):
+        sample_request(player)
+        values.append(pin.voltage())
+        bench.sim_advance(PERIOD)
+    assert values == [pytest.approx(0.25), pytest.approx(0.5), pytest.approx(0.75)]
+
+    player.close()
+    assert player.sample_count() == 0
+    assert not player.running()
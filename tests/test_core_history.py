@@ -0,0 +1,91 @@
+# test_core_history.py
+#
+# Copyright 2023 Clement Savergne <csavergne@yahoo.com>
+#
+# This file is part of yasim-avr.
+#
+# yasim-avr is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# yasim-avr is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+
+import pytest
+import yasimavr.lib.core as corelib
+from _test_bench_avr import BenchAVR
+
+
+'''
+Test of the execution history on ATMega328
+'''
+
+Result = corelib.ExecutionHistory.Result
+
+
+@pytest.fixture
+def bench():
+    b = BenchAVR()
+    #Run the Timer 0 in fast PWM mode, so that the history has
+    #a timer state to rewind
+    tc = b.dev.TC0
+    tc.OCR0A = 64
+    tc.TCCR0A = 0x83
+    tc.TCCR0B = 0x01
+    return b
+
+
+def sample(bench):
+    tc = bench.dev.TC0
+    return (bench.loop.cycle(), int(tc.TCNT0), int(tc.TIFR0))
+
+
+def run_trace(bench, count):
+    trace = []
+    for _ in range(count):
+        bench.sim_advance(37)
+        trace.append(sample(bench))
+    return trace
+
+
+def test_history_rewind(bench):
+    history = corelib.ExecutionHistory(bench.probe, 500)
+    assert history.start()
+    trace = run_trace(bench, 100)
+    assert history.count() > 1
+
+    #Rewind to a point of the trace, in the middle of two snapshots,
+    #and execute again up to the end of the trace
+    k = 42
+    assert history.rewind_to(trace[k][0]) == Result.Reverse_Done
+    assert sample(bench) == trace[k]
+    for s in trace[k + 1:]:
+        bench.sim_advance(s[0] - bench.loop.cycle())
+        assert sample(bench) == s
+
+
+def test_history_reverse_step(bench):
+    history = corelib.ExecutionHistory(bench.probe, 500)
+    assert history.start()
+    bench.sim_advance(2000)
+
+    cycle = bench.loop.cycle()
+    assert history.reverse_step() == Result.Reverse_Done
+    assert bench.loop.cycle() < cycle
+
+
+def test_history_start(bench):
+    history = corelib.ExecutionHistory(bench.probe, 500)
+    assert history.start()
+    start = bench.loop.cycle()
+    bench.sim_advance(2000)
+
+    assert history.oldest_cycle() == start
+    assert history.rewind_to(start - 100) == Result.Reverse_HistoryStart
+    assert bench.loop.cycle() == start
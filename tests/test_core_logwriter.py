@@ -0,0 +1,92 @@
+# test_core_logwriter.py
+#
+# Copyright 2023 Clement Savergne <csavergne@yahoo.com>
+#
+# This file is part of yasim-avr.
+#
+# yasim-avr is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# yasim-avr is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+
+import pytest
+import yasimavr.lib.core as corelib
+
+
+'''
+Test of the asynchronous log writer, in text and binary formats
+'''
+
+
+#The stored format strings are limited to half of the record size
+MAX_FORMAT_LEN = 512
+
+EXPECTED_LINES = [
+    '[00000000] ERR TST0 : first message',
+    '[00000010] WNG TST0 : 100% done',
+    '[00000010] DBG TST0 : debug message',
+    '[00000025] ERR TST0 : ' + 'x' * MAX_FORMAT_LEN,
+    '[00000025] ERR TST0 : first message',
+]
+
+
+def write_log(path, fmt):
+    cycle_manager = corelib.CycleManager()
+    handler = corelib.LogHandler()
+    handler.init(cycle_manager)
+    logger = corelib.Logger(corelib.str_to_id('TST0'), handler)
+    logger.set_level(corelib.Logger.Level.Debug)
+
+    writer = corelib.AsyncLogWriter()
+    assert writer.open(str(path), fmt)
+    assert writer.is_open()
+    handler.set_writer(writer)
+
+    logger.err('first message')
+    cycle_manager.increment_cycle(10)
+    logger.wng('100%% done')
+    logger.dbg('debug message')
+    logger.log(corelib.Logger.Level.Trace, 'filtered out')
+    cycle_manager.increment_cycle(15)
+    logger.err('x' * (MAX_FORMAT_LEN + 100))
+    #Repeated format, written once in the binary file
+    logger.err('first message')
+
+    writer.close()
+    handler.set_writer(corelib.LogWriter.default_writer())
+    assert not writer.is_open()
+
+
+def test_logwriter_text(tmp_path):
+    path = tmp_path / 'log.txt'
+    write_log(path, corelib.AsyncLogWriter.Format.Text)
+    assert path.read_text().splitlines() == EXPECTED_LINES
+
+
+def test_logwriter_binary_decode(tmp_path):
+    path = tmp_path / 'log.bin'
+    write_log(path, corelib.AsyncLogWriter.Format.Binary)
+
+    out_path = tmp_path / 'log_decoded.txt'
+    assert corelib.AsyncLogWriter.decode(str(path), str(out_path))
+    assert out_path.read_text().splitlines() == EXPECTED_LINES
+
+
+def test_logwriter_decode_invalid(tmp_path):
+    path = tmp_path / 'log.bin'
+    path.write_bytes(b'not a log file')
+    assert not corelib.AsyncLogWriter.decode(str(path), str(tmp_path / 'out.txt'))
+
+    #Truncated file
+    write_log(path, corelib.AsyncLogWriter.Format.Binary)
+    data = path.read_bytes()
+    path.write_bytes(data[:-3])
+    assert not corelib.AsyncLogWriter.decode(str(path), str(tmp_path / 'out.txt'))
@@ -100,3 +100,78 @@ def test_nvm_block(nvm):
 
     b = nvm.block(2, 2)
     assert b == data[2:4]
+
+
+def test_nvm_program_across_words(nvm):
+    #The programmed states are stored by words of 64 bytes, check the
+    #operations on blocks crossing the word boundaries
+    block = bytes(range(100))
+    nvm.program(block, 60)
+    assert nvm.programmed(0, 200) == bytes([0] * 60 + [1] * 100 + [0] * 40)
+    assert nvm.compare(block, 60)
+    assert nvm.compare(block, bytes([1] * 100), 60)
+    assert not nvm.compare(block, bytes([1] * 99 + [0]), 60)
+
+    #Erase a block within the programmed one, spanning a word boundary
+    nvm.erase(120, 20)
+    assert nvm.programmed(0, 200) == bytes([0] * 60 + [1] * 60 + [0] * 20 + [1] * 20 + [0] * 40)
+    assert nvm.block(120, 20) == bytes([0xFF] * 20)
+    assert nvm.block(140, 20) == block[80:]
+
+
+def test_nvm_tag_based_across_words(nvm):
+    tag = bytes(i % 3 == 0 for i in range(130))
+    nvm.spm_write(bytes([0xA5] * 130), tag, 62)
+    assert nvm.programmed(62, 130) == tag
+    for i in range(130):
+        assert nvm[62 + i] == (0xA5 if tag[i] else 0xFF)
+
+    nvm.erase(bytes([1] * 65), 62)
+    assert nvm.programmed(62, 130) == bytes(65) + tag[65:]
+
+    #Erasing the whole NVM clears all the words
+    nvm.erase()
+    assert nvm.programmed(0, 1024) == bytes(1024)
+
+
+def test_nvm_map_file(nvm, tmp_path):
+    path = str(tmp_path / 'nvm.bin')
+    nvm.program(data, 100)
+
+    #A new file is initialised with the current content
+    assert nvm.map_file(path)
+    assert nvm.mapped()
+    assert not nvm.persisted()
+    assert nvm.file_tag() == 0
+    assert nvm.block(100, 4) == data
+
+    nvm.program(data, 200)
+    assert nvm.set_file_tag(0x0123456789ABCDEF)
+    assert nvm.sync()
+    nvm.unmap_file()
+    assert not nvm.mapped()
+
+    #The content and the programmed states persist in the file
+    nvm2 = corelib.NonVolatileMemory(1024, 'test', path)
+    assert nvm2.mapped()
+    assert nvm2.persisted()
+    assert nvm2.file_tag() == 0x0123456789ABCDEF
+    assert nvm2.compare(nvm.block(), nvm.programmed(0, 1024), 0)
+
+    #The file can't be mapped by a NVM of a different size
+    assert not corelib.NonVolatileMemory(512, 'test').map_file(path)
+
+
+def test_nvm_map_raw_file(nvm, tmp_path):
+    path = tmp_path / 'nvm.raw'
+    nvm.program(data)
+    assert nvm.map_file(str(path), True)
+    assert not nvm.set_file_tag(1)
+    nvm.unmap_file()
+
+    #A raw file contains only the data, all set as programmed when loaded
+    assert path.stat().st_size == 1024
+    nvm2 = corelib.NonVolatileMemory(1024, 'test', str(path), True)
+    assert nvm2.persisted()
+    assert nvm2.block() == nvm.block()
+    assert nvm2.programmed(0, 1024) == bytes([1] * 1024)
@@ -112,3 +112,161 @@ def test_datasignal_raise():
 
     sigdata, _ = hook.pop(0)
     assert sigdata.data.value() == 1.0
+
+
+class ListSignalHook(corelib.SignalHook):
+    '''Hook recording the raises in order, the data value is read during the call'''
+
+    def __init__(self, signal=None, tag=0):
+        super().__init__()
+        if signal is not None:
+            signal.connect(self, tag)
+        self.raises = []
+
+    def raised(self, sigdata, tag):
+        self.raises.append((sigdata.sigid, sigdata.index, sigdata.data.value()))
+
+
+def test_signalqueue_deferred():
+    queue = corelib.SignalQueue()
+    sig = corelib.Signal()
+    hook = ListSignalHook(sig)
+
+    sig.set_deferred(queue)
+    assert sig.deferred_queue() is not None
+    assert queue.empty()
+
+    sig.raise_(0, 1)
+    assert hook.raises == []
+    assert not queue.empty()
+
+    queue.flush()
+    assert hook.raises == [(0, 0, 1)]
+    assert queue.empty()
+
+    #Back to immediate raises
+    sig.set_deferred(None)
+    sig.raise_(0, 2)
+    assert hook.raises == [(0, 0, 1), (0, 0, 2)]
+
+
+def test_signalqueue_coalescing():
+    queue = corelib.SignalQueue()
+    sig1 = corelib.Signal()
+    sig2 = corelib.Signal()
+    hook = ListSignalHook()
+    sig1.connect(hook, 1)
+    sig2.connect(hook, 2)
+    sig1.set_deferred(queue)
+    sig2.set_deferred(queue)
+
+    sig1.raise_(0, 1)
+    sig1.raise_(1, 2)
+    sig2.raise_(0, 3)
+    sig1.raise_(0, 4, 1)
+    sig1.raise_(0, 5)
+    sig2.raise_(0, 6)
+
+    #The raises with the same signal, sigid and index are merged: the last data
+    #is dispatched at the position of the first raise
+    queue.flush()
+    assert hook.raises == [(0, 0, 5), (1, 0, 2), (0, 0, 6), (0, 1, 4)]
+
+
+def test_signalqueue_payload_copy():
+    queue = corelib.SignalQueue()
+    sig = corelib.Signal()
+    hook = ListSignalHook(sig)
+    sig.set_deferred(queue)
+
+    #Build the objects at runtime and drop them before the flush, the queue
+    #must dispatch its own copy
+    s = ''.join(chr(ord('a') + i) for i in range(8))
+    b = bytes(range(16, 32))
+    sig.raise_(0, s)
+    sig.raise_(1, b)
+    del s, b
+    garbage = [''.join(chr(ord('z') - (i % 26)) for i in range(8)) for _ in range(100)]
+
+    queue.flush()
+    assert hook.raises == [(0, 0, 'abcdefgh'), (1, 0, bytes(range(16, 32)))]
+
+    #A coalesced raise replaces the payload
+    sig.raise_(0, 'first')
+    sig.raise_(0, b'second')
+    queue.flush()
+    assert hook.raises[2:] == [(0, 0, b'second')]
+
+
+def test_signalqueue_raise_in_flush():
+    queue = corelib.SignalQueue()
+    sig1 = corelib.Signal()
+    sig2 = corelib.Signal()
+    sig1.set_deferred(queue)
+    sig2.set_deferred(queue)
+
+    class ChainHook(corelib.SignalHook):
+        def __init__(self):
+            super().__init__()
+            self.raises = []
+        def raised(self, sigdata, tag):
+            v = sigdata.data.value()
+            self.raises.append((tag, v))
+            #Forward to the other signal, and re-raise the same signal once
+            if tag == 1:
+                sig2.raise_(0, v)
+            if tag == 1 and v == 1:
+                sig1.raise_(0, 2)
+
+    hook = ChainHook()
+    sig1.connect(hook, 1)
+    sig2.connect(hook, 2)
+
+    sig1.raise_(0, 1)
+    queue.flush()
+
+    #The raises done during the flush are dispatched by the same flush
+    assert hook.raises == [(1, 1), (2, 1), (1, 2), (2, 2)]
+    assert queue.empty()
+
+
+def test_signalqueue_cancel():
+    queue = corelib.SignalQueue()
+    sig1 = corelib.Signal()
+    sig2 = corelib.Signal()
+    hook1 = ListSignalHook(sig1)
+    hook2 = ListSignalHook(sig2)
+    sig1.set_deferred(queue)
+    sig2.set_deferred(queue)
+
+    sig1.raise_(0, 1)
+    sig2.raise_(0, 2)
+    queue.cancel(sig1)
+    queue.flush()
+    assert hook1.raises == []
+    assert hook2.raises == [(0, 0, 2)]
+
+    #A cancelled raise does not absorb the next ones
+    sig1.raise_(0, 3)
+    queue.flush()
+    assert hook1.raises == [(0, 0, 3)]
+
+
+def test_signalqueue_signal_destroyed():
+    queue = corelib.SignalQueue()
+    sig1 = corelib.Signal()
+    sig2 = corelib.Signal()
+    hook1 = ListSignalHook(sig1)
+    hook2 = ListSignalHook(sig2)
+    sig1.set_deferred(queue)
+    sig2.set_deferred(queue)
+
+    sig1.raise_(0, 1)
+    sig2.raise_(0, 2)
+
+    #Destroying a signal cancels its pending raises
+    del sig1
+    queue.flush()
+    assert hook1.raises == []
+    assert hook2.raises == [(0, 0, 2)]
+    assert queue.empty()
@@ -0,0 +1,124 @@
+# test_core_snapshot.py
+#
+# Copyright 2023 Clement Savergne <csavergne@yahoo.com>
+#
+# This file is part of yasim-avr.
+#
+# yasim-avr is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# yasim-avr is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+
+import pytest
+import yasimavr.lib.core as corelib
+from _test_bench_avr import BenchAVR
+
+
+'''
+Test of the device snapshots on ATMega328
+'''
+
+
+@pytest.fixture
+def bench():
+    b = BenchAVR()
+    #Run the Timer 0 in fast PWM mode, so that the snapshots have
+    #a timer state and a scheduled cycle timer to restore
+    tc = b.dev.TC0
+    tc.OCR0A = 64
+    tc.TCCR0A = 0x83
+    tc.TCCR0B = 0x01
+    b.sim_advance(1000)
+    return b
+
+
+def run_trace(bench):
+    tc = bench.dev.TC0
+    trace = []
+    for i in range(50):
+        bench.sim_advance(37)
+        trace.append((bench.loop.cycle(), int(tc.TCNT0), int(tc.TIFR0)))
+        if i % 10 == 0:
+            tc.TIFR0 = 0x07
+    return trace
+
+
+def test_snapshot_restore(bench):
+    snap = corelib.DeviceSnapshot()
+    assert snap.capture(bench.dev_model)
+    assert snap.valid()
+    assert snap.cycle() == bench.loop.cycle()
+    assert snap.timer_count() > 0
+    assert snap.unsaved_timer_count() == 0
+
+    trace = run_trace(bench)
+
+    assert snap.restore(bench.dev_model)
+    assert bench.loop.cycle() == snap.cycle()
+    assert run_trace(bench) == trace
+
+
+def test_snapshot_fork(bench):
+    snap = corelib.DeviceSnapshot()
+    assert snap.capture(bench.dev_model)
+
+    #A fork shares all its pages until it is captured again
+    fork = snap.fork()
+    assert fork.shared_page_count(snap) == snap.page_count()
+
+    trace = run_trace(bench)
+    assert fork.capture(bench.dev_model)
+    assert fork.shared_page_count(snap) < snap.page_count()
+
+    #The original snapshot is unaffected by the capture of the fork
+    assert snap.restore(bench.dev_model)
+    assert run_trace(bench) == trace
+
+
+def test_snapshot_file(bench, tmp_path):
+    snap = corelib.DeviceSnapshot()
+    assert snap.capture(bench.dev_model)
+    path = str(tmp_path / 'snapshot.bin')
+    assert snap.save(path, bench.fw)
+
+    trace = run_trace(bench)
+
+    loaded = corelib.DeviceSnapshot()
+    assert loaded.load(path, bench.fw)
+    assert loaded.cycle() == snap.cycle()
+    assert loaded.timer_count() == snap.timer_count()
+    assert loaded.restore(bench.dev_model)
+    assert bench.loop.cycle() == snap.cycle()
+    assert run_trace(bench) == trace
+
+
+def test_snapshot_file_invalid(bench, tmp_path):
+    snap = corelib.DeviceSnapshot()
+    assert snap.capture(bench.dev_model)
+    path = tmp_path / 'snapshot.bin'
+    assert snap.save(str(path), bench.fw)
+    content = path.read_bytes()
+
+    #Truncated file, the sections are out of its bounds
+    path.write_bytes(content[:len(content) // 2])
+    assert not corelib.DeviceSnapshot().load(str(path))
+
+    #Unknown format version, stored after the 8-bytes magic
+    corrupted = bytearray(content)
+    corrupted[8] ^= 0xFF
+    path.write_bytes(bytes(corrupted))
+    assert not corelib.DeviceSnapshot().load(str(path))
+
+    #The restoration of the original content succeeds, but not with another firmware
+    path.write_bytes(content)
+    assert corelib.DeviceSnapshot().load(str(path), bench.fw)
+    other_fw = corelib.Firmware()
+    assert not corelib.DeviceSnapshot().load(str(path), other_fw)
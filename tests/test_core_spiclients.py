@@ -0,0 +1,154 @@
+# test_core_spiclients.py
+#
+# Copyright 2023 Clement Savergne <csavergne@yahoo.com>
+#
+# This file is part of yasim-avr.
+#
+# yasim-avr is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# yasim-avr is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+
+import pytest
+import yasimavr.lib.core as corelib
+
+
+'''
+Test of the SPI flash and SD card models, driven by a SPI interface in host mode
+'''
+
+
+class SPIHost:
+
+    def __init__(self, burst=False):
+        self.cycle_manager = corelib.CycleManager()
+        self.logger = corelib.Logger(0)
+        self.spi = corelib.SPI()
+        self.spi.init(self.cycle_manager, self.logger)
+        self.spi.reset()
+        self.spi.set_host_mode(True)
+        self.spi.set_frame_delay(16)
+        self.spi.set_tx_buffer_limit(0)
+        self.spi.set_rx_buffer_limit(0)
+        self.spi.set_burst_mode(burst)
+
+    def add_client(self, client):
+        self.client = client
+        self.spi.add_client(client)
+
+    def transfer(self, frames):
+        '''Exchange the frames with the client selected for the time of the command'''
+        self.client.set_selected(True)
+        self.spi.push_tx(bytes(frames))
+        while self.spi.rx_available() < len(frames):
+            self.cycle_manager.increment_cycle(1)
+            self.cycle_manager.process_timers()
+        self.client.set_selected(False)
+        return bytes(self.spi.pop_rx() for _ in range(len(frames)))
+
+
+@pytest.fixture(params=[False, True], ids=['frames', 'burst'])
+def host(request):
+    return SPIHost(request.param)
+
+
+@pytest.fixture
+def flash(host):
+    f = corelib.SPIFlash(0x10000)
+    host.add_client(f)
+    return f
+
+
+def test_spi_flash_id(host, flash):
+    assert host.transfer([0x9F, 0, 0, 0]) == b'\xFF\xEF\x40\x16'
+
+
+def test_spi_flash_program(host, flash):
+    #Page program without write enable is ignored
+    host.transfer([0x02, 0x00, 0x01, 0xFE, 1, 2, 3, 4])
+    assert flash.memory()[0x1FE] == 0xFF
+
+    host.transfer([0x06])
+    assert host.transfer([0x05, 0]) == b'\xFF\x02'
+
+    #The data rolls over within the page, the write enable is cleared at the end
+    host.transfer([0x02, 0x00, 0x01, 0xFE, 1, 2, 3, 4])
+    assert host.transfer([0x05, 0]) == b'\xFF\x00'
+    assert flash.memory().block(0x1FE, 2) == b'\x01\x02'
+    assert flash.memory().block(0x100, 2) == b'\x03\x04'
+
+    rx = host.transfer([0x03, 0x00, 0x01, 0xFC] + [0] * 6)
+    assert rx[4:] == b'\xFF\xFF\x01\x02\xFF\xFF'
+
+    #Fast read, with a dummy byte after the address
+    rx = host.transfer([0x0B, 0x00, 0x01, 0x00, 0, 0, 0, 0])
+    assert rx[5:] == b'\x03\x04\xFF'
+
+
+def test_spi_flash_erase(host, flash):
+    host.transfer([0x06])
+    host.transfer([0x02, 0x00, 0x10, 0x00, 0xAA, 0x55])
+
+    #Sector erase without write enable is ignored
+    host.transfer([0x20, 0x00, 0x10, 0x00])
+    assert flash.memory().block(0x1000, 2) == b'\xAA\x55'
+
+    host.transfer([0x06])
+    host.transfer([0x20, 0x00, 0x10, 0x80])
+    assert flash.memory().block(0x1000, 2) == b'\xFF\xFF'
+
+
+def test_spi_flash_read_wrap(host, flash):
+    flash.memory().program(b'\x11\x22', 0xFFFE)
+    flash.memory().program(b'\x33', 0)
+
+    #A read rolls over at the end of the memory
+    rx = host.transfer([0x03, 0x00, 0xFF, 0xFE, 0, 0, 0])
+    assert rx[4:] == b'\x11\x22\x33'
+
+
+def test_spi_flash_zero_size():
+    with pytest.raises(ValueError):
+        corelib.SPIFlash(0)
+
+
+def sd_command(host, cmd, arg, extra):
+    frames = [0x40 | cmd, (arg >> 24) & 0xFF, (arg >> 16) & 0xFF, (arg >> 8) & 0xFF, arg & 0xFF, 0x95]
+    return host.transfer(frames + [0xFF] * extra)[6:]
+
+
+def test_spi_sdcard(host):
+    sd = corelib.SPISDCard(1 << 20)
+    host.add_client(sd)
+
+    #Initialisation sequence
+    assert sd_command(host, 0, 0, 2) == b'\xFF\x01'
+    assert sd_command(host, 8, 0x1AA, 6) == b'\xFF\x01\x00\x00\x01\xAA'
+    #A read is rejected while in idle state
+    assert sd_command(host, 17, 0, 2)[1] != 0x00
+    assert sd_command(host, 55, 0, 2) == b'\xFF\x01'
+    assert sd_command(host, 41, 0x40000000, 2) == b'\xFF\x00'
+    assert sd_command(host, 58, 0, 6) == b'\xFF\x00\xC0\xFF\x80\x00'
+
+    #Write of the block 3
+    data = bytes(i & 0xFF for i in range(512))
+    rx = host.transfer([0x58, 0, 0, 0, 3, 0xFF, 0xFF, 0xFF, 0xFE] + list(data) + [0, 0] + [0xFF] * 4)
+    assert rx[-4] == 0x05
+    assert sd.memory().block(3 * 512, 512) == data
+
+    #Read back of the block 3: R1, a byte of delay, the start token and the data
+    rx = sd_command(host, 17, 3, 2 + 512 + 2 + 2)
+    assert rx[:3] == b'\xFF\x00\xFF'
+    assert rx[3] == 0xFE
+    assert rx[4:516] == data
+
+    #Unsupported command
+    assert sd_command(host, 33, 0, 2) == b'\xFF\x04'
@@ -0,0 +1,146 @@
+# test_core_stimulus.py
+#
+# Copyright 2023 Clement Savergne <csavergne@yahoo.com>
+#
+# This file is part of yasim-avr.
+#
+# yasim-avr is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# yasim-avr is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+
+import yasimavr.lib.core as corelib
+from _test_bench_avr import BenchAVR
+from _test_utils import PinState
+
+
+'''
+Test of the record and replay of external stimuli on ATMega328
+'''
+
+
+class CycleSignalHook(corelib.SignalHook):
+
+    def __init__(self, bench, signal):
+        super().__init__()
+        signal.connect(self)
+        self._bench = bench
+        self.events = []
+
+    def raised(self, sigdata, tag):
+        self.events.append((self._bench.loop.cycle(), sigdata.data.as_uint()))
+
+
+def test_stimulus_replay(tmp_path):
+    path = str(tmp_path / 'stimuli.bin')
+
+    #Record the changes of a pin applied in-between simulation steps
+    bench = BenchAVR()
+    pin = bench.dev.pins['PB0']
+    pin.set_external_state(PinState.Low)
+    hook = CycleSignalHook(bench, bench.dev.PORTB.signal())
+    recorder = corelib.StimulusRecorder(bench.dev_model)
+    recorder.add_pin(pin)
+    recorder.set_recording(True)
+    for i in range(10):
+        bench.sim_advance(7 + i)
+        pin.set_external_state(PinState.Low if i % 2 else PinState.High)
+    recorder.set_recording(False)
+    bench.sim_advance(100)
+
+    assert recorder.count() == 10
+    assert recorder.save(path)
+    recorded = hook.events
+    assert len(recorded) == 10
+
+    #Replay them on a new device, the port sees the same changes at the same cycles
+    bench = BenchAVR()
+    bench.dev.pins['PB0'].set_external_state(PinState.Low)
+    hook = CycleSignalHook(bench, bench.dev.PORTB.signal())
+    replayer = corelib.StimulusReplayer(bench.dev_model)
+    assert replayer.load(path)
+    assert replayer.remaining() == 10
+    assert replayer.start()
+    bench.sim_advance(sum(7 + i for i in range(10)) + 100)
+
+    assert replayer.remaining() == 0
+    assert hook.events == recorded
+
+
+class ScheduleHook(corelib.SignalHook):
+
+    def __init__(self, bench):
+        super().__init__()
+        self._bench = bench
+        self.events = []
+
+    def raised(self, sigdata, tag):
+        self.events.append((self._bench.loop.cycle(), sigdata.sigid, sigdata.index, sigdata.data.value()))
+
+
+#The firmware runs at 1kHz, so 1ms is one cycle
+SCHEDULE_TEXT = r'''# comment line
+2s hook 0 1 0 10
++100 hook 0 2 0 1.5   # relative to the previous event
+2500ms hook 0 3 -2 "tab\there\x41\"q\""
+3000000us hook 0 4 0 "a b"
++0.5s hook 0 5 0 0x10
+4000000000ns hook 0 6 0 -3
+1500 pin PB0 H
+'''
+
+
+def test_stimulus_schedule(tmp_path):
+    bench = BenchAVR()
+    pin = bench.dev.pins['PB0']
+    pin.set_external_state(PinState.Low)
+    hook = ScheduleHook(bench)
+    schedule = corelib.StimulusSchedule(bench.dev_model)
+    schedule.add_hook(hook)
+
+    path = tmp_path / 'schedule.txt'
+    path.write_text(SCHEDULE_TEXT)
+    assert schedule.load_text(str(path))
+    assert schedule.remaining() == 7
+
+    assert schedule.start()
+    bench.sim_advance(1600 - bench.loop.cycle())
+    assert pin.state() == PinState.High
+    bench.sim_advance(3000)
+
+    #The events are sorted by time, the durations are converted with the device frequency
+    assert schedule.remaining() == 0
+    assert hook.events == [
+        (2000, 1, 0, 10),
+        (2100, 2, 0, 1.5),
+        (2500, 3, -2, 'tab\thereA"q"'),
+        (3000, 4, 0, 'a b'),
+        (3500, 5, 0, 16),
+        (4000, 6, 0, -3),
+    ]
+
+
+def test_stimulus_schedule_syntax_error():
+    bench = BenchAVR()
+    schedule = corelib.StimulusSchedule(bench.dev_model)
+    assert schedule.parse('2000 pin PB0 H\n3000 pin PB0 L\n')
+    assert schedule.remaining() == 2
+
+    #A rejected text leaves the previous schedule unchanged
+    for text in ['10 pin PB0\n',
+                 '10xs pin PB0 H\n',
+                 '-5 pin PB0 H\n',
+                 '10 foo 1 2\n',
+                 '10 hook 0 1 0 "abc\n',
+                 '10 hook 0 1 0 "\\xZZ"\n',
+                 '10 pin PB0 H\nxyz\n']:
+        assert not schedule.parse(text)
+        assert schedule.remaining() == 2
@@ -0,0 +1,159 @@
+# test_core_twi.py
+#
+# Copyright 2023 Clement Savergne <csavergne@yahoo.com>
+#
+# This file is part of yasim-avr.
+#
+# yasim-avr is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# yasim-avr is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+
+import pytest
+import yasimavr.lib.core as corelib
+
+
+'''
+Test of the TWI master transaction mode with a slave model, compared to
+the packet mode
+'''
+
+TWISignal = corelib.TWI.SignalId
+BusSignal = corelib.TWIBus.SignalId
+
+BIT_DELAY = 10
+
+#Delay emulating the firmware reaction to each master event
+REACTION_DELAY = 10
+
+
+class TWIMasterBench(corelib.SignalHook):
+
+    def __init__(self, transaction_mode):
+        super().__init__()
+        self.cycle_manager = corelib.CycleManager()
+        self.logger = corelib.Logger(0)
+        self.twi = corelib.TWI()
+        self.twi.init(self.cycle_manager, self.logger)
+        self.twi.reset()
+        self.twi.set_master_enabled(True)
+        self.twi.set_bit_delay(BIT_DELAY)
+        self.twi.set_transaction_mode(transaction_mode)
+        self.twi.signal().connect(self)
+
+        self.eeprom = corelib.TWIEEPROM(256, 8)
+        self.bus = corelib.TWIBus()
+        self.bus.add_endpoint(self.twi)
+        self.bus.add_endpoint(self.eeprom)
+
+        self.bus_hook = BusPacketHook(self.bus.signal())
+        self.events = []
+
+    def raised(self, sigdata, tag):
+        if sigdata.sigid in (TWISignal.AddrAck, TWISignal.TxComplete, TWISignal.RxComplete):
+            self.events.append((self.cycle_manager.cycle(), int(sigdata.sigid), sigdata.data.as_uint()))
+
+    def advance(self, cycles):
+        for _ in range(cycles):
+            self.cycle_manager.increment_cycle(1)
+            self.cycle_manager.process_timers()
+
+    def wait_event(self):
+        n = len(self.events)
+        while len(self.events) == n:
+            self.advance(1)
+        self.advance(REACTION_DELAY)
+        return self.events[-1]
+
+    def write(self, addr, data):
+        assert self.twi.start_transfer()
+        self.twi.send_address(0x50, False)
+        assert self.wait_event()[2]
+        for b in [addr] + list(data):
+            self.twi.start_master_tx(b)
+            assert self.wait_event()[2]
+        self.twi.end_transfer()
+
+    def read(self, addr, n):
+        assert self.twi.start_transfer()
+        self.twi.send_address(0x50, False)
+        assert self.wait_event()[2]
+        self.twi.start_master_tx(addr)
+        assert self.wait_event()[2]
+        #Repeated start for the read
+        self.twi.send_address(0x50, True)
+        assert self.wait_event()[2]
+        data = []
+        for i in range(n):
+            self.twi.start_master_rx()
+            data.append(self.wait_event()[2])
+            self.twi.set_master_ack(i < n - 1)
+        self.twi.end_transfer()
+        return bytes(data)
+
+
+class BusPacketHook(corelib.SignalHook):
+
+    def __init__(self, signal):
+        super().__init__()
+        signal.connect(self)
+        self.count = 0
+
+    def raised(self, sigdata, tag):
+        if sigdata.sigid in (BusSignal.Address, BusSignal.Data):
+            self.count += 1
+
+
+def run_sequence(bench):
+    bench.advance(5)
+    bench.write(0x10, b'\xA5\x5A\x3C')
+    bench.advance(50)
+    data = bench.read(0x10, 3)
+    bench.advance(50)
+    return data
+
+
+def test_twi_transaction_timing():
+    packet_bench = TWIMasterBench(False)
+    tlm_bench = TWIMasterBench(True)
+    assert run_sequence(packet_bench) == b'\xA5\x5A\x3C'
+    assert run_sequence(tlm_bench) == b'\xA5\x5A\x3C'
+
+    #Each byte takes 9 bit times in both modes, and the events to the upper
+    #layer are raised at the same cycles
+    assert len(tlm_bench.events) == 11
+    assert tlm_bench.events == packet_bench.events
+    first_cycle = tlm_bench.events[0][0]
+    assert first_cycle == 5 + 9 * BIT_DELAY
+
+    assert tlm_bench.eeprom.memory().block(0x10, 3) == b'\xA5\x5A\x3C'
+    assert packet_bench.eeprom.memory().block(0x10, 3) == b'\xA5\x5A\x3C'
+
+    #No packet is circulated on the bus in transaction mode
+    assert packet_bench.bus_hook.count > 0
+    assert tlm_bench.bus_hook.count == 0
+
+    assert tlm_bench.twi.master_state() == corelib.TWI.State.Idle
+    assert packet_bench.twi.master_state() == corelib.TWI.State.Idle
+
+
+def test_twi_transaction_nack():
+    bench = TWIMasterBench(True)
+    bench.advance(5)
+
+    #An address not matching any slave is not acknowledged, with the same timing
+    assert bench.twi.start_transfer()
+    bench.twi.send_address(0x33, False)
+    cycle, sigid, ack = bench.wait_event()
+    assert sigid == TWISignal.AddrAck
+    assert not ack
+    assert cycle == 5 + 9 * BIT_DELAY
+    bench.twi.end_transfer()
@@ -0,0 +1,150 @@
+# test_core_twislaves.py
+#
+# Copyright 2023 Clement Savergne <csavergne@yahoo.com>
+#
+# This file is part of yasim-avr.
+#
+# yasim-avr is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# yasim-avr is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with yasim-avr.  If not, see <http://www.gnu.org/licenses/>.
+
+import pytest
+import yasimavr.lib.core as corelib
+
+
+'''
+Test of the TWI EEPROM and register map slave models, driven by
+transaction-level transfers on a bus
+'''
+
+MapSignal = corelib.TWIRegisterMap.SignalId
+
+
+def make_bus(model):
+    bus = corelib.TWIBus()
+    bus.add_endpoint(model)
+    return bus
+
+
+def test_twi_eeprom_page_wrap():
+    eeprom = corelib.TWIEEPROM(256, 8)
+    bus = make_bus(eeprom)
+
+    #The data rolls over within the 8-bytes page
+    assert bus.transfer_write(0x50, b'\x0E\x01\x02\x03\x04') == 5
+    assert eeprom.memory().block(0x08, 9) == b'\x03\x04\xFF\xFF\xFF\xFF\x01\x02\xFF'
+
+
+def test_twi_eeprom_address_pointer():
+    eeprom = corelib.TWIEEPROM(256, 8)
+    bus = make_bus(eeprom)
+    eeprom.memory().program(b'\x01\x02\x21\x22\x23', 0x0E)
+
+    #Random read: the word address is written then the data is read
+    assert bus.transfer_write(0x50, b'\x0E') == 1
+    assert bus.transfer_read(0x50, 2) == b'\x01\x02'
+
+    #Current address read: continues from the pointer left by the previous transfer
+    assert bus.transfer_read(0x50, 3) == b'\x21\x22\x23'
+
+    #Sequential reads roll over at the end of the memory
+    eeprom.memory().program(b'\xF1\xF2', 0xFE)
+    eeprom.memory().program(b'\x99', 0)
+    assert bus.transfer_write(0x50, b'\xFE') == 1
+    assert bus.transfer_read(0x50, 3) == b'\xF1\xF2\x99'
+
+    #Other device addresses are not acknowledged
+    assert bus.transfer_read(0x51, 1) is None
+
+
+def test_twi_eeprom_block_address():
+    #1024 bytes with a 1-byte word address: the 2 LSBs of the device address
+    #select the 256-bytes block
+    eeprom = corelib.TWIEEPROM(1024, 16)
+    bus = make_bus(eeprom)
+
+    assert bus.transfer_write(0x52, b'\x05\xAB') == 2
+    assert eeprom.memory().block(0x205, 1) == b'\xAB'
+
+    assert bus.transfer_write(0x52, b'\x05') == 1
+    assert bus.transfer_read(0x52, 1) == b'\xAB'
+    assert bus.transfer_read(0x54, 1) is None
+
+
+def test_twi_eeprom_write_delay():
+    cycle_manager = corelib.CycleManager()
+    eeprom = corelib.TWIEEPROM(256, 8)
+    eeprom.set_write_delay(cycle_manager, 100)
+    bus = make_bus(eeprom)
+
+    #The device does not acknowledge its address during the write cycle
+    assert bus.transfer_write(0x50, b'\x20\x42') == 2
+    assert eeprom.busy()
+    assert bus.transfer_read(0x50, 1) is None
+
+    cycle_manager.increment_cycle(100)
+    assert not eeprom.busy()
+    assert bus.transfer_write(0x50, b'\x20') == 1
+    assert bus.transfer_read(0x50, 1) == b'\x42'
+
+
+class RegisterHook(corelib.SignalHook):
+
+    def __init__(self, regmap):
+        super().__init__()
+        regmap.signal().connect(self)
+        self.regmap = regmap
+        self.update = None
+        self.events = []
+
+    def raised(self, sigdata, tag):
+        self.events.append((sigdata.sigid, sigdata.index, sigdata.data.as_uint()))
+        #Update the register just in time for the read
+        if sigdata.sigid == MapSignal.Read and self.update is not None:
+            self.regmap.write_register(sigdata.index, self.update)
+
+
+def test_twi_regmap_auto_increment():
+    regmap = corelib.TWIRegisterMap(0x20, 16)
+    bus = make_bus(regmap)
+    hook = RegisterHook(regmap)
+    regmap.write_registers(b'\x10\x11\x12', 4)
+
+    assert bus.transfer_write(0x20, b'\x04') == 1
+    assert bus.transfer_read(0x20, 3) == b'\x10\x11\x12'
+
+    #The index rolls over at the end of the map
+    assert bus.transfer_write(0x20, b'\x0E\xAA\xBB\xCC') == 4
+    assert regmap.read_register(14) == 0xAA
+    assert regmap.read_register(15) == 0xBB
+    assert regmap.read_register(0) == 0xCC
+
+    assert hook.events == [(MapSignal.Read, 4, 0),
+                           (MapSignal.Write, 14, 0xAA),
+                           (MapSignal.Write, 15, 0xBB),
+                           (MapSignal.Write, 0, 0xCC)]
+
+    hook.update = 0x77
+    assert bus.transfer_write(0x20, b'\x02') == 1
+    assert bus.transfer_read(0x20, 2) == b'\x77\x00'
+
+
+def test_twi_regmap_wide_index():
+    #Above 256 registers, the index is written on 2 bytes, MSB first
+    regmap = corelib.TWIRegisterMap(0x20, 300)
+    bus = make_bus(regmap)
+
+    assert bus.transfer_write(0x20, b'\x01\x2A\x55') == 3
+    assert regmap.read_register(0x12A) == 0x55
+
+    assert bus.transfer_write(0x20, b'\x01\x2A') == 2
+    assert bus.transfer_read(0x20, 1) == b'\x55'